@@ -0,0 +1,554 @@
+/* binner.c -- Accumulate time-ordered data into maps
+ *
+ * Copyright 2011-2013 Maurizio Tomasi.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.  */
+
+#include "config.h"
+
+#include <hpixlib/hpix.h>
+#include <assert.h>
+#include <math.h>
+#include <string.h>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+/* A binner accumulates samples into a set of per-pixel sums. To
+ * avoid atomic operations on the accumulators (which scale badly with
+ * the number of threads), the samples of each chunk are first
+ * distributed into "buckets", each of them covering a contiguous
+ * range of pixel indexes. Every bucket is then processed by exactly
+ * one thread. Samples within a bucket are kept in the same order as
+ * they were passed by the caller: this means that the result does
+ * not depend on the number of threads.
+ *
+ * For polarized binning, each sample `d` is modeled as
+ *
+ *     d = I + Q cos(2 psi) + U sin(2 psi),
+ *
+ * and for each pixel we accumulate the upper triangle of the 3x3
+ * matrix A^T W A together with the vector A^T W d. */
+
+/* Number of buckets assigned to each thread */
+#define BUCKETS_PER_THREAD 16
+
+/* Chunks smaller than this are accumulated serially */
+#define MIN_SAMPLES_FOR_BUCKETS 8192
+
+/* Number of terms accumulated for polarized binning, besides the
+ * signal and the weight (see accumulate_sample) */
+#define NUM_OF_POL_TERMS 7
+
+struct hpix_binner_t {
+    hpix_resolution_t      * resolution;
+    hpix_ordering_scheme_t   scheme;
+    int                      polarization_flag;
+
+    double                 * signal;
+    double                 * weights;
+    uint64_t               * hits;
+    double                 * pol_terms;
+
+    /* Scratch buffers, reused across calls */
+    hpix_pixel_num_t       * pixel_buf;
+    size_t                 * order_buf;
+    size_t                   scratch_size;
+    size_t                 * bucket_offsets;
+    size_t                   bucket_offsets_size;
+};
+
+/**********************************************************************/
+
+
+hpix_binner_t *
+hpix_create_binner(hpix_nside_t nside,
+		   hpix_ordering_scheme_t scheme,
+		   int polarization_flag)
+{
+    assert(hpix_valid_nside(nside));
+
+    hpix_binner_t * binner = hpix_calloc(sizeof(hpix_binner_t), 1);
+    binner->resolution = hpix_create_resolution(nside);
+    binner->scheme = scheme;
+    binner->polarization_flag = polarization_flag;
+
+    const size_t num_of_pixels = hpix_num_of_pixels(binner->resolution);
+    binner->signal = hpix_calloc(sizeof(binner->signal[0]), num_of_pixels);
+    binner->weights = hpix_calloc(sizeof(binner->weights[0]), num_of_pixels);
+    binner->hits = hpix_calloc(sizeof(binner->hits[0]), num_of_pixels);
+    if(polarization_flag)
+	binner->pol_terms = hpix_calloc(sizeof(binner->pol_terms[0]),
+					NUM_OF_POL_TERMS * num_of_pixels);
+
+    return binner;
+}
+
+/**********************************************************************/
+
+
+void
+hpix_free_binner(hpix_binner_t * binner)
+{
+    if(binner == NULL)
+	return;
+
+    hpix_free_resolution(binner->resolution);
+    hpix_free(binner->signal);
+    hpix_free(binner->weights);
+    hpix_free(binner->hits);
+    hpix_free(binner->pol_terms);
+    hpix_free(binner->pixel_buf);
+    hpix_free(binner->order_buf);
+    hpix_free(binner->bucket_offsets);
+    hpix_free(binner);
+}
+
+/**********************************************************************/
+
+
+void
+hpix_reset_binner(hpix_binner_t * binner)
+{
+    assert(binner);
+
+    const size_t num_of_pixels = hpix_num_of_pixels(binner->resolution);
+    memset(binner->signal, 0, num_of_pixels * sizeof(binner->signal[0]));
+    memset(binner->weights, 0, num_of_pixels * sizeof(binner->weights[0]));
+    memset(binner->hits, 0, num_of_pixels * sizeof(binner->hits[0]));
+    if(binner->polarization_flag)
+	memset(binner->pol_terms, 0,
+	       NUM_OF_POL_TERMS * num_of_pixels * sizeof(binner->pol_terms[0]));
+}
+
+/**********************************************************************/
+
+
+const hpix_resolution_t *
+hpix_binner_resolution(const hpix_binner_t * binner)
+{
+    assert(binner);
+    return binner->resolution;
+}
+
+/**********************************************************************/
+
+
+hpix_ordering_scheme_t
+hpix_binner_ordering_scheme(const hpix_binner_t * binner)
+{
+    assert(binner);
+    return binner->scheme;
+}
+
+/**********************************************************************/
+
+
+/* Make sure that the scratch buffers can hold `num_of_samples`
+ * elements. Memory is never shrunk, so that in the steady state no
+ * allocation is done. */
+static void
+grow_scratch_buffers(hpix_binner_t * binner, size_t num_of_samples)
+{
+    if(num_of_samples <= binner->scratch_size)
+	return;
+
+    hpix_free(binner->pixel_buf);
+    hpix_free(binner->order_buf);
+    binner->pixel_buf = hpix_malloc(sizeof(binner->pixel_buf[0]),
+				    num_of_samples);
+    binner->order_buf = hpix_malloc(sizeof(binner->order_buf[0]),
+				    num_of_samples);
+    binner->scratch_size = num_of_samples;
+}
+
+/**********************************************************************/
+
+
+static void
+grow_bucket_offsets(hpix_binner_t * binner, size_t size)
+{
+    if(size <= binner->bucket_offsets_size)
+	return;
+
+    hpix_free(binner->bucket_offsets);
+    binner->bucket_offsets = hpix_malloc(sizeof(binner->bucket_offsets[0]),
+					 size);
+    binner->bucket_offsets_size = size;
+}
+
+/**********************************************************************/
+
+
+static inline void
+accumulate_sample(hpix_binner_t * binner,
+		  hpix_pixel_num_t pixel,
+		  double psi,
+		  double value,
+		  double weight)
+{
+    binner->signal[pixel] += weight * value;
+    binner->weights[pixel] += weight;
+    binner->hits[pixel]++;
+
+    if(binner->polarization_flag)
+    {
+	const double cos_2psi = cos(2.0 * psi);
+	const double sin_2psi = sin(2.0 * psi);
+	double * terms = binner->pol_terms + NUM_OF_POL_TERMS * pixel;
+
+	terms[0] += weight * cos_2psi;
+	terms[1] += weight * sin_2psi;
+	terms[2] += weight * cos_2psi * cos_2psi;
+	terms[3] += weight * cos_2psi * sin_2psi;
+	terms[4] += weight * sin_2psi * sin_2psi;
+	terms[5] += weight * value * cos_2psi;
+	terms[6] += weight * value * sin_2psi;
+    }
+}
+
+/**********************************************************************/
+
+
+#define SAMPLE_PSI(psi, idx)    ((psi) != NULL ? (psi)[idx] : 0.0)
+#define SAMPLE_WEIGHT(w, idx)   ((w) != NULL ? (w)[idx] : 1.0)
+
+/* Accumulate the samples whose pixel indexes have already been
+ * computed and saved in binner->pixel_buf. */
+static void
+accumulate_chunk(hpix_binner_t * binner,
+		 const hpix_pixel_num_t * pixels,
+		 const double * psi,
+		 const double * values,
+		 const double * weights,
+		 size_t num_of_samples)
+{
+#ifdef _OPENMP
+    const int num_of_threads = omp_get_max_threads();
+#else
+    const int num_of_threads = 1;
+#endif
+
+    if(num_of_threads == 1 || num_of_samples < MIN_SAMPLES_FOR_BUCKETS)
+    {
+	for(size_t idx = 0; idx < num_of_samples; ++idx)
+	    accumulate_sample(binner, pixels[idx],
+			      SAMPLE_PSI(psi, idx),
+			      values[idx],
+			      SAMPLE_WEIGHT(weights, idx));
+	return;
+    }
+
+    const size_t num_of_pixels = hpix_num_of_pixels(binner->resolution);
+    size_t num_of_buckets = BUCKETS_PER_THREAD * num_of_threads;
+    if(num_of_buckets > num_of_pixels)
+	num_of_buckets = num_of_pixels;
+    const size_t pixels_per_bucket =
+	(num_of_pixels + num_of_buckets - 1) / num_of_buckets;
+
+    /* bucket_offsets[t * num_of_buckets + b] is initially the number
+     * of samples of thread `t` falling in bucket `b`, then it becomes
+     * the position in `order_buf` where the next sample should be
+     * written. */
+    grow_bucket_offsets(binner, num_of_threads * num_of_buckets);
+    size_t * offsets = binner->bucket_offsets;
+    size_t * order = binner->order_buf;
+
+#pragma omp parallel num_threads(num_of_threads) default(shared)
+    {
+#ifdef _OPENMP
+	const int thread_num = omp_get_thread_num();
+	const int actual_threads = omp_get_num_threads();
+#else
+	const int thread_num = 0;
+	const int actual_threads = 1;
+#endif
+	const size_t first = num_of_samples * thread_num / actual_threads;
+	const size_t last = num_of_samples * (thread_num + 1) / actual_threads;
+	size_t * my_offsets = offsets + thread_num * num_of_buckets;
+
+	/* 1. Histogram of the samples in each bucket */
+	memset(my_offsets, 0, num_of_buckets * sizeof(my_offsets[0]));
+	for(size_t idx = first; idx < last; ++idx)
+	    my_offsets[pixels[idx] / pixels_per_bucket]++;
+
+#pragma omp barrier
+#pragma omp single
+	{
+	    /* 2. Convert counts into offsets. Threads that were not
+	     * spawned have no samples at all. */
+	    size_t running_sum = 0;
+	    for(size_t bucket = 0; bucket < num_of_buckets; ++bucket)
+	    {
+		for(int t = 0; t < actual_threads; ++t)
+		{
+		    size_t count = offsets[t * num_of_buckets + bucket];
+		    offsets[t * num_of_buckets + bucket] = running_sum;
+		    running_sum += count;
+		}
+	    }
+	}
+
+	/* 3. Scatter the indexes of the samples into the buckets */
+	for(size_t idx = first; idx < last; ++idx)
+	    order[my_offsets[pixels[idx] / pixels_per_bucket]++] = idx;
+
+#pragma omp barrier
+
+	/* 4. Accumulate each bucket. After step 3, the offsets of the
+	 * last thread mark the end of each bucket. */
+	const size_t * bucket_ends =
+	    offsets + (actual_threads - 1) * num_of_buckets;
+#pragma omp for schedule(dynamic,1)
+	for(size_t bucket = 0; bucket < num_of_buckets; ++bucket)
+	{
+	    const size_t start = (bucket > 0) ? bucket_ends[bucket - 1] : 0;
+	    for(size_t pos = start; pos < bucket_ends[bucket]; ++pos)
+	    {
+		const size_t idx = order[pos];
+		accumulate_sample(binner, pixels[idx],
+				  SAMPLE_PSI(psi, idx),
+				  values[idx],
+				  SAMPLE_WEIGHT(weights, idx));
+	    }
+	}
+    }
+}
+
+/**********************************************************************/
+
+
+void
+hpix_binner_add_pixels(hpix_binner_t * binner,
+		       const hpix_pixel_num_t * pixels,
+		       const double * psi,
+		       const double * values,
+		       const double * weights,
+		       size_t num_of_samples)
+{
+    assert(binner);
+    assert(pixels);
+    assert(values);
+    assert(psi != NULL || ! binner->polarization_flag);
+
+    grow_scratch_buffers(binner, num_of_samples);
+    accumulate_chunk(binner, pixels, psi, values, weights, num_of_samples);
+}
+
+/**********************************************************************/
+
+
+void
+hpix_binner_add_angles(hpix_binner_t * binner,
+		       const double * theta,
+		       const double * phi,
+		       const double * psi,
+		       const double * values,
+		       const double * weights,
+		       size_t num_of_samples)
+{
+    assert(binner);
+    assert(theta && phi);
+    assert(values);
+    assert(psi != NULL || ! binner->polarization_flag);
+
+    hpix_angles_to_pixel_fn_t * angles_to_pixel_fn =
+	(binner->scheme == HPIX_ORDER_SCHEME_NEST)
+	? hpix_angles_to_nest_pixel
+	: hpix_angles_to_ring_pixel;
+
+    grow_scratch_buffers(binner, num_of_samples);
+    hpix_pixel_num_t * pixels = binner->pixel_buf;
+
+#pragma omp parallel for default(shared) schedule(static)
+    for(size_t idx = 0; idx < num_of_samples; ++idx)
+	pixels[idx] = angles_to_pixel_fn(binner->resolution,
+					 theta[idx], phi[idx]);
+
+    accumulate_chunk(binner, pixels, psi, values, weights, num_of_samples);
+}
+
+/**********************************************************************/
+
+
+void
+hpix_binner_add_vectors(hpix_binner_t * binner,
+			const hpix_vector_t * vectors,
+			const double * psi,
+			const double * values,
+			const double * weights,
+			size_t num_of_samples)
+{
+    assert(binner);
+    assert(vectors);
+    assert(values);
+    assert(psi != NULL || ! binner->polarization_flag);
+
+    hpix_vector_to_pixel_fn_t * vector_to_pixel_fn =
+	(binner->scheme == HPIX_ORDER_SCHEME_NEST)
+	? hpix_vector_to_nest_pixel
+	: hpix_vector_to_ring_pixel;
+
+    grow_scratch_buffers(binner, num_of_samples);
+    hpix_pixel_num_t * pixels = binner->pixel_buf;
+
+#pragma omp parallel for default(shared) schedule(static)
+    for(size_t idx = 0; idx < num_of_samples; ++idx)
+	pixels[idx] = vector_to_pixel_fn(binner->resolution, &vectors[idx]);
+
+    accumulate_chunk(binner, pixels, psi, values, weights, num_of_samples);
+}
+
+/**********************************************************************/
+
+
+static hpix_map_t *
+create_output_map(const hpix_binner_t * binner)
+{
+    return hpix_create_map(hpix_nside(binner->resolution), binner->scheme);
+}
+
+/**********************************************************************/
+
+
+hpix_map_t *
+hpix_binner_hit_map(const hpix_binner_t * binner)
+{
+    assert(binner);
+
+    hpix_map_t * map = create_output_map(binner);
+    double * pixels = hpix_map_pixels(map);
+    const size_t num_of_pixels = hpix_map_num_of_pixels(map);
+    for(size_t idx = 0; idx < num_of_pixels; ++idx)
+	pixels[idx] = binner->hits[idx];
+
+    return map;
+}
+
+/**********************************************************************/
+
+
+hpix_map_t *
+hpix_binner_weight_map(const hpix_binner_t * binner)
+{
+    assert(binner);
+
+    hpix_map_t * map = create_output_map(binner);
+    memcpy(hpix_map_pixels(map), binner->weights,
+	   hpix_map_num_of_pixels(map) * sizeof(double));
+
+    return map;
+}
+
+/**********************************************************************/
+
+
+hpix_map_t *
+hpix_binner_signal_map(const hpix_binner_t * binner)
+{
+    assert(binner);
+
+    hpix_map_t * map = create_output_map(binner);
+    memcpy(hpix_map_pixels(map), binner->signal,
+	   hpix_map_num_of_pixels(map) * sizeof(double));
+
+    return map;
+}
+
+/**********************************************************************/
+
+
+hpix_map_t *
+hpix_binner_binned_map(const hpix_binner_t * binner)
+{
+    assert(binner);
+
+    hpix_map_t * map = create_output_map(binner);
+    double * pixels = hpix_map_pixels(map);
+    const size_t num_of_pixels = hpix_map_num_of_pixels(map);
+
+#pragma omp parallel for default(shared)
+    for(size_t idx = 0; idx < num_of_pixels; ++idx)
+    {
+	if(binner->weights[idx] > 0.0)
+	    pixels[idx] = binner->signal[idx] / binner->weights[idx];
+	else
+	    pixels[idx] = NAN;
+    }
+
+    return map;
+}
+
+/**********************************************************************/
+
+
+void
+hpix_binner_iqu_maps(const hpix_binner_t * binner,
+		     double min_determinant,
+		     hpix_map_t ** map_i,
+		     hpix_map_t ** map_q,
+		     hpix_map_t ** map_u)
+{
+    assert(binner);
+    assert(binner->polarization_flag);
+    assert(map_i && map_q && map_u);
+
+    *map_i = create_output_map(binner);
+    *map_q = create_output_map(binner);
+    *map_u = create_output_map(binner);
+
+    double * pixels_i = hpix_map_pixels(*map_i);
+    double * pixels_q = hpix_map_pixels(*map_q);
+    double * pixels_u = hpix_map_pixels(*map_u);
+    const size_t num_of_pixels = hpix_map_num_of_pixels(*map_i);
+
+#pragma omp parallel for default(shared)
+    for(size_t idx = 0; idx < num_of_pixels; ++idx)
+    {
+	const double weight = binner->weights[idx];
+	const double * terms = binner->pol_terms + NUM_OF_POL_TERMS * idx;
+	hpix_matrix_t matrix, inverse;
+
+	pixels_i[idx] = pixels_q[idx] = pixels_u[idx] = NAN;
+	if(weight <= 0.0)
+	    continue;
+
+	/* Normalize the matrix by the total weight, so that the
+	 * threshold on the determinant does not depend on the number
+	 * of samples */
+	matrix.m[0][0] = 1.0;
+	matrix.m[0][1] = matrix.m[1][0] = terms[0] / weight;
+	matrix.m[0][2] = matrix.m[2][0] = terms[1] / weight;
+	matrix.m[1][1] = terms[2] / weight;
+	matrix.m[1][2] = matrix.m[2][1] = terms[3] / weight;
+	matrix.m[2][2] = terms[4] / weight;
+
+	if(hpix_matrix_determinant(&matrix) < min_determinant
+	   || ! hpix_matrix_inverse(&inverse, &matrix))
+	    continue;
+
+	const hpix_vector_t rhs = {
+	    .x = binner->signal[idx] / weight,
+	    .y = terms[5] / weight,
+	    .z = terms[6] / weight
+	};
+	hpix_vector_t stokes;
+	hpix_matrix_vector_mul(&stokes, &inverse, &rhs);
+
+	pixels_i[idx] = stokes.x;
+	pixels_q[idx] = stokes.y;
+	pixels_u[idx] = stokes.z;
+    }
+}
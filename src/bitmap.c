@@ -21,26 +21,11 @@
 #include <float.h>
 #include <math.h>
 #include <assert.h>
+#include <stdlib.h>
+#include <string.h>
 
-typedef int inside_test_t (const hpix_bmp_projection_t * proj,
-			   unsigned int x,
-			   unsigned int y);
-typedef int xy_to_angles_t (const hpix_bmp_projection_t * proj,
-			    unsigned int x,
-			    unsigned int y,
-			    double * theta,
-			    double * phi);
-
-struct ___hpix_bmp_projection_t {
-    unsigned int           width;
-    unsigned int           height;
-    hpix_coordinates_t     coordsys;
-
-    hpix_projection_type_t type;
-    xy_to_angles_t         * xy_to_angles_fn;
-    void                   * angle_to_xy_fn;
-    inside_test_t          * inside_test_fn;
-};
+#include "constants.h"
+#include "bmp_projection.h"
 
 /**********************************************************************/
 
@@ -54,6 +39,7 @@ hpix_create_bmp_projection(unsigned int width, unsigned int height)
     obj->height = height;
     obj->xy_to_angles_fn = NULL;
     obj->angle_to_xy_fn = NULL;
+    obj->angles_to_xy_batch_fn = NULL;
     obj->inside_test_fn = NULL;
     obj->type = HPIX_PROJ_NULL;
 
@@ -109,7 +95,8 @@ hpix_set_equirectangular_projection(hpix_bmp_projection_t * proj)
     assert(proj);
 
     proj->xy_to_angles_fn = hpix_equirectangular_xy_to_angles;
-    proj->angle_to_xy_fn = NULL;
+    proj->angle_to_xy_fn = hpix_equirectangular_angles_to_xy;
+    proj->angles_to_xy_batch_fn = NULL;
     proj->inside_test_fn = hpix_equirectangular_is_xy_inside;
     proj->type = HPIX_PROJ_EQUIRECTANGULAR;
 }
@@ -123,13 +110,105 @@ hpix_set_mollweide_projection(hpix_bmp_projection_t * proj)
     assert(proj);
 
     proj->xy_to_angles_fn = hpix_mollweide_xy_to_angles;
-    proj->angle_to_xy_fn = NULL;
+    proj->angle_to_xy_fn = hpix_mollweide_angles_to_xy;
+    proj->angles_to_xy_batch_fn = hpix_mollweide_angles_to_xy_batch;
     proj->inside_test_fn = hpix_mollweide_is_xy_inside;
     proj->type = HPIX_PROJ_MOLLWEIDE;
 }
 
 /**********************************************************************/
 
+
+/* Compute the unit vectors used by the gnomonic and orthographic
+ * projections. The sky is seen from the inside of the sphere, with
+ * the north towards the top of the bitmap: therefore longitudes
+ * increase towards the left. */
+static void
+set_view_axes(hpix_bmp_projection_t * proj,
+	      double center_theta,
+	      double center_phi)
+{
+    const double sin_theta = sin(center_theta);
+    const double cos_theta = cos(center_theta);
+    const double sin_phi = sin(center_phi);
+    const double cos_phi = cos(center_phi);
+
+    hpix_angles_to_vector(center_theta, center_phi, &proj->center);
+    proj->right_axis = (hpix_vector_t) { .x = sin_phi,
+					 .y = -cos_phi,
+					 .z = 0.0 };
+    proj->up_axis = (hpix_vector_t) { .x = -cos_theta * cos_phi,
+				      .y = -cos_theta * sin_phi,
+				      .z = sin_theta };
+}
+
+/**********************************************************************/
+
+
+void
+hpix_set_gnomonic_projection(hpix_bmp_projection_t * proj,
+			     double center_theta,
+			     double center_phi,
+			     double field_of_view)
+{
+    assert(proj);
+    assert(field_of_view > 0.0 && field_of_view < M_PI);
+
+    set_view_axes(proj, center_theta, center_phi);
+    proj->field_of_view = field_of_view;
+
+    proj->xy_to_angles_fn = hpix_gnomonic_xy_to_angles;
+    proj->angle_to_xy_fn = hpix_gnomonic_angles_to_xy;
+    proj->angles_to_xy_batch_fn = NULL;
+    proj->inside_test_fn = hpix_gnomonic_is_xy_inside;
+    proj->type = HPIX_PROJ_GNOMONIC;
+}
+
+/**********************************************************************/
+
+
+void
+hpix_set_orthographic_projection(hpix_bmp_projection_t * proj,
+				 double center_theta,
+				 double center_phi)
+{
+    assert(proj);
+
+    set_view_axes(proj, center_theta, center_phi);
+
+    proj->xy_to_angles_fn = hpix_orthographic_xy_to_angles;
+    proj->angle_to_xy_fn = hpix_orthographic_angles_to_xy;
+    proj->angles_to_xy_batch_fn = NULL;
+    proj->inside_test_fn = hpix_orthographic_is_xy_inside;
+    proj->type = HPIX_PROJ_ORTHOGRAPHIC;
+}
+
+/**********************************************************************/
+
+
+void
+hpix_set_cartesian_projection(hpix_bmp_projection_t * proj,
+			      double lon_min, double lon_max,
+			      double lat_min, double lat_max)
+{
+    assert(proj);
+    assert(lon_min < lon_max && lon_max - lon_min <= 2.0 * M_PI);
+    assert(lat_min < lat_max && lat_min >= -M_PI_2 && lat_max <= M_PI_2);
+
+    proj->lon_min = lon_min;
+    proj->lon_max = lon_max;
+    proj->lat_min = lat_min;
+    proj->lat_max = lat_max;
+
+    proj->xy_to_angles_fn = hpix_cartesian_xy_to_angles;
+    proj->angle_to_xy_fn = hpix_cartesian_angles_to_xy;
+    proj->angles_to_xy_batch_fn = NULL;
+    proj->inside_test_fn = hpix_cartesian_is_xy_inside;
+    proj->type = HPIX_PROJ_CARTESIAN;
+}
+
+/**********************************************************************/
+
 int
 hpix_bmp_projection_is_xy_inside(const hpix_bmp_projection_t * proj,
 				 unsigned int x,
@@ -159,6 +238,761 @@ hpix_bmp_projection_xy_to_angles(const hpix_bmp_projection_t * proj,
 
 /**********************************************************************/
 
+
+int
+hpix_bmp_projection_angles_to_xy(const hpix_bmp_projection_t * proj,
+				 double theta,
+				 double phi,
+				 double * x,
+				 double * y)
+{
+    assert(proj);
+
+    if(proj->angle_to_xy_fn == NULL)
+	return FALSE;
+
+    return proj->angle_to_xy_fn(proj, theta, phi, x, y);
+}
+
+/**********************************************************************/
+
+
+size_t
+hpix_bmp_projection_angles_to_xy_batch(const hpix_bmp_projection_t * proj,
+				       const double * theta,
+				       const double * phi,
+				       size_t num_of_points,
+				       double * x,
+				       double * y)
+{
+    assert(proj);
+    assert(theta && phi);
+    assert(x && y);
+
+    if(proj->angles_to_xy_batch_fn != NULL)
+	return proj->angles_to_xy_batch_fn(proj, theta, phi, num_of_points,
+					   x, y);
+
+    size_t num_of_visible_points = 0;
+
+#pragma omp parallel for default(shared) reduction(+:num_of_visible_points)
+    for(size_t idx = 0; idx < num_of_points; ++idx)
+    {
+	if(proj->angle_to_xy_fn != NULL
+	   && proj->angle_to_xy_fn(proj, theta[idx], phi[idx],
+				   &x[idx], &y[idx]))
+	{
+	    ++num_of_visible_points;
+	}
+	else
+	    x[idx] = y[idx] = NAN;
+    }
+
+    return num_of_visible_points;
+}
+
+/**********************************************************************/
+
+
+/* A projection plan stores the index of the map pixel seen by each
+ * element of the bitmap. Since this depends only on the projection,
+ * on the size of the bitmap and on the resolution/ordering of the
+ * map, the (costly) inverse projection and the angle-to-pixel
+ * conversion are done once, and tracing a map becomes a simple
+ * gather. Elements that fall outside the projection are marked with
+ * HPIX_BMP_OUTSIDE_PIXEL.
+ *
+ * Supersampling and area-weighted plans look at a grid of k x k
+ * points within each element instead. The points falling on the same
+ * map pixel are merged, so that each element is associated with a
+ * list of (pixel, weight) pairs, where the weight is the fraction of
+ * the element covered by the pixel. The lists are stored one after
+ * another in `pixel_indexes` and `weights`, and the list of element
+ * `i` spans the range [offsets[i], offsets[i + 1]). Points outside
+ * the projection are simply dropped. */
+
+struct hpix_bmp_projection_plan_t {
+    unsigned int             width;
+    unsigned int             height;
+    hpix_nside_t             nside;
+    hpix_ordering_scheme_t   scheme;
+    hpix_bmp_sampling_t      sampling;
+    unsigned int             samples_per_side;
+
+    hpix_pixel_num_t       * pixel_indexes;
+    size_t                 * offsets; /* NULL for HPIX_BMP_SAMPLE_NEAREST */
+    float                  * weights; /* NULL for HPIX_BMP_SAMPLE_NEAREST */
+};
+
+/* Upper limit for the number of samples per side used by
+ * area-weighted plans */
+#define DEFAULT_MAX_SAMPLES_PER_SIDE 16
+
+/**********************************************************************/
+
+
+static hpix_angles_to_pixel_fn_t *
+angles_to_pixel_fn_for_scheme(hpix_ordering_scheme_t scheme)
+{
+    return (scheme == HPIX_ORDER_SCHEME_NEST)
+	? hpix_angles_to_nest_pixel
+	: hpix_angles_to_ring_pixel;
+}
+
+/**********************************************************************/
+
+
+static void
+init_nearest_plan(hpix_bmp_projection_plan_t * plan,
+		  const hpix_bmp_projection_t * proj,
+		  const hpix_resolution_t * resolution)
+{
+    hpix_angles_to_pixel_fn_t * angles_to_pixel_fn =
+	angles_to_pixel_fn_for_scheme(plan->scheme);
+
+    plan->pixel_indexes =
+	hpix_malloc(sizeof(plan->pixel_indexes[0]),
+		    (size_t) plan->width * plan->height);
+
+#pragma omp parallel for default(shared)
+    for (unsigned int y = 0; y < plan->height; ++y)
+    {
+	hpix_pixel_num_t * line_ptr =
+	    plan->pixel_indexes + (size_t) y * plan->width;
+
+	for (unsigned int x = 0; x < plan->width; ++x, ++line_ptr)
+	{
+	    double theta, phi;
+
+	    if(! proj->xy_to_angles_fn(proj, x, y, &theta, &phi))
+		*line_ptr = HPIX_BMP_OUTSIDE_PIXEL;
+	    else
+		*line_ptr = angles_to_pixel_fn(resolution, theta, phi);
+	}
+    }
+}
+
+/**********************************************************************/
+
+
+/* Estimate the number of samples per side needed to have roughly one
+ * sample for each map pixel within a bitmap element. The size of an
+ * element is measured on a coarse grid of elements spread over the
+ * bitmap, by computing the angular distance between each of them and
+ * its right/upper neighbours. */
+static unsigned int
+area_samples_per_side(const hpix_bmp_projection_t * proj,
+		      hpix_nside_t nside,
+		      unsigned int max_samples_per_side)
+{
+    const unsigned int grid_size = 16;
+    const double pixel_size =
+	sqrt(4.0 * M_PI / hpix_nside_to_npixel(nside));
+    double element_size = 0.0;
+
+    for(unsigned int grid_y = 0; grid_y < grid_size; ++grid_y)
+    {
+	for(unsigned int grid_x = 0; grid_x < grid_size; ++grid_x)
+	{
+	    const unsigned int x = (proj->width * (2 * grid_x + 1))
+		/ (2 * grid_size);
+	    const unsigned int y = (proj->height * (2 * grid_y + 1))
+		/ (2 * grid_size);
+	    const unsigned int neighbours[2][2] = { { x + 1, y },
+						    { x, y + 1 } };
+	    double theta, phi;
+	    hpix_vector_t center;
+
+	    if(! proj->xy_to_angles_fn(proj, x, y, &theta, &phi))
+		continue;
+	    hpix_angles_to_vector(theta, phi, &center);
+
+	    for(int idx = 0; idx < 2; ++idx)
+	    {
+		hpix_vector_t other;
+
+		if(! proj->xy_to_angles_fn(proj,
+					   neighbours[idx][0],
+					   neighbours[idx][1],
+					   &theta, &phi))
+		    continue;
+		hpix_angles_to_vector(theta, phi, &other);
+
+		const double cos_angle =
+		    fmin(fmax(hpix_dot_product(&center, &other), -1.0), 1.0);
+		element_size = fmax(element_size, acos(cos_angle));
+	    }
+	}
+    }
+
+    const double samples = ceil(element_size / pixel_size);
+    if(samples < 1.0)
+	return 1;
+    else if(samples > max_samples_per_side)
+	return max_samples_per_side;
+    else
+	return (unsigned int) samples;
+}
+
+/**********************************************************************/
+
+
+static int
+compare_pixel_nums(const void * a, const void * b)
+{
+    const hpix_pixel_num_t pixel_a = *((const hpix_pixel_num_t *) a);
+    const hpix_pixel_num_t pixel_b = *((const hpix_pixel_num_t *) b);
+
+    return (pixel_a > pixel_b) - (pixel_a < pixel_b);
+}
+
+/**********************************************************************/
+
+
+static void
+init_multisample_plan(hpix_bmp_projection_plan_t * plan,
+		      const hpix_bmp_projection_t * proj,
+		      const hpix_resolution_t * resolution)
+{
+    hpix_angles_to_pixel_fn_t * angles_to_pixel_fn =
+	angles_to_pixel_fn_for_scheme(plan->scheme);
+    const unsigned int k = plan->samples_per_side;
+    const float sample_weight = 1.0f / (k * k);
+
+    /* The samples of element (x, y) are centred on the point seen by
+     * the nearest-pixel plan: sample (i, j) is at (x + (i - (k-1)/2)/k,
+     * y + (j - (k-1)/2)/k), i.e., at the point (2k*x + 2i - (k-1),
+     * 2k*y + 2j - (k-1)) of a bitmap which is 2k times larger than
+     * `proj`. Samples before the first row/column are outside the
+     * bitmap and are dropped. */
+    hpix_bmp_projection_t fine_proj = *proj;
+    fine_proj.width *= 2 * k;
+    fine_proj.height *= 2 * k;
+
+    /* Each row is built independently: the lists are concatenated
+     * once all of them are known */
+    size_t * row_lengths = hpix_malloc(sizeof(row_lengths[0]), plan->height);
+    hpix_pixel_num_t ** row_pixels =
+	hpix_malloc(sizeof(row_pixels[0]), plan->height);
+    float ** row_weights = hpix_malloc(sizeof(row_weights[0]), plan->height);
+
+    plan->offsets = hpix_malloc(sizeof(plan->offsets[0]),
+				(size_t) plan->width * plan->height + 1);
+
+#pragma omp parallel default(shared)
+    {
+	hpix_pixel_num_t * samples =
+	    hpix_malloc(sizeof(samples[0]), (size_t) k * k);
+
+#pragma omp for schedule(dynamic)
+	for (unsigned int y = 0; y < plan->height; ++y)
+	{
+	    size_t * row_offsets = plan->offsets + (size_t) y * plan->width;
+	    size_t capacity = (size_t) plan->width * k;
+	    size_t length = 0;
+	    hpix_pixel_num_t * pixels =
+		hpix_malloc(sizeof(pixels[0]), capacity);
+	    float * weights = hpix_malloc(sizeof(weights[0]), capacity);
+
+	    for (unsigned int x = 0; x < plan->width; ++x)
+	    {
+		size_t num_of_samples = 0;
+
+		for (unsigned int j = 0; j < k; ++j)
+		{
+		    if(2 * k * y + 2 * j < k - 1)
+			continue;
+
+		    for (unsigned int i = 0; i < k; ++i)
+		    {
+			double theta, phi;
+
+			if(2 * k * x + 2 * i < k - 1)
+			    continue;
+
+			if(fine_proj.xy_to_angles_fn(&fine_proj,
+						     2 * k * x + 2 * i - (k - 1),
+						     2 * k * y + 2 * j - (k - 1),
+						     &theta, &phi))
+			{
+			    samples[num_of_samples++] =
+				angles_to_pixel_fn(resolution, theta, phi);
+			}
+		    }
+		}
+
+		qsort(samples, num_of_samples, sizeof(samples[0]),
+		      compare_pixel_nums);
+
+		if(length + num_of_samples > capacity)
+		{
+		    capacity = 2 * capacity + num_of_samples;
+		    pixels = hpix_realloc(pixels, sizeof(pixels[0]) * capacity);
+		    weights = hpix_realloc(weights,
+					   sizeof(weights[0]) * capacity);
+		}
+
+		/* Offsets are relative to the beginning of the row
+		 * here, they will be fixed later */
+		row_offsets[x] = length;
+		for (size_t idx = 0; idx < num_of_samples; ++idx)
+		{
+		    if(idx > 0 && samples[idx] == samples[idx - 1])
+			weights[length - 1] += sample_weight;
+		    else
+		    {
+			pixels[length] = samples[idx];
+			weights[length] = sample_weight;
+			++length;
+		    }
+		}
+	    }
+
+	    row_lengths[y] = length;
+	    row_pixels[y] = pixels;
+	    row_weights[y] = weights;
+	}
+
+	hpix_free(samples);
+    }
+
+    size_t total_length = 0;
+    for (unsigned int y = 0; y < plan->height; ++y)
+	total_length += row_lengths[y];
+
+    plan->pixel_indexes =
+	hpix_malloc(sizeof(plan->pixel_indexes[0]), total_length);
+    plan->weights = hpix_malloc(sizeof(plan->weights[0]), total_length);
+
+    size_t row_start = 0;
+    for (unsigned int y = 0; y < plan->height; ++y)
+    {
+	size_t * row_offsets = plan->offsets + (size_t) y * plan->width;
+	for (unsigned int x = 0; x < plan->width; ++x)
+	    row_offsets[x] += row_start;
+
+	memcpy(plan->pixel_indexes + row_start, row_pixels[y],
+	       sizeof(plan->pixel_indexes[0]) * row_lengths[y]);
+	memcpy(plan->weights + row_start, row_weights[y],
+	       sizeof(plan->weights[0]) * row_lengths[y]);
+	hpix_free(row_pixels[y]);
+	hpix_free(row_weights[y]);
+
+	row_start += row_lengths[y];
+    }
+    plan->offsets[(size_t) plan->width * plan->height] = total_length;
+
+    hpix_free(row_lengths);
+    hpix_free(row_pixels);
+    hpix_free(row_weights);
+}
+
+/**********************************************************************/
+
+
+hpix_bmp_projection_plan_t *
+hpix_create_bmp_sampling_plan(const hpix_bmp_projection_t * proj,
+			      hpix_nside_t nside,
+			      hpix_ordering_scheme_t scheme,
+			      hpix_bmp_sampling_t sampling,
+			      unsigned int samples_per_side)
+{
+    assert(proj);
+    assert(proj->xy_to_angles_fn);
+
+    hpix_bmp_projection_plan_t * plan =
+	hpix_calloc(sizeof(hpix_bmp_projection_plan_t), 1);
+    plan->width = proj->width;
+    plan->height = proj->height;
+    plan->nside = nside;
+    plan->scheme = scheme;
+    plan->sampling = sampling;
+
+    switch(sampling)
+    {
+    case HPIX_BMP_SAMPLE_NEAREST:
+	plan->samples_per_side = 1;
+	break;
+    case HPIX_BMP_SAMPLE_SUPERSAMPLE:
+	assert(samples_per_side > 0);
+	plan->samples_per_side = samples_per_side;
+	break;
+    case HPIX_BMP_SAMPLE_AREA:
+	plan->samples_per_side =
+	    area_samples_per_side(proj, nside,
+				  samples_per_side > 0
+				  ? samples_per_side
+				  : DEFAULT_MAX_SAMPLES_PER_SIDE);
+	break;
+    default:
+	assert(0);
+    }
+
+    hpix_resolution_t * resolution = hpix_create_resolution(nside);
+
+    if(sampling == HPIX_BMP_SAMPLE_NEAREST)
+	init_nearest_plan(plan, proj, resolution);
+    else
+	init_multisample_plan(plan, proj, resolution);
+
+    hpix_free_resolution(resolution);
+    return plan;
+}
+
+/**********************************************************************/
+
+
+hpix_bmp_projection_plan_t *
+hpix_create_bmp_projection_plan(const hpix_bmp_projection_t * proj,
+				hpix_nside_t nside,
+				hpix_ordering_scheme_t scheme)
+{
+    return hpix_create_bmp_sampling_plan(proj, nside, scheme,
+					 HPIX_BMP_SAMPLE_NEAREST, 1);
+}
+
+/**********************************************************************/
+
+
+void
+hpix_free_bmp_projection_plan(hpix_bmp_projection_plan_t * plan)
+{
+    if(plan == NULL)
+	return;
+
+    hpix_free(plan->pixel_indexes);
+    hpix_free(plan->offsets);
+    hpix_free(plan->weights);
+    hpix_free(plan);
+}
+
+/**********************************************************************/
+
+
+unsigned int
+hpix_bmp_projection_plan_width(const hpix_bmp_projection_plan_t * plan)
+{
+    assert(plan);
+    return plan->width;
+}
+
+/**********************************************************************/
+
+
+unsigned int
+hpix_bmp_projection_plan_height(const hpix_bmp_projection_plan_t * plan)
+{
+    assert(plan);
+    return plan->height;
+}
+
+/**********************************************************************/
+
+
+hpix_nside_t
+hpix_bmp_projection_plan_nside(const hpix_bmp_projection_plan_t * plan)
+{
+    assert(plan);
+    return plan->nside;
+}
+
+/**********************************************************************/
+
+
+hpix_ordering_scheme_t
+hpix_bmp_projection_plan_scheme(const hpix_bmp_projection_plan_t * plan)
+{
+    assert(plan);
+    return plan->scheme;
+}
+
+/**********************************************************************/
+
+
+hpix_bmp_sampling_t
+hpix_bmp_projection_plan_sampling(const hpix_bmp_projection_plan_t * plan)
+{
+    assert(plan);
+    return plan->sampling;
+}
+
+/**********************************************************************/
+
+
+unsigned int
+hpix_bmp_projection_plan_samples_per_side(const hpix_bmp_projection_plan_t * plan)
+{
+    assert(plan);
+    return plan->samples_per_side;
+}
+
+/**********************************************************************/
+
+
+const hpix_pixel_num_t *
+hpix_bmp_projection_plan_pixels(const hpix_bmp_projection_plan_t * plan)
+{
+    assert(plan);
+    return plan->pixel_indexes;
+}
+
+/**********************************************************************/
+
+
+const size_t *
+hpix_bmp_projection_plan_offsets(const hpix_bmp_projection_plan_t * plan)
+{
+    assert(plan);
+    return plan->offsets;
+}
+
+/**********************************************************************/
+
+
+const float *
+hpix_bmp_projection_plan_weights(const hpix_bmp_projection_plan_t * plan)
+{
+    assert(plan);
+    return plan->weights;
+}
+
+/**********************************************************************/
+
+
+static void
+compute_bitmap_range(const double * bitmap,
+		     size_t num_of_pixels,
+		     double * min_value,
+		     double * max_value)
+{
+    if(min_value == NULL && max_value == NULL)
+	return;
+
+    if(min_value)
+	*min_value = DBL_MAX;
+
+    if(max_value)
+	*max_value = -DBL_MAX;
+
+    for(size_t idx = 0; idx < num_of_pixels; ++idx)
+    {
+	const double value = bitmap[idx];
+	if(isnan(value) || isinf(value))
+	    continue;
+
+	if(min_value && *min_value > value)
+	    *min_value = value;
+	if(max_value && *max_value < value)
+	    *max_value = value;
+    }
+}
+
+/**********************************************************************/
+
+
+/* Compute the value of the element with index `idx` in the bitmap
+ * described by `plan`. Elements outside the projection are INFINITY,
+ * unseen ones are NaN. */
+static inline double
+sample_plan_element(const hpix_bmp_projection_plan_t * plan,
+		    const double *restrict pixels,
+		    size_t idx)
+{
+    const hpix_pixel_num_t *restrict indexes = plan->pixel_indexes;
+
+    if(plan->offsets == NULL)
+    {
+	const hpix_pixel_num_t pixel_idx = indexes[idx];
+
+	if(pixel_idx == HPIX_BMP_OUTSIDE_PIXEL)
+	    return INFINITY; /* Skip the pixel */
+	else if(pixels[pixel_idx] > -1.6e+30)
+	    return pixels[pixel_idx];
+	else
+	    return NAN;
+    }
+    else
+    {
+	const size_t *restrict offsets = plan->offsets;
+	const float *restrict weights = plan->weights;
+	double sum = 0.0;
+	double sum_of_weights = 0.0;
+
+	if(offsets[idx] == offsets[idx + 1])
+	    return INFINITY; /* Skip the pixel */
+
+	/* Masked pixels are excluded from the average, and an element
+	 * is marked as unseen only if all its pixels are masked */
+	for(size_t sample = offsets[idx]; sample < offsets[idx + 1]; ++sample)
+	{
+	    const double value = pixels[indexes[sample]];
+	    if(value > -1.6e+30)
+	    {
+		sum += weights[sample] * value;
+		sum_of_weights += weights[sample];
+	    }
+	}
+
+	return (sum_of_weights > 0.0) ? sum / sum_of_weights : NAN;
+    }
+}
+
+/**********************************************************************/
+
+
+void
+hpix_bmp_projection_plan_trace_into(const hpix_bmp_projection_plan_t * plan,
+				    const hpix_map_t * map,
+				    double * bitmap,
+				    double * min_value,
+				    double * max_value)
+{
+    assert(plan);
+    assert(map);
+    assert(bitmap);
+    assert(hpix_map_nside(map) == plan->nside);
+    assert(hpix_map_ordering_scheme(map) == plan->scheme);
+
+    const size_t num_of_pixels = (size_t) plan->width * plan->height;
+    const double *restrict pixels = hpix_map_pixels(map);
+
+    /* Elements of multisampling plans have a varying number of
+     * samples, hence the dynamic schedule */
+#pragma omp parallel for default(shared) schedule(dynamic, 1024)
+    for(size_t idx = 0; idx < num_of_pixels; ++idx)
+	bitmap[idx] = sample_plan_element(plan, pixels, idx);
+
+    compute_bitmap_range(bitmap, num_of_pixels, min_value, max_value);
+}
+
+/**********************************************************************/
+
+
+void
+hpix_bmp_projection_plan_range(const hpix_bmp_projection_plan_t * plan,
+			       const hpix_map_t * map,
+			       double * min_value,
+			       double * max_value)
+{
+    assert(plan);
+    assert(map);
+    assert(hpix_map_nside(map) == plan->nside);
+    assert(hpix_map_ordering_scheme(map) == plan->scheme);
+
+    const size_t num_of_pixels = (size_t) plan->width * plan->height;
+    const double *restrict pixels = hpix_map_pixels(map);
+    double min = DBL_MAX;
+    double max = -DBL_MAX;
+
+#pragma omp parallel default(shared)
+    {
+	double thread_min = DBL_MAX;
+	double thread_max = -DBL_MAX;
+
+#pragma omp for schedule(dynamic, 1024)
+	for(size_t idx = 0; idx < num_of_pixels; ++idx)
+	{
+	    const double value = sample_plan_element(plan, pixels, idx);
+	    if(isnan(value) || isinf(value))
+		continue;
+
+	    if(thread_min > value)
+		thread_min = value;
+	    if(thread_max < value)
+		thread_max = value;
+	}
+
+#pragma omp critical
+	{
+	    if(min > thread_min)
+		min = thread_min;
+	    if(max < thread_max)
+		max = thread_max;
+	}
+    }
+
+    if(min_value)
+	*min_value = min;
+    if(max_value)
+	*max_value = max;
+}
+
+/**********************************************************************/
+
+
+/* Number of elements sampled at once by
+ * `hpix_bmp_projection_plan_render`. They are kept in a buffer on the
+ * stack, which should fit in the L1 cache together with the
+ * corresponding packed colors. */
+#define RENDER_CHUNK_SIZE 256
+
+void
+hpix_bmp_projection_plan_render(const hpix_bmp_projection_plan_t * plan,
+				const hpix_map_t * map,
+				const hpix_palette_lut_t * lut,
+				double min_value,
+				double max_value,
+				void * dest,
+				size_t dest_stride)
+{
+    assert(plan);
+    assert(map);
+    assert(lut);
+    assert(dest);
+    assert(dest_stride >= plan->width * sizeof(uint32_t));
+    assert(hpix_map_nside(map) == plan->nside);
+    assert(hpix_map_ordering_scheme(map) == plan->scheme);
+
+    const unsigned int width = plan->width;
+    const unsigned int height = plan->height;
+    const double *restrict pixels = hpix_map_pixels(map);
+
+    /* As in `hpix_palette_lut_colorize`, the first row of the bitmap
+     * is the last row of the image */
+#pragma omp parallel for default(shared) schedule(dynamic, 1)
+    for(unsigned int y = 0; y < height; ++y)
+    {
+	uint32_t * row = (uint32_t *) ((char *) dest
+				       + (size_t) (height - y - 1) * dest_stride);
+	double values[RENDER_CHUNK_SIZE];
+
+	for(unsigned int x = 0; x < width; x += RENDER_CHUNK_SIZE)
+	{
+	    const size_t first = (size_t) y * width + x;
+	    const unsigned int count = (width - x < RENDER_CHUNK_SIZE)
+		? width - x
+		: RENDER_CHUNK_SIZE;
+
+	    for(unsigned int idx = 0; idx < count; ++idx)
+		values[idx] = sample_plan_element(plan, pixels, first + idx);
+
+	    hpix_palette_lut_colorize_values(lut, values, count,
+					     min_value, max_value,
+					     row + x);
+	}
+    }
+}
+
+/**********************************************************************/
+
+
+double *
+hpix_bmp_projection_plan_trace(const hpix_bmp_projection_plan_t * plan,
+			       const hpix_map_t * map,
+			       double * min_value,
+			       double * max_value)
+{
+    assert(plan);
+
+    double * bitmap = hpix_malloc(sizeof(bitmap[0]),
+				  (size_t) plan->width * plan->height);
+    hpix_bmp_projection_plan_trace_into(plan, map, bitmap,
+					min_value, max_value);
+    return bitmap;
+}
+
+/**********************************************************************/
+
 
 double *
 hpix_bmp_projection_trace(const hpix_bmp_projection_t * proj,
@@ -169,39 +1003,35 @@ hpix_bmp_projection_trace(const hpix_bmp_projection_t * proj,
     assert(proj);
     assert(map);
 
-    hpix_nside_t nside = hpix_map_nside(map);
-
+    /* A one-shot trace does not build a plan, which would need one
+     * more index per element on top of the bitmap */
+    const hpix_resolution_t * resolution = hpix_map_resolution(map);
     hpix_angles_to_pixel_fn_t * angles_to_pixel_fn =
-	(hpix_map_ordering_scheme(map) == HPIX_ORDER_SCHEME_NEST)
-	? hpix_angles_to_nest_pixel
-	: hpix_angles_to_ring_pixel;
-
-    size_t num_of_pixels = proj->width * proj->height;
-    double *restrict bitmap =
-	hpix_malloc(sizeof(bitmap[0]), num_of_pixels);
+	angles_to_pixel_fn_for_scheme(hpix_map_ordering_scheme(map));
 
-    double * pixels = hpix_map_pixels(map);
+    const unsigned int width = proj->width;
+    const unsigned int height = proj->height;
+    const size_t num_of_pixels = (size_t) width * height;
+    double *restrict bitmap = hpix_malloc(sizeof(bitmap[0]), num_of_pixels);
+    const double *restrict pixels = hpix_map_pixels(map);
 
-    /* First step: render the bitmap */
 #pragma omp parallel for default(shared)
-    for (unsigned int y = 0; y < hpix_bmp_projection_height(proj); ++y)
+    for (unsigned int y = 0; y < height; ++y)
     {
-	double * line_ptr = bitmap + y * hpix_bmp_projection_width(proj);
+	double * line_ptr = bitmap + (size_t) y * width;
 
-	for (unsigned int x = 0; 
-	     x < hpix_bmp_projection_width(proj); 
-	     ++x, ++line_ptr)
+	for (unsigned int x = 0; x < width; ++x, ++line_ptr)
 	{
 	    double theta, phi;
 
-	    if(! hpix_bmp_projection_xy_to_angles(proj, x, y, &theta, &phi))
+	    if(! proj->xy_to_angles_fn(proj, x, y, &theta, &phi))
 	    {
 		*line_ptr = INFINITY; /* Skip the pixel */
 		continue;
 	    }
 
-	    hpix_pixel_num_t pixel_idx =
-		angles_to_pixel_fn(hpix_map_resolution(map), theta, phi);
+	    const hpix_pixel_num_t pixel_idx =
+		angles_to_pixel_fn(resolution, theta, phi);
 	    if(pixels[pixel_idx] > -1.6e+30)
 		*line_ptr = pixels[pixel_idx];
 	    else
@@ -209,28 +1039,7 @@ hpix_bmp_projection_trace(const hpix_bmp_projection_t * proj,
 	}
     }
 
-    /* Second step: if the user asked for them, compute the maximum
-     * and/or minimum values in the bitmap */
-    if(min_value || max_value) 
-    {
-	if(min_value)
-	    *min_value = DBL_MAX;
-
-	if(max_value)
-	    *max_value = -DBL_MAX;
-
-	double * bitmap_ptr = bitmap;
-	for(size_t idx = 0; idx < num_of_pixels; ++idx, ++bitmap_ptr) 
-	{
-	    if(isnan(*bitmap_ptr) || isinf(*bitmap_ptr))
-		continue;
-
-	    if(min_value && *min_value > *bitmap_ptr)
-		*min_value = *bitmap_ptr;
-	    if(max_value && *max_value < *bitmap_ptr)
-		*max_value = *bitmap_ptr;
-	}
-    }
+    compute_bitmap_range(bitmap, num_of_pixels, min_value, max_value);
 
     return bitmap;
 }
@@ -0,0 +1,74 @@
+/* bmp_projection.h -- Internal layout of hpix_bmp_projection_t
+ *
+ * Copyright 2011-2013 Maurizio Tomasi.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.  */
+
+#ifndef BMP_PROJECTION_H
+#define BMP_PROJECTION_H
+
+#include <hpixlib/hpix.h>
+
+/* This header is not installed: it is shared by bitmap.c and by the
+ * files implementing the projections which need more parameters than
+ * the size of the bitmap. */
+
+typedef int inside_test_t (const hpix_bmp_projection_t * proj,
+			   unsigned int x,
+			   unsigned int y);
+typedef int xy_to_angles_t (const hpix_bmp_projection_t * proj,
+			    unsigned int x,
+			    unsigned int y,
+			    double * theta,
+			    double * phi);
+typedef int angles_to_xy_t (const hpix_bmp_projection_t * proj,
+			    double theta,
+			    double phi,
+			    double * x,
+			    double * y);
+typedef size_t angles_to_xy_batch_t (const hpix_bmp_projection_t * proj,
+				     const double * theta,
+				     const double * phi,
+				     size_t num_of_points,
+				     double * x,
+				     double * y);
+
+struct ___hpix_bmp_projection_t {
+    unsigned int           width;
+    unsigned int           height;
+    hpix_coordinates_t     coordsys;
+
+    hpix_projection_type_t type;
+    xy_to_angles_t         * xy_to_angles_fn;
+    angles_to_xy_t         * angle_to_xy_fn;
+    angles_to_xy_batch_t   * angles_to_xy_batch_fn; /* Can be NULL */
+    inside_test_t          * inside_test_fn;
+
+    /* Gnomonic and orthographic projections: direction of the center
+     * of the bitmap, and unit vectors pointing towards the right side
+     * (decreasing longitude) and the upper side (north) of the
+     * bitmap */
+    hpix_vector_t          center;
+    hpix_vector_t          right_axis;
+    hpix_vector_t          up_axis;
+    double                 field_of_view; /* Gnomonic only */
+
+    /* Cartesian projection: longitude/latitude box, in radians */
+    double                 lon_min;
+    double                 lon_max;
+    double                 lat_min;
+    double                 lat_max;
+};
+
+#endif
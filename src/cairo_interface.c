@@ -21,97 +21,85 @@
 #include <hpixlib/hpix-cairo.h>
 #include <assert.h>
 #include <string.h>
+#include <stdint.h>
 #include <math.h>
 
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
 /******************************************************************************/
 
 
-/* This function creates a Cairo image surface that contains a
- * projection of the map. The values `map_min` and `map_max` are used
- * to rescale every value in the map (i.e. to convert every pixel
- * value in the map into a number in [0.0, 1.0]). The value of
- * `bitmap` is the return value of `hpix_bmp_trace_bitmap`. Finally,
- * `width` and `height` give the resolution (in pixel) of the image
- * surface. */
+/* Create a Cairo image surface containing the map, using a
+ * precomputed projection plan and palette lookup table. Each pixel is
+ * sampled and colorized directly into the image data by
+ * `hpix_bmp_projection_plan_render`, so that no intermediate bitmap
+ * is allocated. The values `map_min` and `map_max` are mapped to the
+ * two ends of the palette. */
 cairo_surface_t *
-hpix_bmp_projection_to_cairo_surface(const hpix_bmp_projection_t * proj,
-				     const hpix_color_palette_t * palette,
-				     const hpix_map_t * map,
-				     double map_min, double map_max)
+hpix_bmp_projection_plan_to_cairo_surface(const hpix_bmp_projection_plan_t * plan,
+					  const hpix_palette_lut_t * lut,
+					  const hpix_map_t * map,
+					  double map_min, double map_max)
 {
-    const double dynamic_range = map_max - map_min;
-    double * map_bitmap;
-    double * cur_pixel;
-    unsigned char * image_data;
-    unsigned int cur_y;
-    unsigned int stride;
     cairo_surface_t * surface;
-    unsigned int width;
-    unsigned int height;
-
-    assert(proj);
-    width = hpix_bmp_projection_width(proj);
-    height = hpix_bmp_projection_height(proj);
 
+    assert(plan);
+    assert(lut);
     assert(map);
 
-    map_bitmap = hpix_bmp_projection_trace(proj, map, NULL, NULL);
-    assert(map_bitmap);
-
-    cur_pixel = map_bitmap;
-
     /* Because of the way Cairo implements surface copies, it is not
      * possible to use CAIRO_FORMAT_ARGB32 here. It would have been
      * really useful, as having an "alpha" (transparency) channel
      * would have helped in implementing the surface copy
      * operation. */
     surface = cairo_image_surface_create(CAIRO_FORMAT_RGB24,
-					 width, height);
-    image_data = cairo_image_surface_get_data(surface);
-    stride = cairo_image_surface_get_stride(surface);
+					 hpix_bmp_projection_plan_width(plan),
+					 hpix_bmp_projection_plan_height(plan));
 
-    hpix_color_t color_for_unseen_pixels =
-	hpix_color_for_unseen_pixels_in_palette(palette);
-    hpix_color_t white_color = hpix_create_color(1.0, 1.0, 1.0);
+    cairo_surface_flush(surface);
+    hpix_bmp_projection_plan_render(plan, map, lut, map_min, map_max,
+				    cairo_image_surface_get_data(surface),
+				    cairo_image_surface_get_stride(surface));
+    cairo_surface_mark_dirty(surface);
 
-    for(cur_y = 0; cur_y < height; ++cur_y)
-    {
-	unsigned int cur_x;
-	unsigned char * row = image_data + (height - cur_y - 1) * stride;
-	for(cur_x = 0; cur_x < width; ++cur_x)
-	{
-	    double value = *cur_pixel++;
-	    hpix_color_t color;
-
-	    /* Not sure if this works on big-endian machines... */
-#define SET_PIXEL(opacity,color) {  \
-		int base = cur_x * 4; \
-		row[base]     = (int) (255 * color.blue);	\
-		row[base + 1] = (int) (255 * color.green);	\
-		row[base + 2] = (int) (255 * color.red);	\
-		row[base + 3] = (int) (255 * opacity);		\
-	    }
+    return surface;
+}
 
-	    if(isinf(value))
-	    {
-		/* Transparent pixel */
-		SET_PIXEL(0.0, white_color);
-	    }
-	    else if (isnan(value) || value < -1.6e+30)
-	    {
-		SET_PIXEL(1.0, color_for_unseen_pixels);
-	    }
-	    else
-	    {
-		double normalized_value = (value - map_min) / dynamic_range;
-		hpix_palette_color(palette, normalized_value, &color);
-		SET_PIXEL(1.0, color);
-	    }
-#undef SET_PIXEL
-	}
-    }
+/******************************************************************************/
 
-    hpix_free(map_bitmap);
+
+/* This function creates a Cairo image surface that contains a
+ * projection of the map. The values `map_min` and `map_max` are used
+ * to rescale every value in the map (i.e. to convert every pixel
+ * value in the map into a number in [0.0, 1.0]). The projection plan
+ * and the lookup table are discarded afterwards: use
+ * `hpix_bmp_projection_plan_to_cairo_surface` to draw many maps with
+ * the same projection. */
+cairo_surface_t *
+hpix_bmp_projection_to_cairo_surface(const hpix_bmp_projection_t * proj,
+				     const hpix_color_palette_t * palette,
+				     const hpix_map_t * map,
+				     double map_min, double map_max)
+{
+    assert(proj);
+    assert(palette);
+    assert(map);
+
+    hpix_bmp_projection_plan_t * plan =
+	hpix_create_bmp_projection_plan(proj,
+					hpix_map_nside(map),
+					hpix_map_ordering_scheme(map));
+    hpix_palette_lut_t * lut =
+	hpix_create_palette_lut(palette, HPIX_PALETTE_LUT_DEFAULT_SIZE);
+
+    cairo_surface_t * surface =
+	hpix_bmp_projection_plan_to_cairo_surface(plan, lut, map,
+						  map_min, map_max);
+
+    hpix_free_palette_lut(lut);
+    hpix_free_bmp_projection_plan(plan);
     return surface;
 }
 
@@ -134,3 +122,114 @@ hpix_bmp_configure_linear_gradient(cairo_pattern_t * pattern,
 					 color.red, color.green, color.blue);
     }
 }
+
+/******************************************************************************/
+
+
+/* This function draws a filled disc with the given `radius` (in
+ * pixels) for each direction (theta[i], phi[i]) on a surface created
+ * by `hpix_bmp_projection_to_cairo_surface`. Instead of building a
+ * Cairo path for each point (which is way too slow for catalogs with
+ * millions of sources), the directions are converted into bitmap
+ * coordinates using `hpix_bmp_projection_angles_to_xy_batch`, and the
+ * discs are written directly into the image data. Each thread paints
+ * a horizontal band of the image, so that no synchronization is
+ * needed. Points that are not visible are skipped. */
+void
+hpix_bmp_draw_markers(cairo_surface_t * surface,
+		      const hpix_bmp_projection_t * proj,
+		      const double * theta,
+		      const double * phi,
+		      size_t num_of_points,
+		      double radius,
+		      hpix_color_t color)
+{
+    assert(surface);
+    assert(proj);
+    assert(radius >= 0.0);
+
+    const long width = hpix_bmp_projection_width(proj);
+    const long height = hpix_bmp_projection_height(proj);
+    assert(cairo_image_surface_get_width(surface) == width);
+    assert(cairo_image_surface_get_height(surface) == height);
+    assert(cairo_image_surface_get_format(surface) == CAIRO_FORMAT_RGB24
+	   || cairo_image_surface_get_format(surface) == CAIRO_FORMAT_ARGB32);
+
+    if(num_of_points == 0)
+	return;
+
+    double * x = hpix_malloc(sizeof(x[0]), num_of_points);
+    double * y = hpix_malloc(sizeof(y[0]), num_of_points);
+    hpix_bmp_projection_angles_to_xy_batch(proj, theta, phi, num_of_points,
+					   x, y);
+
+    /* Half width of the disc for each row, from -int_radius to
+     * +int_radius */
+    const long int_radius = (long) floor(radius);
+    long * half_widths = hpix_malloc(sizeof(half_widths[0]),
+				     2 * int_radius + 1);
+    for(long dy = -int_radius; dy <= int_radius; ++dy)
+	half_widths[dy + int_radius] =
+	    (long) floor(sqrt(radius * radius - (double) (dy * dy)));
+
+    const uint32_t pixel = hpix_pack_color(color);
+
+    cairo_surface_flush(surface);
+    unsigned char * image_data = cairo_image_surface_get_data(surface);
+    const int stride = cairo_image_surface_get_stride(surface);
+
+#pragma omp parallel default(shared)
+    {
+#ifdef _OPENMP
+	const long thread_num = omp_get_thread_num();
+	const long num_of_threads = omp_get_num_threads();
+#else
+	const long thread_num = 0;
+	const long num_of_threads = 1;
+#endif
+	const long first_row = height * thread_num / num_of_threads;
+	const long last_row = height * (thread_num + 1) / num_of_threads;
+
+	for(size_t idx = 0; idx < num_of_points; ++idx)
+	{
+	    if(isnan(x[idx]) || isnan(y[idx]))
+		continue;
+
+	    /* Bitmap rows are stored from the bottom to the top */
+	    const long center_x = lround(x[idx]);
+	    const long center_row = height - 1 - lround(y[idx]);
+
+	    if(center_row + int_radius < first_row
+	       || center_row - int_radius >= last_row)
+		continue;
+
+	    const long start_row = (center_row - int_radius > first_row)
+		? center_row - int_radius : first_row;
+	    const long end_row = (center_row + int_radius < last_row - 1)
+		? center_row + int_radius : last_row - 1;
+
+	    for(long row = start_row; row <= end_row; ++row)
+	    {
+		const long half_width =
+		    half_widths[row - center_row + int_radius];
+		long start_x = center_x - half_width;
+		long end_x = center_x + half_width;
+
+		if(start_x < 0)
+		    start_x = 0;
+		if(end_x > width - 1)
+		    end_x = width - 1;
+
+		uint32_t * row_ptr = (uint32_t *) (image_data + row * stride);
+		for(long cur_x = start_x; cur_x <= end_x; ++cur_x)
+		    row_ptr[cur_x] = pixel;
+	    }
+	}
+    }
+
+    cairo_surface_mark_dirty(surface);
+
+    hpix_free(half_widths);
+    hpix_free(x);
+    hpix_free(y);
+}
@@ -0,0 +1,107 @@
+/* cartesian_projection.c -- Functions to convert a map into a
+ * Cartesian (longitude/latitude box) projection and vice-versa
+ *
+ * Copyright 2011-2013 Maurizio Tomasi.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.  */
+
+#include "config.h"
+
+#include <hpixlib/hpix.h>
+#include <math.h>
+#include <assert.h>
+
+#include "constants.h"
+#include "bmp_projection.h"
+
+/* The Cartesian projection maps a box in longitude and latitude
+ * linearly on the bitmap. Longitudes increase from right to left (as
+ * in the Mollweide projection), latitudes from bottom to top. The
+ * box can cross the meridian phi = 0, if `lon_min` is negative. */
+
+/**********************************************************************/
+
+
+int
+hpix_cartesian_is_xy_inside(const hpix_bmp_projection_t * proj,
+			    unsigned int x,
+			    unsigned int y)
+{
+    assert(proj);
+    return (x < proj->width) && (y < proj->height);
+}
+
+/**********************************************************************/
+
+
+int
+hpix_cartesian_xy_to_angles(const hpix_bmp_projection_t * proj,
+			    unsigned int x,
+			    unsigned int y,
+			    double * theta,
+			    double * phi)
+{
+    assert(proj);
+    assert(theta);
+    assert(phi);
+
+    if(! hpix_cartesian_is_xy_inside(proj, x, y))
+	return FALSE;
+
+    const double lon = proj->lon_max
+	- (proj->lon_max - proj->lon_min) * x / proj->width;
+    const double lat = proj->lat_min
+	+ (proj->lat_max - proj->lat_min) * y / proj->height;
+
+    *theta = M_PI_2 - lat;
+    *phi = fmod(lon, 2.0 * M_PI);
+    if(*phi < 0.0)
+	*phi += 2.0 * M_PI;
+
+    return TRUE;
+}
+
+/**********************************************************************/
+
+
+int
+hpix_cartesian_angles_to_xy(const hpix_bmp_projection_t * proj,
+			    double theta,
+			    double phi,
+			    double * x,
+			    double * y)
+{
+    assert(proj);
+    assert(x);
+    assert(y);
+
+    const double lat = M_PI_2 - theta;
+    if(lat < proj->lat_min || lat > proj->lat_max)
+	return FALSE;
+
+    /* Angular distance from the right side of the box, measured in
+     * the direction of increasing longitudes */
+    double lon_offset = fmod(phi - proj->lon_min, 2.0 * M_PI);
+    if(lon_offset < 0.0)
+	lon_offset += 2.0 * M_PI;
+    if(lon_offset > proj->lon_max - proj->lon_min)
+	return FALSE;
+
+    *x = proj->width
+	* (1.0 - lon_offset / (proj->lon_max - proj->lon_min));
+    *y = proj->height
+	* (lat - proj->lat_min) / (proj->lat_max - proj->lat_min);
+
+    return TRUE;
+}
@@ -57,3 +57,25 @@ hpix_equirectangular_xy_to_angles(const hpix_bmp_projection_t * proj,
     *phi = ((double) x) / hpix_bmp_projection_width(proj) * 2.0 * M_PI;
     return TRUE;
 }
+
+/**********************************************************************/
+
+
+int
+hpix_equirectangular_angles_to_xy(const hpix_bmp_projection_t * proj,
+				  double theta,
+				  double phi,
+				  double * x,
+				  double * y)
+{
+    assert(proj);
+    assert(x);
+    assert(y);
+
+    /* Bring phi into [0, 2pi) */
+    const double cur_phi = phi - 2.0 * M_PI * floor(phi / (2.0 * M_PI));
+
+    *x = cur_phi / (2.0 * M_PI) * hpix_bmp_projection_width(proj);
+    *y = theta / M_PI * hpix_bmp_projection_height(proj);
+    return TRUE;
+}
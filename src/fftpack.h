@@ -57,6 +57,19 @@ void rfftb(size_t N, double data[], double wrk[]);
 /*! initializer for real transforms */
 void rffti(size_t N, double wrk[]);
 
+/*! number of arrays transformed together by rfftf_multi() and rfftb_multi() */
+enum { fftpack_multi_vlen=4 };
+/*! forward real transform of fftpack_multi_vlen arrays, stored interleaved:
+    element i of array j is data[i*fftpack_multi_vlen+j]. \a wrk must have
+    been initialized by rffti(), and \a scratch must have room for
+    N*fftpack_multi_vlen values. */
+void rfftf_multi(size_t N, double data[], double scratch[],
+  const double wrk[]);
+/*! backward real transform of fftpack_multi_vlen interleaved arrays, see
+    rfftf_multi() */
+void rfftb_multi(size_t N, double data[], double scratch[],
+  const double wrk[]);
+
 #ifdef __cplusplus
 }
 #endif
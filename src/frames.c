@@ -0,0 +1,243 @@
+/* frames.c -- Render sequences of maps as animation frames
+ *
+ * Copyright 2011-2013 Maurizio Tomasi.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.  */
+
+#include "config.h"
+
+#include <hpixlib/hpix.h>
+#include <assert.h>
+#include <float.h>
+#include <stdio.h>
+#include <string.h>
+
+/* All the frames of a sequence share the same projection plan and the
+ * same color scale, so that the colors of different frames can be
+ * compared. Frames are distributed among threads: each thread renders
+ * a whole frame with `hpix_bmp_projection_plan_render` (which runs
+ * serially inside the parallel region) into its own image buffer, so
+ * that the throughput grows with the number of cores even when the
+ * images are small. */
+
+/**********************************************************************/
+
+
+void
+hpix_frame_sequence_range(const hpix_bmp_projection_plan_t * plan,
+			  const hpix_map_t * const * maps,
+			  size_t num_of_frames,
+			  double * min_value,
+			  double * max_value)
+{
+    assert(plan);
+    assert(maps);
+
+    double min = DBL_MAX;
+    double max = -DBL_MAX;
+
+    for(size_t frame = 0; frame < num_of_frames; ++frame)
+    {
+	double frame_min, frame_max;
+
+	hpix_bmp_projection_plan_range(plan, maps[frame],
+				       &frame_min, &frame_max);
+	if(min > frame_min)
+	    min = frame_min;
+	if(max < frame_max)
+	    max = frame_max;
+    }
+
+    if(min_value)
+	*min_value = min;
+    if(max_value)
+	*max_value = max;
+}
+
+/**********************************************************************/
+
+
+static int
+write_frame(FILE * out,
+	    hpix_image_format_t format,
+	    const uint32_t * image,
+	    unsigned int width,
+	    unsigned int height)
+{
+    hpix_image_writer_t * writer =
+	hpix_create_image_writer(out, format, width, height);
+    int result =
+	hpix_image_writer_write_rows(writer, image,
+				     width * sizeof(uint32_t), height);
+
+    return hpix_close_image_writer(writer) && result;
+}
+
+/**********************************************************************/
+
+
+/* Return nonzero if `file_name_template` contains exactly one
+ * conversion for an unsigned int (with optional flags, field width
+ * and precision). The only other conversion allowed is "%%". */
+static int
+is_valid_file_name_template(const char * file_name_template)
+{
+    unsigned int num_of_conversions = 0;
+
+    for(const char * ptr = file_name_template; *ptr != '\0'; ++ptr)
+    {
+	if(*ptr != '%')
+	    continue;
+
+	++ptr;
+	if(*ptr == '%')
+	    continue;
+
+	ptr += strspn(ptr, "-+ #0");
+	ptr += strspn(ptr, "0123456789");
+	if(*ptr == '.')
+	{
+	    ++ptr;
+	    ptr += strspn(ptr, "0123456789");
+	}
+
+	if(*ptr == '\0' || strchr("ouxX", *ptr) == NULL)
+	    return 0;
+
+	++num_of_conversions;
+    }
+
+    return num_of_conversions == 1;
+}
+
+/**********************************************************************/
+
+
+int
+hpix_write_frame_files(const hpix_bmp_projection_plan_t * plan,
+		       const hpix_palette_lut_t * lut,
+		       double min_value,
+		       double max_value,
+		       const hpix_map_t * const * maps,
+		       size_t num_of_frames,
+		       const char * file_name_template,
+		       unsigned int first_frame_number)
+{
+    assert(plan);
+    assert(lut);
+    assert(maps);
+    assert(file_name_template);
+
+    /* The template is used as a format string */
+    if(! is_valid_file_name_template(file_name_template))
+	return 0;
+
+    const unsigned int width = hpix_bmp_projection_plan_width(plan);
+    const unsigned int height = hpix_bmp_projection_plan_height(plan);
+    const size_t file_name_size = strlen(file_name_template) + 32;
+    int num_of_errors = 0;
+
+    /* Frames are independent, so each thread renders, compresses and
+     * saves whole frames */
+#pragma omp parallel default(shared) reduction(+:num_of_errors)
+    {
+	uint32_t * image = hpix_malloc(sizeof(image[0]),
+				       (size_t) width * height);
+	char * file_name = hpix_malloc(1, file_name_size);
+
+#pragma omp for schedule(dynamic, 1)
+	for(size_t frame = 0; frame < num_of_frames; ++frame)
+	{
+	    hpix_bmp_projection_plan_render(plan, maps[frame], lut,
+					    min_value, max_value,
+					    image, width * sizeof(uint32_t));
+
+	    if(snprintf(file_name, file_name_size, file_name_template,
+			first_frame_number + (unsigned int) frame)
+	       >= (int) file_name_size)
+	    {
+		/* The field width is too large */
+		++num_of_errors;
+		continue;
+	    }
+
+	    FILE * out = fopen(file_name, "wb");
+	    if(out == NULL)
+	    {
+		++num_of_errors;
+		continue;
+	    }
+
+	    if(! write_frame(out, HPIX_IMAGE_FORMAT_PNG, image, width, height))
+		++num_of_errors;
+
+	    if(fclose(out) != 0)
+		++num_of_errors;
+	}
+
+	hpix_free(file_name);
+	hpix_free(image);
+    }
+
+    return num_of_errors == 0;
+}
+
+/**********************************************************************/
+
+
+int
+hpix_write_frame_stream(const hpix_bmp_projection_plan_t * plan,
+			const hpix_palette_lut_t * lut,
+			double min_value,
+			double max_value,
+			const hpix_map_t * const * maps,
+			size_t num_of_frames,
+			FILE * out)
+{
+    assert(plan);
+    assert(lut);
+    assert(maps);
+    assert(out);
+
+    const unsigned int width = hpix_bmp_projection_plan_width(plan);
+    const unsigned int height = hpix_bmp_projection_plan_height(plan);
+    int result = 1;
+
+    /* Frames must reach `out` in order: while one thread writes its
+     * frame, the others are already rendering the following ones */
+#pragma omp parallel default(shared)
+    {
+	uint32_t * image = hpix_malloc(sizeof(image[0]),
+				       (size_t) width * height);
+
+#pragma omp for ordered schedule(static, 1)
+	for(size_t frame = 0; frame < num_of_frames; ++frame)
+	{
+	    hpix_bmp_projection_plan_render(plan, maps[frame], lut,
+					    min_value, max_value,
+					    image, width * sizeof(uint32_t));
+
+#pragma omp ordered
+	    {
+		if(result)
+		    result = write_frame(out, HPIX_IMAGE_FORMAT_RAW,
+					 image, width, height);
+	    }
+	}
+
+	hpix_free(image);
+    }
+
+    return result;
+}
@@ -0,0 +1,118 @@
+/* gnomonic_projection.c -- Functions to convert a map into a
+ * gnomonic projection and vice-versa
+ *
+ * Copyright 2011-2013 Maurizio Tomasi.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.  */
+
+#include "config.h"
+
+#include <hpixlib/hpix.h>
+#include <math.h>
+#include <assert.h>
+
+#include "constants.h"
+#include "bmp_projection.h"
+
+/* The gnomonic projection maps the sky on the plane tangent to the
+ * sphere at the center of the bitmap, projecting each point from the
+ * center of the sphere. Great circles become straight lines. The
+ * plane coordinates (u, v) are measured along `right_axis` and
+ * `up_axis`, and `field_of_view` is the angle subtended by the width
+ * of the bitmap. */
+
+/**********************************************************************/
+
+
+static inline double
+gnomonic_scale(const hpix_bmp_projection_t * proj)
+{
+    /* Number of bitmap elements per unit of (u, v) */
+    return 0.5 * proj->width / tan(0.5 * proj->field_of_view);
+}
+
+/**********************************************************************/
+
+
+int
+hpix_gnomonic_is_xy_inside(const hpix_bmp_projection_t * proj,
+			   unsigned int x,
+			   unsigned int y)
+{
+    assert(proj);
+    return (x < proj->width) && (y < proj->height);
+}
+
+/**********************************************************************/
+
+
+int
+hpix_gnomonic_xy_to_angles(const hpix_bmp_projection_t * proj,
+			   unsigned int x,
+			   unsigned int y,
+			   double * theta,
+			   double * phi)
+{
+    assert(proj);
+    assert(theta);
+    assert(phi);
+
+    if(! hpix_gnomonic_is_xy_inside(proj, x, y))
+	return FALSE;
+
+    const double scale = gnomonic_scale(proj);
+    const double u = (x - 0.5 * proj->width) / scale;
+    const double v = (y - 0.5 * proj->height) / scale;
+    const hpix_vector_t direction = {
+	.x = proj->center.x + u * proj->right_axis.x + v * proj->up_axis.x,
+	.y = proj->center.y + u * proj->right_axis.y + v * proj->up_axis.y,
+	.z = proj->center.z + u * proj->right_axis.z + v * proj->up_axis.z
+    };
+
+    hpix_vector_to_angles(&direction, theta, phi);
+    return TRUE;
+}
+
+/**********************************************************************/
+
+
+int
+hpix_gnomonic_angles_to_xy(const hpix_bmp_projection_t * proj,
+			   double theta,
+			   double phi,
+			   double * x,
+			   double * y)
+{
+    assert(proj);
+    assert(x);
+    assert(y);
+
+    hpix_vector_t direction;
+    hpix_angles_to_vector(theta, phi, &direction);
+
+    /* Points in the hemisphere opposite to the center cannot be
+     * projected */
+    const double distance = hpix_dot_product(&direction, &proj->center);
+    if(distance <= 0.0)
+	return FALSE;
+
+    const double scale = gnomonic_scale(proj);
+    *x = 0.5 * proj->width
+	+ scale * hpix_dot_product(&direction, &proj->right_axis) / distance;
+    *y = 0.5 * proj->height
+	+ scale * hpix_dot_product(&direction, &proj->up_axis) / distance;
+
+    return (*x >= 0.0) && (*x < proj->width)
+	&& (*y >= 0.0) && (*y < proj->height);
+}
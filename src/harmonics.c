@@ -0,0 +1,1277 @@
+/* harmonics.c -- Spherical harmonic transforms of maps
+ *
+ * Copyright 2011-2013 Maurizio Tomasi.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.  */
+
+#include "config.h"
+
+#include <hpixlib/hpix.h>
+#include <assert.h>
+#include <math.h>
+#include <string.h>
+
+#include "psht.h"
+#include "psht_geomhelpers.h"
+#include "psht_almhelpers.h"
+
+/* The transforms are done by libpsht. Setting up the geometry of a
+ * map and the layout of the a_lm coefficients is not cheap, so the
+ * structures created by libpsht are kept in a small cache, indexed
+ * by (nside, lmax, mmax), together with a psht plan holding the
+ * normalisation factors and the Y_lm generators. Each entry has a
+ * reference count, so that an entry used by one thread is never
+ * evicted by another one. */
+
+struct hpix_alm_t {
+    unsigned int     lmax;
+    unsigned int     mmax;
+    size_t           num_of_coefficients;
+    hpix_complex_t * coefficients;
+};
+
+/* Spectra are stored for every ordered pair of fields: the spectrum
+ * of component `comp` between fields f1 and f2 starts at index
+ * ((f1 * num_of_fields + f2) * num_of_components + comp) * (lmax + 1)
+ * of `cl`. */
+struct hpix_power_spectrum_t {
+    unsigned int      lmax;
+    size_t            num_of_fields;
+    int               polarization_flag;
+    unsigned int      num_of_components;
+    double            fsky;
+    double          * cl;
+};
+
+/* The windows of T and of E/B include both the beam and the pixel
+ * window. The buffers are kept between calls to hpix_smooth_maps, and
+ * they are reallocated only if the number of pixels changes. */
+struct hpix_smoothing_t {
+    unsigned int      lmax;
+    double          * window_t;
+    double          * window_pol;
+
+    hpix_alm_t      * alm_buffers[psht_maxjobs * 3];
+    double          * pixel_buffers[psht_maxjobs * 3];
+    size_t            pixels_per_buffer;
+};
+
+typedef struct {
+    hpix_nside_t      nside;
+    unsigned int      lmax;
+    unsigned int      mmax;
+    psht_geom_info  * geom_info;
+    psht_alm_info   * alm_info;
+    psht_plan       * plan;
+
+    unsigned int      ref_count;
+    unsigned long     last_use;
+    int               is_private; /* Not stored in sht_cache */
+} sht_setup_t;
+
+#define SHT_CACHE_SIZE 8
+
+static sht_setup_t sht_cache[SHT_CACHE_SIZE];
+static unsigned long sht_cache_clock = 0;
+
+/**********************************************************************/
+
+
+hpix_alm_t *
+hpix_create_alm(unsigned int lmax, unsigned int mmax)
+{
+    assert(mmax <= lmax);
+
+    hpix_alm_t * alm = hpix_malloc(sizeof(hpix_alm_t), 1);
+    alm->lmax = lmax;
+    alm->mmax = mmax;
+    alm->num_of_coefficients =
+	((size_t) mmax + 1) * (mmax + 2) / 2
+	+ ((size_t) mmax + 1) * (lmax - mmax);
+    alm->coefficients = hpix_calloc(sizeof(hpix_complex_t),
+				    alm->num_of_coefficients);
+
+    return alm;
+}
+
+/**********************************************************************/
+
+
+void
+hpix_free_alm(hpix_alm_t * alm)
+{
+    if(alm == NULL)
+	return;
+
+    hpix_free(alm->coefficients);
+    hpix_free(alm);
+}
+
+/**********************************************************************/
+
+
+unsigned int
+hpix_alm_lmax(const hpix_alm_t * alm)
+{
+    assert(alm);
+    return alm->lmax;
+}
+
+/**********************************************************************/
+
+
+unsigned int
+hpix_alm_mmax(const hpix_alm_t * alm)
+{
+    assert(alm);
+    return alm->mmax;
+}
+
+/**********************************************************************/
+
+
+size_t
+hpix_alm_num_of_coefficients(const hpix_alm_t * alm)
+{
+    assert(alm);
+    return alm->num_of_coefficients;
+}
+
+/**********************************************************************/
+
+
+hpix_complex_t *
+hpix_alm_coefficients(const hpix_alm_t * alm)
+{
+    assert(alm);
+    return alm->coefficients;
+}
+
+/**********************************************************************/
+
+
+size_t
+hpix_alm_index(const hpix_alm_t * alm, unsigned int l, unsigned int m)
+{
+    assert(alm);
+    assert(m <= alm->mmax);
+    assert(l >= m && l <= alm->lmax);
+
+    /* Coefficients are sorted by m first, then by l (the same
+     * "triangular" scheme used by Healpix_cxx) */
+    return (size_t) m * (2 * alm->lmax + 1 - m) / 2 + l;
+}
+
+/**********************************************************************/
+
+
+static void
+init_setup(sht_setup_t * setup,
+	   hpix_nside_t nside,
+	   unsigned int lmax,
+	   unsigned int mmax,
+	   const double * ring_weights)
+{
+    setup->nside = nside;
+    setup->lmax = lmax;
+    setup->mmax = mmax;
+    if(ring_weights != NULL)
+	psht_make_weighted_healpix_geom_info(nside, 1, ring_weights,
+					     &setup->geom_info);
+    else
+	psht_make_healpix_geom_info(nside, 1, &setup->geom_info);
+    psht_make_triangular_alm_info(lmax, mmax, 1, &setup->alm_info);
+    psht_make_plan(setup->geom_info, setup->alm_info, &setup->plan);
+    setup->ref_count = 0;
+    setup->is_private = 0;
+}
+
+/**********************************************************************/
+
+
+static void
+destroy_setup(sht_setup_t * setup)
+{
+    psht_destroy_plan(setup->plan);
+    psht_destroy_geom_info(setup->geom_info);
+    psht_destroy_alm_info(setup->alm_info);
+    memset(setup, 0, sizeof(*setup));
+}
+
+/**********************************************************************/
+
+
+/* Create a setup which is not stored in the cache. It is destroyed
+ * by release_setup. */
+static sht_setup_t *
+create_private_setup(hpix_nside_t nside,
+		     unsigned int lmax,
+		     unsigned int mmax,
+		     const double * ring_weights)
+{
+    sht_setup_t * setup = hpix_malloc(sizeof(sht_setup_t), 1);
+    init_setup(setup, nside, lmax, mmax, ring_weights);
+    setup->is_private = 1;
+    return setup;
+}
+
+/**********************************************************************/
+
+
+/* Return a setup for the given parameters, either from the cache or
+ * by creating a new one. The result must be passed to
+ * release_setup. */
+static sht_setup_t *
+acquire_setup(hpix_nside_t nside, unsigned int lmax, unsigned int mmax)
+{
+    sht_setup_t * result = NULL;
+
+#pragma omp critical(hpix_sht_cache)
+    {
+	sht_setup_t * victim = NULL;
+
+	for(size_t idx = 0; idx < SHT_CACHE_SIZE; ++idx)
+	{
+	    sht_setup_t * entry = &sht_cache[idx];
+	    if(entry->geom_info != NULL
+	       && entry->nside == nside
+	       && entry->lmax == lmax
+	       && entry->mmax == mmax)
+	    {
+		result = entry;
+		break;
+	    }
+
+	    /* Prefer empty slots, then the least recently used one */
+	    if(entry->ref_count == 0
+	       && (victim == NULL
+		   || (victim->geom_info != NULL
+		       && (entry->geom_info == NULL
+			   || entry->last_use < victim->last_use))))
+		victim = entry;
+	}
+
+	if(result == NULL && victim != NULL)
+	{
+	    if(victim->geom_info != NULL)
+		destroy_setup(victim);
+	    init_setup(victim, nside, lmax, mmax, NULL);
+	    result = victim;
+	}
+
+	if(result != NULL)
+	{
+	    result->ref_count++;
+	    result->last_use = ++sht_cache_clock;
+	}
+    }
+
+    if(result == NULL)
+    {
+	/* Every entry in the cache is being used: create a private
+	 * setup that will be destroyed by release_setup */
+	result = create_private_setup(nside, lmax, mmax, NULL);
+    }
+
+    return result;
+}
+
+/**********************************************************************/
+
+
+static void
+release_setup(sht_setup_t * setup)
+{
+    if(setup->is_private)
+    {
+	destroy_setup(setup);
+	hpix_free(setup);
+	return;
+    }
+
+#pragma omp critical(hpix_sht_cache)
+    setup->ref_count--;
+}
+
+/**********************************************************************/
+
+
+void
+hpix_free_sht_cache(void)
+{
+#pragma omp critical(hpix_sht_cache)
+    {
+	for(size_t idx = 0; idx < SHT_CACHE_SIZE; ++idx)
+	{
+	    sht_setup_t * entry = &sht_cache[idx];
+	    if(entry->geom_info != NULL && entry->ref_count == 0)
+		destroy_setup(entry);
+	}
+    }
+}
+
+/**********************************************************************/
+
+
+/* Return a RING-ordered copy of `map` if it uses the NEST scheme, or
+ * the map itself otherwise. */
+static const hpix_map_t *
+ring_ordered_map(const hpix_map_t * map)
+{
+    if(hpix_map_ordering_scheme(map) == HPIX_ORDER_SCHEME_RING)
+	return map;
+
+    hpix_map_t * copy = hpix_create_copy_of_map(map);
+    hpix_switch_order(copy);
+    return copy;
+}
+
+/**********************************************************************/
+
+
+static void
+free_ring_ordered_map(const hpix_map_t * ring_map,
+		      const hpix_map_t * original_map)
+{
+    if(ring_map != original_map)
+	hpix_free_map((hpix_map_t *) ring_map);
+}
+
+/**********************************************************************/
+
+
+/* Maps are passed to alm2map in RING order. If the caller used NEST
+ * maps, we fill them as if they were RING maps and reorder them in
+ * place at the end, so that no additional memory is needed. */
+static void
+prepare_output_map(hpix_map_t * map, int * is_nest)
+{
+    *is_nest = (hpix_map_ordering_scheme(map) == HPIX_ORDER_SCHEME_NEST);
+    if(*is_nest)
+	map->scheme = HPIX_ORDER_SCHEME_RING;
+}
+
+/**********************************************************************/
+
+
+static void
+finalize_output_map(hpix_map_t * map, int is_nest)
+{
+    if(is_nest)
+	hpix_switch_order(map);
+}
+
+/**********************************************************************/
+
+
+void
+hpix_map2alm(const hpix_map_t * map, hpix_alm_t * alm)
+{
+    assert(map);
+    assert(alm);
+
+    const hpix_map_t * ring_map = ring_ordered_map(map);
+    sht_setup_t * setup = acquire_setup(hpix_map_nside(map),
+					alm->lmax, alm->mmax);
+
+    pshtd_joblist * joblist;
+    pshtd_make_joblist(&joblist);
+    pshtd_add_job_map2alm(joblist, hpix_map_pixels(ring_map),
+			  (pshtd_cmplx *) alm->coefficients, 0);
+    pshtd_execute_jobs_plan(joblist, setup->plan);
+    pshtd_destroy_joblist(joblist);
+
+    release_setup(setup);
+    free_ring_ordered_map(ring_map, map);
+}
+
+/**********************************************************************/
+
+
+void
+hpix_alm2map(const hpix_alm_t * alm, hpix_map_t * map)
+{
+    assert(alm);
+    assert(map);
+
+    int is_nest;
+    prepare_output_map(map, &is_nest);
+    sht_setup_t * setup = acquire_setup(hpix_map_nside(map),
+					alm->lmax, alm->mmax);
+
+    pshtd_joblist * joblist;
+    pshtd_make_joblist(&joblist);
+    pshtd_add_job_alm2map(joblist, (const pshtd_cmplx *) alm->coefficients,
+			  hpix_map_pixels(map), 0);
+    pshtd_execute_jobs_plan(joblist, setup->plan);
+    pshtd_destroy_joblist(joblist);
+
+    release_setup(setup);
+    finalize_output_map(map, is_nest);
+}
+
+/**********************************************************************/
+
+
+void
+hpix_map2alm_pol(const hpix_map_t * map_i,
+		 const hpix_map_t * map_q,
+		 const hpix_map_t * map_u,
+		 hpix_alm_t * alm_t,
+		 hpix_alm_t * alm_e,
+		 hpix_alm_t * alm_b)
+{
+    assert(map_i && map_q && map_u);
+    assert(alm_t && alm_e && alm_b);
+    assert(hpix_map_nside(map_q) == hpix_map_nside(map_i));
+    assert(hpix_map_nside(map_u) == hpix_map_nside(map_i));
+    assert(alm_e->lmax == alm_t->lmax && alm_e->mmax == alm_t->mmax);
+    assert(alm_b->lmax == alm_t->lmax && alm_b->mmax == alm_t->mmax);
+
+    const hpix_map_t * ring_i = ring_ordered_map(map_i);
+    const hpix_map_t * ring_q = ring_ordered_map(map_q);
+    const hpix_map_t * ring_u = ring_ordered_map(map_u);
+    sht_setup_t * setup = acquire_setup(hpix_map_nside(map_i),
+					alm_t->lmax, alm_t->mmax);
+
+    pshtd_joblist * joblist;
+    pshtd_make_joblist(&joblist);
+    pshtd_add_job_map2alm_pol(joblist,
+			      hpix_map_pixels(ring_i),
+			      hpix_map_pixels(ring_q),
+			      hpix_map_pixels(ring_u),
+			      (pshtd_cmplx *) alm_t->coefficients,
+			      (pshtd_cmplx *) alm_e->coefficients,
+			      (pshtd_cmplx *) alm_b->coefficients,
+			      0);
+    pshtd_execute_jobs_plan(joblist, setup->plan);
+    pshtd_destroy_joblist(joblist);
+
+    release_setup(setup);
+    free_ring_ordered_map(ring_i, map_i);
+    free_ring_ordered_map(ring_q, map_q);
+    free_ring_ordered_map(ring_u, map_u);
+}
+
+/**********************************************************************/
+
+
+void
+hpix_alm2map_pol(const hpix_alm_t * alm_t,
+		 const hpix_alm_t * alm_e,
+		 const hpix_alm_t * alm_b,
+		 hpix_map_t * map_i,
+		 hpix_map_t * map_q,
+		 hpix_map_t * map_u)
+{
+    assert(alm_t && alm_e && alm_b);
+    assert(map_i && map_q && map_u);
+    assert(hpix_map_nside(map_q) == hpix_map_nside(map_i));
+    assert(hpix_map_nside(map_u) == hpix_map_nside(map_i));
+    assert(alm_e->lmax == alm_t->lmax && alm_e->mmax == alm_t->mmax);
+    assert(alm_b->lmax == alm_t->lmax && alm_b->mmax == alm_t->mmax);
+
+    int is_nest_i, is_nest_q, is_nest_u;
+    prepare_output_map(map_i, &is_nest_i);
+    prepare_output_map(map_q, &is_nest_q);
+    prepare_output_map(map_u, &is_nest_u);
+    sht_setup_t * setup = acquire_setup(hpix_map_nside(map_i),
+					alm_t->lmax, alm_t->mmax);
+
+    pshtd_joblist * joblist;
+    pshtd_make_joblist(&joblist);
+    pshtd_add_job_alm2map_pol(joblist,
+			      (const pshtd_cmplx *) alm_t->coefficients,
+			      (const pshtd_cmplx *) alm_e->coefficients,
+			      (const pshtd_cmplx *) alm_b->coefficients,
+			      hpix_map_pixels(map_i),
+			      hpix_map_pixels(map_q),
+			      hpix_map_pixels(map_u),
+			      0);
+    pshtd_execute_jobs_plan(joblist, setup->plan);
+    pshtd_destroy_joblist(joblist);
+
+    release_setup(setup);
+    finalize_output_map(map_i, is_nest_i);
+    finalize_output_map(map_q, is_nest_q);
+    finalize_output_map(map_u, is_nest_u);
+}
+
+/**********************************************************************/
+
+
+/* Copy the pixels in `map` into `result` using the RING scheme.
+ * Masked pixels are set to zero, and the others are multiplied by the
+ * (RING-ordered) weights in `mask_pixels`, if it is not NULL. */
+static void
+masked_ring_pixels(const hpix_map_t * map,
+		   const double * mask_pixels,
+		   double * result)
+{
+    const hpix_map_t * ring_map = ring_ordered_map(map);
+    const double * pixels = hpix_map_pixels(ring_map);
+    const size_t num_of_pixels = hpix_map_num_of_pixels(map);
+
+#pragma omp parallel for default(shared)
+    for(size_t idx = 0; idx < num_of_pixels; ++idx)
+    {
+	double value = pixels[idx];
+	if(HPIX_IS_MASKED(value))
+	    value = 0.0;
+	else if(mask_pixels != NULL)
+	{
+	    const double weight = mask_pixels[idx];
+	    value = HPIX_IS_MASKED(weight) ? 0.0 : value * weight;
+	}
+	result[idx] = value;
+    }
+
+    free_ring_ordered_map(ring_map, map);
+}
+
+/**********************************************************************/
+
+
+/* Number of fields whose transforms can be added to the same
+ * joblist. Polarized transforms use two libpsht jobs each (one for
+ * the spin-0 and one for the spin-2 components). */
+static size_t
+fields_per_batch(int polarization_flag)
+{
+    return polarization_flag ? psht_maxjobs / 2 : psht_maxjobs;
+}
+
+/**********************************************************************/
+
+
+/* Return (1 / (2l + 1)) sum_m a_lm b_lm^*, using the fact that the
+ * coefficients with negative m are the complex conjugates of the
+ * ones with positive m. */
+static double
+alm_cross_power(const hpix_alm_t * a, const hpix_alm_t * b, unsigned int l)
+{
+    const hpix_complex_t * coeff_a = a->coefficients;
+    const hpix_complex_t * coeff_b = b->coefficients;
+    const unsigned int max_m = (l < a->mmax) ? l : a->mmax;
+
+    double sum = coeff_a[l].re * coeff_b[l].re;
+    for(unsigned int m = 1; m <= max_m; ++m)
+    {
+	const size_t idx = hpix_alm_index(a, l, m);
+	sum += 2.0 * (coeff_a[idx].re * coeff_b[idx].re
+		      + coeff_a[idx].im * coeff_b[idx].im);
+    }
+
+    return sum / (2.0 * l + 1.0);
+}
+
+/**********************************************************************/
+
+
+hpix_power_spectrum_t *
+hpix_anafast(const hpix_map_t * const * maps_i,
+	     const hpix_map_t * const * maps_q,
+	     const hpix_map_t * const * maps_u,
+	     size_t num_of_fields,
+	     const hpix_map_t * mask,
+	     unsigned int lmax)
+{
+    /* Indexes of the a_lm (T, E, B) used by each spectrum component */
+    static const unsigned int
+	component_alms[HPIX_NUM_OF_SPECTRUM_COMPONENTS][2] = {
+	    { 0, 0 }, { 1, 1 }, { 2, 2 }, { 0, 1 }, { 0, 2 }, { 1, 2 }
+	};
+
+    assert(maps_i);
+    assert(num_of_fields > 0);
+    assert((maps_q == NULL) == (maps_u == NULL));
+
+    const int polarization_flag = (maps_q != NULL);
+    const unsigned int num_of_alms = polarization_flag ? 3 : 1;
+    const hpix_nside_t nside = hpix_map_nside(maps_i[0]);
+    const size_t num_of_pixels = hpix_map_num_of_pixels(maps_i[0]);
+
+    for(size_t field = 0; field < num_of_fields; ++field)
+    {
+	assert(hpix_map_nside(maps_i[field]) == nside);
+	if(polarization_flag)
+	{
+	    assert(hpix_map_nside(maps_q[field]) == nside);
+	    assert(hpix_map_nside(maps_u[field]) == nside);
+	}
+    }
+
+    hpix_power_spectrum_t * spectrum =
+	hpix_malloc(sizeof(hpix_power_spectrum_t), 1);
+    spectrum->lmax = lmax;
+    spectrum->num_of_fields = num_of_fields;
+    spectrum->polarization_flag = polarization_flag;
+    spectrum->num_of_components =
+	polarization_flag ? HPIX_NUM_OF_SPECTRUM_COMPONENTS : 1;
+    spectrum->fsky = 1.0;
+
+    const hpix_map_t * ring_mask = NULL;
+    const double * mask_pixels = NULL;
+    if(mask != NULL)
+    {
+	assert(hpix_map_nside(mask) == nside);
+	ring_mask = ring_ordered_map(mask);
+	mask_pixels = hpix_map_pixels(ring_mask);
+
+	/* Pseudo-C_l are biased low by the average of the squared
+	 * weights, which is the usual definition of the sky fraction */
+	double sum = 0.0;
+#pragma omp parallel for default(shared) reduction(+:sum)
+	for(size_t idx = 0; idx < num_of_pixels; ++idx)
+	{
+	    if(! HPIX_IS_MASKED(mask_pixels[idx]))
+		sum += mask_pixels[idx] * mask_pixels[idx];
+	}
+	spectrum->fsky = sum / num_of_pixels;
+    }
+
+    /* Compute the a_lm of all the fields, running as many transforms
+     * at once as libpsht allows, so that they share the Y_lm
+     * recursion */
+    hpix_alm_t ** alms = hpix_malloc(sizeof(hpix_alm_t *),
+				     num_of_fields * num_of_alms);
+    for(size_t idx = 0; idx < num_of_fields * num_of_alms; ++idx)
+	alms[idx] = hpix_create_alm(lmax, lmax);
+
+    sht_setup_t * setup = acquire_setup(nside, lmax, lmax);
+    pshtd_joblist * joblist;
+    pshtd_make_joblist(&joblist);
+    double * buffers[psht_maxjobs][3];
+
+    const size_t max_batch_size = fields_per_batch(polarization_flag);
+
+    for(size_t first = 0; first < num_of_fields; first += max_batch_size)
+    {
+	const size_t batch_size = (num_of_fields - first < max_batch_size)
+	    ? num_of_fields - first : max_batch_size;
+
+	pshtd_clear_joblist(joblist);
+	for(size_t job = 0; job < batch_size; ++job)
+	{
+	    const size_t field = first + job;
+	    hpix_alm_t ** field_alms = alms + field * num_of_alms;
+
+	    const hpix_map_t * field_maps[3] = {
+		maps_i[field],
+		polarization_flag ? maps_q[field] : NULL,
+		polarization_flag ? maps_u[field] : NULL
+	    };
+	    for(unsigned int comp = 0; comp < num_of_alms; ++comp)
+	    {
+		buffers[job][comp] = hpix_malloc(sizeof(double), num_of_pixels);
+		masked_ring_pixels(field_maps[comp], mask_pixels,
+				   buffers[job][comp]);
+	    }
+
+	    if(polarization_flag)
+	    {
+		pshtd_add_job_map2alm_pol(joblist,
+					  buffers[job][0],
+					  buffers[job][1],
+					  buffers[job][2],
+					  (pshtd_cmplx *) field_alms[0]->coefficients,
+					  (pshtd_cmplx *) field_alms[1]->coefficients,
+					  (pshtd_cmplx *) field_alms[2]->coefficients,
+					  0);
+	    }
+	    else
+		pshtd_add_job_map2alm(joblist, buffers[job][0],
+				      (pshtd_cmplx *) field_alms[0]->coefficients,
+				      0);
+	}
+
+	pshtd_execute_jobs_plan(joblist, setup->plan);
+
+	for(size_t job = 0; job < batch_size; ++job)
+	{
+	    for(unsigned int comp = 0; comp < num_of_alms; ++comp)
+		hpix_free(buffers[job][comp]);
+	}
+    }
+
+    pshtd_destroy_joblist(joblist);
+    release_setup(setup);
+    if(ring_mask != NULL)
+	free_ring_ordered_map(ring_mask, mask);
+
+    /* Accumulate the auto- and cross-spectra */
+    const size_t num_of_spectra =
+	num_of_fields * num_of_fields * spectrum->num_of_components;
+    const size_t num_of_multipoles = (size_t) lmax + 1;
+    spectrum->cl = hpix_malloc(sizeof(double),
+			       num_of_spectra * num_of_multipoles);
+
+#pragma omp parallel for default(shared) schedule(dynamic, 64)
+    for(size_t idx = 0; idx < num_of_spectra * num_of_multipoles; ++idx)
+    {
+	const unsigned int l = idx % num_of_multipoles;
+	const size_t spectrum_idx = idx / num_of_multipoles;
+	const unsigned int comp = spectrum_idx % spectrum->num_of_components;
+	const size_t pair = spectrum_idx / spectrum->num_of_components;
+	const size_t field1 = pair / num_of_fields;
+	const size_t field2 = pair % num_of_fields;
+
+	spectrum->cl[idx] =
+	    alm_cross_power(alms[field1 * num_of_alms + component_alms[comp][0]],
+			    alms[field2 * num_of_alms + component_alms[comp][1]],
+			    l);
+    }
+
+    for(size_t idx = 0; idx < num_of_fields * num_of_alms; ++idx)
+	hpix_free_alm(alms[idx]);
+    hpix_free(alms);
+
+    return spectrum;
+}
+
+/**********************************************************************/
+
+
+void
+hpix_free_power_spectrum(hpix_power_spectrum_t * spectrum)
+{
+    if(spectrum == NULL)
+	return;
+
+    hpix_free(spectrum->cl);
+    hpix_free(spectrum);
+}
+
+/**********************************************************************/
+
+
+unsigned int
+hpix_power_spectrum_lmax(const hpix_power_spectrum_t * spectrum)
+{
+    assert(spectrum);
+    return spectrum->lmax;
+}
+
+/**********************************************************************/
+
+
+size_t
+hpix_power_spectrum_num_of_fields(const hpix_power_spectrum_t * spectrum)
+{
+    assert(spectrum);
+    return spectrum->num_of_fields;
+}
+
+/**********************************************************************/
+
+
+int
+hpix_power_spectrum_has_polarization(const hpix_power_spectrum_t * spectrum)
+{
+    assert(spectrum);
+    return spectrum->polarization_flag;
+}
+
+/**********************************************************************/
+
+
+double
+hpix_power_spectrum_fsky(const hpix_power_spectrum_t * spectrum)
+{
+    assert(spectrum);
+    return spectrum->fsky;
+}
+
+/**********************************************************************/
+
+
+const double *
+hpix_power_spectrum_cl(const hpix_power_spectrum_t * spectrum,
+		       size_t field1,
+		       size_t field2,
+		       hpix_spectrum_component_t component)
+{
+    assert(spectrum);
+    assert(field1 < spectrum->num_of_fields);
+    assert(field2 < spectrum->num_of_fields);
+
+    if((unsigned int) component >= spectrum->num_of_components)
+	return NULL;
+
+    const size_t spectrum_idx =
+	(field1 * spectrum->num_of_fields + field2)
+	* spectrum->num_of_components + component;
+    return spectrum->cl + spectrum_idx * (spectrum->lmax + 1);
+}
+
+/**********************************************************************/
+
+
+static hpix_smoothing_t *
+create_smoothing(unsigned int lmax)
+{
+    hpix_smoothing_t * smoothing = hpix_malloc(sizeof(hpix_smoothing_t), 1);
+    smoothing->lmax = lmax;
+    smoothing->window_t = hpix_malloc(sizeof(double), lmax + 1);
+    smoothing->window_pol = hpix_malloc(sizeof(double), lmax + 1);
+    for(size_t idx = 0; idx < psht_maxjobs * 3; ++idx)
+    {
+	smoothing->alm_buffers[idx] = NULL;
+	smoothing->pixel_buffers[idx] = NULL;
+    }
+    smoothing->pixels_per_buffer = 0;
+
+    return smoothing;
+}
+
+/**********************************************************************/
+
+
+hpix_smoothing_t *
+hpix_create_gaussian_smoothing(double fwhm, unsigned int lmax)
+{
+    assert(fwhm >= 0.0);
+
+    hpix_smoothing_t * smoothing = create_smoothing(lmax);
+    const double sigma = fwhm / sqrt(8.0 * log(2.0));
+
+    /* The window of spin-2 fields uses l(l+1) - s^2, like Healpix */
+    for(unsigned int l = 0; l <= lmax; ++l)
+    {
+	const double l_factor = l * (l + 1.0);
+	smoothing->window_t[l] = exp(-0.5 * l_factor * sigma * sigma);
+	smoothing->window_pol[l] = exp(-0.5 * (l_factor - 4.0) * sigma * sigma);
+    }
+
+    return smoothing;
+}
+
+/**********************************************************************/
+
+
+hpix_smoothing_t *
+hpix_create_tabulated_smoothing(const double * window_t,
+				const double * window_pol,
+				unsigned int lmax)
+{
+    assert(window_t);
+
+    hpix_smoothing_t * smoothing = create_smoothing(lmax);
+    if(window_pol == NULL)
+	window_pol = window_t;
+
+    memcpy(smoothing->window_t, window_t, sizeof(double) * (lmax + 1));
+    memcpy(smoothing->window_pol, window_pol, sizeof(double) * (lmax + 1));
+
+    return smoothing;
+}
+
+/**********************************************************************/
+
+
+void
+hpix_free_smoothing(hpix_smoothing_t * smoothing)
+{
+    if(smoothing == NULL)
+	return;
+
+    for(size_t idx = 0; idx < psht_maxjobs * 3; ++idx)
+    {
+	hpix_free_alm(smoothing->alm_buffers[idx]);
+	hpix_free(smoothing->pixel_buffers[idx]);
+    }
+
+    hpix_free(smoothing->window_t);
+    hpix_free(smoothing->window_pol);
+    hpix_free(smoothing);
+}
+
+/**********************************************************************/
+
+
+unsigned int
+hpix_smoothing_lmax(const hpix_smoothing_t * smoothing)
+{
+    assert(smoothing);
+    return smoothing->lmax;
+}
+
+/**********************************************************************/
+
+
+const double *
+hpix_smoothing_window(const hpix_smoothing_t * smoothing,
+		      int polarization_flag)
+{
+    assert(smoothing);
+    return polarization_flag ? smoothing->window_pol : smoothing->window_t;
+}
+
+/**********************************************************************/
+
+
+void
+hpix_smoothing_apply_pixel_window(hpix_smoothing_t * smoothing,
+				  const double * pixwin_t,
+				  const double * pixwin_pol)
+{
+    assert(smoothing);
+    assert(pixwin_t);
+
+    if(pixwin_pol == NULL)
+	pixwin_pol = pixwin_t;
+
+    for(unsigned int l = 0; l <= smoothing->lmax; ++l)
+    {
+	smoothing->window_t[l] *= pixwin_t[l];
+	smoothing->window_pol[l] *= pixwin_pol[l];
+    }
+}
+
+/**********************************************************************/
+
+
+static void
+multiply_alm_by_window(hpix_alm_t * alm, const double * window)
+{
+#pragma omp parallel for default(shared) schedule(dynamic, 4)
+    for(unsigned int m = 0; m <= alm->mmax; ++m)
+    {
+	hpix_complex_t * coeffs = alm->coefficients + hpix_alm_index(alm, m, m);
+	for(unsigned int l = m; l <= alm->lmax; ++l)
+	{
+	    coeffs[l - m].re *= window[l];
+	    coeffs[l - m].im *= window[l];
+	}
+    }
+}
+
+/**********************************************************************/
+
+
+static pshtd_cmplx *
+psht_coefficients(const hpix_alm_t * alm)
+{
+    return (pshtd_cmplx *) alm->coefficients;
+}
+
+/**********************************************************************/
+
+
+void
+hpix_smooth_maps(hpix_smoothing_t * smoothing,
+		 hpix_map_t * const * maps_i,
+		 hpix_map_t * const * maps_q,
+		 hpix_map_t * const * maps_u,
+		 size_t num_of_fields)
+{
+    assert(smoothing);
+    assert(maps_i);
+    assert((maps_q == NULL) == (maps_u == NULL));
+
+    if(num_of_fields == 0)
+	return;
+
+    const int polarization_flag = (maps_q != NULL);
+    const unsigned int num_of_alms = polarization_flag ? 3 : 1;
+    const unsigned int lmax = smoothing->lmax;
+    const hpix_nside_t nside = hpix_map_nside(maps_i[0]);
+    const size_t num_of_pixels = hpix_map_num_of_pixels(maps_i[0]);
+
+    for(size_t field = 0; field < num_of_fields; ++field)
+    {
+	assert(hpix_map_nside(maps_i[field]) == nside);
+	if(polarization_flag)
+	{
+	    assert(hpix_map_nside(maps_q[field]) == nside);
+	    assert(hpix_map_nside(maps_u[field]) == nside);
+	}
+    }
+
+    if(smoothing->pixels_per_buffer != num_of_pixels)
+    {
+	for(size_t idx = 0; idx < psht_maxjobs * 3; ++idx)
+	{
+	    hpix_free(smoothing->pixel_buffers[idx]);
+	    smoothing->pixel_buffers[idx] = NULL;
+	}
+	smoothing->pixels_per_buffer = num_of_pixels;
+    }
+
+    sht_setup_t * setup = acquire_setup(nside, lmax, lmax);
+    pshtd_joblist * joblist;
+    pshtd_make_joblist(&joblist);
+
+    const size_t max_batch_size = fields_per_batch(polarization_flag);
+
+    for(size_t first = 0; first < num_of_fields; first += max_batch_size)
+    {
+	const size_t batch_size = (num_of_fields - first < max_batch_size)
+	    ? num_of_fields - first : max_batch_size;
+	hpix_map_t * maps[psht_maxjobs][3];
+	hpix_alm_t ** alms = smoothing->alm_buffers;
+
+	/* Decompose all the maps in the batch at once */
+	pshtd_clear_joblist(joblist);
+	for(size_t job = 0; job < batch_size; ++job)
+	{
+	    maps[job][0] = maps_i[first + job];
+	    maps[job][1] = polarization_flag ? maps_q[first + job] : NULL;
+	    maps[job][2] = polarization_flag ? maps_u[first + job] : NULL;
+
+	    for(unsigned int comp = 0; comp < num_of_alms; ++comp)
+	    {
+		const size_t idx = job * 3 + comp;
+		if(alms[idx] == NULL)
+		    alms[idx] = hpix_create_alm(lmax, lmax);
+		if(smoothing->pixel_buffers[idx] == NULL)
+		    smoothing->pixel_buffers[idx] =
+			hpix_malloc(sizeof(double), num_of_pixels);
+
+		masked_ring_pixels(maps[job][comp], NULL,
+				   smoothing->pixel_buffers[idx]);
+	    }
+
+	    double ** buffers = smoothing->pixel_buffers + job * 3;
+	    if(polarization_flag)
+		pshtd_add_job_map2alm_pol(joblist,
+					  buffers[0], buffers[1], buffers[2],
+					  psht_coefficients(alms[job * 3]),
+					  psht_coefficients(alms[job * 3 + 1]),
+					  psht_coefficients(alms[job * 3 + 2]),
+					  0);
+	    else
+		pshtd_add_job_map2alm(joblist, buffers[0],
+				      psht_coefficients(alms[job * 3]), 0);
+	}
+	pshtd_execute_jobs_plan(joblist, setup->plan);
+
+	/* Apply the window and synthesize the maps again */
+	pshtd_clear_joblist(joblist);
+	int is_nest[psht_maxjobs][3];
+	for(size_t job = 0; job < batch_size; ++job)
+	{
+	    for(unsigned int comp = 0; comp < num_of_alms; ++comp)
+	    {
+		multiply_alm_by_window(alms[job * 3 + comp],
+				       (comp == 0) ? smoothing->window_t
+				       : smoothing->window_pol);
+		prepare_output_map(maps[job][comp], &is_nest[job][comp]);
+	    }
+
+	    if(polarization_flag)
+		pshtd_add_job_alm2map_pol(joblist,
+					  psht_coefficients(alms[job * 3]),
+					  psht_coefficients(alms[job * 3 + 1]),
+					  psht_coefficients(alms[job * 3 + 2]),
+					  hpix_map_pixels(maps[job][0]),
+					  hpix_map_pixels(maps[job][1]),
+					  hpix_map_pixels(maps[job][2]),
+					  0);
+	    else
+		pshtd_add_job_alm2map(joblist,
+				      psht_coefficients(alms[job * 3]),
+				      hpix_map_pixels(maps[job][0]), 0);
+	}
+	pshtd_execute_jobs_plan(joblist, setup->plan);
+
+	for(size_t job = 0; job < batch_size; ++job)
+	{
+	    for(unsigned int comp = 0; comp < num_of_alms; ++comp)
+		finalize_output_map(maps[job][comp], is_nest[job][comp]);
+	}
+    }
+
+    pshtd_destroy_joblist(joblist);
+    release_setup(setup);
+}
+
+/**********************************************************************/
+
+
+void
+hpix_smooth_map(hpix_smoothing_t * smoothing, hpix_map_t * map)
+{
+    hpix_smooth_maps(smoothing, &map, NULL, NULL, 1);
+}
+
+/**********************************************************************/
+
+
+void
+hpix_smooth_map_pol(hpix_smoothing_t * smoothing,
+		    hpix_map_t * map_i,
+		    hpix_map_t * map_q,
+		    hpix_map_t * map_u)
+{
+    hpix_smooth_maps(smoothing, &map_i, &map_q, &map_u, 1);
+}
+
+/**********************************************************************/
+
+
+/* Iteratively improve the a_lm of `num_of_alms` maps (1 for
+ * temperature, 3 for I, Q, U) by repeatedly computing the residual
+ * map - alm2map(alm) and adding its map2alm to the coefficients. */
+static unsigned int
+map2alm_iterative(const hpix_map_t * const * maps,
+		  hpix_alm_t * const * alms,
+		  unsigned int num_of_alms,
+		  unsigned int max_iterations,
+		  double tolerance,
+		  const double * ring_weights)
+{
+    const hpix_nside_t nside = hpix_map_nside(maps[0]);
+    const size_t num_of_pixels = hpix_map_num_of_pixels(maps[0]);
+    const unsigned int lmax = alms[0]->lmax;
+    const unsigned int mmax = alms[0]->mmax;
+    double * pixels[3], * residuals[3];
+    pshtd_cmplx * coeffs[3];
+    double max_abs_pixel = 0.0;
+
+    for(unsigned int comp = 0; comp < num_of_alms; ++comp)
+    {
+	assert(hpix_map_nside(maps[comp]) == nside);
+	assert(alms[comp]->lmax == lmax && alms[comp]->mmax == mmax);
+
+	pixels[comp] = hpix_malloc(sizeof(double), num_of_pixels);
+	residuals[comp] = hpix_malloc(sizeof(double), num_of_pixels);
+	coeffs[comp] = psht_coefficients(alms[comp]);
+	masked_ring_pixels(maps[comp], NULL, pixels[comp]);
+
+	for(size_t idx = 0; idx < num_of_pixels; ++idx)
+	{
+	    if(fabs(pixels[comp][idx]) > max_abs_pixel)
+		max_abs_pixel = fabs(pixels[comp][idx]);
+	}
+    }
+
+    /* Weighted geometries are not cached, but they are built only
+     * once for all the iterations */
+    sht_setup_t * setup = (ring_weights != NULL)
+	? create_private_setup(nside, lmax, mmax, ring_weights)
+	: acquire_setup(nside, lmax, mmax);
+
+    pshtd_joblist * joblist;
+    pshtd_make_joblist(&joblist);
+
+    if(num_of_alms == 3)
+	pshtd_add_job_map2alm_pol(joblist, pixels[0], pixels[1], pixels[2],
+				  coeffs[0], coeffs[1], coeffs[2], 0);
+    else
+	pshtd_add_job_map2alm(joblist, pixels[0], coeffs[0], 0);
+    pshtd_execute_jobs_plan(joblist, setup->plan);
+
+    unsigned int iteration;
+    for(iteration = 0; iteration < max_iterations; ++iteration)
+    {
+	pshtd_clear_joblist(joblist);
+	if(num_of_alms == 3)
+	    pshtd_add_job_alm2map_pol(joblist, coeffs[0], coeffs[1], coeffs[2],
+				      residuals[0], residuals[1], residuals[2],
+				      0);
+	else
+	    pshtd_add_job_alm2map(joblist, coeffs[0], residuals[0], 0);
+	pshtd_execute_jobs_plan(joblist, setup->plan);
+
+	double max_abs_residual = 0.0;
+	for(unsigned int comp = 0; comp < num_of_alms; ++comp)
+	{
+	    double * residual = residuals[comp];
+	    const double * pixel = pixels[comp];
+	    double max_abs_value = 0.0;
+
+#pragma omp parallel default(shared)
+	    {
+		double local_max = 0.0;
+#pragma omp for
+		for(size_t idx = 0; idx < num_of_pixels; ++idx)
+		{
+		    residual[idx] = pixel[idx] - residual[idx];
+		    if(fabs(residual[idx]) > local_max)
+			local_max = fabs(residual[idx]);
+		}
+#pragma omp critical(hpix_map2alm_iterative)
+		if(local_max > max_abs_value)
+		    max_abs_value = local_max;
+	    }
+
+	    if(max_abs_value > max_abs_residual)
+		max_abs_residual = max_abs_value;
+	}
+
+	if(max_abs_residual <= tolerance * max_abs_pixel)
+	    break;
+
+	/* alm += map2alm(residual) */
+	pshtd_clear_joblist(joblist);
+	if(num_of_alms == 3)
+	    pshtd_add_job_map2alm_pol(joblist,
+				      residuals[0], residuals[1], residuals[2],
+				      coeffs[0], coeffs[1], coeffs[2], 1);
+	else
+	    pshtd_add_job_map2alm(joblist, residuals[0], coeffs[0], 1);
+	pshtd_execute_jobs_plan(joblist, setup->plan);
+    }
+
+    pshtd_destroy_joblist(joblist);
+    release_setup(setup);
+    for(unsigned int comp = 0; comp < num_of_alms; ++comp)
+    {
+	hpix_free(pixels[comp]);
+	hpix_free(residuals[comp]);
+    }
+
+    return iteration;
+}
+
+/**********************************************************************/
+
+
+unsigned int
+hpix_map2alm_iterative(const hpix_map_t * map,
+		       hpix_alm_t * alm,
+		       unsigned int max_iterations,
+		       double tolerance,
+		       const double * ring_weights)
+{
+    assert(map);
+    assert(alm);
+
+    return map2alm_iterative(&map, &alm, 1,
+			     max_iterations, tolerance, ring_weights);
+}
+
+/**********************************************************************/
+
+
+unsigned int
+hpix_map2alm_pol_iterative(const hpix_map_t * map_i,
+			   const hpix_map_t * map_q,
+			   const hpix_map_t * map_u,
+			   hpix_alm_t * alm_t,
+			   hpix_alm_t * alm_e,
+			   hpix_alm_t * alm_b,
+			   unsigned int max_iterations,
+			   double tolerance,
+			   const double * ring_weights)
+{
+    assert(map_i && map_q && map_u);
+    assert(alm_t && alm_e && alm_b);
+
+    const hpix_map_t * maps[3] = { map_i, map_q, map_u };
+    hpix_alm_t * alms[3] = { alm_t, alm_e, alm_b };
+    return map2alm_iterative(maps, alms, 3,
+			     max_iterations, tolerance, ring_weights);
+}
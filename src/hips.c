@@ -0,0 +1,300 @@
+/* hips.c -- Hierarchical tile sets (HiPS) of HEALPix maps
+ *
+ * Copyright 2011-2013 Maurizio Tomasi.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.  */
+
+#include "config.h"
+
+#include <hpixlib/hpix.h>
+#include <assert.h>
+#include <errno.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <time.h>
+
+/* In a HiPS tile set, the tile with index `npix` at order `k` is the
+ * NEST pixel `npix` of a map with NSIDE = 2^k. The tile is an image
+ * of W x W elements, each of them being a NEST pixel at order
+ * k + log2(W). Since tiles are NEST pixels, the elements of a tile are
+ * found by splitting the tile into its (x, y, face) coordinates and
+ * refining x and y.
+ *
+ * Following the HiPS conventions, the upper left corner of the image
+ * is the northern corner of the tile, and moving right (down) the
+ * value of x (y) within the face decreases. */
+
+/* Number of tiles in each "DirNNNNN" directory of a tile set */
+#define HIPS_TILES_PER_DIR 10000
+
+/**********************************************************************/
+
+
+static unsigned int
+log2_of_tile_width(unsigned int tile_width)
+{
+    assert(tile_width > 0 && (tile_width & (tile_width - 1)) == 0);
+
+    unsigned int result = 0;
+    while((1u << result) < tile_width)
+	++result;
+
+    return result;
+}
+
+/**********************************************************************/
+
+
+void
+hpix_render_hips_tile(const hpix_map_t * map,
+		      unsigned int order,
+		      hpix_pixel_num_t tile_index,
+		      unsigned int tile_width,
+		      const hpix_palette_lut_t * lut,
+		      double min_value,
+		      double max_value,
+		      void * dest,
+		      size_t dest_stride)
+{
+    assert(map);
+    assert(lut);
+    assert(dest);
+    assert(hpix_map_ordering_scheme(map) == HPIX_ORDER_SCHEME_NEST);
+    assert(dest_stride >= tile_width * sizeof(uint32_t));
+
+    const unsigned int element_order = order + log2_of_tile_width(tile_width);
+    const unsigned int map_order = hpix_map_resolution(map)->order;
+    assert(map_order >= order && map_order <= element_order);
+
+    /* When the map has fewer pixels than the tile, each pixel is
+     * repeated over 4^shift elements */
+    const unsigned int shift = 2 * (element_order - map_order);
+
+    hpix_resolution_t * tile_resolution =
+	hpix_create_resolution((hpix_nside_t) 1 << order);
+    hpix_resolution_t * element_resolution =
+	hpix_create_resolution((hpix_nside_t) 1 << element_order);
+
+    unsigned int tile_x, tile_y, face_num;
+    hpix_nest_to_xyf(tile_resolution, tile_index,
+		     &tile_x, &tile_y, &face_num);
+
+    const double *restrict pixels = hpix_map_pixels(map);
+    double * values = hpix_malloc(sizeof(values[0]), tile_width);
+
+    for(unsigned int row = 0; row < tile_width; ++row)
+    {
+	const unsigned int y = tile_y * tile_width + (tile_width - 1 - row);
+
+	for(unsigned int column = 0; column < tile_width; ++column)
+	{
+	    const unsigned int x =
+		tile_x * tile_width + (tile_width - 1 - column);
+	    const hpix_pixel_num_t element =
+		hpix_xyf_to_nest(element_resolution, x, y, face_num);
+	    const double value = pixels[element >> shift];
+
+	    values[column] = (value > -1.6e+30) ? value : NAN;
+	}
+
+	hpix_palette_lut_colorize_values(lut, values, tile_width,
+					 min_value, max_value,
+					 (uint32_t *) ((char *) dest
+						       + row * dest_stride));
+    }
+
+    hpix_free(values);
+    hpix_free_resolution(element_resolution);
+    hpix_free_resolution(tile_resolution);
+}
+
+/**********************************************************************/
+
+
+static int
+make_directory(const char * path)
+{
+    return mkdir(path, 0755) == 0 || errno == EEXIST;
+}
+
+/**********************************************************************/
+
+
+/* Write the `properties` file describing the tile set. Besides the
+ * keys describing the tiles, the HiPS standard requires an identifier
+ * (`creator_did`), a title, a release date and a status. */
+static int
+write_hips_properties(const char * root_dir,
+		      const hpix_map_t * map,
+		      unsigned int tile_width,
+		      unsigned int max_order,
+		      const char * creator_did,
+		      const char * obs_title)
+{
+    char release_date[32];
+    const time_t now = time(NULL);
+    strftime(release_date, sizeof(release_date), "%Y-%m-%dT%H:%MZ",
+	     gmtime(&now));
+
+    char * file_name = hpix_malloc(1, strlen(root_dir) + 32);
+    sprintf(file_name, "%s/properties", root_dir);
+
+    FILE * out = fopen(file_name, "wt");
+    hpix_free(file_name);
+    if(out == NULL)
+	return 0;
+
+    fprintf(out, "creator_did = %s\n", creator_did);
+    fprintf(out, "obs_title = %s\n", obs_title);
+    fputs("dataproduct_type = image\n"
+	  "hips_version = 1.4\n"
+	  "hips_status = public master clonableOnce\n"
+	  "hips_tile_format = png\n"
+	  "hips_order_min = 0\n", out);
+    fprintf(out, "hips_order = %u\n", max_order);
+    fprintf(out, "hips_tile_width = %u\n", tile_width);
+    fprintf(out, "hips_release_date = %s\n", release_date);
+
+    switch(hpix_map_coordinate_system(map))
+    {
+    case HPIX_COORD_ECLIPTIC: fputs("hips_frame = ecliptic\n", out); break;
+    case HPIX_COORD_GALACTIC: fputs("hips_frame = galactic\n", out); break;
+    case HPIX_COORD_CELESTIAL: fputs("hips_frame = equatorial\n", out); break;
+    default: break;
+    }
+
+    return fclose(out) == 0;
+}
+
+/**********************************************************************/
+
+
+int
+hpix_write_hips_tiles(hpix_map_pyramid_t * pyramid,
+		      const hpix_palette_lut_t * lut,
+		      double min_value,
+		      double max_value,
+		      unsigned int tile_width,
+		      unsigned int max_order,
+		      const char * creator_did,
+		      const char * obs_title,
+		      const char * root_dir)
+{
+    assert(pyramid);
+    assert(lut);
+    assert(creator_did);
+    assert(obs_title);
+    assert(root_dir);
+
+    const hpix_map_t * base_map = hpix_map_pyramid_base_map(pyramid);
+    const unsigned int base_order = hpix_map_resolution(base_map)->order;
+    const unsigned int tile_order = log2_of_tile_width(tile_width);
+    assert(max_order <= base_order);
+
+    if(! make_directory(root_dir)
+       || ! write_hips_properties(root_dir, base_map, tile_width, max_order,
+				  creator_did, obs_title))
+	return 0;
+
+    const size_t path_size = strlen(root_dir) + 64;
+    char * path = hpix_malloc(1, path_size);
+    int num_of_errors = 0;
+
+    for(unsigned int order = 0;
+	order <= max_order && num_of_errors == 0;
+	++order)
+    {
+	/* Use the coarsest level of the pyramid which still has one
+	 * pixel per element (or the base map, if even that is not
+	 * enough). Levels are computed here, as the pyramid is not
+	 * thread-safe. */
+	const unsigned int element_order = order + tile_order;
+	const hpix_map_t * map =
+	    (element_order < base_order)
+	    ? hpix_map_pyramid_level(pyramid, base_order - element_order)
+	    : base_map;
+
+	const hpix_pixel_num_t num_of_tiles = (hpix_pixel_num_t) 12 << (2 * order);
+
+	snprintf(path, path_size, "%s/Norder%u", root_dir, order);
+	if(! make_directory(path))
+	{
+	    ++num_of_errors;
+	    break;
+	}
+
+	for(hpix_pixel_num_t dir = 0;
+	    dir < num_of_tiles;
+	    dir += HIPS_TILES_PER_DIR)
+	{
+	    snprintf(path, path_size, "%s/Norder%u/Dir%" PRIu64,
+		     root_dir, order, (uint64_t) dir);
+	    if(! make_directory(path))
+		++num_of_errors;
+	}
+
+	/* Each thread keeps only the tile it is working on */
+#pragma omp parallel default(shared) reduction(+:num_of_errors)
+	{
+	    uint32_t * image = hpix_malloc(sizeof(image[0]),
+					   (size_t) tile_width * tile_width);
+	    char * file_name = hpix_malloc(1, path_size);
+
+#pragma omp for schedule(dynamic, 1)
+	    for(hpix_pixel_num_t tile = 0; tile < num_of_tiles; ++tile)
+	    {
+		hpix_render_hips_tile(map, order, tile, tile_width, lut,
+				      min_value, max_value,
+				      image, tile_width * sizeof(uint32_t));
+
+		snprintf(file_name, path_size,
+			 "%s/Norder%u/Dir%" PRIu64 "/Npix%" PRIu64 ".png",
+			 root_dir, order,
+			 (uint64_t) (tile / HIPS_TILES_PER_DIR) * HIPS_TILES_PER_DIR,
+			 (uint64_t) tile);
+
+		FILE * out = fopen(file_name, "wb");
+		if(out == NULL)
+		{
+		    ++num_of_errors;
+		    continue;
+		}
+
+		hpix_image_writer_t * writer =
+		    hpix_create_image_writer(out, HPIX_IMAGE_FORMAT_PNG,
+					     tile_width, tile_width);
+		int success =
+		    hpix_image_writer_write_rows(writer, image,
+						 tile_width * sizeof(uint32_t),
+						 tile_width);
+		success = hpix_close_image_writer(writer) && success;
+		if(! success)
+		    ++num_of_errors;
+
+		if(fclose(out) != 0)
+		    ++num_of_errors;
+	    }
+
+	    hpix_free(file_name);
+	    hpix_free(image);
+	}
+    }
+
+    hpix_free(path);
+    return num_of_errors == 0;
+}
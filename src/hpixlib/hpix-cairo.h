@@ -33,10 +33,25 @@ hpix_bmp_projection_to_cairo_surface(const hpix_bmp_projection_t * proj,
 				     const hpix_map_t * map,
 				     double map_min, double map_max);
 
+cairo_surface_t *
+hpix_bmp_projection_plan_to_cairo_surface(const hpix_bmp_projection_plan_t * plan,
+					  const hpix_palette_lut_t * lut,
+					  const hpix_map_t * map,
+					  double map_min, double map_max);
+
 void
 hpix_bmp_configure_linear_gradient(cairo_pattern_t * pattern, 
 				   const hpix_color_palette_t * palette);
 
+void
+hpix_bmp_draw_markers(cairo_surface_t * surface,
+		      const hpix_bmp_projection_t * proj,
+		      const double * theta,
+		      const double * phi,
+		      size_t num_of_points,
+		      double radius,
+		      hpix_color_t color);
+
 #ifdef __cplusplus
 };
 #endif /* __cplusplus */
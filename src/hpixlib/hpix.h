@@ -45,6 +45,20 @@ typedef enum {
     HPIX_COORD_CELESTIAL
 } hpix_coordinates_t;
 
+/* Geometry of one ring of pixels in the RING scheme (see rings.c).
+ * `phi0` is the longitude of the first pixel in the ring, and
+ * `delta_phi` is the angular separation between two pixels. */
+typedef struct {
+    hpix_pixel_num_t       first_pixel;
+    unsigned int           num_of_pixels;
+    int                    shifted;
+    double                 z;
+    double                 sin_theta;
+    double                 theta;
+    double                 phi0;
+    double                 delta_phi;
+} hpix_ring_info_t;
+
 typedef struct {
     hpix_nside_t           nside;
     hpix_nside_t           nside_times_two;
@@ -58,6 +72,10 @@ typedef struct {
     unsigned int           ncap;
     double                 fact2;
     double                 fact1;
+
+    /* Table of the 4*nside - 1 rings, or NULL if it has not been
+     * built (see hpix_build_ring_table) */
+    hpix_ring_info_t     * ring_table;
 } hpix_resolution_t;
 
 typedef struct {
@@ -91,18 +109,119 @@ typedef struct {
 
 typedef struct hpix_color_palette_t hpix_color_palette_t;
 
+/* Precomputed table of packed colors (see palette.c) */
+typedef struct hpix_palette_lut_t hpix_palette_lut_t;
+
+#define HPIX_PALETTE_LUT_DEFAULT_SIZE 4096
+
 #define HPIX_MAP_PIXEL(map, index)				\
     (*((double *) (((char *) map->pixels)			\
 		   + (index) * sizeof(map->pixels[0]))))
 
 typedef enum { HPIX_PROJ_NULL, 
 	       HPIX_PROJ_MOLLWEIDE, 
-	       HPIX_PROJ_EQUIRECTANGULAR }
+	       HPIX_PROJ_EQUIRECTANGULAR,
+	       HPIX_PROJ_GNOMONIC,
+	       HPIX_PROJ_ORTHOGRAPHIC,
+	       HPIX_PROJ_CARTESIAN }
     hpix_projection_type_t;
 
 struct ___hpix_bmp_projection_t;
 typedef struct ___hpix_bmp_projection_t hpix_bmp_projection_t;
 
+/* Precomputed mapping between the elements of a bitmap and the pixels
+ * of a map (see bitmap.c) */
+typedef struct hpix_bmp_projection_plan_t hpix_bmp_projection_plan_t;
+
+/* How the elements of a bitmap are sampled by a projection plan */
+typedef enum { HPIX_BMP_SAMPLE_NEAREST,
+	       HPIX_BMP_SAMPLE_SUPERSAMPLE,
+	       HPIX_BMP_SAMPLE_AREA }
+    hpix_bmp_sampling_t;
+
+/* Value used by a projection plan for bitmap elements that fall
+ * outside the projection */
+#define HPIX_BMP_OUTSIDE_PIXEL ((hpix_pixel_num_t) UINT64_MAX)
+
+/* Renderer producing the image of a projection one tile at a time
+ * (see tiles.c) */
+typedef struct hpix_bmp_tile_renderer_t hpix_bmp_tile_renderer_t;
+
+/* Image files that can be written one row at a time (see
+ * image_writer.c) */
+typedef enum { HPIX_IMAGE_FORMAT_RAW,
+	       HPIX_IMAGE_FORMAT_PNG }
+    hpix_image_format_t;
+
+typedef struct hpix_image_writer_t hpix_image_writer_t;
+
+/* Statistics that can be used to merge the four children of a pixel
+ * when building a pyramid of maps (see pyramid.c) */
+typedef enum { HPIX_PYRAMID_SUM,
+	       HPIX_PYRAMID_MEAN,
+	       HPIX_PYRAMID_VALID_COUNT }
+    hpix_pyramid_statistic_t;
+
+typedef struct hpix_map_pyramid_t hpix_map_pyramid_t;
+
+/* A complex number, binary compatible with the one used by libpsht */
+typedef struct {
+    double re;
+    double im;
+} hpix_complex_t;
+
+/* A set of a_lm coefficients of a spherical harmonic expansion (see
+ * harmonics.c) */
+typedef struct hpix_alm_t hpix_alm_t;
+
+/* Components of an angular power spectrum, in the order used by
+ * Healpix (see hpix_anafast) */
+typedef enum { HPIX_SPECTRUM_TT,
+	       HPIX_SPECTRUM_EE,
+	       HPIX_SPECTRUM_BB,
+	       HPIX_SPECTRUM_TE,
+	       HPIX_SPECTRUM_TB,
+	       HPIX_SPECTRUM_EB }
+    hpix_spectrum_component_t;
+
+#define HPIX_NUM_OF_SPECTRUM_COMPONENTS 6
+
+typedef struct hpix_power_spectrum_t hpix_power_spectrum_t;
+
+/* Window function used to smooth maps in harmonic space */
+typedef struct hpix_smoothing_t hpix_smoothing_t;
+
+typedef struct hpix_binner_t hpix_binner_t;
+
+typedef struct hpix_pointing_pipeline_t hpix_pointing_pipeline_t;
+
+/* Functions used by a pointing pipeline to read the pointings and to
+ * hand the pixel indexes over to the caller. The reader must return
+ * the number of samples written in `theta` and `phi` (zero at the end
+ * of the stream). */
+typedef size_t hpix_pointing_reader_fn_t(void * user_data,
+					 double * theta,
+					 double * phi,
+					 size_t max_num_of_samples);
+typedef void hpix_pixel_consumer_fn_t(void * user_data,
+				      const hpix_pixel_num_t * pixels,
+				      const double * theta,
+				      const double * phi,
+				      size_t first_sample,
+				      size_t num_of_samples);
+
+/* Timings are in seconds. The conversion time is summed over all the
+ * threads that convert pointings. */
+typedef struct {
+    size_t num_of_samples;
+    size_t num_of_chunks;
+    int    num_of_threads;
+    double read_time;
+    double conversion_time;
+    double consume_time;
+    double wall_time;
+} hpix_pipeline_stats_t;
+
 /* Functions implemented in math.c */
 
 double hpix_average_pixel_value(const hpix_map_t * map);
@@ -157,6 +276,182 @@ hpix_nside_t hpix_nside(const hpix_resolution_t * resolution);
 
 size_t hpix_num_of_pixels(const hpix_resolution_t * resolution);
 
+/* Functions implemented in pyramid.c */
+
+hpix_map_pyramid_t *
+hpix_create_map_pyramid(hpix_map_t * base_map,
+			hpix_pyramid_statistic_t statistic);
+
+void hpix_free_map_pyramid(hpix_map_pyramid_t * pyramid);
+
+unsigned int hpix_map_pyramid_num_of_levels(const hpix_map_pyramid_t * pyramid);
+
+hpix_map_t * hpix_map_pyramid_base_map(const hpix_map_pyramid_t * pyramid);
+
+hpix_pyramid_statistic_t
+hpix_map_pyramid_statistic(const hpix_map_pyramid_t * pyramid);
+
+const hpix_map_t * hpix_map_pyramid_level(hpix_map_pyramid_t * pyramid,
+					  unsigned int level_num);
+
+void hpix_map_pyramid_set_pixel(hpix_map_pyramid_t * pyramid,
+				hpix_pixel_num_t index,
+				double value);
+
+void hpix_map_pyramid_invalidate_pixel(hpix_map_pyramid_t * pyramid,
+				       hpix_pixel_num_t index);
+
+void hpix_map_pyramid_invalidate(hpix_map_pyramid_t * pyramid);
+
+/* Functions implemented in binner.c */
+
+hpix_binner_t * hpix_create_binner(hpix_nside_t nside,
+				   hpix_ordering_scheme_t scheme,
+				   int polarization_flag);
+void hpix_free_binner(hpix_binner_t * binner);
+void hpix_reset_binner(hpix_binner_t * binner);
+
+const hpix_resolution_t * hpix_binner_resolution(const hpix_binner_t * binner);
+hpix_ordering_scheme_t hpix_binner_ordering_scheme(const hpix_binner_t * binner);
+
+void hpix_binner_add_pixels(hpix_binner_t * binner,
+			    const hpix_pixel_num_t * pixels,
+			    const double * psi,
+			    const double * values,
+			    const double * weights,
+			    size_t num_of_samples);
+void hpix_binner_add_angles(hpix_binner_t * binner,
+			    const double * theta,
+			    const double * phi,
+			    const double * psi,
+			    const double * values,
+			    const double * weights,
+			    size_t num_of_samples);
+void hpix_binner_add_vectors(hpix_binner_t * binner,
+			     const hpix_vector_t * vectors,
+			     const double * psi,
+			     const double * values,
+			     const double * weights,
+			     size_t num_of_samples);
+
+hpix_map_t * hpix_binner_hit_map(const hpix_binner_t * binner);
+hpix_map_t * hpix_binner_weight_map(const hpix_binner_t * binner);
+hpix_map_t * hpix_binner_signal_map(const hpix_binner_t * binner);
+hpix_map_t * hpix_binner_binned_map(const hpix_binner_t * binner);
+void hpix_binner_iqu_maps(const hpix_binner_t * binner,
+			  double min_determinant,
+			  hpix_map_t ** map_i,
+			  hpix_map_t ** map_q,
+			  hpix_map_t ** map_u);
+
+/* Functions implemented in pipeline.c */
+
+hpix_pointing_pipeline_t *
+hpix_create_pointing_pipeline(hpix_nside_t nside,
+			      hpix_ordering_scheme_t scheme,
+			      size_t num_of_buffers,
+			      size_t samples_per_buffer);
+void hpix_free_pointing_pipeline(hpix_pointing_pipeline_t * pipeline);
+
+size_t hpix_run_pointing_pipeline(hpix_pointing_pipeline_t * pipeline,
+				  hpix_pointing_reader_fn_t * reader,
+				  void * reader_data,
+				  hpix_pixel_consumer_fn_t * consumer,
+				  void * consumer_data);
+
+const hpix_pipeline_stats_t *
+hpix_pointing_pipeline_stats(const hpix_pointing_pipeline_t * pipeline);
+void hpix_print_pipeline_stats(FILE * output_file,
+			       const hpix_pipeline_stats_t * stats);
+
+/* Functions implemented in harmonics.c */
+
+hpix_alm_t * hpix_create_alm(unsigned int lmax, unsigned int mmax);
+void hpix_free_alm(hpix_alm_t * alm);
+
+unsigned int hpix_alm_lmax(const hpix_alm_t * alm);
+unsigned int hpix_alm_mmax(const hpix_alm_t * alm);
+size_t hpix_alm_num_of_coefficients(const hpix_alm_t * alm);
+hpix_complex_t * hpix_alm_coefficients(const hpix_alm_t * alm);
+size_t hpix_alm_index(const hpix_alm_t * alm, unsigned int l, unsigned int m);
+
+void hpix_map2alm(const hpix_map_t * map, hpix_alm_t * alm);
+void hpix_alm2map(const hpix_alm_t * alm, hpix_map_t * map);
+
+void hpix_map2alm_pol(const hpix_map_t * map_i,
+		      const hpix_map_t * map_q,
+		      const hpix_map_t * map_u,
+		      hpix_alm_t * alm_t,
+		      hpix_alm_t * alm_e,
+		      hpix_alm_t * alm_b);
+void hpix_alm2map_pol(const hpix_alm_t * alm_t,
+		      const hpix_alm_t * alm_e,
+		      const hpix_alm_t * alm_b,
+		      hpix_map_t * map_i,
+		      hpix_map_t * map_q,
+		      hpix_map_t * map_u);
+
+unsigned int hpix_map2alm_iterative(const hpix_map_t * map,
+				    hpix_alm_t * alm,
+				    unsigned int max_iterations,
+				    double tolerance,
+				    const double * ring_weights);
+unsigned int hpix_map2alm_pol_iterative(const hpix_map_t * map_i,
+					const hpix_map_t * map_q,
+					const hpix_map_t * map_u,
+					hpix_alm_t * alm_t,
+					hpix_alm_t * alm_e,
+					hpix_alm_t * alm_b,
+					unsigned int max_iterations,
+					double tolerance,
+					const double * ring_weights);
+
+hpix_power_spectrum_t *
+hpix_anafast(const hpix_map_t * const * maps_i,
+	     const hpix_map_t * const * maps_q,
+	     const hpix_map_t * const * maps_u,
+	     size_t num_of_fields,
+	     const hpix_map_t * mask,
+	     unsigned int lmax);
+void hpix_free_power_spectrum(hpix_power_spectrum_t * spectrum);
+
+unsigned int hpix_power_spectrum_lmax(const hpix_power_spectrum_t * spectrum);
+size_t
+hpix_power_spectrum_num_of_fields(const hpix_power_spectrum_t * spectrum);
+int hpix_power_spectrum_has_polarization(const hpix_power_spectrum_t * spectrum);
+double hpix_power_spectrum_fsky(const hpix_power_spectrum_t * spectrum);
+const double *
+hpix_power_spectrum_cl(const hpix_power_spectrum_t * spectrum,
+		       size_t field1,
+		       size_t field2,
+		       hpix_spectrum_component_t component);
+
+hpix_smoothing_t * hpix_create_gaussian_smoothing(double fwhm,
+						  unsigned int lmax);
+hpix_smoothing_t * hpix_create_tabulated_smoothing(const double * window_t,
+						   const double * window_pol,
+						   unsigned int lmax);
+void hpix_free_smoothing(hpix_smoothing_t * smoothing);
+unsigned int hpix_smoothing_lmax(const hpix_smoothing_t * smoothing);
+const double * hpix_smoothing_window(const hpix_smoothing_t * smoothing,
+				     int polarization_flag);
+void hpix_smoothing_apply_pixel_window(hpix_smoothing_t * smoothing,
+				       const double * pixwin_t,
+				       const double * pixwin_pol);
+
+void hpix_smooth_maps(hpix_smoothing_t * smoothing,
+		      hpix_map_t * const * maps_i,
+		      hpix_map_t * const * maps_q,
+		      hpix_map_t * const * maps_u,
+		      size_t num_of_fields);
+void hpix_smooth_map(hpix_smoothing_t * smoothing, hpix_map_t * map);
+void hpix_smooth_map_pol(hpix_smoothing_t * smoothing,
+			 hpix_map_t * map_i,
+			 hpix_map_t * map_q,
+			 hpix_map_t * map_u);
+
+void hpix_free_sht_cache(void);
+
 /* Functions implemented in integer_functions.c */
 
 unsigned int hpix_ilog2 (const unsigned int argument);
@@ -280,6 +575,32 @@ void hpix_nest_pixel_to_vector(const hpix_resolution_t * resolution,
 			       hpix_pixel_num_t pixel_index,
 			       hpix_vector_t * vector);
 
+void hpix_pixel_range_to_vectors(const hpix_resolution_t * resolution,
+				 hpix_ordering_scheme_t scheme,
+				 hpix_pixel_num_t first_pixel,
+				 size_t num_of_pixels,
+				 double * x, double * y, double * z);
+
+void hpix_pixel_range_to_angles(const hpix_resolution_t * resolution,
+				hpix_ordering_scheme_t scheme,
+				hpix_pixel_num_t first_pixel,
+				size_t num_of_pixels,
+				double * theta, double * phi);
+
+/* Functions implemented in rings.c */
+
+unsigned int hpix_num_of_rings(const hpix_resolution_t * resolution);
+
+void hpix_build_ring_table(hpix_resolution_t * resolution);
+void hpix_free_ring_table(hpix_resolution_t * resolution);
+
+void hpix_ring_info(const hpix_resolution_t * resolution,
+		    unsigned int ring,
+		    hpix_ring_info_t * info);
+
+unsigned int hpix_ring_pixel_to_ring(const hpix_resolution_t * resolution,
+				     hpix_pixel_num_t pixel);
+
 /* Functions implemented in bitmap.c */
 
 hpix_bmp_projection_t * 
@@ -305,6 +626,16 @@ hpix_set_bmp_projection_height(hpix_bmp_projection_t * proj,
 hpix_projection_type_t hpix_bmp_projection_type(const hpix_bmp_projection_t * proj);
 void hpix_set_equirectangular_projection(hpix_bmp_projection_t * proj);
 void hpix_set_mollweide_projection(hpix_bmp_projection_t * proj);
+void hpix_set_gnomonic_projection(hpix_bmp_projection_t * proj,
+				  double center_theta,
+				  double center_phi,
+				  double field_of_view);
+void hpix_set_orthographic_projection(hpix_bmp_projection_t * proj,
+				      double center_theta,
+				      double center_phi);
+void hpix_set_cartesian_projection(hpix_bmp_projection_t * proj,
+				   double lon_min, double lon_max,
+				   double lat_min, double lat_max);
 int hpix_bmp_projection_is_xy_inside(const hpix_bmp_projection_t * proj,
 				     unsigned int x,
 				     unsigned int y);
@@ -313,12 +644,78 @@ int hpix_bmp_projection_xy_to_angles(const hpix_bmp_projection_t * proj,
 				     unsigned int y,
 				     double * theta,
 				     double * phi);
+int hpix_bmp_projection_angles_to_xy(const hpix_bmp_projection_t * proj,
+				     double theta,
+				     double phi,
+				     double * x,
+				     double * y);
+size_t
+hpix_bmp_projection_angles_to_xy_batch(const hpix_bmp_projection_t * proj,
+				       const double * theta,
+				       const double * phi,
+				       size_t num_of_points,
+				       double * x,
+				       double * y);
 double *
 hpix_bmp_projection_trace(const hpix_bmp_projection_t * proj,
 			  const hpix_map_t * map,
 			  double * min_value,
 			  double * max_value);
 
+hpix_bmp_projection_plan_t *
+hpix_create_bmp_projection_plan(const hpix_bmp_projection_t * proj,
+				hpix_nside_t nside,
+				hpix_ordering_scheme_t scheme);
+hpix_bmp_projection_plan_t *
+hpix_create_bmp_sampling_plan(const hpix_bmp_projection_t * proj,
+			      hpix_nside_t nside,
+			      hpix_ordering_scheme_t scheme,
+			      hpix_bmp_sampling_t sampling,
+			      unsigned int samples_per_side);
+void hpix_free_bmp_projection_plan(hpix_bmp_projection_plan_t * plan);
+unsigned int
+hpix_bmp_projection_plan_width(const hpix_bmp_projection_plan_t * plan);
+unsigned int
+hpix_bmp_projection_plan_height(const hpix_bmp_projection_plan_t * plan);
+hpix_nside_t
+hpix_bmp_projection_plan_nside(const hpix_bmp_projection_plan_t * plan);
+hpix_ordering_scheme_t
+hpix_bmp_projection_plan_scheme(const hpix_bmp_projection_plan_t * plan);
+hpix_bmp_sampling_t
+hpix_bmp_projection_plan_sampling(const hpix_bmp_projection_plan_t * plan);
+unsigned int
+hpix_bmp_projection_plan_samples_per_side(const hpix_bmp_projection_plan_t * plan);
+const hpix_pixel_num_t *
+hpix_bmp_projection_plan_pixels(const hpix_bmp_projection_plan_t * plan);
+const size_t *
+hpix_bmp_projection_plan_offsets(const hpix_bmp_projection_plan_t * plan);
+const float *
+hpix_bmp_projection_plan_weights(const hpix_bmp_projection_plan_t * plan);
+double *
+hpix_bmp_projection_plan_trace(const hpix_bmp_projection_plan_t * plan,
+			       const hpix_map_t * map,
+			       double * min_value,
+			       double * max_value);
+void
+hpix_bmp_projection_plan_trace_into(const hpix_bmp_projection_plan_t * plan,
+				    const hpix_map_t * map,
+				    double * bitmap,
+				    double * min_value,
+				    double * max_value);
+void
+hpix_bmp_projection_plan_range(const hpix_bmp_projection_plan_t * plan,
+			       const hpix_map_t * map,
+			       double * min_value,
+			       double * max_value);
+void
+hpix_bmp_projection_plan_render(const hpix_bmp_projection_plan_t * plan,
+				const hpix_map_t * map,
+				const hpix_palette_lut_t * lut,
+				double min_value,
+				double max_value,
+				void * dest,
+				size_t dest_stride);
+
 /* Functions implemented in cairo_interface.c */
 
 #ifdef HAVE_CAIRO
@@ -331,10 +728,25 @@ hpix_bmp_projection_to_cairo_surface(const hpix_bmp_projection_t * proj,
 				     const hpix_map_t * map,
 				     double map_min, double map_max);
 
+cairo_surface_t *
+hpix_bmp_projection_plan_to_cairo_surface(const hpix_bmp_projection_plan_t * plan,
+					  const hpix_palette_lut_t * lut,
+					  const hpix_map_t * map,
+					  double map_min, double map_max);
+
 void
 hpix_bmp_configure_linear_gradient(cairo_pattern_t * pattern, 
 				   const hpix_color_palette_t * palette);
 
+void
+hpix_bmp_draw_markers(cairo_surface_t * surface,
+		      const hpix_bmp_projection_t * proj,
+		      const double * theta,
+		      const double * phi,
+		      size_t num_of_points,
+		      double radius,
+		      hpix_color_t color);
+
 #endif /* HAVE_CAIRO */
 
 /* Functions implemented in order_conversion.c */
@@ -347,6 +759,22 @@ hpix_pixel_num_t
 hpix_ring_to_nest_idx(const hpix_resolution_t * resolution,
 		      hpix_pixel_num_t ring_index);
 
+/* Position of a NEST pixel within one of the 12 base faces: x and y
+ * range from 0 to nside - 1, with (0, 0) being the southern corner of
+ * the face */
+void
+hpix_nest_to_xyf(const hpix_resolution_t * resolution,
+		 hpix_pixel_num_t nest_index,
+		 unsigned int * x,
+		 unsigned int * y,
+		 unsigned int * face_num);
+
+hpix_pixel_num_t
+hpix_xyf_to_nest(const hpix_resolution_t * resolution,
+		 unsigned int x,
+		 unsigned int y,
+		 unsigned int face_num);
+
 void
 hpix_switch_order(hpix_map_t * map);
 
@@ -382,6 +810,124 @@ void hpix_sort_levels_in_color_palette(hpix_color_palette_t * palette);
 void hpix_palette_color(const hpix_color_palette_t * palette,
 			double level, hpix_color_t * color);
 
+uint32_t hpix_pack_color(hpix_color_t color);
+hpix_palette_lut_t * hpix_create_palette_lut(const hpix_color_palette_t * palette,
+					     size_t num_of_entries);
+void hpix_free_palette_lut(hpix_palette_lut_t * lut);
+size_t hpix_palette_lut_size(const hpix_palette_lut_t * lut);
+const uint32_t * hpix_palette_lut_entries(const hpix_palette_lut_t * lut);
+uint32_t hpix_palette_lut_unseen_color(const hpix_palette_lut_t * lut);
+uint32_t hpix_palette_lut_color(const hpix_palette_lut_t * lut, double level);
+void hpix_palette_lut_colorize_values(const hpix_palette_lut_t * lut,
+				      const double * values,
+				      size_t num_of_values,
+				      double min_value,
+				      double max_value,
+				      uint32_t * dest);
+void hpix_palette_lut_colorize(const hpix_palette_lut_t * lut,
+			       const double * bitmap,
+			       unsigned int width,
+			       unsigned int height,
+			       double min_value,
+			       double max_value,
+			       void * dest,
+			       size_t dest_stride);
+
+/* Functions implemented in tiles.c */
+
+hpix_bmp_tile_renderer_t *
+hpix_create_bmp_tile_renderer(const hpix_bmp_projection_t * proj,
+			      const hpix_map_t * map,
+			      const hpix_palette_lut_t * lut,
+			      double min_value,
+			      double max_value,
+			      unsigned int tile_size);
+void hpix_free_bmp_tile_renderer(hpix_bmp_tile_renderer_t * renderer);
+unsigned int
+hpix_bmp_tile_renderer_tile_size(const hpix_bmp_tile_renderer_t * renderer);
+unsigned int
+hpix_bmp_tile_renderer_num_of_columns(const hpix_bmp_tile_renderer_t * renderer);
+unsigned int
+hpix_bmp_tile_renderer_num_of_rows(const hpix_bmp_tile_renderer_t * renderer);
+void
+hpix_bmp_tile_renderer_render_tile(const hpix_bmp_tile_renderer_t * renderer,
+				   unsigned int column,
+				   unsigned int row,
+				   unsigned int step,
+				   void * dest,
+				   size_t dest_stride);
+void
+hpix_bmp_tile_renderer_render_preview(const hpix_bmp_tile_renderer_t * renderer,
+				      unsigned int factor,
+				      void * dest,
+				      size_t dest_stride);
+int
+hpix_bmp_tile_renderer_write(const hpix_bmp_tile_renderer_t * renderer,
+			     unsigned int step,
+			     hpix_image_writer_t * writer);
+
+/* Functions implemented in image_writer.c */
+
+hpix_image_writer_t *
+hpix_create_image_writer(FILE * out,
+			 hpix_image_format_t format,
+			 unsigned int width,
+			 unsigned int height);
+int hpix_image_writer_write_rows(hpix_image_writer_t * writer,
+				 const void * rows,
+				 size_t stride,
+				 unsigned int num_of_rows);
+int hpix_close_image_writer(hpix_image_writer_t * writer);
+
+/* Functions implemented in hips.c */
+
+void
+hpix_render_hips_tile(const hpix_map_t * map,
+		      unsigned int order,
+		      hpix_pixel_num_t tile_index,
+		      unsigned int tile_width,
+		      const hpix_palette_lut_t * lut,
+		      double min_value,
+		      double max_value,
+		      void * dest,
+		      size_t dest_stride);
+int
+hpix_write_hips_tiles(hpix_map_pyramid_t * pyramid,
+		      const hpix_palette_lut_t * lut,
+		      double min_value,
+		      double max_value,
+		      unsigned int tile_width,
+		      unsigned int max_order,
+		      const char * creator_did,
+		      const char * obs_title,
+		      const char * root_dir);
+
+/* Functions implemented in frames.c */
+
+void
+hpix_frame_sequence_range(const hpix_bmp_projection_plan_t * plan,
+			  const hpix_map_t * const * maps,
+			  size_t num_of_frames,
+			  double * min_value,
+			  double * max_value);
+int
+hpix_write_frame_files(const hpix_bmp_projection_plan_t * plan,
+		       const hpix_palette_lut_t * lut,
+		       double min_value,
+		       double max_value,
+		       const hpix_map_t * const * maps,
+		       size_t num_of_frames,
+		       const char * file_name_template,
+		       unsigned int first_frame_number);
+int
+hpix_write_frame_stream(const hpix_bmp_projection_plan_t * plan,
+			const hpix_palette_lut_t * lut,
+			double min_value,
+			double max_value,
+			const hpix_map_t * const * maps,
+			size_t num_of_frames,
+			FILE * out);
+
 /* Functions implemented in matrices.c */
 
 void hpix_set_matrix_to_unity(hpix_matrix_t * matrix);
@@ -418,6 +964,12 @@ int hpix_equirectangular_xy_to_angles(const hpix_bmp_projection_t * proj,
 				      double * theta,
 				      double * phi);
 
+int hpix_equirectangular_angles_to_xy(const hpix_bmp_projection_t * proj,
+				      double theta,
+				      double phi,
+				      double * x,
+				      double * y);
+
 /* Functions implemented in mollweide_projection.c */
 
 int hpix_mollweide_is_xy_inside(const hpix_bmp_projection_t * proj,
@@ -430,6 +982,73 @@ int hpix_mollweide_xy_to_angles(const hpix_bmp_projection_t * proj,
 				double * theta,
 				double * phi);
 
+int hpix_mollweide_angles_to_xy(const hpix_bmp_projection_t * proj,
+				double theta,
+				double phi,
+				double * x,
+				double * y);
+
+size_t hpix_mollweide_angles_to_xy_batch(const hpix_bmp_projection_t * proj,
+					 const double * theta,
+					 const double * phi,
+					 size_t num_of_points,
+					 double * x,
+					 double * y);
+
+/* Functions implemented in gnomonic_projection.c */
+
+int hpix_gnomonic_is_xy_inside(const hpix_bmp_projection_t * proj,
+			       unsigned int x,
+			       unsigned int y);
+
+int hpix_gnomonic_xy_to_angles(const hpix_bmp_projection_t * proj,
+			       unsigned int x,
+			       unsigned int y,
+			       double * theta,
+			       double * phi);
+
+int hpix_gnomonic_angles_to_xy(const hpix_bmp_projection_t * proj,
+			       double theta,
+			       double phi,
+			       double * x,
+			       double * y);
+
+/* Functions implemented in orthographic_projection.c */
+
+int hpix_orthographic_is_xy_inside(const hpix_bmp_projection_t * proj,
+				   unsigned int x,
+				   unsigned int y);
+
+int hpix_orthographic_xy_to_angles(const hpix_bmp_projection_t * proj,
+				   unsigned int x,
+				   unsigned int y,
+				   double * theta,
+				   double * phi);
+
+int hpix_orthographic_angles_to_xy(const hpix_bmp_projection_t * proj,
+				   double theta,
+				   double phi,
+				   double * x,
+				   double * y);
+
+/* Functions implemented in cartesian_projection.c */
+
+int hpix_cartesian_is_xy_inside(const hpix_bmp_projection_t * proj,
+				unsigned int x,
+				unsigned int y);
+
+int hpix_cartesian_xy_to_angles(const hpix_bmp_projection_t * proj,
+				unsigned int x,
+				unsigned int y,
+				double * theta,
+				double * phi);
+
+int hpix_cartesian_angles_to_xy(const hpix_bmp_projection_t * proj,
+				double theta,
+				double phi,
+				double * x,
+				double * y);
+
 /* Functions implemented in query_disc.c */
 
 void hpix_query_disc(double theta, double phi, double radius,
@@ -0,0 +1,392 @@
+/* image_writer.c -- Write images one row at a time
+ *
+ * Copyright 2011-2013 Maurizio Tomasi.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.  */
+
+#include "config.h"
+
+#include <hpixlib/hpix.h>
+#include <assert.h>
+#include <string.h>
+
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+/* The writers defined here accept rows of packed colors in the format
+ * used by `hpix_palette_lut_colorize` (0xAARRGGBB in native byte
+ * order), from the top to the bottom of the image. Rows are written
+ * as soon as they arrive, so that images much larger than the
+ * available memory can be produced.
+ *
+ * PNG files are written as RGBA images with 8 bits per component. If
+ * HPixLib was compiled with zlib, the image data are compressed;
+ * otherwise they are saved in "stored" (uncompressed) deflate blocks,
+ * which every PNG reader understands. */
+
+/* Maximum size of an IDAT chunk */
+#define PNG_CHUNK_SIZE 65536
+
+/* Maximum size of the data in a stored deflate block. Each block is
+ * written in one IDAT chunk together with its five-byte header, so
+ * it must fit in the PNG_CHUNK_SIZE bytes of `writer->buffer` (the
+ * deflate format would allow up to 65535 bytes). */
+#define STORED_BLOCK_SIZE (PNG_CHUNK_SIZE - 5)
+
+struct hpix_image_writer_t {
+    hpix_image_format_t   format;
+    FILE                * out;
+    unsigned int          width;
+    unsigned int          height;
+    unsigned int          rows_written;
+    int                   error;
+
+    /* The following fields are used only for PNG files */
+    uint32_t              crc_table[256];
+    uint8_t             * scanline;
+    uint8_t             * buffer;
+    size_t                buffer_used;
+#ifdef HAVE_ZLIB
+    z_stream              stream;
+#else
+    uint32_t              adler_a;
+    uint32_t              adler_b;
+#endif
+};
+
+/**********************************************************************/
+
+
+static void
+init_crc_table(uint32_t * table)
+{
+    for(uint32_t n = 0; n < 256; ++n)
+    {
+	uint32_t c = n;
+	for(int k = 0; k < 8; ++k)
+	    c = (c & 1) ? UINT32_C(0xEDB88320) ^ (c >> 1) : c >> 1;
+
+	table[n] = c;
+    }
+}
+
+/**********************************************************************/
+
+
+static uint32_t
+update_crc(const uint32_t * table, uint32_t crc,
+	   const uint8_t * data, size_t size)
+{
+    for(size_t idx = 0; idx < size; ++idx)
+	crc = table[(crc ^ data[idx]) & 0xFF] ^ (crc >> 8);
+
+    return crc;
+}
+
+/**********************************************************************/
+
+
+static void
+store_uint32_be(uint8_t * dest, uint32_t value)
+{
+    dest[0] = (value >> 24) & 0xFF;
+    dest[1] = (value >> 16) & 0xFF;
+    dest[2] = (value >> 8) & 0xFF;
+    dest[3] = value & 0xFF;
+}
+
+/**********************************************************************/
+
+
+static void
+write_bytes(hpix_image_writer_t * writer, const void * data, size_t size)
+{
+    if(writer->error || size == 0)
+	return;
+
+    if(fwrite(data, 1, size, writer->out) != size)
+	writer->error = 1;
+}
+
+/**********************************************************************/
+
+
+static void
+write_png_chunk(hpix_image_writer_t * writer, const char * type,
+		const uint8_t * data, size_t size)
+{
+    uint8_t header[8];
+    uint8_t trailer[4];
+
+    store_uint32_be(header, (uint32_t) size);
+    memcpy(header + 4, type, 4);
+
+    uint32_t crc = update_crc(writer->crc_table, UINT32_C(0xFFFFFFFF),
+			      header + 4, 4);
+    crc = update_crc(writer->crc_table, crc, data, size);
+    store_uint32_be(trailer, crc ^ UINT32_C(0xFFFFFFFF));
+
+    write_bytes(writer, header, sizeof(header));
+    write_bytes(writer, data, size);
+    write_bytes(writer, trailer, sizeof(trailer));
+}
+
+/**********************************************************************/
+
+
+#ifdef HAVE_ZLIB
+
+/* Compress `size` bytes and write IDAT chunks as soon as the output
+ * buffer is full. If `finish` is nonzero, the stream is terminated
+ * and the remaining data are written as well. */
+static void
+deflate_png_data(hpix_image_writer_t * writer,
+		 const uint8_t * data, size_t size, int finish)
+{
+    z_stream * stream = &writer->stream;
+    const int flush = finish ? Z_FINISH : Z_NO_FLUSH;
+    int result;
+
+    stream->next_in = (Bytef *) data;
+    stream->avail_in = (uInt) size;
+
+    do {
+	stream->next_out = writer->buffer + writer->buffer_used;
+	stream->avail_out = (uInt) (PNG_CHUNK_SIZE - writer->buffer_used);
+
+	result = deflate(stream, flush);
+	if(result == Z_STREAM_ERROR)
+	{
+	    writer->error = 1;
+	    return;
+	}
+
+	writer->buffer_used = PNG_CHUNK_SIZE - stream->avail_out;
+	if(writer->buffer_used == PNG_CHUNK_SIZE
+	   || (flush == Z_FINISH && result == Z_STREAM_END))
+	{
+	    write_png_chunk(writer, "IDAT",
+			    writer->buffer, writer->buffer_used);
+	    writer->buffer_used = 0;
+	}
+    } while(stream->avail_in > 0
+	    || (flush == Z_FINISH && result != Z_STREAM_END));
+}
+
+#else
+
+/* Write the stored deflate block contained in `writer->buffer`. The
+ * first five bytes of the buffer are reserved for the block
+ * header. */
+static void
+write_stored_block(hpix_image_writer_t * writer, int is_final)
+{
+    const size_t length = writer->buffer_used - 5;
+
+    writer->buffer[0] = is_final ? 1 : 0;
+    writer->buffer[1] = length & 0xFF;
+    writer->buffer[2] = (length >> 8) & 0xFF;
+    writer->buffer[3] = ~length & 0xFF;
+    writer->buffer[4] = (~length >> 8) & 0xFF;
+
+    write_png_chunk(writer, "IDAT", writer->buffer, writer->buffer_used);
+    writer->buffer_used = 5;
+}
+
+/**********************************************************************/
+
+
+/* Append `size` bytes to the current stored block, and write it when
+ * it is full. If `finish` is nonzero, the last block and the Adler-32
+ * checksum of the stream are written as well. */
+static void
+deflate_png_data(hpix_image_writer_t * writer,
+		 const uint8_t * data, size_t size, int finish)
+{
+    for(size_t idx = 0; idx < size; ++idx)
+    {
+	writer->adler_a = (writer->adler_a + data[idx]) % 65521;
+	writer->adler_b = (writer->adler_b + writer->adler_a) % 65521;
+    }
+
+    while(size > 0)
+    {
+	size_t room = STORED_BLOCK_SIZE + 5 - writer->buffer_used;
+	size_t bytes_to_copy = (size < room) ? size : room;
+
+	memcpy(writer->buffer + writer->buffer_used, data, bytes_to_copy);
+	writer->buffer_used += bytes_to_copy;
+	data += bytes_to_copy;
+	size -= bytes_to_copy;
+
+	if(writer->buffer_used == STORED_BLOCK_SIZE + 5)
+	    write_stored_block(writer, 0);
+    }
+
+    if(finish)
+    {
+	uint8_t adler[4];
+
+	write_stored_block(writer, 1);
+	store_uint32_be(adler, (writer->adler_b << 16) | writer->adler_a);
+	write_png_chunk(writer, "IDAT", adler, sizeof(adler));
+    }
+}
+
+#endif
+
+/**********************************************************************/
+
+
+static void
+init_png_writer(hpix_image_writer_t * writer)
+{
+    static const uint8_t signature[8] = {
+	0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'
+    };
+    uint8_t header[13];
+
+    init_crc_table(writer->crc_table);
+    writer->scanline = hpix_malloc(1, 1 + 4 * (size_t) writer->width);
+    writer->buffer = hpix_malloc(1, PNG_CHUNK_SIZE);
+
+    write_bytes(writer, signature, sizeof(signature));
+
+    store_uint32_be(header, writer->width);
+    store_uint32_be(header + 4, writer->height);
+    header[8] = 8;  /* Bits per component */
+    header[9] = 6;  /* RGBA */
+    header[10] = 0; /* Deflate compression */
+    header[11] = 0; /* Adaptive filtering */
+    header[12] = 0; /* No interlace */
+    write_png_chunk(writer, "IHDR", header, sizeof(header));
+
+#ifdef HAVE_ZLIB
+    memset(&writer->stream, 0, sizeof(writer->stream));
+    if(deflateInit(&writer->stream, Z_DEFAULT_COMPRESSION) != Z_OK)
+	writer->error = 1;
+    writer->buffer_used = 0;
+#else
+    /* zlib header: deflate, 32 KB window, no compression */
+    static const uint8_t zlib_header[2] = { 0x78, 0x01 };
+    write_png_chunk(writer, "IDAT", zlib_header, sizeof(zlib_header));
+    writer->adler_a = 1;
+    writer->adler_b = 0;
+    writer->buffer_used = 5;
+#endif
+}
+
+/**********************************************************************/
+
+
+hpix_image_writer_t *
+hpix_create_image_writer(FILE * out,
+			 hpix_image_format_t format,
+			 unsigned int width,
+			 unsigned int height)
+{
+    assert(out);
+    assert(width > 0 && height > 0);
+
+    hpix_image_writer_t * writer = hpix_calloc(sizeof(hpix_image_writer_t), 1);
+    writer->format = format;
+    writer->out = out;
+    writer->width = width;
+    writer->height = height;
+
+    if(format == HPIX_IMAGE_FORMAT_PNG)
+	init_png_writer(writer);
+
+    return writer;
+}
+
+/**********************************************************************/
+
+
+int
+hpix_image_writer_write_rows(hpix_image_writer_t * writer,
+			     const void * rows,
+			     size_t stride,
+			     unsigned int num_of_rows)
+{
+    assert(writer);
+    assert(rows || num_of_rows == 0);
+    assert(stride >= writer->width * sizeof(uint32_t));
+    assert(writer->rows_written + num_of_rows <= writer->height);
+
+    for(unsigned int row = 0; row < num_of_rows && ! writer->error; ++row)
+    {
+	const uint32_t * pixels =
+	    (const uint32_t *) ((const char *) rows + row * stride);
+
+	if(writer->format == HPIX_IMAGE_FORMAT_RAW)
+	{
+	    write_bytes(writer, pixels, writer->width * sizeof(uint32_t));
+	    continue;
+	}
+
+	/* PNG scanlines start with the filter type (0, none) */
+	uint8_t * dest = writer->scanline;
+	*dest++ = 0;
+	for(unsigned int x = 0; x < writer->width; ++x)
+	{
+	    const uint32_t color = pixels[x];
+	    *dest++ = (color >> 16) & 0xFF;
+	    *dest++ = (color >> 8) & 0xFF;
+	    *dest++ = color & 0xFF;
+	    *dest++ = (color >> 24) & 0xFF;
+	}
+
+	deflate_png_data(writer, writer->scanline,
+			 1 + 4 * (size_t) writer->width, 0);
+    }
+
+    writer->rows_written += num_of_rows;
+    return ! writer->error;
+}
+
+/**********************************************************************/
+
+
+int
+hpix_close_image_writer(hpix_image_writer_t * writer)
+{
+    assert(writer);
+
+    if(writer->format == HPIX_IMAGE_FORMAT_PNG)
+    {
+	/* If the image is incomplete, the file is truncated */
+	if(writer->rows_written == writer->height)
+	{
+	    deflate_png_data(writer, NULL, 0, 1);
+	    write_png_chunk(writer, "IEND", NULL, 0);
+	}
+	else
+	    writer->error = 1;
+
+#ifdef HAVE_ZLIB
+	deflateEnd(&writer->stream);
+#endif
+	hpix_free(writer->scanline);
+	hpix_free(writer->buffer);
+    }
+
+    if(! writer->error && fflush(writer->out) != 0)
+	writer->error = 1;
+
+    const int result = ! writer->error;
+    hpix_free(writer);
+    return result;
+}
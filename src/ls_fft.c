@@ -36,21 +36,149 @@
 #include "fftpack.h"
 #include "ls_fft.h"
 
+/* The work arrays of the plans created so far are kept in a global cache,
+   sorted by kind and length, so that a new plan of the same kind and length
+   is set up by copying them instead of recomputing the twiddle factors (and,
+   for Bluestein's algorithm, a FFT). Every plan still gets its own copy,
+   since the work arrays also provide the scratch space of the transforms. */
+typedef struct
+  {
+  size_t length, size;
+  int kind, bluestein;
+  double *work;
+  } plan_template;
+
+enum { kind_complex, kind_real };
+
+static plan_template *templates=NULL;
+static size_t ntemplates=0, s_templates=0, cached_doubles=0,
+  max_cached_doubles=((size_t)1)<<23;
+
+static size_t work_size (size_t length, int kind, int bluestein,
+  const double *work)
+  {
+  if (bluestein)
+    return 2+2*length+8*(((const size_t *)work)[0])+16;
+  return ((kind==kind_real) ? 2 : 4)*length+15;
+  }
+
+/* Returns the position of the template for (length,kind), or the position
+   where it should be inserted if it is not in the cache. */
+static size_t find_template (size_t length, int kind, int *found)
+  {
+  size_t lo=0, hi=ntemplates;
+  while (lo<hi)
+    {
+    size_t mid=(lo+hi)/2;
+    if ((templates[mid].kind<kind) ||
+        ((templates[mid].kind==kind) && (templates[mid].length<length)))
+      lo=mid+1;
+    else
+      hi=mid;
+    }
+  *found = (lo<ntemplates) && (templates[lo].kind==kind)
+        && (templates[lo].length==length);
+  return lo;
+  }
+
+/* If the cache contains a template for (length,kind), copies its work array
+   into a newly allocated one and returns 1; returns 0 otherwise. */
+static int get_cached_work (size_t length, int kind, double **work,
+  int *bluestein)
+  {
+  int found;
+#pragma omp critical (ls_fft_cache)
+{
+  size_t i=find_template(length,kind,&found);
+  if (found)
+    {
+    *work=RALLOC(double,templates[i].size);
+    memcpy(*work,templates[i].work,templates[i].size*sizeof(double));
+    *bluestein=templates[i].bluestein;
+    }
+}
+  return found;
+  }
+
+/* Stores a copy of a freshly computed work array in the cache, unless this
+   would exceed the memory limit. */
+static void cache_work (size_t length, int kind, const double *work,
+  int bluestein)
+  {
+  size_t size=work_size(length,kind,bluestein,work);
+#pragma omp critical (ls_fft_cache)
+{
+  int found;
+  size_t i=find_template(length,kind,&found), j;
+  if ((!found) && (cached_doubles+size<=max_cached_doubles))
+    {
+    if (ntemplates==s_templates)
+      {
+      plan_template *tmp=RALLOC(plan_template,2*s_templates+16);
+      for (j=0; j<ntemplates; ++j)
+        tmp[j]=templates[j];
+      DEALLOC(templates);
+      templates=tmp;
+      s_templates=2*s_templates+16;
+      }
+    for (j=ntemplates; j>i; --j)
+      templates[j]=templates[j-1];
+    templates[i].length=length;
+    templates[i].kind=kind;
+    templates[i].bluestein=bluestein;
+    templates[i].size=size;
+    templates[i].work=RALLOC(double,size);
+    memcpy(templates[i].work,work,size*sizeof(double));
+    ++ntemplates;
+    cached_doubles+=size;
+    }
+}
+  }
+
+static void clear_templates (void)
+  {
+  size_t i;
+  for (i=0; i<ntemplates; ++i)
+    DEALLOC(templates[i].work);
+  DEALLOC(templates);
+  ntemplates=s_templates=cached_doubles=0;
+  }
+
+void ls_fft_clear_plan_cache (void)
+  {
+#pragma omp critical (ls_fft_cache)
+  clear_templates();
+  }
+
+void ls_fft_set_plan_cache_limit (size_t ndoubles)
+  {
+#pragma omp critical (ls_fft_cache)
+{
+  max_cached_doubles=ndoubles;
+  if (cached_doubles>max_cached_doubles)
+    clear_templates();
+}
+  }
+
 complex_plan make_complex_plan (size_t length)
   {
   complex_plan plan = RALLOC(complex_plan_i,1);
-  size_t pfsum = prime_factor_sum(length);
-  double comp1 = length*pfsum;
-  double comp2 = 2*3*length*log(3.*length);
-  comp2*=3.; /* fudge factor that appears to give good overall performance */
   plan->length=length;
-  plan->bluestein = (comp2<comp1);
-  if (plan->bluestein)
-    bluestein_i (length,&(plan->work));
-  else
+  if (!get_cached_work(length,kind_complex,&plan->work,&plan->bluestein))
     {
-    plan->work=RALLOC(double,4*length+15);
-    cffti(length, plan->work);
+    size_t pfsum = prime_factor_sum(length);
+    double comp1 = length*pfsum;
+    double comp2 = 2*3*length*log(3.*length);
+    comp2*=3.; /* fudge factor that appears to give good overall performance */
+    plan->bluestein = (comp2<comp1);
+    if (plan->bluestein)
+      bluestein_i (length,&(plan->work));
+    else
+      {
+      plan->work=RALLOC(double,4*length+15);
+      cffti(length, plan->work);
+      }
+    cache_work(length,kind_complex,plan->work,plan->bluestein);
     }
   return plan;
   }
@@ -81,18 +209,23 @@ void complex_plan_backward (complex_plan plan, double *data)
 real_plan make_real_plan (size_t length)
   {
   real_plan plan = RALLOC(real_plan_i,1);
-  size_t pfsum = prime_factor_sum(length);
-  double comp1 = .5*length*pfsum;
-  double comp2 = 2*3*length*log(3.*length);
-  comp2*=3; /* fudge factor that appears to give good overall performance */
   plan->length=length;
-  plan->bluestein = (comp2<comp1);
-  if (plan->bluestein)
-    bluestein_i (length,&(plan->work));
-  else
+  plan->mwork=NULL;
+  if (!get_cached_work(length,kind_real,&plan->work,&plan->bluestein))
     {
-    plan->work=RALLOC(double,2*length+15);
-    rffti(length, plan->work);
+    size_t pfsum = prime_factor_sum(length);
+    double comp1 = .5*length*pfsum;
+    double comp2 = 2*3*length*log(3.*length);
+    comp2*=3; /* fudge factor that appears to give good overall performance */
+    plan->bluestein = (comp2<comp1);
+    if (plan->bluestein)
+      bluestein_i (length,&(plan->work));
+    else
+      {
+      plan->work=RALLOC(double,2*length+15);
+      rffti(length, plan->work);
+      }
+    cache_work(length,kind_real,plan->work,plan->bluestein);
     }
   return plan;
   }
@@ -100,6 +233,7 @@ real_plan make_real_plan (size_t length)
 void kill_real_plan (real_plan plan)
   {
   DEALLOC(plan->work);
+  DEALLOC(plan->mwork);
   DEALLOC(plan);
   }
 
@@ -265,3 +399,62 @@ void real_plan_backward_c (real_plan plan, double *data)
       }
     }
   }
+
+/* Transforms nvec interleaved arrays in groups of fftpack_multi_vlen. */
+static void real_plan_multi (real_plan plan, double *data, size_t nvec,
+  int forward)
+  {
+  const size_t vlen=fftpack_multi_vlen;
+  size_t n=plan->length, i, j, j0;
+  double *block;
+
+  if (plan->bluestein)
+    {
+    double *tmp=RALLOC(double,n);
+    for (j=0; j<nvec; ++j)
+      {
+      for (i=0; i<n; ++i) tmp[i]=data[i*nvec+j];
+      if (forward)
+        real_plan_forward_fftpack(plan,tmp);
+      else
+        real_plan_backward_fftpack(plan,tmp);
+      for (i=0; i<n; ++i) data[i*nvec+j]=tmp[i];
+      }
+    DEALLOC(tmp);
+    return;
+    }
+
+/* the first half of mwork is the scratch space of the transforms, the
+   second one holds the groups if they have to be copied */
+  if (!plan->mwork)
+    plan->mwork=RALLOC(double,2*vlen*n);
+  block=plan->mwork+vlen*n;
+  for (j0=0; j0<nvec; j0+=vlen)
+    {
+    size_t nv=(nvec-j0<vlen) ? nvec-j0 : vlen;
+    double *buf=data;
+    if (nvec!=vlen)
+      {
+      buf=block;
+      for (i=0; i<n; ++i)
+        for (j=0; j<vlen; ++j)
+          buf[i*vlen+j] = (j<nv) ? data[i*nvec+j0+j] : 0.;
+      }
+    if (forward)
+      rfftf_multi(n,buf,plan->mwork,plan->work);
+    else
+      rfftb_multi(n,buf,plan->mwork,plan->work);
+    if (nvec!=vlen)
+      for (i=0; i<n; ++i)
+        for (j=0; j<nv; ++j)
+          data[i*nvec+j0+j] = buf[i*vlen+j];
+    }
+  }
+
+void real_plan_forward_fftpack_multi (real_plan plan, double *data,
+  size_t nvec)
+  { real_plan_multi(plan,data,nvec,1); }
+
+void real_plan_backward_fftpack_multi (real_plan plan, double *data,
+  size_t nvec)
+  { real_plan_multi(plan,data,nvec,0); }
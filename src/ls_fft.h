@@ -67,9 +67,18 @@ Bluestein's algorithm was implemented according to the description on Wikipedia
 (<a href="http://en.wikipedia.org/wiki/Bluestein%27s_FFT_algorithm">
 http://en.wikipedia.org/wiki/Bluestein%27s_FFT_algorithm</a>).
 
+Plan creation takes the twiddle factors from a global cache of the plans
+created before, if one of the same kind and length exists; the memory used by
+the cache can be limited with ls_fft_set_plan_cache_limit().
+
+Several real arrays of the same length can be transformed at the same time
+with real_plan_forward_fftpack_multi() and real_plan_backward_fftpack_multi(),
+which run the FFTPACK passes on SIMD vectors holding one element of each array.
+
 \b Thread-safety:
 All routines can be called concurrently; all information needed by
-<tt>ls_fft</tt> is stored in the plan variable. However, using the same plan
+<tt>ls_fft</tt> is stored in the plan variable, and the plan cache is
+protected by a lock. However, using the same plan
 variable on multiple threads simultaneously is not supported and will lead to
 data corruption.
 */
@@ -100,7 +109,7 @@ void complex_plan_backward (complex_plan plan, double *data);
 
 typedef struct
   {
-  double *work;
+  double *work, *mwork;
   size_t length;
   int bluestein;
   } real_plan_i;
@@ -149,6 +158,27 @@ void real_plan_forward_c (real_plan plan, double *data);
     - on exit, it has the form <tt>r0, 0, r1, 0, ..., r[length-1], 0</tt>. */
 void real_plan_backward_c (real_plan plan, double *data);
 
+/*! Computes real forward FFTs of \a nvec arrays at once, using \a plan.
+    The arrays are stored interleaved (element \a i of array \a j is
+    <tt>data[i*nvec+j]</tt>), and each of them uses the storage scheme of
+    real_plan_forward_fftpack(). Setting \a nvec to a multiple of
+    <tt>fftpack_multi_vlen</tt> (see fftpack.h) avoids copying the arrays. */
+void real_plan_forward_fftpack_multi (real_plan plan, double *data,
+  size_t nvec);
+/*! Computes real backward FFTs of \a nvec interleaved arrays at once,
+    using \a plan; see real_plan_forward_fftpack_multi() and
+    real_plan_backward_fftpack(). */
+void real_plan_backward_fftpack_multi (real_plan plan, double *data,
+  size_t nvec);
+
+/*! Frees the twiddle factors stored in the global plan cache. Existing
+    plans are not affected. */
+void ls_fft_clear_plan_cache (void);
+/*! Limits the memory used by the global plan cache to \a ndoubles
+    values (the default is 2^23); 0 disables the cache. If the cache
+    is larger than the new limit, it is cleared. */
+void ls_fft_set_plan_cache_limit (size_t ndoubles);
+
 /*! \} */
 
 #ifdef __cplusplus
@@ -40,7 +40,8 @@ hpix_create_resolution(hpix_nside_t nside)
     resolution->ncap             = 2 * (resolution->pixels_per_face - nside);
     resolution->fact2            = 4.0 / resolution->num_of_pixels;
     resolution->fact1            = (2 * nside) * resolution->fact2;
-    
+    resolution->ring_table       = NULL;
+
     return resolution;
 }
 
@@ -50,6 +51,7 @@ void
 hpix_free_resolution(hpix_resolution_t * resolution)
 {
     assert(resolution != NULL);
+    hpix_free(resolution->ring_table);
     hpix_free(resolution);
 }
 
@@ -123,7 +125,7 @@ hpix_free_map(hpix_map_t * map)
 	hpix_free(map->pixels);
 
     if(map->resolution != NULL)
-	hpix_free(map->resolution);
+	hpix_free_resolution(map->resolution);
 
     hpix_free(map);
 }
@@ -23,6 +23,7 @@
 #include <assert.h>
 
 #include "constants.h"
+#include "bmp_projection.h"
 
 /**********************************************************************/
 
@@ -97,3 +98,231 @@ hpix_mollweide_xy_to_angles(const hpix_bmp_projection_t * proj,
     *phi = -M_PI_2 * u / fmax(cos_asin_v, 1e-6);
     return TRUE;
 }
+
+/**********************************************************************/
+
+
+/* The forward projection requires the solution of the equation
+ *
+ *     2 psi + sin(2 psi) = pi sin(lat)
+ *
+ * for the auxiliary angle psi, which is found using Newton's method.
+ * Points are processed in blocks: the initial guess is computed for
+ * the whole block, then the iterations are run on vectors of
+ * MOLLWEIDE_VLEN elements, using polynomial approximations of the
+ * sine and cosine (psi is always in [-pi/2, pi/2]) so that the
+ * compiler can use SIMD instructions. The number of iterations is
+ * fixed: the initial guess is close enough to the solution that four
+ * iterations reach machine precision everywhere. */
+
+#if defined(__GNUC__) && !defined(PLANCK_DISABLE_SSE)
+#if defined(__AVX__)
+#define MOLLWEIDE_VLEN 4
+#else
+#define MOLLWEIDE_VLEN 2
+#endif
+typedef double mollweide_vec_t
+    __attribute__((vector_size(MOLLWEIDE_VLEN * sizeof(double)),
+		   aligned(sizeof(double)), __may_alias__));
+#else
+#define MOLLWEIDE_VLEN 1
+typedef double mollweide_vec_t;
+#endif
+
+#define MOLLWEIDE_NEWTON_ITERATIONS 4
+#define MOLLWEIDE_BLOCK_SIZE 256
+
+/**********************************************************************/
+
+
+/* Taylor series of sin(x) and cos(x), accurate to 1e-16 for |x| <=
+ * pi/2 */
+static inline mollweide_vec_t
+sin_poly(mollweide_vec_t x)
+{
+    const mollweide_vec_t x2 = x * x;
+    mollweide_vec_t result = x2 * (1.0 / 51090942171709440000.0)
+	- (1.0 / 121645100408832000.0);
+
+    result = result * x2 + (1.0 / 355687428096000.0);
+    result = result * x2 - (1.0 / 1307674368000.0);
+    result = result * x2 + (1.0 / 6227020800.0);
+    result = result * x2 - (1.0 / 39916800.0);
+    result = result * x2 + (1.0 / 362880.0);
+    result = result * x2 - (1.0 / 5040.0);
+    result = result * x2 + (1.0 / 120.0);
+    result = result * x2 - (1.0 / 6.0);
+    result = result * x2 + 1.0;
+    return result * x;
+}
+
+static inline mollweide_vec_t
+cos_poly(mollweide_vec_t x)
+{
+    const mollweide_vec_t x2 = x * x;
+    mollweide_vec_t result = x2 * (1.0 / 1124000727777607680000.0)
+	- (1.0 / 2432902008176640000.0);
+
+    result = result * x2 + (1.0 / 6402373705728000.0);
+    result = result * x2 - (1.0 / 20922789888000.0);
+    result = result * x2 + (1.0 / 87178291200.0);
+    result = result * x2 - (1.0 / 479001600.0);
+    result = result * x2 + (1.0 / 3628800.0);
+    result = result * x2 - (1.0 / 40320.0);
+    result = result * x2 + (1.0 / 720.0);
+    result = result * x2 - (1.0 / 24.0);
+    result = result * x2 + 0.5;
+    return 1.0 - result * x2;
+}
+
+/**********************************************************************/
+
+
+/* Solve the Mollweide equation for `num` points. On input, `psi`
+ * contains the initial guess and `rhs` the value of pi sin(lat). On
+ * output, `psi` is replaced by sin(psi), and `rhs` by cos(psi). The
+ * number of points must be a multiple of MOLLWEIDE_VLEN. */
+static void
+mollweide_newton_solve(double * psi, double * rhs, size_t num)
+{
+    assert(num % MOLLWEIDE_VLEN == 0);
+
+    for(size_t idx = 0; idx < num; idx += MOLLWEIDE_VLEN)
+    {
+	mollweide_vec_t * psi_vec = (mollweide_vec_t *) (psi + idx);
+	mollweide_vec_t * rhs_vec = (mollweide_vec_t *) (rhs + idx);
+	mollweide_vec_t angle = *psi_vec;
+	const mollweide_vec_t target = *rhs_vec;
+	mollweide_vec_t sin_angle = sin_poly(angle);
+	mollweide_vec_t cos_angle = cos_poly(angle);
+
+	for(int iter = 0; iter < MOLLWEIDE_NEWTON_ITERATIONS; ++iter)
+	{
+	    /* f(psi) = 2 psi + sin(2 psi) - target, f'(psi) = 4
+	     * cos^2(psi). The tiny constant avoids 0/0 at the poles,
+	     * where the step is zero anyway. */
+	    angle -= (2.0 * angle + 2.0 * sin_angle * cos_angle - target)
+		/ (4.0 * cos_angle * cos_angle + 1e-300);
+	    sin_angle = sin_poly(angle);
+	    cos_angle = cos_poly(angle);
+	}
+
+	*psi_vec = sin_angle;
+	*rhs_vec = cos_angle;
+    }
+}
+
+/**********************************************************************/
+
+
+/* Project a block of at most MOLLWEIDE_BLOCK_SIZE points */
+static void
+mollweide_project_block(const hpix_bmp_projection_t * proj,
+			const double * theta,
+			const double * phi,
+			size_t num,
+			double * x,
+			double * y)
+{
+    const double center_x = hpix_bmp_projection_width(proj) / 2.0;
+    const double center_y = hpix_bmp_projection_height(proj) / 2.0;
+    double psi[MOLLWEIDE_BLOCK_SIZE];
+    double rhs[MOLLWEIDE_BLOCK_SIZE];
+    size_t padded_num = num;
+
+    assert(num <= MOLLWEIDE_BLOCK_SIZE);
+
+    for(size_t idx = 0; idx < num; ++idx)
+    {
+	const double sin_lat = cos(theta[idx]);
+
+	/* Near the poles, 2 psi + sin(2 psi) is approximately pi -
+	 * 4/3 (pi/2 - |psi|)^3. The value of 1 - |sin(lat)| is
+	 * computed from theta to avoid cancellation. */
+	if(fabs(sin_lat) > 0.8)
+	{
+	    const double half_theta = 0.5 * theta[idx];
+	    const double sin_half = (sin_lat > 0.0)
+		? sin(half_theta) : cos(half_theta);
+	    const double distance = cbrt(1.5 * M_PI * sin_half * sin_half);
+	    psi[idx] = copysign(M_PI_2 - distance, sin_lat);
+	}
+	else
+	    psi[idx] = M_PI_2 - theta[idx];
+
+	rhs[idx] = M_PI * sin_lat;
+    }
+
+    /* Pad the block by repeating the last point */
+    while(padded_num % MOLLWEIDE_VLEN != 0)
+    {
+	psi[padded_num] = psi[num - 1];
+	rhs[padded_num] = rhs[num - 1];
+	++padded_num;
+    }
+
+    mollweide_newton_solve(psi, rhs, padded_num);
+
+    for(size_t idx = 0; idx < num; ++idx)
+    {
+	/* Bring phi into [-pi, pi) */
+	const double cur_phi = phi[idx]
+	    - 2.0 * M_PI * floor((phi[idx] + M_PI) / (2.0 * M_PI));
+
+	/* psi and rhs now contain sin(psi) and cos(psi) */
+	x[idx] = center_x * (1.0 - cur_phi * rhs[idx] / M_PI);
+	y[idx] = center_y * (1.0 + psi[idx]);
+    }
+}
+
+/**********************************************************************/
+
+
+int
+hpix_mollweide_angles_to_xy(const hpix_bmp_projection_t * proj,
+			    double theta,
+			    double phi,
+			    double * x,
+			    double * y)
+{
+    assert(proj);
+    assert(x);
+    assert(y);
+
+    mollweide_project_block(proj, &theta, &phi, 1, x, y);
+    return TRUE;
+}
+
+/**********************************************************************/
+
+
+size_t
+hpix_mollweide_angles_to_xy_batch(const hpix_bmp_projection_t * proj,
+				  const double * theta,
+				  const double * phi,
+				  size_t num_of_points,
+				  double * x,
+				  double * y)
+{
+    assert(proj);
+    assert(theta && phi);
+    assert(x && y);
+
+    const size_t num_of_blocks =
+	(num_of_points + MOLLWEIDE_BLOCK_SIZE - 1) / MOLLWEIDE_BLOCK_SIZE;
+
+#pragma omp parallel for default(shared) if(num_of_blocks > 16)
+    for(size_t block = 0; block < num_of_blocks; ++block)
+    {
+	const size_t first = block * MOLLWEIDE_BLOCK_SIZE;
+	const size_t num = (first + MOLLWEIDE_BLOCK_SIZE <= num_of_points)
+	    ? MOLLWEIDE_BLOCK_SIZE
+	    : num_of_points - first;
+
+	mollweide_project_block(proj, theta + first, phi + first, num,
+				x + first, y + first);
+    }
+
+    /* Every direction is visible in a Mollweide projection */
+    return num_of_points;
+}
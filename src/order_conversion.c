@@ -175,7 +175,7 @@ static hpix_pixel_num_t
 xyf2nest(const hpix_resolution_t * resolution,
 	 xyf_pixel_t xyf)
 {
-    return (xyf.face_num << (2 * resolution->order))
+    return ((hpix_pixel_num_t) xyf.face_num << (2 * resolution->order))
 	+ spread_bits(xyf.ix)
 	+ 2 * spread_bits(xyf.iy);
 }
@@ -264,6 +264,15 @@ get_ring_info_small(const hpix_resolution_t * resolution,
     assert(ringpix != NULL);
     assert(shifted != NULL);
 
+    if (resolution->ring_table != NULL)
+    {
+	const hpix_ring_info_t * info = &resolution->ring_table[ring - 1];
+	*ringpix = info->num_of_pixels;
+	*startpix = info->first_pixel;
+	*shifted = info->shifted;
+	return;
+    }
+
     if (ring < resolution->nside)
     {
 	*ringpix = 4 * ring;
@@ -300,9 +309,12 @@ xyf2ring(const hpix_resolution_t * resolution,
     get_ring_info_small(resolution, jr, &n_before, &nr, &shifted);
     nr >>= 2;
     kshift = 1 - shifted;
-    unsigned jp = (jpll[xyf.face_num] * nr + xyf.ix - xyf.iy + 1 + kshift) / 2;
-    assert(jp <= 4 * nr);
-    if (jp < 1)
+    /* ix - iy can be negative, so signed arithmetic is needed here */
+    long jp = ((long) (jpll[xyf.face_num] * nr + kshift + 1)
+	       + (long) xyf.ix - (long) xyf.iy) / 2;
+    if (jp > (long) resolution->nside_times_four)
+	jp -= resolution->nside_times_four;
+    else if (jp < 1)
     {
 	/* Assumption: if this triggers, then resolution->nsidetimes_four==4*nr */
 	jp += resolution->nside_times_four;
@@ -335,6 +347,44 @@ hpix_ring_to_nest_idx(const hpix_resolution_t * resolution,
 
 /**********************************************************************/
 
+
+void
+hpix_nest_to_xyf(const hpix_resolution_t * resolution,
+		 hpix_pixel_num_t nest_index,
+		 unsigned int * x,
+		 unsigned int * y,
+		 unsigned int * face_num)
+{
+    assert(x && y && face_num);
+
+    xyf_pixel_t xyf = nest2xyf(resolution, nest_index);
+    *x = xyf.ix;
+    *y = xyf.iy;
+    *face_num = xyf.face_num;
+}
+
+/**********************************************************************/
+
+
+hpix_pixel_num_t
+hpix_xyf_to_nest(const hpix_resolution_t * resolution,
+		 unsigned int x,
+		 unsigned int y,
+		 unsigned int face_num)
+{
+    assert(resolution != NULL);
+    assert(x < resolution->nside && y < resolution->nside);
+    assert(face_num < 12);
+
+    return xyf2nest(resolution, (xyf_pixel_t) {
+	    .ix = x,
+	    .iy = y,
+	    .face_num = face_num
+	});
+}
+
+/**********************************************************************/
+
 
 static const int *
 cycles_for_swapping(const hpix_resolution_t * resolution,
@@ -365,11 +415,14 @@ hpix_switch_order(hpix_map_t * map)
     assert(map);
 
     /* See the definition of swap_clen and swap_cycle to make sense of
-     * this stuff. */
+     * this stuff. Note that the loop below sets the pixel at index
+     * `i` in the new ordering to the one at index conversion_fn(i)
+     * in the old ordering: so, when going from RING to NEST, we need
+     * the NEST-to-RING conversion. */
     if(map->scheme == HPIX_ORDER_SCHEME_RING)
-	conversion_fn = hpix_ring_to_nest_idx;
-    else
 	conversion_fn = hpix_nest_to_ring_idx;
+    else
+	conversion_fn = hpix_ring_to_nest_idx;
 
     size_t num_of_cycles;
     const int *restrict array_of_cycles = 
@@ -0,0 +1,126 @@
+/* orthographic_projection.c -- Functions to convert a map into a
+ * orthographic projection and vice-versa
+ *
+ * Copyright 2011-2013 Maurizio Tomasi.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.  */
+
+#include "config.h"
+
+#include <hpixlib/hpix.h>
+#include <math.h>
+#include <assert.h>
+
+#include "constants.h"
+#include "bmp_projection.h"
+
+/* The orthographic projection shows the hemisphere centered on
+ * `center` as it would be seen from an infinite distance. The
+ * hemisphere is drawn as a disc inscribed in the bitmap; the (u, v)
+ * coordinates are measured along `right_axis` and `up_axis`, and
+ * cover the range [-1, 1]. */
+
+/**********************************************************************/
+
+
+static inline void
+orthographic_xy_to_uv(const hpix_bmp_projection_t * proj,
+		      unsigned int x,
+		      unsigned int y,
+		      double * u,
+		      double * v)
+{
+    const double radius = 0.5 * fmin(proj->width, proj->height);
+
+    assert(radius > 0.0);
+
+    *u = (x - 0.5 * proj->width) / radius;
+    *v = (y - 0.5 * proj->height) / radius;
+}
+
+/**********************************************************************/
+
+
+int
+hpix_orthographic_is_xy_inside(const hpix_bmp_projection_t * proj,
+			       unsigned int x,
+			       unsigned int y)
+{
+    double u, v;
+
+    assert(proj);
+    orthographic_xy_to_uv(proj, x, y, &u, &v);
+
+    return u*u + v*v < 1.0;
+}
+
+/**********************************************************************/
+
+
+int
+hpix_orthographic_xy_to_angles(const hpix_bmp_projection_t * proj,
+			       unsigned int x,
+			       unsigned int y,
+			       double * theta,
+			       double * phi)
+{
+    assert(proj);
+    assert(theta);
+    assert(phi);
+
+    double u, v;
+    orthographic_xy_to_uv(proj, x, y, &u, &v);
+    if(u*u + v*v >= 1.0)
+	return FALSE;
+
+    const double w = sqrt(1.0 - u*u - v*v);
+    const hpix_vector_t direction = {
+	.x = w * proj->center.x + u * proj->right_axis.x + v * proj->up_axis.x,
+	.y = w * proj->center.y + u * proj->right_axis.y + v * proj->up_axis.y,
+	.z = w * proj->center.z + u * proj->right_axis.z + v * proj->up_axis.z
+    };
+
+    hpix_vector_to_angles(&direction, theta, phi);
+    return TRUE;
+}
+
+/**********************************************************************/
+
+
+int
+hpix_orthographic_angles_to_xy(const hpix_bmp_projection_t * proj,
+			       double theta,
+			       double phi,
+			       double * x,
+			       double * y)
+{
+    assert(proj);
+    assert(x);
+    assert(y);
+
+    hpix_vector_t direction;
+    hpix_angles_to_vector(theta, phi, &direction);
+
+    /* The hemisphere opposite to the center is not visible */
+    if(hpix_dot_product(&direction, &proj->center) < 0.0)
+	return FALSE;
+
+    const double radius = 0.5 * fmin(proj->width, proj->height);
+    *x = 0.5 * proj->width
+	+ radius * hpix_dot_product(&direction, &proj->right_axis);
+    *y = 0.5 * proj->height
+	+ radius * hpix_dot_product(&direction, &proj->up_axis);
+
+    return TRUE;
+}
@@ -20,6 +20,7 @@
 #include <hpixlib/hpix.h>
 #include <assert.h>
 #include <stdlib.h>
+#include <math.h>
 
 /* The following code is used to define the color gradient used to
  * draw the Mollview projection and the color bar. The purpose is to
@@ -386,3 +387,211 @@ hpix_palette_color(const hpix_color_palette_t * palette,
 
 #undef INTERPOLATE_COMPONENT
 }
+
+/**********************************************************************/
+
+/* A lookup table (LUT) contains the colors of a palette for a set of
+ * equally spaced levels in [0.0, 1.0], already packed in the format
+ * used by Cairo's image surfaces (see `hpix_pack_color`). Converting
+ * a level into a color requires therefore just a multiplication and
+ * a memory access, instead of a search in the list of steps and
+ * three interpolations. With 4096 entries, the difference between a
+ * LUT and the exact palette is smaller than the resolution of a 8-bit
+ * color component. */
+
+struct hpix_palette_lut_t {
+    size_t     num_of_entries;
+    uint32_t * entries;
+    uint32_t   unseen_color;
+};
+
+/**********************************************************************/
+
+uint32_t
+hpix_pack_color(hpix_color_t color)
+{
+    /* Components are rounded to the nearest level, as Cairo does */
+#define PACK_COMPONENT(x) ((uint32_t) (255 * fmin(fmax((x), 0.0), 1.0) + 0.5))
+
+    return UINT32_C(0xFF000000)
+	| (PACK_COMPONENT(color.red) << 16)
+	| (PACK_COMPONENT(color.green) << 8)
+	| PACK_COMPONENT(color.blue);
+
+#undef PACK_COMPONENT
+}
+
+/**********************************************************************/
+
+hpix_palette_lut_t *
+hpix_create_palette_lut(const hpix_color_palette_t * palette,
+			size_t num_of_entries)
+{
+    assert(palette != NULL);
+    assert(num_of_entries >= 2);
+
+    hpix_palette_lut_t * lut = hpix_malloc(sizeof(hpix_palette_lut_t), 1);
+    lut->num_of_entries = num_of_entries;
+    lut->entries = hpix_malloc(sizeof(lut->entries[0]), num_of_entries);
+    lut->unseen_color =
+	hpix_pack_color(hpix_color_for_unseen_pixels_in_palette(palette));
+
+    for(size_t idx = 0; idx < num_of_entries; ++idx)
+    {
+	hpix_color_t color;
+	hpix_palette_color(palette, idx / (num_of_entries - 1.0), &color);
+	lut->entries[idx] = hpix_pack_color(color);
+    }
+
+    return lut;
+}
+
+/**********************************************************************/
+
+void
+hpix_free_palette_lut(hpix_palette_lut_t * lut)
+{
+    if(lut == NULL)
+	return;
+
+    hpix_free(lut->entries);
+    hpix_free(lut);
+}
+
+/**********************************************************************/
+
+size_t
+hpix_palette_lut_size(const hpix_palette_lut_t * lut)
+{
+    assert(lut != NULL);
+    return lut->num_of_entries;
+}
+
+/**********************************************************************/
+
+const uint32_t *
+hpix_palette_lut_entries(const hpix_palette_lut_t * lut)
+{
+    assert(lut != NULL);
+    return lut->entries;
+}
+
+/**********************************************************************/
+
+uint32_t
+hpix_palette_lut_unseen_color(const hpix_palette_lut_t * lut)
+{
+    assert(lut != NULL);
+    return lut->unseen_color;
+}
+
+/**********************************************************************/
+
+uint32_t
+hpix_palette_lut_color(const hpix_palette_lut_t * lut, double level)
+{
+    assert(lut != NULL);
+
+    if(isnan(level))
+	return lut->unseen_color;
+
+    const double max_index = lut->num_of_entries - 1;
+    double position = level * max_index + 0.5;
+    position = (position > 0.0) ? position : 0.0;
+    position = (position < max_index) ? position : max_index;
+
+    return lut->entries[(size_t) position];
+}
+
+/**********************************************************************/
+
+/* Convert a row of bitmap values into packed colors. The loop has no
+ * data-dependent branches (special values are handled with selects),
+ * so that the compiler can vectorize it. */
+static void
+colorize_row(const hpix_palette_lut_t * lut,
+	     const double *restrict values,
+	     size_t num_of_values,
+	     double offset,
+	     double scale,
+	     uint32_t *restrict dest)
+{
+    const uint32_t *restrict entries = lut->entries;
+    const double max_index = lut->num_of_entries - 1;
+    const uint32_t unseen_color = lut->unseen_color;
+    /* Same as in `hpix_bmp_projection_to_cairo_surface`: white, fully
+     * transparent */
+    const uint32_t transparent_color = UINT32_C(0x00FFFFFF);
+
+    for(size_t idx = 0; idx < num_of_values; ++idx)
+    {
+	const double value = values[idx];
+	double position = (value - offset) * scale + 0.5;
+
+	/* NaNs fail both comparisons and are clamped to 0 */
+	position = (position > 0.0) ? position : 0.0;
+	position = (position < max_index) ? position : max_index;
+
+	uint32_t color = entries[(uint32_t) position];
+	color = (value > -1.6e+30) ? color : unseen_color;
+	color = (value != value) ? unseen_color : color;
+	color = (fabs(value) == INFINITY) ? transparent_color : color;
+	dest[idx] = color;
+    }
+}
+
+/**********************************************************************/
+
+void
+hpix_palette_lut_colorize_values(const hpix_palette_lut_t * lut,
+				 const double * values,
+				 size_t num_of_values,
+				 double min_value,
+				 double max_value,
+				 uint32_t * dest)
+{
+    assert(lut != NULL);
+    assert(values != NULL || num_of_values == 0);
+    assert(dest != NULL || num_of_values == 0);
+
+    const double dynamic_range = max_value - min_value;
+    const double scale = (dynamic_range > 0.0)
+	? (lut->num_of_entries - 1) / dynamic_range
+	: 0.0;
+
+    colorize_row(lut, values, num_of_values, min_value, scale, dest);
+}
+
+/**********************************************************************/
+
+void
+hpix_palette_lut_colorize(const hpix_palette_lut_t * lut,
+			  const double * bitmap,
+			  unsigned int width,
+			  unsigned int height,
+			  double min_value,
+			  double max_value,
+			  void * dest,
+			  size_t dest_stride)
+{
+    assert(lut != NULL);
+    assert(bitmap != NULL);
+    assert(dest != NULL);
+    assert(dest_stride >= width * sizeof(uint32_t));
+
+    const double dynamic_range = max_value - min_value;
+    const double scale = (dynamic_range > 0.0)
+	? (lut->num_of_entries - 1) / dynamic_range
+	: 0.0;
+
+    /* The first row of the bitmap is the bottom one, while images are
+     * stored from the top to the bottom */
+#pragma omp parallel for default(shared) if((size_t) width * height > 65536)
+    for(unsigned int y = 0; y < height; ++y)
+    {
+	uint32_t * row = (uint32_t *) ((char *) dest
+				       + (height - y - 1) * dest_stride);
+	colorize_row(lut, bitmap + (size_t) y * width, width,
+		     min_value, scale, row);
+    }
+}
@@ -0,0 +1,488 @@
+/* pipeline.c -- Convert streams of pointings into pixel indexes
+ *
+ * Copyright 2011-2013 Maurizio Tomasi.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.  */
+
+#include "config.h"
+
+#include <hpixlib/hpix.h>
+#include <assert.h>
+#include <sched.h>
+#include <stdint.h>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include "walltime_c.h"
+
+/* The pipeline uses a fixed ring of buffers. Each buffer cycles
+ * through three states:
+ *
+ * 1. FREE: the producer can fill it with new pointings;
+ * 2. FILLED: a worker can convert the pointings into pixels;
+ * 3. CONVERTED: the consumer can use the pixels.
+ *
+ * Chunk `k` always goes into buffer `k % num_of_buffers`, and the
+ * consumer receives the chunks in the same order as they were read.
+ * Every transition is done by exactly one thread, so no locks are
+ * needed: each thread just waits for the buffer it is interested in
+ * to reach the state it needs.
+ *
+ * Thread 0 runs the producer, thread 1 the consumer and all the
+ * others convert pointings. If fewer than three threads are
+ * available, the three stages are run one after another. */
+
+enum {
+    BUFFER_FREE,
+    BUFFER_FILLED,
+    BUFFER_CONVERTED
+};
+
+#define MIN_THREADS_FOR_PIPELINING 3
+
+/* Number of chunks still unknown to the workers and to the consumer */
+#define UNKNOWN_NUM_OF_CHUNKS SIZE_MAX
+
+typedef struct {
+    double           * theta;
+    double           * phi;
+    hpix_pixel_num_t * pixels;
+    size_t             num_of_samples;
+    size_t             first_sample;
+
+    size_t             sequence;
+    int                state;
+} pipeline_buffer_t;
+
+struct hpix_pointing_pipeline_t {
+    hpix_resolution_t     * resolution;
+    hpix_ordering_scheme_t  scheme;
+    size_t                  samples_per_buffer;
+    size_t                  num_of_buffers;
+    pipeline_buffer_t     * buffers;
+
+    /* These are used only while the pipeline is running */
+    size_t                  next_chunk_to_convert;
+    size_t                  num_of_chunks;
+
+    hpix_pipeline_stats_t   stats;
+};
+
+/**********************************************************************/
+
+
+hpix_pointing_pipeline_t *
+hpix_create_pointing_pipeline(hpix_nside_t nside,
+			      hpix_ordering_scheme_t scheme,
+			      size_t num_of_buffers,
+			      size_t samples_per_buffer)
+{
+    assert(hpix_valid_nside(nside));
+    assert(num_of_buffers >= 2);
+    assert(samples_per_buffer > 0);
+
+    hpix_pointing_pipeline_t * pipeline =
+	hpix_calloc(sizeof(hpix_pointing_pipeline_t), 1);
+    pipeline->resolution = hpix_create_resolution(nside);
+    pipeline->scheme = scheme;
+    pipeline->samples_per_buffer = samples_per_buffer;
+    pipeline->num_of_buffers = num_of_buffers;
+
+    /* All the memory is allocated here, so that running the pipeline
+     * never needs to allocate anything */
+    pipeline->buffers = hpix_calloc(sizeof(pipeline_buffer_t),
+				    num_of_buffers);
+    for(size_t idx = 0; idx < num_of_buffers; ++idx)
+    {
+	pipeline_buffer_t * buffer = &pipeline->buffers[idx];
+	buffer->theta = hpix_malloc(sizeof(buffer->theta[0]),
+				    samples_per_buffer);
+	buffer->phi = hpix_malloc(sizeof(buffer->phi[0]),
+				  samples_per_buffer);
+	buffer->pixels = hpix_malloc(sizeof(buffer->pixels[0]),
+				     samples_per_buffer);
+    }
+
+    return pipeline;
+}
+
+/**********************************************************************/
+
+
+void
+hpix_free_pointing_pipeline(hpix_pointing_pipeline_t * pipeline)
+{
+    if(pipeline == NULL)
+	return;
+
+    for(size_t idx = 0; idx < pipeline->num_of_buffers; ++idx)
+    {
+	hpix_free(pipeline->buffers[idx].theta);
+	hpix_free(pipeline->buffers[idx].phi);
+	hpix_free(pipeline->buffers[idx].pixels);
+    }
+
+    hpix_free(pipeline->buffers);
+    hpix_free_resolution(pipeline->resolution);
+    hpix_free(pipeline);
+}
+
+/**********************************************************************/
+
+
+const hpix_pipeline_stats_t *
+hpix_pointing_pipeline_stats(const hpix_pointing_pipeline_t * pipeline)
+{
+    assert(pipeline);
+    return &pipeline->stats;
+}
+
+/**********************************************************************/
+
+
+static int
+get_buffer_state(const pipeline_buffer_t * buffer)
+{
+    int state;
+#pragma omp atomic read
+    state = buffer->state;
+#pragma omp flush
+    return state;
+}
+
+/**********************************************************************/
+
+
+static void
+set_buffer_state(pipeline_buffer_t * buffer, int state)
+{
+    /* Make sure that the content of the buffer is visible to the
+     * other threads before they see the new state */
+#pragma omp flush
+    /* The cast is redundant, but without it GCC considers `state` as
+     * set but not used */
+#pragma omp atomic write
+    buffer->state = (int) state;
+#pragma omp flush
+}
+
+/**********************************************************************/
+
+
+static size_t
+get_num_of_chunks(const hpix_pointing_pipeline_t * pipeline)
+{
+    size_t num_of_chunks;
+#pragma omp atomic read
+    num_of_chunks = pipeline->num_of_chunks;
+#pragma omp flush
+    return num_of_chunks;
+}
+
+/**********************************************************************/
+
+
+/* Wait until chunk `sequence` is in state `state`. Return FALSE if
+ * the chunk will never arrive because the stream has ended. */
+static int
+wait_for_chunk(const hpix_pointing_pipeline_t * pipeline,
+	       size_t sequence,
+	       int state)
+{
+    const pipeline_buffer_t * buffer =
+	&pipeline->buffers[sequence % pipeline->num_of_buffers];
+
+    for(;;)
+    {
+	if(get_buffer_state(buffer) == state && buffer->sequence == sequence)
+	    return TRUE;
+
+	if(sequence >= get_num_of_chunks(pipeline))
+	    return FALSE;
+
+	sched_yield();
+    }
+}
+
+/**********************************************************************/
+
+
+static void
+convert_buffer(const hpix_pointing_pipeline_t * pipeline,
+	       pipeline_buffer_t * buffer)
+{
+    hpix_angles_to_pixel_fn_t * angles_to_pixel_fn =
+	(pipeline->scheme == HPIX_ORDER_SCHEME_NEST)
+	? hpix_angles_to_nest_pixel
+	: hpix_angles_to_ring_pixel;
+
+    for(size_t idx = 0; idx < buffer->num_of_samples; ++idx)
+	buffer->pixels[idx] = angles_to_pixel_fn(pipeline->resolution,
+						 buffer->theta[idx],
+						 buffer->phi[idx]);
+}
+
+/**********************************************************************/
+
+
+static void
+run_producer(hpix_pointing_pipeline_t * pipeline,
+	     hpix_pointing_reader_fn_t * reader,
+	     void * reader_data)
+{
+    size_t first_sample = 0;
+    double read_time = 0.0;
+
+    for(size_t sequence = 0; ; ++sequence)
+    {
+	pipeline_buffer_t * buffer =
+	    &pipeline->buffers[sequence % pipeline->num_of_buffers];
+
+	/* The buffer is freed by the consumer, which never stops
+	 * before the producer */
+	while(get_buffer_state(buffer) != BUFFER_FREE)
+	    sched_yield();
+
+	double start = wallTime();
+	size_t num_of_samples = reader(reader_data,
+				       buffer->theta, buffer->phi,
+				       pipeline->samples_per_buffer);
+	read_time += wallTime() - start;
+	assert(num_of_samples <= pipeline->samples_per_buffer);
+
+	if(num_of_samples == 0)
+	{
+#pragma omp flush
+#pragma omp atomic write
+	    pipeline->num_of_chunks = sequence;
+#pragma omp flush
+	    break;
+	}
+
+	buffer->num_of_samples = num_of_samples;
+	buffer->first_sample = first_sample;
+	buffer->sequence = sequence;
+	first_sample += num_of_samples;
+	set_buffer_state(buffer, BUFFER_FILLED);
+    }
+
+    pipeline->stats.read_time = read_time;
+    pipeline->stats.num_of_samples = first_sample;
+}
+
+/**********************************************************************/
+
+
+static void
+run_worker(hpix_pointing_pipeline_t * pipeline)
+{
+    double conversion_time = 0.0;
+
+    for(;;)
+    {
+	size_t sequence;
+#pragma omp atomic capture
+	sequence = pipeline->next_chunk_to_convert++;
+
+	if(! wait_for_chunk(pipeline, sequence, BUFFER_FILLED))
+	    break;
+
+	pipeline_buffer_t * buffer =
+	    &pipeline->buffers[sequence % pipeline->num_of_buffers];
+
+	double start = wallTime();
+	convert_buffer(pipeline, buffer);
+	conversion_time += wallTime() - start;
+
+	set_buffer_state(buffer, BUFFER_CONVERTED);
+    }
+
+#pragma omp atomic
+    pipeline->stats.conversion_time += conversion_time;
+}
+
+/**********************************************************************/
+
+
+static void
+run_consumer(hpix_pointing_pipeline_t * pipeline,
+	     hpix_pixel_consumer_fn_t * consumer,
+	     void * consumer_data)
+{
+    double consume_time = 0.0;
+
+    for(size_t sequence = 0; ; ++sequence)
+    {
+	if(! wait_for_chunk(pipeline, sequence, BUFFER_CONVERTED))
+	    break;
+
+	pipeline_buffer_t * buffer =
+	    &pipeline->buffers[sequence % pipeline->num_of_buffers];
+
+	double start = wallTime();
+	consumer(consumer_data, buffer->pixels, buffer->theta, buffer->phi,
+		 buffer->first_sample, buffer->num_of_samples);
+	consume_time += wallTime() - start;
+
+	set_buffer_state(buffer, BUFFER_FREE);
+    }
+
+    pipeline->stats.consume_time = consume_time;
+}
+
+/**********************************************************************/
+
+
+/* Used when there are not enough threads to run the stages
+ * concurrently */
+static void
+run_serially(hpix_pointing_pipeline_t * pipeline,
+	     hpix_pointing_reader_fn_t * reader,
+	     void * reader_data,
+	     hpix_pixel_consumer_fn_t * consumer,
+	     void * consumer_data)
+{
+    pipeline_buffer_t * buffer = &pipeline->buffers[0];
+    hpix_pipeline_stats_t * stats = &pipeline->stats;
+    size_t first_sample = 0;
+
+    for(;;)
+    {
+	double start = wallTime();
+	buffer->num_of_samples = reader(reader_data,
+					buffer->theta, buffer->phi,
+					pipeline->samples_per_buffer);
+	buffer->first_sample = first_sample;
+	double end = wallTime();
+	stats->read_time += end - start;
+	assert(buffer->num_of_samples <= pipeline->samples_per_buffer);
+
+	if(buffer->num_of_samples == 0)
+	    break;
+
+	start = end;
+	convert_buffer(pipeline, buffer);
+	end = wallTime();
+	stats->conversion_time += end - start;
+
+	start = end;
+	consumer(consumer_data, buffer->pixels, buffer->theta, buffer->phi,
+		 buffer->first_sample, buffer->num_of_samples);
+	stats->consume_time += wallTime() - start;
+
+	first_sample += buffer->num_of_samples;
+	stats->num_of_chunks++;
+    }
+
+    stats->num_of_samples = first_sample;
+}
+
+/**********************************************************************/
+
+
+size_t
+hpix_run_pointing_pipeline(hpix_pointing_pipeline_t * pipeline,
+			   hpix_pointing_reader_fn_t * reader,
+			   void * reader_data,
+			   hpix_pixel_consumer_fn_t * consumer,
+			   void * consumer_data)
+{
+    assert(pipeline);
+    assert(reader);
+    assert(consumer);
+
+    pipeline->stats = (hpix_pipeline_stats_t) { .num_of_threads = 1 };
+    pipeline->next_chunk_to_convert = 0;
+    pipeline->num_of_chunks = UNKNOWN_NUM_OF_CHUNKS;
+    for(size_t idx = 0; idx < pipeline->num_of_buffers; ++idx)
+	pipeline->buffers[idx].state = BUFFER_FREE;
+
+    const double start = wallTime();
+
+#ifdef _OPENMP
+    if(omp_get_max_threads() >= MIN_THREADS_FOR_PIPELINING)
+    {
+#pragma omp parallel default(shared)
+	{
+	    const int thread_num = omp_get_thread_num();
+	    const int num_of_threads = omp_get_num_threads();
+
+	    if(num_of_threads < MIN_THREADS_FOR_PIPELINING)
+	    {
+		if(thread_num == 0)
+		    run_serially(pipeline, reader, reader_data,
+				 consumer, consumer_data);
+	    } else {
+		if(thread_num == 0)
+		{
+		    pipeline->stats.num_of_threads = num_of_threads;
+		    run_producer(pipeline, reader, reader_data);
+		} else if(thread_num == 1)
+		    run_consumer(pipeline, consumer, consumer_data);
+		else
+		    run_worker(pipeline);
+	    }
+	}
+
+	if(pipeline->num_of_chunks != UNKNOWN_NUM_OF_CHUNKS)
+	    pipeline->stats.num_of_chunks = pipeline->num_of_chunks;
+    }
+    else
+#endif
+	run_serially(pipeline, reader, reader_data, consumer, consumer_data);
+
+    pipeline->stats.wall_time = wallTime() - start;
+    return pipeline->stats.num_of_samples;
+}
+
+/**********************************************************************/
+
+
+static void
+print_stage_stats(FILE * output_file,
+		  const char * stage_name,
+		  double time,
+		  size_t num_of_samples)
+{
+    fprintf(output_file, "%-12s %10.4f s", stage_name, time);
+    if(time > 0.0)
+	fprintf(output_file, "  %10.3e samples/s", num_of_samples / time);
+    fputc('\n', output_file);
+}
+
+/**********************************************************************/
+
+
+void
+hpix_print_pipeline_stats(FILE * output_file,
+			  const hpix_pipeline_stats_t * stats)
+{
+    assert(output_file);
+    assert(stats);
+
+    fprintf(output_file,
+	    "%zu samples in %zu chunks, %d thread(s)\n",
+	    stats->num_of_samples, stats->num_of_chunks,
+	    stats->num_of_threads);
+    print_stage_stats(output_file, "Reading", stats->read_time,
+		      stats->num_of_samples);
+    print_stage_stats(output_file, "Conversion", stats->conversion_time,
+		      stats->num_of_samples);
+    print_stage_stats(output_file, "Consumption", stats->consume_time,
+		      stats->num_of_samples);
+    print_stage_stats(output_file, "Total", stats->wall_time,
+		      stats->num_of_samples);
+}
@@ -21,6 +21,10 @@
 #include <assert.h>
 #include <math.h>
 
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
 #include "constants.h"
 
 #include "xy2pix.c"
@@ -230,6 +234,16 @@ hpix_ring_pixel_to_angles(const hpix_resolution_t * resolution,
     assert(resolution);
     assert(theta && phi);
 
+    if(resolution->ring_table != NULL)
+    {
+	const hpix_ring_info_t * ring =
+	    &resolution->ring_table[hpix_ring_pixel_to_ring(resolution,
+							    pixel) - 1];
+	*theta = ring->theta;
+	*phi = ring->phi0 + (pixel - ring->first_pixel) * ring->delta_phi;
+	return;
+    }
+
     hpix_nside_t nside = resolution->nside;
     hpix_nside_t nl2 = resolution->nside_times_two;
     hpix_nside_t nl4 = resolution->nside_times_four;
@@ -355,6 +369,19 @@ hpix_ring_pixel_to_vector(const hpix_resolution_t * resolution,
 {
     assert(vector);
 
+    if(resolution->ring_table != NULL)
+    {
+	const hpix_ring_info_t * ring =
+	    &resolution->ring_table[hpix_ring_pixel_to_ring(resolution,
+							    pixel_index) - 1];
+	const double phi =
+	    ring->phi0 + (pixel_index - ring->first_pixel) * ring->delta_phi;
+	vector->x = ring->sin_theta * cos(phi);
+	vector->y = ring->sin_theta * sin(phi);
+	vector->z = ring->z;
+	return;
+    }
+
     double theta, phi;
     hpix_ring_pixel_to_angles(resolution, pixel_index, &theta, &phi);
     hpix_angles_to_vector(theta, phi, vector);
@@ -374,3 +401,185 @@ hpix_nest_pixel_to_vector(const hpix_resolution_t * resolution,
     hpix_nest_pixel_to_angles(resolution, pixel_index, &theta, &phi);
     hpix_angles_to_vector(theta, phi, vector);
 }
+
+/**********************************************************************/
+
+
+/* Number of pixels after which the incremental rotation in
+ * ring_range_to_vectors restarts from an exact value of phi, in
+ * order to avoid the accumulation of roundoff errors */
+#define PHI_RESEED_INTERVAL 64
+
+/* Ranges smaller than this are not split among threads */
+#define MIN_PIXELS_PER_THREAD 4096
+
+static void
+ring_range_to_vectors(const hpix_resolution_t * resolution,
+		      hpix_pixel_num_t first_pixel,
+		      size_t num_of_pixels,
+		      double * x, double * y, double * z)
+{
+    unsigned int ring = hpix_ring_pixel_to_ring(resolution, first_pixel);
+    size_t done = 0;
+
+    while(done < num_of_pixels)
+    {
+	hpix_ring_info_t info;
+	hpix_ring_info(resolution, ring, &info);
+
+	const size_t offset = first_pixel + done - info.first_pixel;
+	size_t count = info.num_of_pixels - offset;
+	if(count > num_of_pixels - done)
+	    count = num_of_pixels - done;
+
+	/* All the pixels in a ring share the same z, and their
+	 * longitudes are evenly spaced: rotate (cos phi, sin phi)
+	 * instead of calling cos and sin for every pixel */
+	const double cos_delta = cos(info.delta_phi);
+	const double sin_delta = sin(info.delta_phi);
+	double cos_phi = 0.0, sin_phi = 0.0;
+
+	for(size_t idx = 0; idx < count; ++idx)
+	{
+	    if(idx % PHI_RESEED_INTERVAL == 0)
+	    {
+		const double phi = info.phi0 + (offset + idx) * info.delta_phi;
+		cos_phi = cos(phi);
+		sin_phi = sin(phi);
+	    }
+
+	    x[done + idx] = info.sin_theta * cos_phi;
+	    y[done + idx] = info.sin_theta * sin_phi;
+	    z[done + idx] = info.z;
+
+	    const double new_cos_phi = cos_phi * cos_delta - sin_phi * sin_delta;
+	    sin_phi = sin_phi * cos_delta + cos_phi * sin_delta;
+	    cos_phi = new_cos_phi;
+	}
+
+	done += count;
+	++ring;
+    }
+}
+
+/**********************************************************************/
+
+
+static void
+ring_range_to_angles(const hpix_resolution_t * resolution,
+		     hpix_pixel_num_t first_pixel,
+		     size_t num_of_pixels,
+		     double * theta, double * phi)
+{
+    unsigned int ring = hpix_ring_pixel_to_ring(resolution, first_pixel);
+    size_t done = 0;
+
+    while(done < num_of_pixels)
+    {
+	hpix_ring_info_t info;
+	hpix_ring_info(resolution, ring, &info);
+
+	const size_t offset = first_pixel + done - info.first_pixel;
+	size_t count = info.num_of_pixels - offset;
+	if(count > num_of_pixels - done)
+	    count = num_of_pixels - done;
+
+	for(size_t idx = 0; idx < count; ++idx)
+	{
+	    theta[done + idx] = info.theta;
+	    phi[done + idx] = info.phi0 + (offset + idx) * info.delta_phi;
+	}
+
+	done += count;
+	++ring;
+    }
+}
+
+/**********************************************************************/
+
+
+void
+hpix_pixel_range_to_vectors(const hpix_resolution_t * resolution,
+			    hpix_ordering_scheme_t scheme,
+			    hpix_pixel_num_t first_pixel,
+			    size_t num_of_pixels,
+			    double * x, double * y, double * z)
+{
+    assert(resolution);
+    assert(x && y && z);
+    assert(first_pixel + num_of_pixels <= resolution->num_of_pixels);
+
+    if(scheme == HPIX_ORDER_SCHEME_NEST)
+    {
+	/* NEST pixels are not laid out on rings, so there is no
+	 * structure to exploit */
+#pragma omp parallel for default(shared) if(num_of_pixels > MIN_PIXELS_PER_THREAD)
+	for(size_t idx = 0; idx < num_of_pixels; ++idx)
+	{
+	    hpix_vector_t vector;
+	    hpix_nest_pixel_to_vector(resolution, first_pixel + idx, &vector);
+	    x[idx] = vector.x;
+	    y[idx] = vector.y;
+	    z[idx] = vector.z;
+	}
+	return;
+    }
+
+#pragma omp parallel default(shared) if(num_of_pixels > MIN_PIXELS_PER_THREAD)
+    {
+#ifdef _OPENMP
+	const size_t thread_num = omp_get_thread_num();
+	const size_t num_of_threads = omp_get_num_threads();
+#else
+	const size_t thread_num = 0;
+	const size_t num_of_threads = 1;
+#endif
+	const size_t start = num_of_pixels * thread_num / num_of_threads;
+	const size_t end = num_of_pixels * (thread_num + 1) / num_of_threads;
+
+	if(end > start)
+	    ring_range_to_vectors(resolution, first_pixel + start, end - start,
+				  x + start, y + start, z + start);
+    }
+}
+
+/**********************************************************************/
+
+
+void
+hpix_pixel_range_to_angles(const hpix_resolution_t * resolution,
+			   hpix_ordering_scheme_t scheme,
+			   hpix_pixel_num_t first_pixel,
+			   size_t num_of_pixels,
+			   double * theta, double * phi)
+{
+    assert(resolution);
+    assert(theta && phi);
+    assert(first_pixel + num_of_pixels <= resolution->num_of_pixels);
+
+    if(scheme == HPIX_ORDER_SCHEME_NEST)
+    {
+#pragma omp parallel for default(shared) if(num_of_pixels > MIN_PIXELS_PER_THREAD)
+	for(size_t idx = 0; idx < num_of_pixels; ++idx)
+	    hpix_nest_pixel_to_angles(resolution, first_pixel + idx,
+				      &theta[idx], &phi[idx]);
+	return;
+    }
+
+#pragma omp parallel default(shared) if(num_of_pixels > MIN_PIXELS_PER_THREAD)
+    {
+#ifdef _OPENMP
+	const size_t thread_num = omp_get_thread_num();
+	const size_t num_of_threads = omp_get_num_threads();
+#else
+	const size_t thread_num = 0;
+	const size_t num_of_threads = 1;
+#endif
+	const size_t start = num_of_pixels * thread_num / num_of_threads;
+	const size_t end = num_of_pixels * (thread_num + 1) / num_of_threads;
+
+	if(end > start)
+	    ring_range_to_angles(resolution, first_pixel + start, end - start,
+				 theta + start, phi + start);
+    }
+}
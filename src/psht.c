@@ -33,9 +33,11 @@
 
 #include <math.h>
 #include "ls_fft.h"
+#include "fftpack.h"
 #include "sse_utils.h"
 #include "ylmgen_c.h"
 #include "psht.h"
+#include "psht_simd.h"
 #include "c_utils.h"
 
 const pshts_cmplx pshts_cmplx_null={0,0};
@@ -50,30 +52,159 @@ static void get_chunk_info (int ndata, int *nchunks, int *chunksize)
   *nchunks = (ndata+*chunksize-1) / *chunksize;
   }
 
+/* Every ringhelper keeps the FFT plans it creates, sorted by length, so
+   that rings with a length seen before (e.g. the polar rings of a HEALPix
+   grid in repeated transforms) do not even copy the twiddle factors from
+   the global cache of ls_fft. The cache stops growing when its plans
+   (including their scratch space) hold more than this many doubles. */
+enum { ringhelper_max_cached_doubles=1<<22 };
+
+/* Maximum number of consecutive ring pairs with the same number of pixels
+   which are Fourier-transformed together. */
+enum { ringhelper_maxbatch=8 };
+
 typedef struct
   {
   double phi0_;
-  pshtd_cmplx *shiftarr, *work;
+  pshtd_cmplx *shiftarr;
+  double *work;
   int s_shift, s_work;
   real_plan plan;
   int norot;
+  real_plan *plans, uncached;
+  int nplans, s_plans;
+  size_t cached_doubles;
   } ringhelper;
 
 static void ringhelper_init (ringhelper *self)
   {
-  static ringhelper rh_null = { 0, NULL, NULL, 0, 0, NULL, 0 };
+  static ringhelper rh_null =
+    { 0, NULL, NULL, 0, 0, NULL, 0, NULL, NULL, 0, 0, 0 };
   *self = rh_null;
   }
 
 static void ringhelper_destroy (ringhelper *self)
   {
-  if (self->plan) kill_real_plan(self->plan);
+  int i;
+  for (i=0; i<self->nplans; ++i)
+    kill_real_plan(self->plans[i]);
+  if (self->uncached) kill_real_plan(self->uncached);
+  DEALLOC(self->plans);
   DEALLOC(self->shiftarr);
   DEALLOC(self->work);
   ringhelper_init(self);
   }
 
-static void ringhelper_update (ringhelper *self, int nph, int mmax, double phi0)
+/* Returns a plan for real FFTs of length nph, taking it from the cache if
+   possible. The plan belongs to the ringhelper. */
+static real_plan ringhelper_get_plan (ringhelper *self, int nph)
+  {
+  int lo=0, hi=self->nplans, i;
+  size_t plan_doubles=(2+2*fftpack_multi_vlen)*(size_t)nph+15;
+  real_plan plan;
+  while (lo<hi)
+    {
+    int mid=(lo+hi)/2;
+    if ((int)self->plans[mid]->length<nph) lo=mid+1; else hi=mid;
+    }
+  if ((lo<self->nplans) && ((int)self->plans[lo]->length==nph))
+    return self->plans[lo];
+  if (self->uncached && ((int)self->uncached->length==nph))
+    return self->uncached;
+
+  plan = make_real_plan(nph);
+  if (self->cached_doubles+plan_doubles>ringhelper_max_cached_doubles)
+    {
+    if (self->uncached) kill_real_plan(self->uncached);
+    return self->uncached=plan;
+    }
+  if (self->nplans==self->s_plans)
+    {
+    real_plan *tmp = RALLOC(real_plan,2*self->s_plans+16);
+    for (i=0; i<self->nplans; ++i)
+      tmp[i] = self->plans[i];
+    DEALLOC(self->plans);
+    self->plans = tmp;
+    self->s_plans = 2*self->s_plans+16;
+    }
+  for (i=self->nplans; i>lo; --i)
+    self->plans[i] = self->plans[i-1];
+  self->plans[lo] = plan;
+  ++self->nplans;
+  self->cached_doubles += plan_doubles;
+  return plan;
+  }
+
+/* Prepares the helper for the FFTs of nrings rings of nph pixels each.
+   The rings are transformed in groups of fftpack_multi_vlen (the last
+   group may be smaller), whose values are interleaved in work. */
+static void ringhelper_update (ringhelper *self, int nph, int nrings)
+  {
+  if ((!self->plan) || (nph!=(int)self->plan->length))
+    self->plan = ringhelper_get_plan(self,nph);
+  GROW(self->work,double,self->s_work,nph*nrings);
+  }
+
+/* Returns the first value of ring i out of nrings in the work array, and
+   the distance between its values in *stride. */
+static double *ringhelper_ring (ringhelper *self, int nph, int nrings, int i,
+  int *stride)
+  {
+  const int vlen=fftpack_multi_vlen;
+  *stride = IMIN(vlen,nrings-(i/vlen)*vlen);
+  return self->work+(ptrdiff_t)(i/vlen)*vlen*nph+i%vlen;
+  }
+
+/* Computes the FFTs of the nrings rings in the work array */
+static void ringhelper_fft (ringhelper *self, int nph, int nrings,
+  int forward)
+  {
+  const int vlen=fftpack_multi_vlen;
+  int i;
+  for (i=0; i<nrings; i+=vlen)
+    {
+    double *work = self->work+(ptrdiff_t)i*nph;
+    if (forward)
+      real_plan_forward_fftpack_multi (self->plan,work,IMIN(vlen,nrings-i));
+    else
+      real_plan_backward_fftpack_multi (self->plan,work,IMIN(vlen,nrings-i));
+    }
+  }
+
+/* The FFTs of the rings only store the coefficients k<=nph/2 of their
+   spectra W, with the layout used by real_plan_forward_fftpack(); the
+   coefficients of a ring are stride values apart. */
+
+/* Adds (re,im) to W[k], ignoring the coefficients with k>nph/2 */
+static void fftpack_add (double *w, ptrdiff_t stride, int nph, int k,
+  double re, double im)
+  {
+  if (k==0)
+    w[0] += re;
+  else if (2*k<nph)
+    { w[(2*k-1)*stride] += re; w[2*k*stride] += im; }
+  else if (2*k==nph)
+    w[(nph-1)*stride] += re;
+  }
+
+/* Returns W[k] for 0<=k<nph */
+static pshtd_cmplx fftpack_get (const double *w, ptrdiff_t stride, int nph,
+  int k)
+  {
+  pshtd_cmplx res;
+  if (k==0)
+    { res.re=w[0]; res.im=0; }
+  else if (2*k<nph)
+    { res.re=w[(2*k-1)*stride]; res.im=w[2*k*stride]; }
+  else if (2*k==nph)
+    { res.re=w[(nph-1)*stride]; res.im=0; }
+  else
+    { res.re=w[(2*(nph-k)-1)*stride]; res.im=-w[2*(nph-k)*stride]; }
+  return res;
+  }
+
+/* Computes the phase shifts for a ring starting at phi0 */
+static void ringhelper_set_phi0 (ringhelper *self, int mmax, double phi0)
   {
   int m;
   self->norot = (fabs(phi0)<1e-14);
@@ -89,13 +220,27 @@ static void ringhelper_update (ringhelper *self, int nph, int mmax, double phi0)
         self->shiftarr[m].im = sin(m*phi0);
         }
       }
-  if (!self->plan) self->plan=make_real_plan(nph);
-  if (nph!=(int)self->plan->length)
+  }
+
+/* Splits the ring pairs [llim;ulim[ in batches of consecutive pairs whose
+   rings have the same number of pixels. On exit, batch i covers the pairs
+   [start[i];start[i+1][; returns the number of batches. start must have
+   room for ulim-llim+1 elements. */
+static int get_ring_batches (const psht_geom_info *ginfo, int llim, int ulim,
+  int *start)
+  {
+  int nbatch=0, ith;
+  for (ith=llim; ith<ulim; ++ith)
     {
-    kill_real_plan(self->plan);
-    self->plan=make_real_plan(nph);
+    const psht_ringpair *first = (nbatch>0) ?
+      &ginfo->pair[start[nbatch-1]] : NULL;
+    const psht_ringpair *cur = &ginfo->pair[ith];
+    if ((nbatch==0) || (ith-start[nbatch-1]>=ringhelper_maxbatch)
+        || (cur->r1.nph!=first->r1.nph) || (cur->r2.nph!=first->r2.nph))
+      start[nbatch++] = ith;
     }
-  GROW(self->work,pshtd_cmplx,self->s_work,nph);
+  start[nbatch] = ulim;
+  return nbatch;
   }
 
 static int ringinfo_compare (const void *xa, const void *xb)
@@ -201,6 +346,146 @@ void psht_destroy_geom_info (psht_geom_info *geom_info)
   DEALLOC (geom_info);
   }
 
+void psht_make_plan (const psht_geom_info *geom_info,
+  const psht_alm_info *alm_info, psht_plan **plan)
+  {
+  int i;
+  psht_plan *res = *plan = RALLOC(psht_plan,1);
+  res->geom_info = geom_info;
+  res->alm_info = alm_info;
+  res->maxspin = Ylmgen_maxspin();
+  for (i=0; i<2; ++i)
+    {
+    int spin;
+    res->norm_l[i] = RALLOC(double *,res->maxspin+1);
+    for (spin=0; spin<=res->maxspin; ++spin)
+      res->norm_l[i][spin] = NULL;
+    }
+  res->generators = NULL;
+  res->nfree = res->nalloc = 0;
+  res->ringhelpers = NULL;
+  res->rh_nfree = res->rh_nalloc = 0;
+  }
+
+void psht_destroy_plan (psht_plan *plan)
+  {
+  int i, spin;
+  for (i=0; i<2; ++i)
+    {
+    for (spin=0; spin<=plan->maxspin; ++spin)
+      DEALLOC(plan->norm_l[i][spin]);
+    DEALLOC(plan->norm_l[i]);
+    }
+  for (i=0; i<plan->nfree; ++i)
+    {
+    Ylmgen_destroy((Ylmgen_C *)plan->generators[i]);
+    DEALLOC(plan->generators[i]);
+    }
+  DEALLOC(plan->generators);
+  for (i=0; i<plan->rh_nfree; ++i)
+    {
+    ringhelper_destroy((ringhelper *)plan->ringhelpers[i]);
+    DEALLOC(plan->ringhelpers[i]);
+    }
+  DEALLOC(plan->ringhelpers);
+  DEALLOC(plan);
+  }
+
+/* Returns the normalisation factors for the given spin, computing them
+   the first time they are requested. The array belongs to the plan. */
+static double *plan_get_norm (psht_plan *plan, int spin, int spinrec)
+  {
+  double *res;
+#pragma omp critical (psht_plan)
+{
+  if (!plan->norm_l[spinrec][spin])
+    plan->norm_l[spinrec][spin] =
+      Ylmgen_get_norm (plan->alm_info->lmax, spin, spinrec);
+  res = plan->norm_l[spinrec][spin];
+}
+  return res;
+  }
+
+/* Adds item to the pool of unused objects in items. Must be called
+   inside the psht_plan critical section. */
+static void pool_put (void ***items, int *nfree, int *nalloc, void *item)
+  {
+  if (*nfree==*nalloc)
+    {
+    int i;
+    void **tmp = RALLOC(void *,2*(*nalloc)+4);
+    for (i=0; i<*nfree; ++i)
+      tmp[i] = (*items)[i];
+    DEALLOC(*items);
+    *items = tmp;
+    *nalloc = 2*(*nalloc)+4;
+    }
+  (*items)[(*nfree)++] = item;
+  }
+
+/* Takes a Y_lm generator from the pool of the plan, creating a new one if
+   all of them are in use. */
+static Ylmgen_C *plan_get_generator (psht_plan *plan, int spinrec)
+  {
+  Ylmgen_C *gen=NULL;
+#pragma omp critical (psht_plan)
+{
+  if (plan->nfree>0)
+    gen = (Ylmgen_C *)plan->generators[--plan->nfree];
+}
+  if (!gen)
+    {
+    gen = RALLOC(Ylmgen_C,1);
+    Ylmgen_init (gen,plan->alm_info->lmax,plan->alm_info->mmax,spinrec,1e-30);
+    }
+  gen->spinrec = spinrec;
+  return gen;
+  }
+
+/* Puts a generator obtained by plan_get_generator() back into the pool. */
+static void plan_release_generator (psht_plan *plan, Ylmgen_C *gen)
+  {
+#pragma omp critical (psht_plan)
+{
+  pool_put (&plan->generators,&plan->nfree,&plan->nalloc,gen);
+}
+  }
+
+/* Takes a ringhelper from the pool of the plan, creating a new one if all
+   of them are in use. Pooled helpers keep their cached FFT plans. */
+static ringhelper *plan_get_ringhelper (psht_plan *plan)
+  {
+  ringhelper *helper=NULL;
+#pragma omp critical (psht_plan)
+{
+  if (plan->rh_nfree>0)
+    helper = (ringhelper *)plan->ringhelpers[--plan->rh_nfree];
+}
+  if (!helper)
+    {
+    helper = RALLOC(ringhelper,1);
+    ringhelper_init(helper);
+    }
+  return helper;
+  }
+
+/* Puts a ringhelper obtained by plan_get_ringhelper() back into the pool. */
+static void plan_release_ringhelper (psht_plan *plan, ringhelper *helper)
+  {
+#pragma omp critical (psht_plan)
+{
+  pool_put (&plan->ringhelpers,&plan->rh_nfree,&plan->rh_nalloc,helper);
+}
+  }
+
+/* Spin-0 a_lm are stored as interleaved real and imaginary parts, both
+   with and without SSE2 */
+#ifdef PLANCK_HAVE_SSE2
+#define ALMTMP_SCALAR(job,i) ((double *)((job)->alm_tmp.v[i]))
+#else
+#define ALMTMP_SCALAR(job,i) ((double *)((job)->alm_tmp.c[i]))
+#endif
+
 #define CONCAT(a,b) a ## b
 
 #define FLT double
@@ -216,3 +501,6 @@ void psht_destroy_geom_info (psht_geom_info *geom_info)
 #undef X
 
 #undef CONCAT
+
+void pshts_set_float_recursion (pshts_joblist *joblist, int flag)
+  { joblist->float_recursion = flag; }
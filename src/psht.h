@@ -113,6 +113,8 @@ typedef struct
   {
   pshtd_job job[psht_maxjobs];
   int njobs;
+  /*! Unused for double precision job lists */
+  int float_recursion;
   } pshtd_joblist;
 
 /*! Type holding all required information about a single precision SHT.
@@ -143,6 +145,8 @@ typedef struct
   {
   pshts_job job[psht_maxjobs];
   int njobs;
+  /*! Set by pshts_set_float_recursion() */
+  int float_recursion;
   } pshts_joblist;
 
 /*! \defgroup almgroup Helpers for calculation of a_lm indices */
@@ -202,6 +206,54 @@ void psht_destroy_geom_info (psht_geom_info *info);
 
 /* \} */
 
+/*! \defgroup plangroup Functions for dealing with transform plans */
+/*! \{ */
+
+/*! Type holding the tables which can be shared by all the transforms
+    using the same map geometry and a_lm structure: the normalisation
+    factors for every spin, a pool of initialised Y_lm generators and a
+    pool of helpers for the ring FFTs, which keep their FFT plans.
+    A plan can be used by several threads at the same time.
+    \note No user serviceable parts inside! */
+typedef struct
+  {
+  const psht_geom_info *geom_info;
+  const psht_alm_info *alm_info;
+  int maxspin;
+  double **norm_l[2];
+  void **generators;
+  int nfree, nalloc;
+  void **ringhelpers;
+  int rh_nfree, rh_nalloc;
+  } psht_plan;
+
+/*! Creates a plan for transforms using \a geom_info as map geometry
+    and \a alm_info as structure of the a_lm coefficients.
+    \param geom_info the map geometry
+    \param alm_info the structure of the a_lm coefficients
+    \param plan will hold a pointer to the newly created data structure
+    \note The plan only stores pointers to \a geom_info and \a alm_info,
+    which must not be de-allocated before the plan. */
+void psht_make_plan (const psht_geom_info *geom_info,
+  const psht_alm_info *alm_info, psht_plan **plan);
+/*! Deallocates the plan \a plan and all the tables it holds. */
+void psht_destroy_plan (psht_plan *plan);
+
+/* \} */
+
+/*! \defgroup simdgroup Functions controlling the vectorised kernels */
+/*! \{ */
+
+/*! Returns the number of rings processed at once by the vectorised
+    kernels used for spin-0 transforms (8 with AVX-512, 4 with AVX2), or 0
+    if this machine only supports the SSE2 or scalar code. */
+int psht_simd_lanes (void);
+/*! Prevents the vectorised kernels from processing more than \a lanes
+    rings at once; 0 disables them. This is mainly useful for testing. */
+void psht_limit_simd_lanes (int lanes);
+
+/* \} */
+
 /*! \defgroup sjoblistgroup Functions for dealing with single precision job lists
 \note All pointers to maps or a_lm that are passed to the job-adding functions
 must not be de-allocated until after the last call of execute_jobs() for
@@ -216,6 +268,12 @@ void pshts_make_joblist (pshts_joblist **joblist);
 void pshts_clear_joblist (pshts_joblist *joblist);
 /*! Deallocates the given joblist object. */
 void pshts_destroy_joblist (pshts_joblist *joblist);
+/*! If \a flag is nonzero, the Y_lm of the spin-0 jobs in \a joblist are
+    computed in single precision, processing twice as many rings at once
+    as the double precision code. The relative accuracy of the results
+    drops to about 1e-6. This has no effect if the job list contains
+    jobs with nonzero spin or if psht_simd_lanes() returns 0. */
+void pshts_set_float_recursion (pshts_joblist *joblist, int flag);
 
 /*! Adds a new scalar alm2map job to \a joblist, which reads data from \a alm
     and writes data to \a map. If \a add_output is 0, \a map will be
@@ -277,6 +335,12 @@ void pshts_add_job_alm2map_deriv1 (pshts_joblist *joblist,
 void pshts_execute_jobs (pshts_joblist *joblist,
   const psht_geom_info *geom_info, const psht_alm_info *alm_info);
 
+/*! Executes the jobs in \a joblist, using the map geometry, the a_lm
+    structure and the precomputed tables stored in \a plan. The result
+    is the same as calling pshts_execute_jobs(), but the set-up cost is
+    paid only once per plan. */
+void pshts_execute_jobs_plan (pshts_joblist *joblist, psht_plan *plan);
+
 /* \} */
 
 /*! \defgroup djoblistgroup Functions for dealing with double precision job lists
@@ -354,6 +418,12 @@ void pshtd_add_job_alm2map_deriv1 (pshtd_joblist *joblist,
 void pshtd_execute_jobs (pshtd_joblist *joblist,
   const psht_geom_info *geom_info, const psht_alm_info *alm_info);
 
+/*! Executes the jobs in \a joblist, using the map geometry, the a_lm
+    structure and the precomputed tables stored in \a plan. The result
+    is the same as calling pshtd_execute_jobs(), but the set-up cost is
+    paid only once per plan. */
+void pshtd_execute_jobs_plan (pshtd_joblist *joblist, psht_plan *plan);
+
 /* \} */
 
 #ifdef __cplusplus
@@ -0,0 +1,332 @@
+/*
+ *  This file is part of libpsht.
+ *
+ *  libpsht is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  libpsht is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with libpsht; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+/*
+ *  libpsht is being developed at the Max-Planck-Institut fuer Astrophysik
+ *  and financially supported by the Deutsches Zentrum fuer Luft- und Raumfahrt
+ *  (DLR).
+ */
+
+/*! \file psht_bench.c
+    Benchmark of libpsht's transforms with machine-readable output.
+
+    This program runs a sweep over the resolutions, maximum multipoles,
+    numbers of threads and job types given on the command line, timing every
+    combination separately (in double precision). Lists are separated by
+    commas, e.g.
+
+      psht_bench -o results.json healpix 0 256,512 1,4,8 alm2map map2alm
+
+    An lmax of 0 stands for 2*nside on HEALPix grids and nphi/2-1 on the
+    other grids. Every transform is repeated (3 times by default, see the
+    -r switch), and the results are written as a JSON document to standard
+    output or to the file given with -o.
+
+    The GFlops rate is derived from a simple model of the operation count
+    (a fixed number of operations per a_lm and ring pair, depending on the
+    job type, plus 2.5 N log2(N) for the FFT of each ring of N pixels),
+    which makes it comparable across library versions and machines, but
+    not an exact count of the floating point instructions.
+
+    Copyright (C) 2013 Maurizio Tomasi
+*/
+
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/time.h>
+#include <sys/resource.h>
+#define PSHT_BENCH_HAVE_RUSAGE
+#endif
+#include "psht.h"
+#include "psht_geomhelpers.h"
+#include "psht_almhelpers.h"
+#include "c_utils.h"
+#include "walltime_c.h"
+
+typedef struct
+  {
+  const char *name;
+  int nmaps, nalms;
+  /* operations per a_lm (of each component) and ring pair */
+  double ops_per_alm;
+  } bench_job;
+
+static const bench_job jobtypes[] = {
+  { "alm2map",        1, 1,  8 },
+  { "map2alm",        1, 1,  8 },
+  { "alm2map_pol",    3, 3, 32 },
+  { "map2alm_pol",    3, 3, 32 },
+  { "alm2map_spin1",  2, 2, 24 },
+  { "map2alm_spin1",  2, 2, 24 },
+  { "alm2map_spin2",  2, 2, 24 },
+  { "map2alm_spin2",  2, 2, 24 },
+  { "alm2map_spin3",  2, 2, 24 },
+  { "map2alm_spin3",  2, 2, 24 },
+  { "alm2map_deriv1", 2, 1, 24 } };
+
+static const bench_job *find_job (const char *name)
+  {
+  size_t i;
+  for (i=0; i<sizeof(jobtypes)/sizeof(jobtypes[0]); ++i)
+    if (strcmp(jobtypes[i].name,name)==0)
+      return &jobtypes[i];
+  UTIL_FAIL("unknown transform type");
+  return NULL;
+  }
+
+static void add_job (pshtd_joblist *joblist, const char *name, double **map,
+  pshtd_cmplx **alm)
+  {
+  if (strcmp(name,"alm2map")==0)
+    pshtd_add_job_alm2map(joblist,alm[0],map[0],0);
+  else if (strcmp(name,"map2alm")==0)
+    pshtd_add_job_map2alm(joblist,map[0],alm[0],0);
+  else if (strcmp(name,"alm2map_pol")==0)
+    pshtd_add_job_alm2map_pol(joblist,alm[0],alm[1],alm[2],
+                              map[0],map[1],map[2],0);
+  else if (strcmp(name,"map2alm_pol")==0)
+    pshtd_add_job_map2alm_pol(joblist,map[0],map[1],map[2],
+                              alm[0],alm[1],alm[2],0);
+  else if (strcmp(name,"alm2map_deriv1")==0)
+    pshtd_add_job_alm2map_deriv1(joblist,alm[0],map[0],map[1],0);
+  else
+    {
+    int spin=name[strlen(name)-1]-'0';
+    if (strncmp(name,"alm2map",7)==0)
+      pshtd_add_job_alm2map_spin(joblist,alm[0],alm[1],map[0],map[1],spin,0);
+    else
+      pshtd_add_job_map2alm_spin(joblist,map[0],map[1],alm[0],alm[1],spin,0);
+    }
+  }
+
+/* Parses a comma-separated list of integers */
+static int parse_list (const char *str, int *list, int maxlen)
+  {
+  int n=0;
+  const char *p=str;
+  while (*p)
+    {
+    char *end;
+    UTIL_ASSERT(n<maxlen,"too many values in list");
+    list[n++]=(int)strtol(p,&end,10);
+    UTIL_ASSERT((end!=p) && ((*end==',') || (*end=='\0')),
+      "malformed list of integers");
+    p = (*end==',') ? end+1 : end;
+    }
+  return n;
+  }
+
+/* Peak resident memory of the process in MB, or -1 if unknown */
+static double max_rss_mb (void)
+  {
+#ifdef PSHT_BENCH_HAVE_RUSAGE
+  struct rusage usage;
+  if (getrusage(RUSAGE_SELF,&usage)==0)
+#ifdef __APPLE__
+    return usage.ru_maxrss/(1024.*1024.);
+#else
+    return usage.ru_maxrss/1024.;
+#endif
+#endif
+  return -1;
+  }
+
+static double fft_ops (const psht_geom_info *ginfo)
+  {
+  double res=0;
+  int i;
+  for (i=0; i<ginfo->npairs; ++i)
+    {
+    int nph1=ginfo->pair[i].r1.nph, nph2=ginfo->pair[i].r2.nph;
+    if (nph1>1) res+=2.5*nph1*log(nph1)/log(2.);
+    if (nph2>1) res+=2.5*nph2*log(nph2)/log(2.);
+    }
+  return res;
+  }
+
+static void make_geometry (const char *type, int res, int lmax,
+  psht_geom_info **ginfo, ptrdiff_t *npix)
+  {
+  if (strcmp(type,"gauss")==0)
+    {
+    *npix=(ptrdiff_t)(lmax+1)*res;
+    psht_make_gauss_geom_info (lmax+1, res, 1, ginfo);
+    }
+  else if (strcmp(type,"ecp")==0)
+    {
+    *npix=(ptrdiff_t)(2*lmax+2)*res;
+    psht_make_ecp_geom_info (2*lmax+2, res, 0., 1, ginfo);
+    }
+  else if (strcmp(type,"healpix")==0)
+    {
+    *npix=12*(ptrdiff_t)res*res;
+    psht_make_healpix_geom_info (res, 1, ginfo);
+    }
+  else
+    UTIL_FAIL("unknown geometry");
+  }
+
+static void run_benchmark (FILE *out, int *first, const char *geometry,
+  int res, int lmax, int nthreads, const bench_job *job, int nrep)
+  {
+  static const pshtd_cmplx one={1,1};
+  psht_geom_info *ginfo;
+  psht_alm_info *ainfo;
+  ptrdiff_t npix=0, nalm, i;
+  double *map[3];
+  pshtd_cmplx *alm[3];
+  double tmin=1e30, tsum=0, ops, data_mb;
+  int rep, m;
+
+#ifdef _OPENMP
+  omp_set_num_threads(nthreads);
+  nthreads=omp_get_max_threads();
+#else
+  UTIL_ASSERT(nthreads==1,"multiple threads need OpenMP support");
+#endif
+
+  make_geometry (geometry, res, lmax, &ginfo, &npix);
+  psht_make_triangular_alm_info(lmax,lmax,1,&ainfo);
+  nalm = ((ptrdiff_t)(lmax+1)*(lmax+2))/2;
+  for (m=0; m<job->nmaps; ++m)
+    {
+    map[m]=RALLOC(double,npix);
+    for (i=0; i<npix; ++i) map[m][i]=1;
+    }
+  for (m=0; m<job->nalms; ++m)
+    {
+    alm[m]=RALLOC(pshtd_cmplx,nalm);
+    SET_ARRAY(alm[m],0,nalm,one);
+    }
+
+  for (rep=0; rep<nrep; ++rep)
+    {
+    pshtd_joblist *joblist;
+    double wtimer, t;
+    pshtd_make_joblist (&joblist);
+    add_job (joblist, job->name, map, alm);
+    wtimer=wallTime();
+    pshtd_execute_jobs (joblist, ginfo, ainfo);
+    t=wallTime()-wtimer;
+    pshtd_destroy_joblist(joblist);
+    tsum+=t;
+    if (t<tmin) tmin=t;
+    }
+
+  ops = job->ops_per_alm*job->nalms*(double)nalm*ginfo->npairs
+      + job->nmaps*fft_ops(ginfo);
+  data_mb = (job->nmaps*npix*sizeof(double)
+           + job->nalms*nalm*sizeof(pshtd_cmplx))/(1024.*1024.);
+  fprintf(stderr,"%s %d, lmax=%d, %s, %d thread(s): %fs\n", geometry, res,
+    lmax, job->name, nthreads, tmin);
+
+  fprintf(out,"%s\n    {\"geometry\": \"%s\", \"%s\": %d, \"lmax\": %d, "
+    "\"job\": \"%s\", \"threads\": %d,\n", (*first) ? "" : ",", geometry,
+    (strcmp(geometry,"healpix")==0) ? "nside" : "nphi", res, lmax,
+    job->name, nthreads);
+  fprintf(out,"     \"npix\": %ld, \"nalm\": %ld, \"repetitions\": %d, "
+    "\"wall_time\": %g, \"wall_time_mean\": %g,\n", (long)npix, (long)nalm,
+    nrep, tmin, tsum/nrep);
+  fprintf(out,"     \"gflops\": %g, \"data_mb\": %g, \"max_rss_mb\": %g}",
+    ops/tmin*1e-9, data_mb, max_rss_mb());
+  fflush(out);
+  *first=0;
+
+  for (m=0; m<job->nmaps; ++m)
+    DEALLOC(map[m]);
+  for (m=0; m<job->nalms; ++m)
+    DEALLOC(alm[m]);
+  psht_destroy_geom_info(ginfo);
+  psht_destroy_alm_info(ainfo);
+  }
+
+int main(int argc, char **argv)
+  {
+  enum { maxlist=64 };
+  int res[maxlist], lmax[maxlist], threads[maxlist];
+  int nres, nlmax, nthreads, ires, ilmax, ithr, m, arg=1, nrep=3, first=1;
+  const char *outname=NULL;
+  FILE *out=stdout;
+
+  while ((arg+1<argc) && (argv[arg][0]=='-'))
+    {
+    if (strcmp(argv[arg],"-o")==0)
+      outname=argv[arg+1];
+    else if (strcmp(argv[arg],"-r")==0)
+      nrep=atoi(argv[arg+1]);
+    else
+      UTIL_FAIL("unknown option");
+    arg+=2;
+    }
+
+  UTIL_ASSERT ((argc-arg>=5) && (nrep>0),
+    "usage: psht_bench [-o <file>] [-r <repetitions>] <healpix|ecp|gauss>\n"
+    "         <lmax list> <nside|nphi list> <threads list> <type>+\n"
+    "  where lists are separated by commas, an lmax of 0 selects a default\n"
+    "  value, and <type> can be 'alm2map', 'map2alm', 'alm2map_pol',\n"
+    "  'map2alm_pol', 'alm2map_spin[1-3]', 'map2alm_spin[1-3]' or\n"
+    "  'alm2map_deriv1'");
+  nlmax=parse_list(argv[arg+1],lmax,maxlist);
+  nres=parse_list(argv[arg+2],res,maxlist);
+  nthreads=parse_list(argv[arg+3],threads,maxlist);
+  for (m=arg+4; m<argc; ++m)
+    find_job(argv[m]);
+
+  if (outname)
+    {
+    out=fopen(outname,"w");
+    UTIL_ASSERT(out,"cannot open output file");
+    }
+
+  fprintf(out,"{\n  \"benchmark\": \"psht_bench\",\n");
+#ifdef PACKAGE_STRING
+  fprintf(out,"  \"package\": \"%s\",\n",PACKAGE_STRING);
+#endif
+#ifdef _OPENMP
+  fprintf(out,"  \"openmp\": true,\n");
+#else
+  fprintf(out,"  \"openmp\": false,\n");
+#endif
+  fprintf(out,"  \"simd_lanes\": %d,\n  \"results\": [",psht_simd_lanes());
+
+  for (ires=0; ires<nres; ++ires)
+    for (ilmax=0; ilmax<nlmax; ++ilmax)
+      {
+      int l=lmax[ilmax];
+      if (l<=0)
+        l = (strcmp(argv[arg],"healpix")==0) ? 2*res[ires] : res[ires]/2-1;
+      for (ithr=0; ithr<nthreads; ++ithr)
+        for (m=arg+4; m<argc; ++m)
+          run_benchmark (out, &first, argv[arg], res[ires], l,
+                         threads[ithr], find_job(argv[m]), nrep);
+      }
+
+  fprintf(out,"\n  ]\n}\n");
+  if (outname)
+    fclose(out);
+
+  return 0;
+  }
@@ -32,88 +32,145 @@
 #define COMPMUL_(a_,b_,c_) \
   { a_.re = b_.re*c_.re - b_.im*c_.im; a_.im = b_.re*c_.im + b_.im*c_.re; }
 
-static void X(ringhelper_phase2ring) (ringhelper *self,
-  const psht_ringinfo *info, FLT *data, int mmax, const pshtd_cmplx *phase)
+/* Synthesises nrings rings with the same number of pixels, adding them to
+   data: ring i is computed from the phases in phase[i]. */
+static void X(ringhelper_phase2rings) (ringhelper *self, int nrings,
+  const psht_ringinfo **info, FLT *data, int mmax, pshtd_cmplx **phase)
   {
-  int m;
-  int nph = info->nph;
-  FLT *ring = data + info->ofs;
-  int stride = info->stride;
+  int i, m, stride;
+  int nph = info[0]->nph;
 
-  ringhelper_update (self, nph, mmax, info->phi0);
-  self->work[0]=phase[0];
-  SET_ARRAY(self->work,1,nph,pshtd_cmplx_null);
+  ringhelper_update (self, nph, nrings);
+  SET_ARRAY(self->work,0,nph*nrings,0.);
+  for (i=0; i<nrings; ++i)
+    {
+    double *work = ringhelper_ring (self, nph, nrings, i, &stride);
+    int idx1 = 1%nph, idx2 = nph-1;
+    ringhelper_set_phi0 (self, mmax, info[i]->phi0);
+    work[0]=phase[i][0].re;
 
-  if (self->norot)
+/* idx1 = m%nph and idx2 = nph-1-((m-1)%nph), updated incrementally */
     for (m=1; m<=mmax; ++m)
       {
-      int idx1 = m%nph;
-      int idx2 = nph-1-((m-1)%nph);
-      self->work[idx1].re += phase[m].re; self->work[idx1].im += phase[m].im;
-      self->work[idx2].re += phase[m].re; self->work[idx2].im -= phase[m].im;
+      pshtd_cmplx tmp = phase[i][m];
+      if (!self->norot)
+        COMPMUL_(tmp,phase[i][m],self->shiftarr[m]);
+      fftpack_add (work,stride,nph,idx1,tmp.re,tmp.im);
+      fftpack_add (work,stride,nph,idx2,tmp.re,-tmp.im);
+      if (++idx1==nph) idx1=0;
+      if (--idx2<0) idx2=nph-1;
       }
-  else
-    for (m=1; m<=mmax; ++m)
-      {
-      int idx1 = m%nph;
-      int idx2 = nph-1-((m-1)%nph);
-      pshtd_cmplx tmp;
-      COMPMUL_(tmp,phase[m],self->shiftarr[m]);
-      self->work[idx1].re += tmp.re; self->work[idx1].im += tmp.im;
-      self->work[idx2].re += tmp.re; self->work[idx2].im -= tmp.im;
-      }
-  real_plan_backward_c (self->plan, &self->work[0].re);
-  for (m=0; m<nph; ++m) ring[m*stride] += (FLT)self->work[m].re;
+    }
+
+  ringhelper_fft (self, nph, nrings, 0);
+
+  for (i=0; i<nrings; ++i)
+    {
+    const double *work = ringhelper_ring (self, nph, nrings, i, &stride);
+    FLT *ring = data + info[i]->ofs;
+    int rstride = info[i]->stride;
+    for (m=0; m<nph; ++m) ring[m*rstride] += (FLT)work[m*stride];
+    }
   }
 
-static void X(ringhelper_ring2phase) (ringhelper *self,
-  const psht_ringinfo *info, const FLT *data, int mmax, pshtd_cmplx *phase)
+/* Computes the phases of nrings rings with the same number of pixels,
+   storing those of ring i in phase[i]. */
+static void X(ringhelper_rings2phase) (ringhelper *self, int nrings,
+  const psht_ringinfo **info, const FLT *data, int mmax, pshtd_cmplx **phase)
   {
-  int m;
-  int nph = info->nph;
+  int i, m, stride;
+  int nph = info[0]->nph;
   int maxidx = IMIN(nph-1,mmax);
 /* Enable this for traditional Healpix compatibility */
 #if 1
   maxidx = mmax;
 #endif
 
-  ringhelper_update (self, nph, mmax, -info->phi0);
-  for (m=0; m<nph; ++m)
+  ringhelper_update (self, nph, nrings);
+  for (i=0; i<nrings; ++i)
     {
-    self->work[m].re = data[info->ofs+m*info->stride]*info->weight;
-    self->work[m].im = 0;
+    double *work = ringhelper_ring (self, nph, nrings, i, &stride);
+    for (m=0; m<nph; ++m)
+      work[m*stride] = data[info[i]->ofs+m*info[i]->stride]*info[i]->weight;
     }
 
-  real_plan_forward_c (self->plan, &self->work[0].re);
+  ringhelper_fft (self, nph, nrings, 1);
 
-  if (self->norot)
-    for (m=0; m<=maxidx; ++m)
-      phase[m] = self->work[m%nph];
-  else
+  for (i=0; i<nrings; ++i)
+    {
+    const double *work = ringhelper_ring (self, nph, nrings, i, &stride);
+    int idx=0;
+    ringhelper_set_phi0 (self, mmax, -info[i]->phi0);
     for (m=0; m<=maxidx; ++m)
-      COMPMUL_(phase[m],self->work[m%nph],self->shiftarr[m]);
+      {
+      pshtd_cmplx tmp = fftpack_get (work,stride,nph,idx);
+      if (self->norot)
+        phase[i][m] = tmp;
+      else
+        COMPMUL_(phase[i][m],tmp,self->shiftarr[m]);
+      if (++idx==nph) idx=0;
+      }
+    SET_ARRAY(phase[i],maxidx+1,mmax+1,pshtd_cmplx_null);
+    }
+  }
 
-  SET_ARRAY(phase,maxidx+1,mmax+1,pshtd_cmplx_null);
+/* Collects the rings of npairs consecutive ring pairs whose rings have the
+   same number of pixels, together with the phase arrays (phase1 and phase2
+   hold the phases of the first pair, the following ones are mmax+1 entries
+   apart). Returns the number of rings stored in info and phase: if the
+   northern and southern rings have different lengths, they are stored in
+   two groups, the second of which starts at *nsplit. */
+static int X(collect_rings) (int npairs, const psht_ringpair *pair, int mmax,
+  pshtd_cmplx *phase1, pshtd_cmplx *phase2, const psht_ringinfo **info,
+  pshtd_cmplx **phase, int *nsplit)
+  {
+  int ip, n=0;
+  for (ip=0; ip<npairs; ++ip)
+    if (pair[ip].r1.nph>0)
+      { info[n]=&pair[ip].r1; phase[n++]=phase1+(ptrdiff_t)ip*(mmax+1); }
+  *nsplit = ((n>0) && (pair[0].r2.nph!=pair[0].r1.nph)) ? n : 0;
+  for (ip=0; ip<npairs; ++ip)
+    if (pair[ip].r2.nph>0)
+      { info[n]=&pair[ip].r2; phase[n++]=phase2+(ptrdiff_t)ip*(mmax+1); }
+  return n;
   }
 
-static void X(ringhelper_pair2phase) (ringhelper *self, int mmax,
-  const psht_ringpair *pair, const FLT *data,
+static void X(ringhelper_pairs2phase) (ringhelper *self, int mmax,
+  int npairs, const psht_ringpair *pair, const FLT *data,
   pshtd_cmplx *phase1, pshtd_cmplx *phase2)
   {
-  if (pair->r1.nph>0)
-    X(ringhelper_ring2phase) (self, &(pair->r1), data, mmax, phase1);
-  if (pair->r2.nph>0)
-    X(ringhelper_ring2phase) (self, &(pair->r2), data, mmax, phase2);
+  const psht_ringinfo *info[2*ringhelper_maxbatch];
+  pshtd_cmplx *phase[2*ringhelper_maxbatch];
+  int nsplit, n = X(collect_rings) (npairs,pair,mmax,phase1,phase2,info,
+    phase,&nsplit);
+  if (nsplit>0)
+    {
+    X(ringhelper_rings2phase) (self,nsplit,info,data,mmax,phase);
+    if (n>nsplit)
+      X(ringhelper_rings2phase) (self,n-nsplit,info+nsplit,data,mmax,
+        phase+nsplit);
+    }
+  else if (n>0)
+    X(ringhelper_rings2phase) (self,n,info,data,mmax,phase);
   }
 
-static void X(ringhelper_phase2pair) (ringhelper *self, int mmax,
-  const pshtd_cmplx *phase1, const pshtd_cmplx *phase2,
+static void X(ringhelper_phase2pairs) (ringhelper *self, int mmax,
+  int npairs, pshtd_cmplx *phase1, pshtd_cmplx *phase2,
   const psht_ringpair *pair, FLT *data)
   {
-  if (pair->r1.nph>0)
-    X(ringhelper_phase2ring) (self, &(pair->r1), data, mmax, phase1);
-  if (pair->r2.nph>0)
-    X(ringhelper_phase2ring) (self, &(pair->r2), data, mmax, phase2);
+  const psht_ringinfo *info[2*ringhelper_maxbatch];
+  pshtd_cmplx *phase[2*ringhelper_maxbatch];
+  int nsplit, n = X(collect_rings) (npairs,pair,mmax,phase1,phase2,info,
+    phase,&nsplit);
+  if (nsplit>0)
+    {
+    X(ringhelper_phase2rings) (self,nsplit,info,data,mmax,phase);
+    if (n>nsplit)
+      X(ringhelper_phase2rings) (self,n-nsplit,info+nsplit,data,mmax,
+        phase+nsplit);
+    }
+  else if (n>0)
+    X(ringhelper_phase2rings) (self,n,info,data,mmax,phase);
   }
 
 
@@ -189,17 +246,23 @@ static void X(dealloc_phase) (X(joblist) *jobs)
   }
 
 static void X(map2phase) (X(joblist) *jobs, const psht_geom_info *ginfo,
-  int mmax, int llim, int ulim)
+  int mmax, int llim, int ulim, psht_plan *plan)
   {
+  int *start = RALLOC(int,ulim-llim+1);
+  int nbatch = get_ring_batches (ginfo, llim, ulim, start);
 #pragma omp parallel
 {
-  ringhelper helper;
-  int ith;
-  ringhelper_init(&helper);
+  ringhelper local_helper, *helper=&local_helper;
+  int ibatch;
+  if (plan)
+    helper = plan_get_ringhelper(plan);
+  else
+    ringhelper_init(helper);
 #pragma omp for schedule(dynamic,1)
-  for (ith=llim; ith<ulim; ++ith)
+  for (ibatch=0; ibatch<nbatch; ++ibatch)
     {
     int ijob,i;
+    int ith = start[ibatch], npairs = start[ibatch+1]-ith;
     int dim2 = (ith-llim)*(mmax+1);
     for (ijob=0; ijob<jobs->njobs; ++ijob)
       {
@@ -208,7 +271,7 @@ static void X(map2phase) (X(joblist) *jobs, const psht_geom_info *ginfo,
         {
         case MAP2ALM:
           for (i=0; i<curjob->nmaps; ++i)
-            X(ringhelper_pair2phase)(&helper,mmax,&ginfo->pair[ith],
+            X(ringhelper_pairs2phase)(helper,mmax,npairs,&ginfo->pair[ith],
               curjob->map[i], &curjob->phas1[i][dim2], &curjob->phas2[i][dim2]);
           break;
         default:
@@ -216,8 +279,12 @@ static void X(map2phase) (X(joblist) *jobs, const psht_geom_info *ginfo,
         }
       }
     }
-    ringhelper_destroy(&helper);
+  if (plan)
+    plan_release_ringhelper(plan,helper);
+  else
+    ringhelper_destroy(helper);
 } /* end of parallel region */
+  DEALLOC(start);
   }
 
 static void X(alloc_almtmp) (X(joblist) *jobs, int lmax)
@@ -901,17 +968,23 @@ static void X(almtmp2alm) (X(joblist) *jobs, int lmax, int m,
   }
 
 static void X(phase2map) (X(joblist) *jobs, const psht_geom_info *ginfo,
-  int mmax, int llim, int ulim)
+  int mmax, int llim, int ulim, psht_plan *plan)
   {
+  int *start = RALLOC(int,ulim-llim+1);
+  int nbatch = get_ring_batches (ginfo, llim, ulim, start);
 #pragma omp parallel
 {
-  ringhelper helper;
-  int ith;
-  ringhelper_init(&helper);
+  ringhelper local_helper, *helper=&local_helper;
+  int ibatch;
+  if (plan)
+    helper = plan_get_ringhelper(plan);
+  else
+    ringhelper_init(helper);
 #pragma omp for schedule(dynamic,1)
-  for (ith=llim; ith<ulim; ++ith)
+  for (ibatch=0; ibatch<nbatch; ++ibatch)
     {
     int ijob,i;
+    int ith = start[ibatch], npairs = start[ibatch+1]-ith;
     int dim2 = (ith-llim)*(mmax+1);
     for (ijob=0; ijob<jobs->njobs; ++ijob)
       {
@@ -921,29 +994,233 @@ static void X(phase2map) (X(joblist) *jobs, const psht_geom_info *ginfo,
         case ALM2MAP:
         case ALM2MAP_DERIV1:
           for (i=0; i<curjob->nmaps; ++i)
-            X(ringhelper_phase2pair)(&helper,mmax,&curjob->phas1[i][dim2],
-              &curjob->phas2[i][dim2],&ginfo->pair[ith],curjob->map[i]);
+            X(ringhelper_phase2pairs)(helper,mmax,npairs,
+              &curjob->phas1[i][dim2],&curjob->phas2[i][dim2],
+              &ginfo->pair[ith],curjob->map[i]);
           break;
         default:
           break;
         }
       }
     }
-  ringhelper_destroy(&helper);
+  if (plan)
+    plan_release_ringhelper(plan,helper);
+  else
+    ringhelper_destroy(helper);
 } /* end of parallel region */
+  DEALLOC(start);
   }
 
-void X(execute_jobs) (X(joblist) *joblist, const psht_geom_info *geom_info,
-  const psht_alm_info *alm_info)
+/* Returns the number of rings that can be processed at once by the
+   vectorised kernels, or 0 if the job list contains jobs they do not
+   support. */
+static int X(simd_lanes) (const X(joblist) *jobs)
+  {
+  int ijob;
+  for (ijob=0; ijob<jobs->njobs; ++ijob)
+    if ((jobs->job[ijob].spin!=0) ||
+        ((jobs->job[ijob].type!=ALM2MAP) && (jobs->job[ijob].type!=MAP2ALM)))
+      return 0;
+  return psht_simd_lanes();
+  }
+
+/* Version of inner_loop() for spin-0 jobs, which processes \a lanes rings
+   at once using the kernels in psht_simd.c */
+static void X(inner_loop_wide) (X(joblist) *jobs, const psht_geom_info *ginfo,
+  int lmax, int mmax, int llim, int ulim, Ylmgen_C *generator, int m,
+  int lanes, double *ylm)
+  {
+  int ith,ijob,lane;
+  for (ith=0; ith<ulim-llim; ith+=lanes)
+    {
+    double cth[psht_simd_maxlanes], lam_1[psht_simd_maxlanes],
+      lam_2[psht_simd_maxlanes], state_1[psht_simd_maxlanes],
+      state_2[psht_simd_maxlanes], res[4*psht_simd_maxlanes];
+    int firstl[psht_simd_maxlanes];
+    int nth = IMIN(lanes,ulim-llim-ith), lstart=lmax+1, l;
+
+    for (lane=0; lane<lanes; ++lane)
+      {
+      firstl[lane] = lmax+1;
+      cth[lane] = state_1[lane] = state_2[lane] = 0.;
+      if (lane<nth)
+        {
+        Ylmgen_prepare(generator,ith+lane,m);
+        firstl[lane] = Ylmgen_get_first_Ylm(generator,&lam_1[lane],
+          &lam_2[lane]);
+        cth[lane] = generator->cth[ith+lane];
+        lstart = IMIN(lstart,firstl[lane]);
+        }
+      }
+
+/* Rings join the recursion when their first non-negligible Y_lm is
+   reached; until then, their Y_lm are zero. */
+    for (l=lstart; l<=lmax;)
+      {
+      int lnext=lmax+1;
+      for (lane=0; lane<nth; ++lane)
+        {
+        if (firstl[lane]==l)
+          { state_1[lane]=lam_1[lane]; state_2[lane]=lam_2[lane]; }
+        else if (firstl[lane]>l)
+          lnext = IMIN(lnext,firstl[lane]);
+        }
+      psht_simd_ylm_recursion(lanes,l,lnext-1,cth,state_1,state_2,
+        generator->recfac,ylm+(ptrdiff_t)(l-lstart)*lanes);
+      l=lnext;
+      }
+
+    for (ijob=0; ijob<jobs->njobs; ++ijob)
+      {
+      X(job) *curjob = &jobs->job[ijob];
+      if (curjob->type==ALM2MAP)
+        {
+        if (lstart<=lmax)
+          psht_simd_alm2map(lanes,m,lstart,lmax,ylm,ALMTMP_SCALAR(curjob,0),
+            res);
+        else
+          SET_ARRAY(res,0,4*lanes,0.);
+        for (lane=0; lane<nth; ++lane)
+          {
+          int phas_idx = (ith+lane)*(mmax+1)+m;
+          double p1re=res[lane], p1im=res[lanes+lane],
+                 p2re=res[2*lanes+lane], p2im=res[3*lanes+lane];
+          curjob->phas1[0][phas_idx].re = p1re+p2re;
+          curjob->phas1[0][phas_idx].im = p1im+p2im;
+          if (ginfo->pair[ith+lane+llim].r2.nph>0)
+            {
+            curjob->phas2[0][phas_idx].re = p1re-p2re;
+            curjob->phas2[0][phas_idx].im = p1im-p2im;
+            }
+          }
+        }
+      else if (lstart<=lmax)
+        {
+        SET_ARRAY(res,0,4*lanes,0.);
+        for (lane=0; lane<nth; ++lane)
+          {
+          int phas_idx = (ith+lane)*(mmax+1)+m;
+          pshtd_cmplx ph1 = curjob->phas1[0][phas_idx],
+            ph2 = (ginfo->pair[ith+lane+llim].r2.nph>0) ?
+              curjob->phas2[0][phas_idx] : pshtd_cmplx_null;
+          res[lane] = ph1.re+ph2.re;
+          res[lanes+lane] = ph1.im+ph2.im;
+          res[2*lanes+lane] = ph1.re-ph2.re;
+          res[3*lanes+lane] = ph1.im-ph2.im;
+          }
+        psht_simd_map2alm(lanes,m,lstart,lmax,ylm,res,
+          ALMTMP_SCALAR(curjob,0));
+        }
+      }
+    }
+  }
+
+/* Same as inner_loop_wide(), but runs the Y_lm recursion and the sums over
+   l in single precision */
+static void X(inner_loop_wide_float) (X(joblist) *jobs,
+  const psht_geom_info *ginfo, int lmax, int mmax, int llim, int ulim,
+  Ylmgen_C *generator, int m, int lanes, float *ylm)
+  {
+  int ith,ijob,lane;
+  for (ith=0; ith<ulim-llim; ith+=lanes)
+    {
+    float cth[psht_simd_maxlanes_f], lam_1[psht_simd_maxlanes_f],
+      lam_2[psht_simd_maxlanes_f], state_1[psht_simd_maxlanes_f],
+      state_2[psht_simd_maxlanes_f], res[4*psht_simd_maxlanes_f];
+    int firstl[psht_simd_maxlanes_f];
+    int nth = IMIN(lanes,ulim-llim-ith), lstart=lmax+1, l;
+
+    for (lane=0; lane<lanes; ++lane)
+      {
+      firstl[lane] = lmax+1;
+      cth[lane] = state_1[lane] = state_2[lane] = 0.f;
+      if (lane<nth)
+        {
+        Ylmgen_prepare(generator,ith+lane,m);
+        firstl[lane] = Ylmgen_get_first_Ylm_float(generator,&lam_1[lane],
+          &lam_2[lane]);
+        cth[lane] = (float)generator->cth[ith+lane];
+        lstart = IMIN(lstart,firstl[lane]);
+        }
+      }
+
+    for (l=lstart; l<=lmax;)
+      {
+      int lnext=lmax+1;
+      for (lane=0; lane<nth; ++lane)
+        {
+        if (firstl[lane]==l)
+          { state_1[lane]=lam_1[lane]; state_2[lane]=lam_2[lane]; }
+        else if (firstl[lane]>l)
+          lnext = IMIN(lnext,firstl[lane]);
+        }
+      psht_simd_ylm_recursion_f(lanes,l,lnext-1,cth,state_1,state_2,
+        generator->recfac_f,ylm+(ptrdiff_t)(l-lstart)*lanes);
+      l=lnext;
+      }
+
+    for (ijob=0; ijob<jobs->njobs; ++ijob)
+      {
+      X(job) *curjob = &jobs->job[ijob];
+      if (curjob->type==ALM2MAP)
+        {
+        if (lstart<=lmax)
+          psht_simd_alm2map_f(lanes,m,lstart,lmax,ylm,
+            ALMTMP_SCALAR(curjob,0),res);
+        else
+          SET_ARRAY(res,0,4*lanes,0.f);
+        for (lane=0; lane<nth; ++lane)
+          {
+          int phas_idx = (ith+lane)*(mmax+1)+m;
+          double p1re=res[lane], p1im=res[lanes+lane],
+                 p2re=res[2*lanes+lane], p2im=res[3*lanes+lane];
+          curjob->phas1[0][phas_idx].re = p1re+p2re;
+          curjob->phas1[0][phas_idx].im = p1im+p2im;
+          if (ginfo->pair[ith+lane+llim].r2.nph>0)
+            {
+            curjob->phas2[0][phas_idx].re = p1re-p2re;
+            curjob->phas2[0][phas_idx].im = p1im-p2im;
+            }
+          }
+        }
+      else if (lstart<=lmax)
+        {
+        SET_ARRAY(res,0,4*lanes,0.f);
+        for (lane=0; lane<nth; ++lane)
+          {
+          int phas_idx = (ith+lane)*(mmax+1)+m;
+          pshtd_cmplx ph1 = curjob->phas1[0][phas_idx],
+            ph2 = (ginfo->pair[ith+lane+llim].r2.nph>0) ?
+              curjob->phas2[0][phas_idx] : pshtd_cmplx_null;
+          res[lane] = (float)(ph1.re+ph2.re);
+          res[lanes+lane] = (float)(ph1.im+ph2.im);
+          res[2*lanes+lane] = (float)(ph1.re-ph2.re);
+          res[3*lanes+lane] = (float)(ph1.im-ph2.im);
+          }
+        psht_simd_map2alm_f(lanes,m,lstart,lmax,ylm,res,
+          ALMTMP_SCALAR(curjob,0));
+        }
+      }
+    }
+  }
+
+/* If plan is not NULL, the normalisation factors and the Y_lm generators are
+   taken from it instead of being computed from scratch. */
+static void X(execute_jobs_internal) (X(joblist) *joblist,
+  const psht_geom_info *geom_info, const psht_alm_info *alm_info,
+  psht_plan *plan)
   {
   int lmax = alm_info->lmax, mmax = alm_info->mmax;
   int nchunks, chunksize, chunk, spinrec=0, ijob;
+  int lanes = X(simd_lanes) (joblist);
+  int flanes = joblist->float_recursion ? 2*lanes : 0;
 
   for (ijob=0; ijob<joblist->njobs; ++ijob)
     if (joblist->job[ijob].spin<=1) { spinrec=1; break; }
 
   for (ijob=0; ijob<joblist->njobs; ++ijob)
-    joblist->job[ijob].norm_l =
+    joblist->job[ijob].norm_l = plan ?
+      plan_get_norm (plan, joblist->job[ijob].spin, spinrec) :
       Ylmgen_get_norm (lmax, joblist->job[ijob].spin, spinrec);
 
 /* clear output arrays if requested */
@@ -958,20 +1235,29 @@ void X(execute_jobs) (X(joblist) *joblist, const psht_geom_info *geom_info,
     int llim=chunk*chunksize, ulim=IMIN(llim+chunksize,geom_info->npairs);
 
 /* map->phase where necessary */
-    X(map2phase) (joblist, geom_info, mmax, llim, ulim);
+    X(map2phase) (joblist, geom_info, mmax, llim, ulim, plan);
 
 #pragma omp parallel
 {
     int m;
     X(joblist) ljobs = *joblist;
-    Ylmgen_C generator;
+    Ylmgen_C generator, *gen=&generator;
+    double *ylm=NULL;
+    float *ylm_f=NULL;
     double *theta = RALLOC(double,ulim-llim);
     for (m=0; m<ulim-llim; ++m)
       theta[m] = geom_info->pair[m+llim].r1.theta;
-    Ylmgen_init (&generator,lmax,mmax,spinrec,1e-30);
-    Ylmgen_set_theta (&generator,theta,ulim-llim);
+    if (plan)
+      gen = plan_get_generator (plan,spinrec);
+    else
+      Ylmgen_init (gen,lmax,mmax,spinrec,1e-30);
+    Ylmgen_set_theta (gen,theta,ulim-llim);
     DEALLOC(theta);
     X(alloc_almtmp)(&ljobs,lmax);
+    if (flanes>0)
+      ylm_f = RALLOC(float,(lmax+1)*flanes);
+    else if (lanes>0)
+      ylm = RALLOC(double,(lmax+1)*lanes);
 
 #pragma omp for schedule(dynamic,1)
     for (m=0; m<=mmax; ++m)
@@ -980,29 +1266,56 @@ void X(execute_jobs) (X(joblist) *joblist, const psht_geom_info *geom_info,
       X(alm2almtmp) (&ljobs, lmax, m, alm_info);
 
 /* inner conversion loop */
-      X(inner_loop) (&ljobs, geom_info, lmax, mmax, llim, ulim, &generator, m);
+      if (flanes>0)
+        X(inner_loop_wide_float) (&ljobs, geom_info, lmax, mmax, llim, ulim,
+          gen, m, flanes, ylm_f);
+      else if (lanes>0)
+        X(inner_loop_wide) (&ljobs, geom_info, lmax, mmax, llim, ulim, gen, m,
+          lanes, ylm);
+      else
+        X(inner_loop) (&ljobs, geom_info, lmax, mmax, llim, ulim, gen, m);
 
 /* alm_tmp->alm where necessary */
       X(almtmp2alm) (&ljobs, lmax, m, alm_info);
       }
 
-    Ylmgen_destroy(&generator);
+    if (plan)
+      plan_release_generator (plan,gen);
+    else
+      Ylmgen_destroy(gen);
     X(dealloc_almtmp)(&ljobs);
+    DEALLOC(ylm);
+    DEALLOC(ylm_f);
 } /* end of parallel region */
 
 /* phase->map where necessary */
-    X(phase2map) (joblist, geom_info, mmax, llim, ulim);
+    X(phase2map) (joblist, geom_info, mmax, llim, ulim, plan);
     } /* end of chunk loop */
 
   for (ijob=0; ijob<joblist->njobs; ++ijob)
-    DEALLOC(joblist->job[ijob].norm_l);
+    {
+    if (plan)
+      joblist->job[ijob].norm_l = NULL;
+    else
+      DEALLOC(joblist->job[ijob].norm_l);
+    }
   X(dealloc_phase) (joblist);
   }
 
+void X(execute_jobs) (X(joblist) *joblist, const psht_geom_info *geom_info,
+  const psht_alm_info *alm_info)
+  { X(execute_jobs_internal) (joblist, geom_info, alm_info, NULL); }
+
+void X(execute_jobs_plan) (X(joblist) *joblist, psht_plan *plan)
+  {
+  X(execute_jobs_internal) (joblist, plan->geom_info, plan->alm_info, plan);
+  }
+
 void X(make_joblist) (X(joblist) **joblist)
   {
   *joblist = RALLOC(X(joblist),1);
   (*joblist)->njobs=0;
+  (*joblist)->float_recursion=0;
   }
 
 void X(clear_joblist) (X(joblist) *joblist)
@@ -90,7 +90,8 @@ int main(int argc, char **argv)
     "usage: psht_perftest <healpix|ecp|gauss> <lmax> <nside|nphi> <type>+\n"
     "  where <type> can be 'alm2map', 'map2alm', 'alm2map_pol',\n"
     "  'map2alm_pol', 'alm2map_spin[1-3]', 'map2alm_spin[1-3]',\n"
-    "  or 'alm2map_deriv1'");
+    "  'alm2map_deriv1', or 'float_recursion' (which enables the\n"
+    "  single precision Y_lm recursion)");
   lmax=atoi(argv[2]);
 
   if (strcmp(argv[1],"gauss")==0)
@@ -187,8 +188,8 @@ int main(int argc, char **argv)
     else if (strcmp(argv[m],"alm2map_spin3")==0)
       {
       prepare_job ("alm2map_spin3",map,alm,npix,nalm,ofs_m,ofs_a,2,2);
-      pshts_add_job_map2alm_spin(joblist,map[ofs_m],map[ofs_m+1],
-                                 alm[ofs_a],alm[ofs_a+1],3,0);
+      pshts_add_job_alm2map_spin(joblist,alm[ofs_a],alm[ofs_a+1],
+                                 map[ofs_m],map[ofs_m+1],3,0);
       ofs_m+=2; ofs_a+=2;
       }
     else if (strcmp(argv[m],"map2alm_spin3")==0)
@@ -205,6 +206,8 @@ int main(int argc, char **argv)
                                    map[ofs_m+1],0);
       ofs_m+=2; ofs_a+=1;
       }
+    else if (strcmp(argv[m],"float_recursion")==0)
+      pshts_set_float_recursion(joblist,1);
     else
       UTIL_FAIL("unknown transform type");
     }
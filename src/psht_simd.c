@@ -0,0 +1,219 @@
+/*
+ *  This file is part of libpsht.
+ *
+ *  libpsht is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  libpsht is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with libpsht; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+/*
+ *  libpsht is being developed at the Max-Planck-Institut fuer Astrophysik
+ *  and financially supported by the Deutsches Zentrum fuer Luft- und Raumfahrt
+ *  (DLR).
+ */
+
+/*! \file psht_simd.c
+ *  Vectorised kernels for spin-0 transforms, with run-time selection of
+ *  the instruction set
+ *
+ *  Copyright (C) 2013 Maurizio Tomasi
+ */
+
+#include "config.h"
+
+#include <string.h>
+#include <stddef.h>
+#include "psht.h"
+#include "psht_simd.h"
+#include "c_utils.h"
+
+/* The kernels use GCC vector extensions and per-function target
+   attributes, so that they can be compiled without enabling AVX for the
+   whole library. Which one is used is decided at run time. */
+#if (defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__)) \
+     && !defined(PLANCK_DISABLE_SSE))
+#define PSHT_HAVE_WIDE_KERNELS
+#endif
+
+#ifdef PSHT_HAVE_WIDE_KERNELS
+
+#define CONCAT(a,b) a ## b
+
+#define KREAL double
+#define KRECFAC ylmgen_dbl2
+
+#define VLEN 4
+#define K(arg) CONCAT(avx2_,arg)
+#define KERNEL_TARGET __attribute__ ((target ("avx2,fma")))
+#include "psht_simd_inc.c"
+#undef VLEN
+#undef K
+#undef KERNEL_TARGET
+
+#define VLEN 8
+#define K(arg) CONCAT(avx512_,arg)
+#define KERNEL_TARGET __attribute__ ((target ("avx512f")))
+#include "psht_simd_inc.c"
+#undef VLEN
+#undef K
+#undef KERNEL_TARGET
+
+#undef KREAL
+#undef KRECFAC
+
+/* Single precision kernels fit twice as many rings in a vector */
+#define KREAL float
+#define KRECFAC ylmgen_flt2
+
+#define VLEN 8
+#define K(arg) CONCAT(avx2f_,arg)
+#define KERNEL_TARGET __attribute__ ((target ("avx2,fma")))
+#include "psht_simd_inc.c"
+#undef VLEN
+#undef K
+#undef KERNEL_TARGET
+
+#define VLEN 16
+#define K(arg) CONCAT(avx512f_,arg)
+#define KERNEL_TARGET __attribute__ ((target ("avx512f")))
+#include "psht_simd_inc.c"
+#undef VLEN
+#undef K
+#undef KERNEL_TARGET
+
+#undef KREAL
+#undef KRECFAC
+
+static int detect_lanes (void)
+  {
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx512f"))
+    return 8;
+  if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+    return 4;
+  return 0;
+  }
+
+#else
+
+static int detect_lanes (void)
+  { return 0; }
+
+#endif
+
+static int detected_lanes=-1, max_lanes=psht_simd_maxlanes;
+
+int psht_simd_lanes (void)
+  {
+  int res;
+#pragma omp critical (psht_simd)
+{
+  if (detected_lanes<0)
+    detected_lanes = detect_lanes();
+  res = IMIN(detected_lanes,max_lanes);
+  /* only widths for which a kernel exists */
+  if (res<4) res=0;
+  else if (res<8) res=4;
+}
+  return res;
+  }
+
+void psht_limit_simd_lanes (int lanes)
+  {
+#pragma omp critical (psht_simd)
+  max_lanes = lanes;
+  }
+
+void psht_simd_ylm_recursion (int lanes, int lstart, int lend,
+  const double *cth, double *lam_1, double *lam_2, const ylmgen_dbl2 *recfac,
+  double *ylm)
+  {
+#ifdef PSHT_HAVE_WIDE_KERNELS
+  switch (lanes)
+    {
+    case 4:
+      avx2_ylm_recursion(lstart,lend,cth,lam_1,lam_2,recfac,ylm); return;
+    case 8:
+      avx512_ylm_recursion(lstart,lend,cth,lam_1,lam_2,recfac,ylm); return;
+    }
+#endif
+  UTIL_FAIL("unsupported number of SIMD lanes");
+  }
+
+void psht_simd_alm2map (int lanes, int m, int lstart, int lmax,
+  const double *ylm, const double *alm, double *res)
+  {
+#ifdef PSHT_HAVE_WIDE_KERNELS
+  switch (lanes)
+    {
+    case 4: avx2_alm2map(m,lstart,lmax,ylm,alm,res); return;
+    case 8: avx512_alm2map(m,lstart,lmax,ylm,alm,res); return;
+    }
+#endif
+  UTIL_FAIL("unsupported number of SIMD lanes");
+  }
+
+void psht_simd_map2alm (int lanes, int m, int lstart, int lmax,
+  const double *ylm, const double *res, double *alm)
+  {
+#ifdef PSHT_HAVE_WIDE_KERNELS
+  switch (lanes)
+    {
+    case 4: avx2_map2alm(m,lstart,lmax,ylm,res,alm); return;
+    case 8: avx512_map2alm(m,lstart,lmax,ylm,res,alm); return;
+    }
+#endif
+  UTIL_FAIL("unsupported number of SIMD lanes");
+  }
+
+void psht_simd_ylm_recursion_f (int lanes, int lstart, int lend,
+  const float *cth, float *lam_1, float *lam_2, const ylmgen_flt2 *recfac,
+  float *ylm)
+  {
+#ifdef PSHT_HAVE_WIDE_KERNELS
+  switch (lanes)
+    {
+    case 8:
+      avx2f_ylm_recursion(lstart,lend,cth,lam_1,lam_2,recfac,ylm); return;
+    case 16:
+      avx512f_ylm_recursion(lstart,lend,cth,lam_1,lam_2,recfac,ylm); return;
+    }
+#endif
+  UTIL_FAIL("unsupported number of SIMD lanes");
+  }
+
+void psht_simd_alm2map_f (int lanes, int m, int lstart, int lmax,
+  const float *ylm, const double *alm, float *res)
+  {
+#ifdef PSHT_HAVE_WIDE_KERNELS
+  switch (lanes)
+    {
+    case 8: avx2f_alm2map(m,lstart,lmax,ylm,alm,res); return;
+    case 16: avx512f_alm2map(m,lstart,lmax,ylm,alm,res); return;
+    }
+#endif
+  UTIL_FAIL("unsupported number of SIMD lanes");
+  }
+
+void psht_simd_map2alm_f (int lanes, int m, int lstart, int lmax,
+  const float *ylm, const float *res, double *alm)
+  {
+#ifdef PSHT_HAVE_WIDE_KERNELS
+  switch (lanes)
+    {
+    case 8: avx2f_map2alm(m,lstart,lmax,ylm,res,alm); return;
+    case 16: avx512f_map2alm(m,lstart,lmax,ylm,res,alm); return;
+    }
+#endif
+  UTIL_FAIL("unsupported number of SIMD lanes");
+  }
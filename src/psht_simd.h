@@ -0,0 +1,94 @@
+/*
+ *  This file is part of libpsht.
+ *
+ *  libpsht is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  libpsht is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with libpsht; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+/*
+ *  libpsht is being developed at the Max-Planck-Institut fuer Astrophysik
+ *  and financially supported by the Deutsches Zentrum fuer Luft- und Raumfahrt
+ *  (DLR).
+ */
+
+/*! \file psht_simd.h
+ *  Vectorised kernels for spin-0 transforms, processing several rings
+ *  at the same time
+ *
+ *  Copyright (C) 2013 Maurizio Tomasi
+ */
+
+#ifndef PLANCK_PSHT_SIMD_H
+#define PLANCK_PSHT_SIMD_H
+
+#include "ylmgen_c.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*! Maximum number of rings processed at once by the double and single
+    precision kernels. */
+enum { psht_simd_maxlanes=8, psht_simd_maxlanes_f=16 };
+
+/*! Runs the Y_lm recursion for \a lanes rings (as returned by
+    psht_simd_lanes()) from \a lstart to \a lend, storing Y_lm of ring
+    \a i in \a ylm[(l-lstart)*lanes+i]. \a lam_1 and \a lam_2 contain
+    Y_(l-1),m and Y_lm at \a l=lstart for each ring, and they are updated
+    to the values at \a l=lend+1.
+    \note No user serviceable parts inside! */
+void psht_simd_ylm_recursion (int lanes, int lstart, int lend,
+  const double *cth, double *lam_1, double *lam_2, const ylmgen_dbl2 *recfac,
+  double *ylm);
+
+/*! Accumulates the contributions of the a_lm in \a alm (real and imaginary
+    parts interleaved, indexed by \a l) to the phases of \a lanes rings,
+    using the Y_lm computed by psht_simd_ylm_recursion() from \a lstart to
+    \a lmax. \a res must have room for 4*\a lanes values: the real and
+    imaginary parts of the terms with even \a l-m, followed by those with
+    odd \a l-m.
+    \note No user serviceable parts inside! */
+void psht_simd_alm2map (int lanes, int m, int lstart, int lmax,
+  const double *ylm, const double *alm, double *res);
+
+/*! Adjoint of psht_simd_alm2map(): adds to \a alm the contributions of the
+    phases in \a res, which has the same layout.
+    \note No user serviceable parts inside! */
+void psht_simd_map2alm (int lanes, int m, int lstart, int lmax,
+  const double *ylm, const double *res, double *alm);
+
+/*! Single precision version of psht_simd_ylm_recursion(), which processes
+    twice as many rings.
+    \note No user serviceable parts inside! */
+void psht_simd_ylm_recursion_f (int lanes, int lstart, int lend,
+  const float *cth, float *lam_1, float *lam_2, const ylmgen_flt2 *recfac,
+  float *ylm);
+
+/*! Single precision version of psht_simd_alm2map(). The a_lm are still
+    read in double precision.
+    \note No user serviceable parts inside! */
+void psht_simd_alm2map_f (int lanes, int m, int lstart, int lmax,
+  const float *ylm, const double *alm, float *res);
+
+/*! Single precision version of psht_simd_map2alm(). The sums over the rings
+    are added to \a alm in double precision.
+    \note No user serviceable parts inside! */
+void psht_simd_map2alm_f (int lanes, int m, int lstart, int lmax,
+  const float *ylm, const float *res, double *alm);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
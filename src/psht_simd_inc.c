@@ -0,0 +1,164 @@
+/*
+ *  This file is part of libpsht.
+ *
+ *  libpsht is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  libpsht is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with libpsht; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+/*
+ *  libpsht is being developed at the Max-Planck-Institut fuer Astrophysik
+ *  and financially supported by the Deutsches Zentrum fuer Luft- und Raumfahrt
+ *  (DLR).
+ */
+
+/*! \file psht_simd_inc.c
+ *  Type-generic code for the vectorised kernels. This file is included
+ *  once for every vector width and precision by psht_simd.c, with VLEN,
+ *  KREAL, KRECFAC, K() and KERNEL_TARGET defined appropriately.
+ *
+ *  Copyright (C) 2013 Maurizio Tomasi
+ */
+
+typedef KREAL K(vec) __attribute__ ((vector_size (VLEN*sizeof(KREAL))));
+
+/* Loads and stores go through memcpy(), since the arrays passed to the
+   kernels are not necessarily aligned; compilers turn them into single
+   unaligned vector instructions. */
+
+static KERNEL_TARGET void K(ylm_recursion) (int lstart, int lend,
+  const KREAL *cth_, KREAL *lam_1_, KREAL *lam_2_, const KRECFAC *recfac,
+  KREAL *ylm)
+  {
+  K(vec) cth, lam_1, lam_2;
+  int l;
+  memcpy(&cth,cth_,sizeof(cth));
+  memcpy(&lam_1,lam_1_,sizeof(lam_1));
+  memcpy(&lam_2,lam_2_,sizeof(lam_2));
+
+  for (l=lstart; l<=lend; ++l)
+    {
+    const K(vec) lam_0 = lam_1;
+    memcpy(ylm+(ptrdiff_t)(l-lstart)*VLEN,&lam_2,sizeof(lam_2));
+    lam_1 = lam_2;
+    lam_2 = cth*lam_2*recfac[l][0] - lam_0*recfac[l][1];
+    }
+
+  memcpy(lam_1_,&lam_1,sizeof(lam_1));
+  memcpy(lam_2_,&lam_2,sizeof(lam_2));
+  }
+
+#define ALM2MAP_WIDE_MACRO(pre,pim) \
+  { \
+  K(vec) y_; \
+  memcpy(&y_,ylm+(ptrdiff_t)(l-lstart)*VLEN,sizeof(y_)); \
+  pre += y_*(KREAL)alm[2*l]; \
+  pim += y_*(KREAL)alm[2*l+1]; \
+  ++l; \
+  }
+
+static KERNEL_TARGET void K(alm2map) (int m, int lstart, int lmax,
+  const KREAL *ylm, const double *alm, KREAL *res)
+  {
+  K(vec) p1re, p1im, p2re, p2im;
+  int l=lstart;
+  p1re = p1im = p2re = p2im = (K(vec)) {0};
+
+  if ((l-m)&1)
+    ALM2MAP_WIDE_MACRO(p2re,p2im)
+  for (; l<lmax;)
+    {
+    ALM2MAP_WIDE_MACRO(p1re,p1im)
+    ALM2MAP_WIDE_MACRO(p2re,p2im)
+    }
+  if (l==lmax)
+    ALM2MAP_WIDE_MACRO(p1re,p1im)
+
+  memcpy(res,&p1re,sizeof(p1re));
+  memcpy(res+VLEN,&p1im,sizeof(p1im));
+  memcpy(res+2*VLEN,&p2re,sizeof(p2re));
+  memcpy(res+3*VLEN,&p2im,sizeof(p2im));
+  }
+
+#undef ALM2MAP_WIDE_MACRO
+
+/* The sums over the rings are computed by adding the two halves of the
+   vectors, to avoid a long chain of dependent additions */
+typedef KREAL K(vec2) __attribute__ ((vector_size (2*sizeof(KREAL))));
+#if VLEN>=8
+typedef KREAL K(vec4) __attribute__ ((vector_size (4*sizeof(KREAL))));
+#endif
+#if VLEN>=16
+typedef KREAL K(vec8) __attribute__ ((vector_size (8*sizeof(KREAL))));
+#endif
+
+#define HALVE(src,dst,type) \
+  { \
+  type lo_, hi_; \
+  memcpy(&lo_,&src,sizeof(lo_)); \
+  memcpy(&hi_,(const char *)&src+sizeof(lo_),sizeof(hi_)); \
+  dst = lo_+hi_; \
+  }
+
+static inline KERNEL_TARGET KREAL K(hsum) (K(vec) v)
+  {
+  K(vec2) v2;
+#if VLEN==16
+  K(vec8) v8;
+  K(vec4) v4;
+  HALVE(v,v8,K(vec8))
+  HALVE(v8,v4,K(vec4))
+  HALVE(v4,v2,K(vec2))
+#elif VLEN==8
+  K(vec4) v4;
+  HALVE(v,v4,K(vec4))
+  HALVE(v4,v2,K(vec2))
+#else
+  HALVE(v,v2,K(vec2))
+#endif
+  return v2[0]+v2[1];
+  }
+
+#undef HALVE
+
+#define MAP2ALM_WIDE_MACRO(pre,pim) \
+  { \
+  K(vec) y_; \
+  memcpy(&y_,ylm+(ptrdiff_t)(l-lstart)*VLEN,sizeof(y_)); \
+  alm[2*l] += K(hsum)(pre*y_); \
+  alm[2*l+1] += K(hsum)(pim*y_); \
+  ++l; \
+  }
+
+static KERNEL_TARGET void K(map2alm) (int m, int lstart, int lmax,
+  const KREAL *ylm, const KREAL *res, double *alm)
+  {
+  K(vec) p1re, p1im, p2re, p2im;
+  int l=lstart;
+  memcpy(&p1re,res,sizeof(p1re));
+  memcpy(&p1im,res+VLEN,sizeof(p1im));
+  memcpy(&p2re,res+2*VLEN,sizeof(p2re));
+  memcpy(&p2im,res+3*VLEN,sizeof(p2im));
+
+  if ((l-m)&1)
+    MAP2ALM_WIDE_MACRO(p2re,p2im)
+  for (; l<lmax;)
+    {
+    MAP2ALM_WIDE_MACRO(p1re,p1im)
+    MAP2ALM_WIDE_MACRO(p2re,p2im)
+    }
+  if (l==lmax)
+    MAP2ALM_WIDE_MACRO(p1re,p1im)
+  }
+
+#undef MAP2ALM_WIDE_MACRO
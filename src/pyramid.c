@@ -0,0 +1,327 @@
+/* pyramid.c -- Multi-resolution pyramids of NEST maps
+ *
+ * Copyright 2011-2013 Maurizio Tomasi.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.  */
+
+#include "config.h"
+
+#include <hpixlib/hpix.h>
+#include <assert.h>
+#include <math.h>
+
+/* A pyramid is a stack of maps, each one with half the NSIDE of the
+ * previous one. Level 0 is the map provided by the user, while level
+ * k is obtained by merging the four NEST children of each pixel at
+ * level k-1. Since in the NEST scheme the children of pixel `p` are
+ * pixels 4p, 4p+1, 4p+2 and 4p+3, no index conversion is ever
+ * needed.
+ *
+ * Each level keeps the sum and the number of unmasked pixels it
+ * covers: this is enough to produce any of the supported statistics,
+ * and it allows to build level k directly from level k-1. Levels are
+ * computed only when they are requested for the first time. After
+ * that, any change in the base map marks the ancestors of the
+ * modified pixel as "dirty", and the next request recomputes only
+ * them. */
+
+typedef struct {
+    hpix_map_t       * map;
+    double           * sums;
+    uint32_t         * counts;
+
+    int                is_computed;
+    unsigned char    * dirty_flags;
+    hpix_pixel_num_t * dirty_list;
+    size_t             num_of_dirty_pixels;
+} pyramid_level_t;
+
+struct hpix_map_pyramid_t {
+    hpix_map_t               * base_map;
+    hpix_pyramid_statistic_t   statistic;
+    unsigned int               num_of_levels;
+    pyramid_level_t          * levels;
+};
+
+/**********************************************************************/
+
+
+hpix_map_pyramid_t *
+hpix_create_map_pyramid(hpix_map_t * base_map,
+			hpix_pyramid_statistic_t statistic)
+{
+    assert(base_map);
+    assert(hpix_map_ordering_scheme(base_map) == HPIX_ORDER_SCHEME_NEST);
+    assert(hpix_valid_nside(hpix_map_nside(base_map)));
+
+    hpix_map_pyramid_t * pyramid = hpix_malloc(sizeof(hpix_map_pyramid_t), 1);
+    pyramid->base_map = base_map;
+    pyramid->statistic = statistic;
+    pyramid->num_of_levels = hpix_ilog2(hpix_map_nside(base_map)) + 1;
+    pyramid->levels = hpix_calloc(sizeof(pyramid_level_t),
+				  pyramid->num_of_levels);
+
+    return pyramid;
+}
+
+/**********************************************************************/
+
+
+static void
+free_level(pyramid_level_t * level)
+{
+    hpix_free_map(level->map);
+    hpix_free(level->sums);
+    hpix_free(level->counts);
+    hpix_free(level->dirty_flags);
+    hpix_free(level->dirty_list);
+
+    *level = (pyramid_level_t) { .is_computed = FALSE };
+}
+
+/**********************************************************************/
+
+
+void
+hpix_free_map_pyramid(hpix_map_pyramid_t * pyramid)
+{
+    if(pyramid == NULL)
+	return;
+
+    for(unsigned int level = 0; level < pyramid->num_of_levels; ++level)
+	free_level(&pyramid->levels[level]);
+
+    hpix_free(pyramid->levels);
+    hpix_free(pyramid);
+}
+
+/**********************************************************************/
+
+
+unsigned int
+hpix_map_pyramid_num_of_levels(const hpix_map_pyramid_t * pyramid)
+{
+    assert(pyramid);
+    return pyramid->num_of_levels;
+}
+
+/**********************************************************************/
+
+
+hpix_map_t *
+hpix_map_pyramid_base_map(const hpix_map_pyramid_t * pyramid)
+{
+    assert(pyramid);
+    return pyramid->base_map;
+}
+
+/**********************************************************************/
+
+
+hpix_pyramid_statistic_t
+hpix_map_pyramid_statistic(const hpix_map_pyramid_t * pyramid)
+{
+    assert(pyramid);
+    return pyramid->statistic;
+}
+
+/**********************************************************************/
+
+
+/* Recompute the sum and the number of unmasked pixels for pixel
+ * `index` at level `level_num` (which must be greater than zero),
+ * using the values of its four children. */
+static void
+update_pixel(hpix_map_pyramid_t * pyramid,
+	     unsigned int level_num,
+	     hpix_pixel_num_t index)
+{
+    pyramid_level_t * level = &pyramid->levels[level_num];
+    const hpix_pixel_num_t first_child = 4 * index;
+    double sum = 0.0;
+    uint32_t count = 0;
+
+    if(level_num == 1)
+    {
+	const double * pixels = hpix_map_pixels(pyramid->base_map);
+	for(hpix_pixel_num_t child = first_child;
+	    child < first_child + 4;
+	    ++child)
+	{
+	    if(! HPIX_IS_MASKED(pixels[child]))
+	    {
+		sum += pixels[child];
+		++count;
+	    }
+	}
+    } else {
+	const pyramid_level_t * finer = &pyramid->levels[level_num - 1];
+	for(hpix_pixel_num_t child = first_child;
+	    child < first_child + 4;
+	    ++child)
+	{
+	    sum += finer->sums[child];
+	    count += finer->counts[child];
+	}
+    }
+
+    level->sums[index] = sum;
+    level->counts[index] = count;
+
+    double * value = &hpix_map_pixels(level->map)[index];
+    switch(pyramid->statistic)
+    {
+    case HPIX_PYRAMID_SUM:
+	*value = (count > 0) ? sum : NAN;
+	break;
+    case HPIX_PYRAMID_MEAN:
+	*value = (count > 0) ? sum / count : NAN;
+	break;
+    case HPIX_PYRAMID_VALID_COUNT:
+	*value = count;
+	break;
+    default:
+	assert(0);
+    }
+}
+
+/**********************************************************************/
+
+
+/* Make sure that level `level_num` is up to date. This assumes that
+ * level `level_num - 1` is already up to date. */
+static void
+refresh_level(hpix_map_pyramid_t * pyramid, unsigned int level_num)
+{
+    pyramid_level_t * level = &pyramid->levels[level_num];
+
+    if(! level->is_computed)
+    {
+	const hpix_nside_t nside =
+	    hpix_map_nside(pyramid->base_map) >> level_num;
+	level->map = hpix_create_map(nside, HPIX_ORDER_SCHEME_NEST);
+	level->map->coord = pyramid->base_map->coord;
+
+	const size_t num_of_pixels = hpix_map_num_of_pixels(level->map);
+	level->sums = hpix_malloc(sizeof(level->sums[0]), num_of_pixels);
+	level->counts = hpix_malloc(sizeof(level->counts[0]), num_of_pixels);
+	level->dirty_flags = hpix_calloc(sizeof(level->dirty_flags[0]),
+					 num_of_pixels);
+	level->dirty_list = NULL;
+	level->num_of_dirty_pixels = 0;
+
+#pragma omp parallel for default(shared)
+	for(size_t index = 0; index < num_of_pixels; ++index)
+	    update_pixel(pyramid, level_num, index);
+
+	level->is_computed = TRUE;
+	return;
+    }
+
+    const size_t num_of_dirty_pixels = level->num_of_dirty_pixels;
+#pragma omp parallel for default(shared) if(num_of_dirty_pixels > 4096)
+    for(size_t idx = 0; idx < num_of_dirty_pixels; ++idx)
+    {
+	hpix_pixel_num_t index = level->dirty_list[idx];
+	update_pixel(pyramid, level_num, index);
+	level->dirty_flags[index] = 0;
+    }
+    level->num_of_dirty_pixels = 0;
+}
+
+/**********************************************************************/
+
+
+const hpix_map_t *
+hpix_map_pyramid_level(hpix_map_pyramid_t * pyramid,
+		       unsigned int level_num)
+{
+    assert(pyramid);
+    assert(level_num < pyramid->num_of_levels);
+
+    if(level_num == 0)
+	return pyramid->base_map;
+
+    /* Coarser levels are built from finer ones, so we must proceed
+     * from the bottom of the pyramid upwards */
+    for(unsigned int cur_level = 1; cur_level <= level_num; ++cur_level)
+	refresh_level(pyramid, cur_level);
+
+    return pyramid->levels[level_num].map;
+}
+
+/**********************************************************************/
+
+
+void
+hpix_map_pyramid_invalidate_pixel(hpix_map_pyramid_t * pyramid,
+				  hpix_pixel_num_t index)
+{
+    assert(pyramid);
+    assert(index < hpix_map_num_of_pixels(pyramid->base_map));
+
+    for(unsigned int level_num = 1;
+	level_num < pyramid->num_of_levels;
+	++level_num)
+    {
+	pyramid_level_t * level = &pyramid->levels[level_num];
+
+	/* A level can be computed only if all the finer ones have
+	 * been computed too, so there is no need to go further */
+	if(! level->is_computed)
+	    break;
+
+	const hpix_pixel_num_t ancestor = index >> (2 * level_num);
+
+	/* If the ancestor is already dirty, so are all the coarser
+	 * ones */
+	if(level->dirty_flags[ancestor])
+	    break;
+
+	if(level->dirty_list == NULL)
+	    level->dirty_list =
+		hpix_malloc(sizeof(level->dirty_list[0]),
+			    hpix_map_num_of_pixels(level->map));
+
+	level->dirty_flags[ancestor] = 1;
+	level->dirty_list[level->num_of_dirty_pixels++] = ancestor;
+    }
+}
+
+/**********************************************************************/
+
+
+void
+hpix_map_pyramid_set_pixel(hpix_map_pyramid_t * pyramid,
+			   hpix_pixel_num_t index,
+			   double value)
+{
+    assert(pyramid);
+    assert(index < hpix_map_num_of_pixels(pyramid->base_map));
+
+    hpix_map_pixels(pyramid->base_map)[index] = value;
+    hpix_map_pyramid_invalidate_pixel(pyramid, index);
+}
+
+/**********************************************************************/
+
+
+void
+hpix_map_pyramid_invalidate(hpix_map_pyramid_t * pyramid)
+{
+    assert(pyramid);
+
+    for(unsigned int level = 1; level < pyramid->num_of_levels; ++level)
+	free_level(&pyramid->levels[level]);
+}
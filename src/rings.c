@@ -0,0 +1,159 @@
+/* rings.c -- Geometry of the rings of a HEALPix tessellation
+ *
+ * Copyright 2011-2013 Maurizio Tomasi.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.  */
+
+#include "config.h"
+
+#include <hpixlib/hpix.h>
+#include <assert.h>
+#include <math.h>
+
+/* Rings are numbered from 1 (the northernmost) to 4*nside - 1 (the
+ * southernmost), following the HEALPix conventions. The ring table
+ * of a resolution is indexed by ring - 1. */
+
+/**********************************************************************/
+
+
+unsigned int
+hpix_num_of_rings(const hpix_resolution_t * resolution)
+{
+    assert(resolution);
+    return 4 * (unsigned int) resolution->nside - 1;
+}
+
+/**********************************************************************/
+
+
+static void
+compute_ring_info(const hpix_resolution_t * resolution,
+		  unsigned int ring,
+		  hpix_ring_info_t * info)
+{
+    const unsigned int nside = resolution->nside;
+    unsigned int northern_ring = (ring < 2 * nside) ? ring : 4 * nside - ring;
+
+    if(northern_ring < nside)
+    {
+	/* Polar caps. We compute 1 - |z| directly, to avoid losing
+	 * precision near the poles. */
+	const double one_minus_z =
+	    northern_ring * (double) northern_ring
+	    / (3.0 * resolution->pixels_per_face);
+
+	info->num_of_pixels = 4 * northern_ring;
+	info->shifted = TRUE;
+	info->z = 1.0 - one_minus_z;
+	info->sin_theta = sqrt(one_minus_z * (2.0 - one_minus_z));
+	if(ring == northern_ring)
+	    info->first_pixel = 2 * (hpix_pixel_num_t) ring * (ring - 1);
+	else
+	{
+	    info->z = -info->z;
+	    info->first_pixel = resolution->num_of_pixels
+		- 2 * (hpix_pixel_num_t) northern_ring * (northern_ring + 1);
+	}
+    }
+    else
+    {
+	/* Equatorial belt */
+	info->num_of_pixels = 4 * nside;
+	info->shifted = ((ring - nside) & 1) == 0;
+	info->z = (2.0 * nside - (double) ring) * resolution->fact1;
+	info->sin_theta = sqrt((1.0 - info->z) * (1.0 + info->z));
+	info->first_pixel = resolution->ncap
+	    + (hpix_pixel_num_t) (ring - nside) * info->num_of_pixels;
+    }
+
+    info->theta = atan2(info->sin_theta, info->z);
+    info->delta_phi = 2.0 * M_PI / info->num_of_pixels;
+    info->phi0 = info->shifted ? 0.5 * info->delta_phi : 0.0;
+}
+
+/**********************************************************************/
+
+
+void
+hpix_build_ring_table(hpix_resolution_t * resolution)
+{
+    assert(resolution);
+
+    if(resolution->ring_table != NULL)
+	return;
+
+    const unsigned int num_of_rings = hpix_num_of_rings(resolution);
+    hpix_ring_info_t * table = hpix_malloc(sizeof(hpix_ring_info_t),
+					   num_of_rings);
+
+#pragma omp parallel for default(shared) if(num_of_rings > 1024)
+    for(unsigned int ring = 1; ring <= num_of_rings; ++ring)
+	compute_ring_info(resolution, ring, &table[ring - 1]);
+
+    resolution->ring_table = table;
+}
+
+/**********************************************************************/
+
+
+void
+hpix_free_ring_table(hpix_resolution_t * resolution)
+{
+    assert(resolution);
+
+    hpix_free(resolution->ring_table);
+    resolution->ring_table = NULL;
+}
+
+/**********************************************************************/
+
+
+void
+hpix_ring_info(const hpix_resolution_t * resolution,
+	       unsigned int ring,
+	       hpix_ring_info_t * info)
+{
+    assert(resolution);
+    assert(info);
+    assert(ring >= 1 && ring <= hpix_num_of_rings(resolution));
+
+    if(resolution->ring_table != NULL)
+	*info = resolution->ring_table[ring - 1];
+    else
+	compute_ring_info(resolution, ring, info);
+}
+
+/**********************************************************************/
+
+
+unsigned int
+hpix_ring_pixel_to_ring(const hpix_resolution_t * resolution,
+			hpix_pixel_num_t pixel)
+{
+    assert(resolution);
+    assert(pixel < resolution->num_of_pixels);
+
+    if(pixel < resolution->ncap)
+	return (1 + hpix_isqrt(1 + 2 * pixel)) >> 1;
+    else if(pixel < resolution->num_of_pixels - resolution->ncap)
+	return (pixel - resolution->ncap) / resolution->nside_times_four
+	    + resolution->nside;
+    else
+    {
+	hpix_pixel_num_t southern_pixel = resolution->num_of_pixels - pixel;
+	return 4 * (unsigned int) resolution->nside
+	    - ((1 + hpix_isqrt(2 * southern_pixel - 1)) >> 1);
+    }
+}
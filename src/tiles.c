@@ -0,0 +1,312 @@
+/* tiles.c -- Render large projections in tiles
+ *
+ * Copyright 2011-2013 Maurizio Tomasi.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.  */
+
+#include "config.h"
+
+#include <hpixlib/hpix.h>
+#include <assert.h>
+#include <math.h>
+
+#include "bmp_projection.h"
+
+/* A tile renderer splits the image of a projection into square tiles
+ * of `tile_size` elements per side, and computes each of them on
+ * demand: unlike projection plans (see bitmap.c), it never stores
+ * anything proportional to the size of the image. Tiles are indexed
+ * in image order, i.e., tile (0, 0) is in the upper left corner of
+ * the image, while the first row of a bitmap returned by
+ * `hpix_bmp_projection_trace` is the bottom one.
+ *
+ * Every tile can be rendered with a step larger than one: in this
+ * case only one element every `step` is computed, and its color fills
+ * a block of `step` x `step` elements. This allows to show a coarse
+ * preview quickly, and then to refine it. */
+
+struct hpix_bmp_tile_renderer_t {
+    const hpix_bmp_projection_t * proj;
+    const hpix_map_t            * map;
+    const hpix_palette_lut_t    * lut;
+    hpix_angles_to_pixel_fn_t   * angles_to_pixel_fn;
+    double                        min_value;
+    double                        max_value;
+    unsigned int                  tile_size;
+};
+
+/**********************************************************************/
+
+
+hpix_bmp_tile_renderer_t *
+hpix_create_bmp_tile_renderer(const hpix_bmp_projection_t * proj,
+			      const hpix_map_t * map,
+			      const hpix_palette_lut_t * lut,
+			      double min_value,
+			      double max_value,
+			      unsigned int tile_size)
+{
+    assert(proj);
+    assert(proj->xy_to_angles_fn);
+    assert(map);
+    assert(lut);
+    assert(tile_size > 0);
+
+    hpix_bmp_tile_renderer_t * renderer =
+	hpix_malloc(sizeof(hpix_bmp_tile_renderer_t), 1);
+
+    renderer->proj = proj;
+    renderer->map = map;
+    renderer->lut = lut;
+    renderer->angles_to_pixel_fn =
+	(hpix_map_ordering_scheme(map) == HPIX_ORDER_SCHEME_NEST)
+	? hpix_angles_to_nest_pixel
+	: hpix_angles_to_ring_pixel;
+    renderer->min_value = min_value;
+    renderer->max_value = max_value;
+    renderer->tile_size = tile_size;
+
+    return renderer;
+}
+
+/**********************************************************************/
+
+
+void
+hpix_free_bmp_tile_renderer(hpix_bmp_tile_renderer_t * renderer)
+{
+    if(renderer == NULL)
+	return;
+
+    hpix_free(renderer);
+}
+
+/**********************************************************************/
+
+
+unsigned int
+hpix_bmp_tile_renderer_tile_size(const hpix_bmp_tile_renderer_t * renderer)
+{
+    assert(renderer);
+    return renderer->tile_size;
+}
+
+/**********************************************************************/
+
+
+unsigned int
+hpix_bmp_tile_renderer_num_of_columns(const hpix_bmp_tile_renderer_t * renderer)
+{
+    assert(renderer);
+    return (renderer->proj->width + renderer->tile_size - 1)
+	/ renderer->tile_size;
+}
+
+/**********************************************************************/
+
+
+unsigned int
+hpix_bmp_tile_renderer_num_of_rows(const hpix_bmp_tile_renderer_t * renderer)
+{
+    assert(renderer);
+    return (renderer->proj->height + renderer->tile_size - 1)
+	/ renderer->tile_size;
+}
+
+/**********************************************************************/
+
+
+/* Return the value of the element of the projection at column `x`
+ * and row `row` of the image (counted from the top). As in
+ * `hpix_bmp_projection_trace`, elements outside the projection are
+ * INFINITY and unseen pixels are NaN. */
+static double
+sample_element(const hpix_bmp_tile_renderer_t * renderer,
+	       unsigned int x, unsigned int row)
+{
+    const hpix_bmp_projection_t * proj = renderer->proj;
+    double theta, phi;
+
+    if(! proj->xy_to_angles_fn(proj, x, proj->height - row - 1,
+			       &theta, &phi))
+	return INFINITY;
+
+    const double value =
+	*(hpix_map_pixels(renderer->map)
+	  + renderer->angles_to_pixel_fn(hpix_map_resolution(renderer->map),
+					 theta, phi));
+    return (value > -1.6e+30) ? value : NAN;
+}
+
+/**********************************************************************/
+
+
+void
+hpix_bmp_tile_renderer_render_tile(const hpix_bmp_tile_renderer_t * renderer,
+				   unsigned int column,
+				   unsigned int row,
+				   unsigned int step,
+				   void * dest,
+				   size_t dest_stride)
+{
+    assert(renderer);
+    assert(dest);
+    assert(step > 0);
+    assert(column < hpix_bmp_tile_renderer_num_of_columns(renderer));
+    assert(row < hpix_bmp_tile_renderer_num_of_rows(renderer));
+
+    const unsigned int tile_size = renderer->tile_size;
+    const unsigned int first_x = column * tile_size;
+    const unsigned int first_row = row * tile_size;
+    const unsigned int width =
+	(renderer->proj->width - first_x < tile_size)
+	? renderer->proj->width - first_x
+	: tile_size;
+    const unsigned int height =
+	(renderer->proj->height - first_row < tile_size)
+	? renderer->proj->height - first_row
+	: tile_size;
+    const unsigned int num_of_samples = (width + step - 1) / step;
+
+    assert(dest_stride >= width * sizeof(uint32_t));
+
+    /* Tiles are usually rendered in parallel, so these buffers are
+     * allocated here instead of being kept in `renderer` */
+    double * values = hpix_malloc(sizeof(values[0]), num_of_samples);
+    uint32_t * colors = hpix_malloc(sizeof(colors[0]), num_of_samples);
+
+    for(unsigned int y = 0; y < height; y += step)
+    {
+	for(unsigned int idx = 0; idx < num_of_samples; ++idx)
+	    values[idx] = sample_element(renderer, first_x + idx * step,
+					 first_row + y);
+
+	hpix_palette_lut_colorize_values(renderer->lut, values,
+					 num_of_samples,
+					 renderer->min_value,
+					 renderer->max_value,
+					 colors);
+
+	/* Fill the block of rows [y, y + step) */
+	for(unsigned int block_y = y;
+	    block_y < y + step && block_y < height;
+	    ++block_y)
+	{
+	    uint32_t * dest_row =
+		(uint32_t *) ((char *) dest + block_y * dest_stride);
+
+	    for(unsigned int x = 0; x < width; ++x)
+		dest_row[x] = colors[x / step];
+	}
+    }
+
+    hpix_free(colors);
+    hpix_free(values);
+}
+
+/**********************************************************************/
+
+
+void
+hpix_bmp_tile_renderer_render_preview(const hpix_bmp_tile_renderer_t * renderer,
+				      unsigned int factor,
+				      void * dest,
+				      size_t dest_stride)
+{
+    assert(renderer);
+    assert(dest);
+    assert(factor > 0);
+
+    const hpix_bmp_projection_t * proj = renderer->proj;
+    const unsigned int width = (proj->width + factor - 1) / factor;
+    const unsigned int height = (proj->height + factor - 1) / factor;
+
+    assert(dest_stride >= width * sizeof(uint32_t));
+
+#pragma omp parallel default(shared)
+    {
+	double * values = hpix_malloc(sizeof(values[0]), width);
+
+#pragma omp for
+	for(unsigned int row = 0; row < height; ++row)
+	{
+	    /* Sample the center of each block of elements */
+	    for(unsigned int x = 0; x < width; ++x)
+	    {
+		const unsigned int full_x = x * factor + factor / 2;
+		const unsigned int full_row = row * factor + factor / 2;
+		values[x] = sample_element(renderer,
+					   (full_x < proj->width)
+					   ? full_x : proj->width - 1,
+					   (full_row < proj->height)
+					   ? full_row : proj->height - 1);
+	    }
+
+	    hpix_palette_lut_colorize_values(renderer->lut, values, width,
+					     renderer->min_value,
+					     renderer->max_value,
+					     (uint32_t *) ((char *) dest
+							   + row * dest_stride));
+	}
+
+	hpix_free(values);
+    }
+}
+
+/**********************************************************************/
+
+
+int
+hpix_bmp_tile_renderer_write(const hpix_bmp_tile_renderer_t * renderer,
+			     unsigned int step,
+			     hpix_image_writer_t * writer)
+{
+    assert(renderer);
+    assert(writer);
+
+    const unsigned int tile_size = renderer->tile_size;
+    const unsigned int width = renderer->proj->width;
+    const unsigned int height = renderer->proj->height;
+    const unsigned int num_of_columns =
+	hpix_bmp_tile_renderer_num_of_columns(renderer);
+    const unsigned int num_of_rows =
+	hpix_bmp_tile_renderer_num_of_rows(renderer);
+    const size_t stride = width * sizeof(uint32_t);
+
+    /* Only one row of tiles is kept in memory: its tiles are rendered
+     * in parallel, then the row is passed to the writer */
+    uint32_t * band = hpix_malloc(stride, tile_size);
+    int result = 1;
+
+    for(unsigned int row = 0; row < num_of_rows && result; ++row)
+    {
+#pragma omp parallel for default(shared) schedule(dynamic, 1)
+	for(unsigned int column = 0; column < num_of_columns; ++column)
+	{
+	    hpix_bmp_tile_renderer_render_tile(renderer, column, row, step,
+					       band + column * tile_size,
+					       stride);
+	}
+
+	const unsigned int num_of_lines =
+	    (height - row * tile_size < tile_size)
+	    ? height - row * tile_size
+	    : tile_size;
+	result = hpix_image_writer_write_rows(writer, band, stride,
+					      num_of_lines);
+    }
+
+    hpix_free(band);
+    return result;
+}
@@ -37,6 +37,9 @@
 #include "c_utils.h"
 
 enum { large_exponent2=90, minscale=-4, maxscale=11, max_spin=100 };
+/* The single precision recursion rescales its values by 2^30, so that
+   they never leave the range of IEEE floats */
+enum { large_exponent2_f=30, minscale_f=-4, maxscale_f=2 };
 
 static void sylmgen_init (sylmgen_d *gen, const Ylmgen_C *ygen, int spin)
   {
@@ -442,6 +445,12 @@ void Ylmgen_init (Ylmgen_C *gen, int l_max, int m_max, int spinrec,
   for (m=0; m<(maxscale-minscale+1); ++m)
     gen->cf[m] = ldexp(1.,(m+minscale)*large_exponent2);
   gen->recfac = RALLOC(ylmgen_dbl2,gen->lmax+1);
+  gen->fsmall_f = (float)ldexp(1.,-large_exponent2_f);
+  gen->fbig_f   = (float)ldexp(1., large_exponent2_f);
+  gen->cf_f = RALLOC(float,maxscale_f-minscale_f+1);
+  for (m=0; m<(maxscale_f-minscale_f+1); ++m)
+    gen->cf_f[m] = (float)ldexp(1.,(m+minscale_f)*large_exponent2_f);
+  gen->recfac_f = RALLOC(ylmgen_flt2,gen->lmax+1);
   gen->mfac = RALLOC(double,gen->mmax+1);
   gen->mfac[0] = 1;
   for (m=1; m<=gen->mmax; ++m)
@@ -511,6 +520,8 @@ void Ylmgen_destroy (Ylmgen_C *gen)
   DEALLOC(gen->firstl);
   DEALLOC(gen->cf);
   DEALLOC(gen->recfac);
+  DEALLOC(gen->cf_f);
+  DEALLOC(gen->recfac_f);
   DEALLOC(gen->mfac);
   DEALLOC(gen->t1fac);
   DEALLOC(gen->t2fac);
@@ -616,6 +627,8 @@ static void Ylmgen_recalc_recfac (Ylmgen_C *gen)
     gen->recfac[l][0] = gen->t1fac[l]*gen->t2fac[l+m]*gen->t2fac[l-m];
     gen->recfac[l][1] = gen->recfac[l][0]/f_old;
     f_old = gen->recfac[l][0];
+    gen->recfac_f[l][0] = (float)gen->recfac[l][0];
+    gen->recfac_f[l][1] = (float)gen->recfac[l][1];
     }
   }
 
@@ -641,7 +654,8 @@ static void Ylmgen_recalc_lamfact (Ylmgen_C *gen)
     } \
   while(0)
 
-void Ylmgen_recalc_Ylm (Ylmgen_C *gen)
+int Ylmgen_get_first_Ylm (Ylmgen_C *gen, double *lam_1_out,
+  double *lam_2_out)
   {
   const double ln2 = 0.6931471805599453094172321214581766;
 
@@ -652,13 +666,9 @@ void Ylmgen_recalc_Ylm (Ylmgen_C *gen)
   int scale,l;
   int m = gen->m_cur;
   double cth=gen->cth[gen->ith], sth=gen->sth[gen->ith];
-  double *result = gen->ylm;
-
-  if (gen->ylm_uptodate) return;
-  gen->ylm_uptodate=1;
 
   if (((m>=gen->m_crit)&&(fabs(cth)>=gen->cth_crit)) || ((m>0)&&(sth==0)))
-    { gen->firstl[0]=gen->lmax+1; return; }
+    return lmax+1;
 
   Ylmgen_recalc_recfac(gen);
 
@@ -705,9 +715,102 @@ void Ylmgen_recalc_Ylm (Ylmgen_C *gen)
       }
     }
 
-  gen->firstl[0]=l;
   if (l>lmax)
-    { gen->m_crit=m; gen->cth_crit=fabs(cth); return; }
+    { gen->m_crit=m; gen->cth_crit=fabs(cth); return l; }
+
+  *lam_1_out = lam_1;
+  *lam_2_out = lam_2;
+  return l;
+  }
+
+int Ylmgen_get_first_Ylm_float (Ylmgen_C *gen, float *lam_1_out,
+  float *lam_2_out)
+  {
+  const double ln2 = 0.6931471805599453094172321214581766;
+
+  double logval;
+  float lam_1,lam_2,corfac;
+  float eps=(float)gen->eps, fbig=gen->fbig_f, fsmall=gen->fsmall_f;
+  ylmgen_flt2 *recfac = gen->recfac_f;
+  int lmax=gen->lmax;
+  int scale,l;
+  int m = gen->m_cur;
+  float cth=(float)gen->cth[gen->ith];
+  double sth=gen->sth[gen->ith];
+
+  if (((m>=gen->m_crit)&&(fabs(cth)>=gen->cth_crit)) || ((m>0)&&(sth==0)))
+    return lmax+1;
+
+  Ylmgen_recalc_recfac(gen);
+
+  logval = gen->mfac[m];
+  if (m>0) logval += m*gen->logsth[gen->ith];
+  scale = (int) (logval/large_exponent2_f)-minscale_f;
+  if (scale>maxscale_f-minscale_f) scale=maxscale_f-minscale_f;
+  corfac = (scale<0) ? 0.f : gen->cf_f[scale];
+
+  lam_1 = 0;
+  lam_2 = (float)exp(ln2*(logval-(scale+minscale_f)*large_exponent2_f));
+  if (m&1) lam_2 = -lam_2;
+
+  l=m;
+  if (scale<0)
+    {
+    while (1)
+      {
+      if (++l>lmax) break;
+      lam_1 = cth*lam_2*recfac[l-1][0] - lam_1*recfac[l-1][1];
+      if (++l>lmax) break;
+      lam_2 = cth*lam_1*recfac[l-1][0] - lam_2*recfac[l-1][1];
+      if (fabsf(lam_2)>fbig)
+        {
+        while (fabsf(lam_2)>fbig)
+          { lam_1*=fsmall; lam_2*=fsmall; ++scale; }
+        corfac = (scale<0) ? 0.f : gen->cf_f[scale];
+        if (scale>=0) break;
+        }
+      }
+    }
+
+  lam_1*=corfac;
+  lam_2*=corfac;
+
+  if (l<=lmax)
+    {
+    while (1)
+      {
+      if (fabsf(lam_2)>eps) break;
+      if (++l>lmax) break;
+      lam_1 = cth*lam_2*recfac[l-1][0] - lam_1*recfac[l-1][1];
+      if (fabsf(lam_1)>eps)
+        { float x=lam_1; lam_1=lam_2; lam_2=x; break; }
+      if (++l>lmax) break;
+      lam_2 = cth*lam_1*recfac[l-1][0] - lam_2*recfac[l-1][1];
+      }
+    }
+
+  if (l>lmax)
+    { gen->m_crit=m; gen->cth_crit=fabs(cth); return l; }
+
+  *lam_1_out = lam_1;
+  *lam_2_out = lam_2;
+  return l;
+  }
+
+void Ylmgen_recalc_Ylm (Ylmgen_C *gen)
+  {
+  double lam_1,lam_2;
+  ylmgen_dbl2 *recfac = gen->recfac;
+  int lmax=gen->lmax;
+  int l;
+  double cth=gen->cth[gen->ith];
+  double *result = gen->ylm;
+
+  if (gen->ylm_uptodate) return;
+  gen->ylm_uptodate=1;
+
+  l = gen->firstl[0] = Ylmgen_get_first_Ylm (gen,&lam_1,&lam_2);
+  if (l>lmax) return;
 
   for(;l<lmax-3;l+=4)
     {
@@ -40,6 +40,7 @@ extern "C" {
 
 typedef double ylmgen_dbl2[2];
 typedef double ylmgen_dbl3[3];
+typedef float ylmgen_flt2[2];
 
 typedef struct
   {
@@ -60,6 +61,11 @@ typedef struct
   int *firstl;
   double *cf, *mfac, *t1fac, *t2fac, *th, *cth, *sth, *logsth;
   ylmgen_dbl2 *recfac;
+  /*! Single precision versions of \a fsmall, \a fbig, \a cf and
+      \a recfac, used by Ylmgen_get_first_Ylm_float(). */
+  float fsmall_f, fbig_f;
+  float *cf_f;
+  ylmgen_flt2 *recfac_f;
   double *lamfact;
   /*! Points to an array of size [0..lmax] containing the Y_lm values. */
   double *ylm;
@@ -110,6 +116,16 @@ void Ylmgen_prepare (Ylmgen_C *gen, int ith, int m);
 
 /*! Recalculates (if necessary) the Y_lm values. */
 void Ylmgen_recalc_Ylm (Ylmgen_C *gen);
+/*! Computes the first non-negligible Y_lm for the current theta and m
+    and returns its \a l index (or \a l_max+1 if all the Y_lm are
+    negligible). On return, \a lam_1 and \a lam_2 contain Y_(l-1),m and
+    Y_lm, so that the following values can be calculated with the
+    recursion coefficients in \a recfac. */
+int Ylmgen_get_first_Ylm (Ylmgen_C *gen, double *lam_1, double *lam_2);
+/*! Same as Ylmgen_get_first_Ylm(), but runs the recursion in single
+    precision. The following values can be calculated with the recursion
+    coefficients in \a recfac_f. */
+int Ylmgen_get_first_Ylm_float (Ylmgen_C *gen, float *lam_1, float *lam_2);
 /*! Recalculates (if necessary) the lambda_w and lambda_x values for spin >0
     transforms. */
 void Ylmgen_recalc_lambda_wx (Ylmgen_C *gen, int spin);
@@ -0,0 +1,184 @@
+/* test_binner.c -- check the implementation of hpix_binner_t
+ *
+ * Copyright 2011-2013 Maurizio Tomasi.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.  */
+
+#include <hpixlib/hpix.h>
+#include <math.h>
+#include <stdlib.h>
+#include <check.h>
+#include "check_helpers.h"
+#include "constants.h"
+
+/**********************************************************************/
+
+START_TEST(binner_unpolarized)
+{
+    hpix_binner_t * binner = hpix_create_binner(4, HPIX_ORDER_SCHEME_RING,
+						FALSE);
+    const hpix_resolution_t * resolution = hpix_binner_resolution(binner);
+    const size_t num_of_pixels = hpix_num_of_pixels(resolution);
+
+    /* Observe every pixel but the first one twice, once with value
+     * `idx` and once with value `2 idx` */
+    for(hpix_pixel_num_t idx = 1; idx < num_of_pixels; ++idx)
+    {
+	double theta, phi;
+	hpix_ring_pixel_to_angles(resolution, idx, &theta, &phi);
+
+	const double thetas[] = { theta, theta };
+	const double phis[] = { phi, phi };
+	const double values[] = { idx, 2.0 * idx };
+	const double weights[] = { 2.0, 1.0 };
+	hpix_binner_add_angles(binner, thetas, phis, NULL,
+			       values, weights, 2);
+    }
+
+    hpix_map_t * hits = hpix_binner_hit_map(binner);
+    hpix_map_t * weights = hpix_binner_weight_map(binner);
+    hpix_map_t * binned = hpix_binner_binned_map(binner);
+
+    TEST_FOR_CLOSENESS(hpix_map_pixels(hits)[0], 0.0);
+    fail_unless(isnan(hpix_map_pixels(binned)[0]));
+    for(size_t idx = 1; idx < num_of_pixels; ++idx)
+    {
+	TEST_FOR_CLOSENESS(hpix_map_pixels(hits)[idx], 2.0);
+	TEST_FOR_CLOSENESS(hpix_map_pixels(weights)[idx], 3.0);
+	TEST_FOR_CLOSENESS(hpix_map_pixels(binned)[idx], (4.0 * idx / 3.0));
+    }
+
+    hpix_free_map(hits);
+    hpix_free_map(weights);
+    hpix_free_map(binned);
+
+    hpix_reset_binner(binner);
+    hits = hpix_binner_hit_map(binner);
+    TEST_FOR_CLOSENESS(hpix_map_pixels(hits)[1], 0.0);
+    hpix_free_map(hits);
+
+    hpix_free_binner(binner);
+}
+END_TEST
+
+/**********************************************************************/
+
+START_TEST(binner_polarized)
+{
+    const double stokes_i = 1.0, stokes_q = 0.5, stokes_u = -0.25;
+    hpix_binner_t * binner = hpix_create_binner(2, HPIX_ORDER_SCHEME_NEST,
+						TRUE);
+
+    /* Pixel 5 is observed with four polarization angles, pixel 6 with
+     * one angle only */
+    const hpix_pixel_num_t pixels[] = { 5, 5, 5, 5, 6, 6 };
+    const double psi[] = { 0.0, M_PI / 4, M_PI / 2, 3 * M_PI / 4, 0.0, 0.0 };
+    double values[6];
+    for(size_t idx = 0; idx < 6; ++idx)
+	values[idx] = stokes_i
+	    + stokes_q * cos(2 * psi[idx])
+	    + stokes_u * sin(2 * psi[idx]);
+
+    hpix_binner_add_pixels(binner, pixels, psi, values, NULL, 6);
+
+    hpix_map_t * map_i, * map_q, * map_u;
+    hpix_binner_iqu_maps(binner, 1e-6, &map_i, &map_q, &map_u);
+
+    TEST_FOR_CLOSENESS(hpix_map_pixels(map_i)[5], stokes_i);
+    TEST_FOR_CLOSENESS(hpix_map_pixels(map_q)[5], stokes_q);
+    TEST_FOR_CLOSENESS(hpix_map_pixels(map_u)[5], stokes_u);
+
+    fail_unless(isnan(hpix_map_pixels(map_i)[6]));
+    fail_unless(isnan(hpix_map_pixels(map_q)[0]));
+
+    hpix_free_map(map_i);
+    hpix_free_map(map_q);
+    hpix_free_map(map_u);
+    hpix_free_binner(binner);
+}
+END_TEST
+
+/**********************************************************************/
+
+START_TEST(binner_large_chunks)
+{
+    /* Use enough samples to trigger the parallel code path, and
+     * compare the result with a straightforward accumulation. Since
+     * the binner keeps the order of the samples within each pixel,
+     * the two sums must be exactly the same. */
+    const size_t num_of_samples = 100000;
+    hpix_binner_t * binner = hpix_create_binner(16, HPIX_ORDER_SCHEME_NEST,
+						FALSE);
+    const size_t num_of_pixels =
+	hpix_num_of_pixels(hpix_binner_resolution(binner));
+
+    hpix_pixel_num_t * pixels = malloc(num_of_samples * sizeof(pixels[0]));
+    double * values = malloc(num_of_samples * sizeof(values[0]));
+    double * expected = calloc(num_of_pixels, sizeof(expected[0]));
+
+    srand(12345);
+    for(size_t idx = 0; idx < num_of_samples; ++idx)
+    {
+	pixels[idx] = rand() % num_of_pixels;
+	values[idx] = rand() / (double) RAND_MAX - 0.5;
+	expected[pixels[idx]] += values[idx];
+    }
+
+    /* Add the samples in two chunks of different size */
+    hpix_binner_add_pixels(binner, pixels, NULL, values, NULL, 30000);
+    hpix_binner_add_pixels(binner, pixels + 30000, NULL, values + 30000,
+			   NULL, num_of_samples - 30000);
+
+    hpix_map_t * signal = hpix_binner_signal_map(binner);
+    for(size_t idx = 0; idx < num_of_pixels; ++idx)
+	fail_unless(hpix_map_pixels(signal)[idx] == expected[idx]);
+
+    hpix_free_map(signal);
+    hpix_free_binner(binner);
+    free(pixels);
+    free(values);
+    free(expected);
+}
+END_TEST
+
+/**********************************************************************/
+
+Suite *
+create_hpix_test_suite(void)
+{
+    Suite * suite = suite_create("Binning of time-ordered data");
+    TCase * tc_core = tcase_create("Binner");
+
+    tcase_add_test(tc_core, binner_unpolarized);
+    tcase_add_test(tc_core, binner_polarized);
+    tcase_add_test(tc_core, binner_large_chunks);
+    suite_add_tcase(suite, tc_core);
+
+    return suite;
+}
+
+/**********************************************************************/
+
+int
+main(void)
+{
+    int number_failed;
+    Suite * suite = create_hpix_test_suite();
+    SRunner * runner = srunner_create(suite);
+    srunner_run_all(runner, CK_VERBOSE);
+    number_failed = srunner_ntests_failed(runner);
+    srunner_free(runner);
+
+    return (number_failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
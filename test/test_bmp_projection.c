@@ -16,10 +16,18 @@
  * You should have received a copy of the GNU General Public License
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.  */
 
+#include "config.h"
+
 #include <hpixlib/hpix.h>
 #include <stdlib.h>
+#include <string.h>
 #include <math.h>
 #include <check.h>
+#include "constants.h"
+
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif
 
 START_TEST(projection_size)
 {
@@ -121,10 +129,1014 @@ END_TEST
 
 /**********************************************************************/
 
+START_TEST(projection_plan)
+{
+    hpix_map_t * map = hpix_create_map(8, HPIX_ORDER_SCHEME_RING);
+    double *restrict array_of_pixels = hpix_map_pixels(map);
+
+    for(hpix_pixel_num_t index = 0;
+	index < hpix_map_num_of_pixels(map);
+	++index)
+    {
+	array_of_pixels[index] = index;
+    }
+    array_of_pixels[0] = -1.6375e+30; /* Mark one pixel as unseen */
+
+    hpix_bmp_projection_t * proj = hpix_create_bmp_projection(64, 32);
+    hpix_set_mollweide_projection(proj);
+
+    hpix_bmp_projection_plan_t * plan =
+	hpix_create_bmp_projection_plan(proj, 8, HPIX_ORDER_SCHEME_RING);
+    ck_assert_int_eq(hpix_bmp_projection_plan_width(plan), 64);
+    ck_assert_int_eq(hpix_bmp_projection_plan_height(plan), 32);
+    ck_assert_int_eq(hpix_bmp_projection_plan_nside(plan), 8);
+    fail_unless(hpix_bmp_projection_plan_scheme(plan)
+		== HPIX_ORDER_SCHEME_RING);
+
+    const hpix_pixel_num_t * indexes = hpix_bmp_projection_plan_pixels(plan);
+    fail_unless(indexes[0] == HPIX_BMP_OUTSIDE_PIXEL);
+    fail_unless(indexes[16 * 64 + 32] != HPIX_BMP_OUTSIDE_PIXEL);
+
+    /* The plan must be reusable with any map having the same
+     * resolution and ordering */
+    for(int iteration = 0; iteration < 2; ++iteration)
+    {
+	double ref_min, ref_max, plan_min, plan_max;
+	double * ref_bmp = hpix_bmp_projection_trace(proj, map,
+						     &ref_min, &ref_max);
+	double * plan_bmp = hpix_bmp_projection_plan_trace(plan, map,
+							   &plan_min,
+							   &plan_max);
+
+	fail_unless(ref_min == plan_min && ref_max == plan_max,
+		    "Wrong range for iteration %d", iteration);
+	for(size_t index = 0; index < 64 * 32; ++index)
+	{
+	    if(isnan(ref_bmp[index]))
+		fail_unless(isnan(plan_bmp[index]),
+			    "Pixel %u is not NAN", (unsigned) index);
+	    else if(isinf(ref_bmp[index]))
+		fail_unless(isinf(plan_bmp[index])
+			    && indexes[index] == HPIX_BMP_OUTSIDE_PIXEL,
+			    "Pixel %u is not INFINITY", (unsigned) index);
+	    else
+		fail_unless(ref_bmp[index] == plan_bmp[index],
+			    "Difference in pixel %u", (unsigned) index);
+	}
+
+	hpix_free(ref_bmp);
+	hpix_free(plan_bmp);
+
+	for(hpix_pixel_num_t index = 1;
+	    index < hpix_map_num_of_pixels(map);
+	    ++index)
+	{
+	    array_of_pixels[index] = -2.0 * index;
+	}
+    }
+
+    hpix_free_bmp_projection_plan(plan);
+    hpix_free_bmp_projection(proj);
+    hpix_free_map(map);
+}
+END_TEST
+
+/**********************************************************************/
+
+START_TEST(sampling_plans)
+{
+    hpix_map_t * map = hpix_create_map(64, HPIX_ORDER_SCHEME_NEST);
+    double *restrict array_of_pixels = hpix_map_pixels(map);
+
+    /* Every other pixel is masked: the average must ignore them */
+    for(hpix_pixel_num_t index = 0;
+	index < hpix_map_num_of_pixels(map);
+	++index)
+    {
+	array_of_pixels[index] = (index % 2 == 0) ? 3.0 : -1.6375e+30;
+    }
+
+    hpix_bmp_projection_t * proj = hpix_create_bmp_projection(32, 16);
+    hpix_set_mollweide_projection(proj);
+
+    /* One sample per element must give the same result as the
+     * nearest-pixel plan */
+    hpix_bmp_projection_plan_t * nearest_plan =
+	hpix_create_bmp_projection_plan(proj, 64, HPIX_ORDER_SCHEME_NEST);
+    hpix_bmp_projection_plan_t * single_plan =
+	hpix_create_bmp_sampling_plan(proj, 64, HPIX_ORDER_SCHEME_NEST,
+				      HPIX_BMP_SAMPLE_SUPERSAMPLE, 1);
+    double * nearest_bmp =
+	hpix_bmp_projection_plan_trace(nearest_plan, map, NULL, NULL);
+    double * single_bmp =
+	hpix_bmp_projection_plan_trace(single_plan, map, NULL, NULL);
+
+    fail_unless(hpix_bmp_projection_plan_offsets(nearest_plan) == NULL);
+    for(size_t index = 0; index < 32 * 16; ++index)
+    {
+	fail_unless((isinf(nearest_bmp[index]) && isinf(single_bmp[index]))
+		    || (isnan(nearest_bmp[index]) && isnan(single_bmp[index]))
+		    || nearest_bmp[index] == single_bmp[index],
+		    "Difference in pixel %u", (unsigned) index);
+    }
+
+    hpix_free(nearest_bmp);
+    hpix_free(single_bmp);
+    hpix_free_bmp_projection_plan(single_plan);
+
+    hpix_bmp_projection_plan_t * plans[] = {
+	hpix_create_bmp_sampling_plan(proj, 64, HPIX_ORDER_SCHEME_NEST,
+				      HPIX_BMP_SAMPLE_SUPERSAMPLE, 4),
+	hpix_create_bmp_sampling_plan(proj, 64, HPIX_ORDER_SCHEME_NEST,
+				      HPIX_BMP_SAMPLE_AREA, 0)
+    };
+
+    ck_assert_int_eq(hpix_bmp_projection_plan_samples_per_side(plans[0]), 4);
+    /* Each element of the bitmap is ~11 degrees wide, while a pixel
+     * is less than one degree wide */
+    fail_unless(hpix_bmp_projection_plan_samples_per_side(plans[1]) > 4);
+
+    for(int plan_idx = 0; plan_idx < 2; ++plan_idx)
+    {
+	const size_t * offsets = hpix_bmp_projection_plan_offsets(plans[plan_idx]);
+	const float * weights = hpix_bmp_projection_plan_weights(plans[plan_idx]);
+	double min, max;
+	double * bmp = hpix_bmp_projection_plan_trace(plans[plan_idx], map,
+						      &min, &max);
+
+	fail_unless(min == 3.0 && max == 3.0,
+		    "Wrong range for plan %d: [%f, %f]", plan_idx, min, max);
+
+	for(size_t index = 0; index < 32 * 16; ++index)
+	{
+	    double sum_of_weights = 0.0;
+	    for(size_t sample = offsets[index];
+		sample < offsets[index + 1];
+		++sample)
+	    {
+		sum_of_weights += weights[sample];
+	    }
+	    fail_unless(sum_of_weights < 1.0 + 1e-5);
+
+	    /* Elements which are at least partially inside the ellipse
+	     * cannot be fully transparent */
+	    if(hpix_bmp_projection_is_xy_inside(proj, index % 32, index / 32))
+		fail_unless(! isinf(bmp[index]),
+			    "Pixel %u is INFINITY", (unsigned) index);
+	}
+
+	hpix_free(bmp);
+	hpix_free_bmp_projection_plan(plans[plan_idx]);
+    }
+
+    hpix_free_bmp_projection_plan(nearest_plan);
+    hpix_free_bmp_projection(proj);
+    hpix_free_map(map);
+}
+END_TEST
+
+/**********************************************************************/
+
+START_TEST(sampling_plans_alignment)
+{
+    /* A smooth map: the average of the samples within an element must
+     * be close to the value at the point seen by the nearest-pixel
+     * plan, otherwise switching between the two plans would shift the
+     * image */
+    hpix_map_t * map = hpix_create_map(256, HPIX_ORDER_SCHEME_RING);
+    double *restrict array_of_pixels = hpix_map_pixels(map);
+    for(hpix_pixel_num_t index = 0;
+	index < hpix_map_num_of_pixels(map);
+	++index)
+    {
+	double theta, phi;
+	hpix_ring_pixel_to_angles(hpix_map_resolution(map), index,
+				  &theta, &phi);
+	array_of_pixels[index] = cos(theta) + sin(theta) * cos(phi);
+    }
+
+    hpix_bmp_projection_t * proj = hpix_create_bmp_projection(64, 32);
+    hpix_set_equirectangular_projection(proj);
+
+    hpix_bmp_projection_plan_t * nearest_plan =
+	hpix_create_bmp_projection_plan(proj, 256, HPIX_ORDER_SCHEME_RING);
+    hpix_bmp_projection_plan_t * supersample_plan =
+	hpix_create_bmp_sampling_plan(proj, 256, HPIX_ORDER_SCHEME_RING,
+				      HPIX_BMP_SAMPLE_SUPERSAMPLE, 4);
+    double * nearest_bmp =
+	hpix_bmp_projection_plan_trace(nearest_plan, map, NULL, NULL);
+    double * supersample_bmp =
+	hpix_bmp_projection_plan_trace(supersample_plan, map, NULL, NULL);
+
+    /* Elements in the first row/column lose the samples falling
+     * outside the bitmap */
+    for(unsigned int y = 1; y < 32; ++y)
+    {
+	for(unsigned int x = 1; x < 64; ++x)
+	{
+	    const size_t index = y * 64 + x;
+	    fail_unless(fabs(nearest_bmp[index] - supersample_bmp[index])
+			< 2e-2,
+			"Element (%u, %u) is %f with one sample, %f with 4x4",
+			x, y, nearest_bmp[index], supersample_bmp[index]);
+	}
+    }
+
+    hpix_free(nearest_bmp);
+    hpix_free(supersample_bmp);
+    hpix_free_bmp_projection_plan(nearest_plan);
+    hpix_free_bmp_projection_plan(supersample_plan);
+    hpix_free_bmp_projection(proj);
+    hpix_free_map(map);
+}
+END_TEST
+
+/**********************************************************************/
+
+START_TEST(fused_rendering)
+{
+    hpix_map_t * map = hpix_create_map(32, HPIX_ORDER_SCHEME_RING);
+    double *restrict array_of_pixels = hpix_map_pixels(map);
+
+    for(hpix_pixel_num_t index = 0;
+	index < hpix_map_num_of_pixels(map);
+	++index)
+    {
+	array_of_pixels[index] = (index % 7 == 0)
+	    ? -1.6375e+30 : sin(0.01 * index);
+    }
+
+    hpix_color_palette_t * palette = hpix_create_healpix_color_palette();
+    hpix_palette_lut_t * lut =
+	hpix_create_palette_lut(palette, HPIX_PALETTE_LUT_DEFAULT_SIZE);
+
+    /* The width is not a multiple of the internal chunk size, and
+     * the destination rows are padded */
+    const unsigned int width = 300;
+    const unsigned int height = 150;
+    const size_t stride = (width + 5) * sizeof(uint32_t);
+    hpix_bmp_projection_t * proj = hpix_create_bmp_projection(width, height);
+    hpix_set_mollweide_projection(proj);
+
+    hpix_bmp_projection_plan_t * plans[] = {
+	hpix_create_bmp_projection_plan(proj, 32, HPIX_ORDER_SCHEME_RING),
+	hpix_create_bmp_sampling_plan(proj, 32, HPIX_ORDER_SCHEME_RING,
+				      HPIX_BMP_SAMPLE_SUPERSAMPLE, 2)
+    };
+
+    uint32_t * fused = malloc(stride * height);
+    uint32_t * reference = malloc(stride * height);
+
+    for(int plan_idx = 0; plan_idx < 2; ++plan_idx)
+    {
+	/* The pre-pass must give the same range as the full trace */
+	double min, max;
+	double trace_min, trace_max;
+	double * bitmap = hpix_bmp_projection_plan_trace(plans[plan_idx], map,
+							 &trace_min, &trace_max);
+	hpix_bmp_projection_plan_range(plans[plan_idx], map, &min, &max);
+	fail_unless(min == trace_min && max == trace_max,
+		    "Wrong range for plan %d: [%f, %f] instead of [%f, %f]",
+		    plan_idx, min, max, trace_min, trace_max);
+
+	hpix_palette_lut_colorize(lut, bitmap, width, height, min, max,
+				  reference, stride);
+	hpix_bmp_projection_plan_render(plans[plan_idx], map, lut, min, max,
+					fused, stride);
+
+	for(unsigned int y = 0; y < height; ++y)
+	{
+	    for(unsigned int x = 0; x < width; ++x)
+	    {
+		const size_t index = y * (stride / sizeof(uint32_t)) + x;
+		fail_unless(fused[index] == reference[index],
+			    "Plan %d, element (%u, %u): %08x instead of %08x",
+			    plan_idx, x, y, fused[index], reference[index]);
+	    }
+	}
+
+	hpix_free(bitmap);
+	hpix_free_bmp_projection_plan(plans[plan_idx]);
+    }
+
+    free(fused);
+    free(reference);
+    hpix_free_bmp_projection(proj);
+    hpix_free_palette_lut(lut);
+    hpix_free_color_palette(palette);
+    hpix_free_map(map);
+}
+END_TEST
+
+/**********************************************************************/
+
+/* Decode the PNG image in `file`, checking the CRC of every chunk,
+ * and return the concatenation of its scanlines (each starting with
+ * the filter byte). Return NULL if the file is not valid. Stored
+ * deflate blocks are decoded here, so that the test does not need
+ * zlib if HPixLib was compiled without it. */
+static unsigned char *
+decode_png(FILE * file, unsigned int width, unsigned int height)
+{
+    uint32_t crc_table[256];
+    for(uint32_t n = 0; n < 256; ++n)
+    {
+	uint32_t c = n;
+	for(int k = 0; k < 8; ++k)
+	    c = (c & 1) ? UINT32_C(0xEDB88320) ^ (c >> 1) : c >> 1;
+	crc_table[n] = c;
+    }
+
+    unsigned char signature[8];
+    rewind(file);
+    if(fread(signature, 1, 8, file) != 8
+       || memcmp(signature, "\x89PNG\r\n\x1a\n", 8) != 0)
+	return NULL;
+
+    /* Concatenate the content of the IDAT chunks */
+    unsigned char * stream = NULL;
+    size_t stream_size = 0;
+    int end_found = 0;
+    while(! end_found)
+    {
+	unsigned char header[8], trailer[4];
+	if(fread(header, 1, 8, file) != 8)
+	    break;
+
+	const size_t length = ((size_t) header[0] << 24) | (header[1] << 16)
+	    | (header[2] << 8) | header[3];
+	unsigned char * data = malloc(length + 4);
+	memcpy(data, header + 4, 4);
+	if(fread(data + 4, 1, length, file) != length
+	   || fread(trailer, 1, 4, file) != 4)
+	{
+	    free(data);
+	    break;
+	}
+
+	uint32_t crc = UINT32_C(0xFFFFFFFF);
+	for(size_t idx = 0; idx < length + 4; ++idx)
+	    crc = crc_table[(crc ^ data[idx]) & 0xFF] ^ (crc >> 8);
+	crc ^= UINT32_C(0xFFFFFFFF);
+	fail_unless(crc == (((uint32_t) trailer[0] << 24) | (trailer[1] << 16)
+			    | (trailer[2] << 8) | trailer[3]),
+		    "Wrong CRC for chunk %.4s", header + 4);
+
+	if(memcmp(header + 4, "IDAT", 4) == 0)
+	{
+	    stream = realloc(stream, stream_size + length);
+	    memcpy(stream + stream_size, data + 4, length);
+	    stream_size += length;
+	}
+	else if(memcmp(header + 4, "IEND", 4) == 0)
+	    end_found = 1;
+
+	free(data);
+    }
+
+    const size_t image_size = (1 + 4 * (size_t) width) * height;
+    unsigned char * image = malloc(image_size);
+    int success = end_found && stream_size >= 6;
+
+#ifdef HAVE_ZLIB
+    uLongf decoded_size = image_size;
+    success = success
+	&& uncompress(image, &decoded_size, stream, stream_size) == Z_OK
+	&& decoded_size == image_size;
+#else
+    /* Skip the zlib header, then decode the stored blocks */
+    size_t pos = 2;
+    size_t decoded_size = 0;
+    int is_final = 0;
+    while(success && ! is_final)
+    {
+	if(pos + 5 > stream_size || (stream[pos] & 0x06) != 0)
+	{
+	    success = 0;
+	    break;
+	}
+
+	const size_t length = stream[pos + 1] | (stream[pos + 2] << 8);
+	const size_t complement = stream[pos + 3] | (stream[pos + 4] << 8);
+	is_final = stream[pos] & 1;
+	pos += 5;
+
+	if((length ^ complement) != 0xFFFF
+	   || pos + length > stream_size
+	   || decoded_size + length > image_size)
+	{
+	    success = 0;
+	    break;
+	}
+
+	memcpy(image + decoded_size, stream + pos, length);
+	decoded_size += length;
+	pos += length;
+    }
+
+    /* The stream ends with the Adler-32 checksum of the data */
+    uint32_t adler_a = 1, adler_b = 0;
+    for(size_t idx = 0; idx < decoded_size; ++idx)
+    {
+	adler_a = (adler_a + image[idx]) % 65521;
+	adler_b = (adler_b + adler_a) % 65521;
+    }
+    success = success
+	&& decoded_size == image_size
+	&& pos + 4 == stream_size
+	&& (((uint32_t) stream[pos] << 24) | (stream[pos + 1] << 16)
+	    | (stream[pos + 2] << 8) | stream[pos + 3])
+	== ((adler_b << 16) | adler_a);
+#endif
+
+    free(stream);
+    if(! success)
+    {
+	free(image);
+	return NULL;
+    }
+
+    return image;
+}
+
+/**********************************************************************/
+
+/* Write an image with the PNG writer, decode it and compare the
+ * result with the original colors */
+static void
+check_png_roundtrip(const uint32_t * colors,
+		    unsigned int width, unsigned int height)
+{
+    FILE * png_file = tmpfile();
+    hpix_image_writer_t * writer =
+	hpix_create_image_writer(png_file, HPIX_IMAGE_FORMAT_PNG,
+				 width, height);
+    fail_unless(hpix_image_writer_write_rows(writer, colors,
+					     width * sizeof(uint32_t),
+					     height));
+    fail_unless(hpix_close_image_writer(writer));
+
+    unsigned char * image = decode_png(png_file, width, height);
+    fail_unless(image != NULL, "Unable to decode a %ux%u PNG image",
+		width, height);
+    fclose(png_file);
+
+    for(unsigned int y = 0; y < height; ++y)
+    {
+	const unsigned char * scanline = image + y * (1 + 4 * (size_t) width);
+	ck_assert_int_eq(scanline[0], 0);
+	for(unsigned int x = 0; x < width; ++x)
+	{
+	    const uint32_t color = colors[y * width + x];
+	    const unsigned char * rgba = scanline + 1 + 4 * x;
+	    fail_unless(rgba[0] == ((color >> 16) & 0xFF)
+			&& rgba[1] == ((color >> 8) & 0xFF)
+			&& rgba[2] == (color & 0xFF)
+			&& rgba[3] == (color >> 24),
+			"Wrong color for element (%u, %u)", x, y);
+	}
+    }
+
+    free(image);
+}
+
+/**********************************************************************/
+
+START_TEST(png_writer)
+{
+    /* The largest image has much more than 64 KB of data, so it spans
+     * several IDAT chunks (and deflate blocks, if it is not
+     * compressed) */
+    const unsigned int sizes[][2] = { { 1, 1 }, { 30, 20 }, { 200, 200 } };
+
+    for(int size_idx = 0; size_idx < 3; ++size_idx)
+    {
+	const unsigned int width = sizes[size_idx][0];
+	const unsigned int height = sizes[size_idx][1];
+	uint32_t * colors = malloc(sizeof(uint32_t) * width * height);
+
+	/* Pseudo-random colors, so that zlib cannot shrink them much */
+	uint32_t state = 12345;
+	for(size_t idx = 0; idx < (size_t) width * height; ++idx)
+	{
+	    state = state * 1103515245 + 12345;
+	    colors[idx] = state;
+	}
+
+	check_png_roundtrip(colors, width, height);
+	free(colors);
+    }
+}
+END_TEST
+
+/**********************************************************************/
+
+START_TEST(tile_rendering)
+{
+    hpix_map_t * map = hpix_create_map(16, HPIX_ORDER_SCHEME_NEST);
+    double *restrict array_of_pixels = hpix_map_pixels(map);
+
+    for(hpix_pixel_num_t index = 0;
+	index < hpix_map_num_of_pixels(map);
+	++index)
+    {
+	array_of_pixels[index] = (index % 5 == 0)
+	    ? -1.6375e+30 : cos(0.1 * index);
+    }
+
+    hpix_color_palette_t * palette = hpix_create_planck_color_palette();
+    hpix_palette_lut_t * lut =
+	hpix_create_palette_lut(palette, HPIX_PALETTE_LUT_DEFAULT_SIZE);
+
+    /* Neither dimension is a multiple of the tile size */
+    const unsigned int width = 100;
+    const unsigned int height = 50;
+    const size_t stride = width * sizeof(uint32_t);
+    hpix_bmp_projection_t * proj = hpix_create_bmp_projection(width, height);
+    hpix_set_mollweide_projection(proj);
+
+    hpix_bmp_projection_plan_t * plan =
+	hpix_create_bmp_projection_plan(proj, 16, HPIX_ORDER_SCHEME_NEST);
+    uint32_t * reference = malloc(stride * height);
+    hpix_bmp_projection_plan_render(plan, map, lut, -1.0, 1.0,
+				    reference, stride);
+
+    hpix_bmp_tile_renderer_t * renderer =
+	hpix_create_bmp_tile_renderer(proj, map, lut, -1.0, 1.0, 32);
+    ck_assert_int_eq(hpix_bmp_tile_renderer_num_of_columns(renderer), 4);
+    ck_assert_int_eq(hpix_bmp_tile_renderer_num_of_rows(renderer), 2);
+
+    /* Full-resolution tiles must match the plan, while coarse tiles
+     * replicate the upper left element of each block */
+    uint32_t * image = malloc(stride * height);
+    for(unsigned int step = 1; step <= 4; step += 3)
+    {
+	for(unsigned int row = 0; row < 2; ++row)
+	{
+	    for(unsigned int column = 0; column < 4; ++column)
+	    {
+		hpix_bmp_tile_renderer_render_tile(renderer, column, row, step,
+						   image + row * 32 * width
+						   + column * 32,
+						   stride);
+	    }
+	}
+
+	for(unsigned int y = 0; y < height; ++y)
+	{
+	    for(unsigned int x = 0; x < width; ++x)
+	    {
+		const unsigned int ref_x = x - (x % 32) % step;
+		const unsigned int ref_y = y - (y % 32) % step;
+		fail_unless(image[y * width + x]
+			    == reference[ref_y * width + ref_x],
+			    "Step %u, element (%u, %u) is wrong", step, x, y);
+	    }
+	}
+    }
+
+    /* The preview samples the center of each block */
+    uint32_t preview[13 * 25];
+    hpix_bmp_tile_renderer_render_preview(renderer, 4, preview,
+					  25 * sizeof(uint32_t));
+    for(unsigned int y = 0; y < 13; ++y)
+    {
+	for(unsigned int x = 0; x < 25; ++x)
+	{
+	    const unsigned int ref_y = (y * 4 + 2 < height) ? y * 4 + 2 : height - 1;
+	    fail_unless(preview[y * 25 + x] == reference[ref_y * width + x * 4 + 2],
+			"Preview element (%u, %u) is wrong", x, y);
+	}
+    }
+
+    /* A raw stream contains the image as it is */
+    FILE * raw_file = tmpfile();
+    hpix_image_writer_t * writer =
+	hpix_create_image_writer(raw_file, HPIX_IMAGE_FORMAT_RAW, width, height);
+    fail_unless(hpix_bmp_tile_renderer_write(renderer, 1, writer));
+    fail_unless(hpix_close_image_writer(writer));
+
+    rewind(raw_file);
+    ck_assert_int_eq(fread(image, stride, height, raw_file), height);
+    fail_unless(memcmp(image, reference, stride * height) == 0);
+    fclose(raw_file);
+
+    /* Check the structure of the PNG file */
+    FILE * png_file = tmpfile();
+    writer = hpix_create_image_writer(png_file, HPIX_IMAGE_FORMAT_PNG,
+				      width, height);
+    fail_unless(hpix_bmp_tile_renderer_write(renderer, 1, writer));
+    fail_unless(hpix_close_image_writer(writer));
+
+    unsigned char header[24];
+    rewind(png_file);
+    ck_assert_int_eq(fread(header, 1, sizeof(header), png_file), sizeof(header));
+    fail_unless(memcmp(header, "\x89PNG\r\n\x1a\n", 8) == 0);
+    fail_unless(memcmp(header + 12, "IHDR", 4) == 0);
+    ck_assert_int_eq((header[18] << 8) + header[19], width);
+    ck_assert_int_eq((header[22] << 8) + header[23], height);
+
+    unsigned char trailer[12];
+    fseek(png_file, -12, SEEK_END);
+    ck_assert_int_eq(fread(trailer, 1, sizeof(trailer), png_file), sizeof(trailer));
+    fail_unless(memcmp(trailer + 4, "IEND", 4) == 0);
+    fclose(png_file);
+
+    free(image);
+    free(reference);
+    hpix_free_bmp_tile_renderer(renderer);
+    hpix_free_bmp_projection_plan(plan);
+    hpix_free_bmp_projection(proj);
+    hpix_free_palette_lut(lut);
+    hpix_free_color_palette(palette);
+    hpix_free_map(map);
+}
+END_TEST
+
+/**********************************************************************/
+
+/* Index of the element (column, row) in a HiPS tile, relative to the
+ * first NEST pixel of the tile */
+static hpix_pixel_num_t
+hips_element_offset(unsigned int tile_width,
+		    unsigned int column,
+		    unsigned int row)
+{
+    const unsigned int x = tile_width - 1 - column;
+    const unsigned int y = tile_width - 1 - row;
+    hpix_pixel_num_t result = 0;
+
+    for(unsigned int bit = 0; (1u << bit) < tile_width; ++bit)
+    {
+	result |= (hpix_pixel_num_t) ((x >> bit) & 1) << (2 * bit);
+	result |= (hpix_pixel_num_t) ((y >> bit) & 1) << (2 * bit + 1);
+    }
+
+    return result;
+}
+
+/* Remove the files written by `hpix_write_hips_tiles` for orders up
+ * to `max_order` (assuming that each order has only one directory) */
+static void
+remove_hips_tiles(const char * root_dir, unsigned int max_order)
+{
+    char file_name[256];
+
+    for(unsigned int order = 0; order <= max_order; ++order)
+    {
+	for(unsigned int tile = 0; tile < (12u << (2 * order)); ++tile)
+	{
+	    snprintf(file_name, sizeof(file_name),
+		     "%s/Norder%u/Dir0/Npix%u.png", root_dir, order, tile);
+	    remove(file_name);
+	}
+	snprintf(file_name, sizeof(file_name), "%s/Norder%u/Dir0",
+		 root_dir, order);
+	remove(file_name);
+	snprintf(file_name, sizeof(file_name), "%s/Norder%u", root_dir, order);
+	remove(file_name);
+    }
+    snprintf(file_name, sizeof(file_name), "%s/properties", root_dir);
+    remove(file_name);
+    remove(root_dir);
+}
+
+/**********************************************************************/
+
+START_TEST(hips_tiles)
+{
+    /* Each pixel of the map selects one of the 16 colors in the LUT */
+    hpix_map_t * map = hpix_create_map(16, HPIX_ORDER_SCHEME_NEST);
+    double *restrict array_of_pixels = hpix_map_pixels(map);
+    for(hpix_pixel_num_t index = 0;
+	index < hpix_map_num_of_pixels(map);
+	++index)
+    {
+	array_of_pixels[index] = index % 16;
+    }
+
+    hpix_color_palette_t * palette = hpix_create_grayscale_color_palette();
+    hpix_palette_lut_t * lut = hpix_create_palette_lut(palette, 16);
+    const uint32_t * colors = hpix_palette_lut_entries(lut);
+    uint32_t image[16 * 16];
+
+    /* Tile 37 at order 1 (16x16 elements at NSIDE 32), where each map
+     * pixel covers 2x2 elements */
+    hpix_render_hips_tile(map, 1, 37, 16, lut, 0.0, 15.0,
+			  image, 16 * sizeof(uint32_t));
+    for(unsigned int row = 0; row < 16; ++row)
+    {
+	for(unsigned int column = 0; column < 16; ++column)
+	{
+	    const hpix_pixel_num_t element =
+		37 * 256 + hips_element_offset(16, column, row);
+	    fail_unless(image[row * 16 + column] == colors[(element / 4) % 16],
+			"Wrong color for element (%u, %u)", column, row);
+	}
+    }
+
+    /* The upper left corner of tile 0 at order 0 points towards the
+     * North pole, the lower right one towards the equator. The upper
+     * right and lower left corners are at phi = 0 and pi/2. */
+    hpix_resolution_t * resolution = hpix_create_resolution(16);
+    double theta[4], phi[4];
+    const unsigned int corners[4][2] = { { 0, 0 }, { 15, 15 },
+					 { 0, 15 }, { 15, 0 } };
+    for(int corner = 0; corner < 4; ++corner)
+	hpix_nest_pixel_to_angles(resolution,
+				  hips_element_offset(16, corners[corner][0],
+						      corners[corner][1]),
+				  &theta[corner], &phi[corner]);
+
+    fail_unless(theta[0] < 0.1);
+    fail_unless(fabs(theta[1] - M_PI_2) < 0.1);
+    fail_unless(phi[3] < 0.1 && fabs(phi[2] - M_PI_2) < 0.1);
+    hpix_free_resolution(resolution);
+
+    /* Write a whole tile set */
+    const char * root_dir = "test_hips";
+
+    hpix_map_pyramid_t * pyramid =
+	hpix_create_map_pyramid(map, HPIX_PYRAMID_MEAN);
+    fail_unless(hpix_write_hips_tiles(pyramid, lut, 0.0, 15.0, 8, 1,
+				      "ivo://hpixlib/test", "Test map",
+				      root_dir));
+
+    char file_name[256];
+    const char * expected_files[] = {
+	"properties",
+	"Norder0/Dir0/Npix0.png",
+	"Norder0/Dir0/Npix11.png",
+	"Norder1/Dir0/Npix47.png"
+    };
+    for(int idx = 0; idx < 4; ++idx)
+    {
+	snprintf(file_name, sizeof(file_name), "%s/%s",
+		 root_dir, expected_files[idx]);
+	FILE * file = fopen(file_name, "rb");
+	fail_unless(file != NULL, "File %s not found", file_name);
+	fclose(file);
+    }
+
+    /* Keys required by the HiPS standard */
+    const char * expected_keys[] = {
+	"creator_did = ivo://hpixlib/test\n",
+	"obs_title = Test map\n",
+	"hips_release_date = ",
+	"hips_status = ",
+	"hips_frame = ",
+	"hips_order = 1\n",
+	"hips_tile_width = 8\n"
+    };
+    char properties[1024];
+    snprintf(file_name, sizeof(file_name), "%s/properties", root_dir);
+    FILE * file = fopen(file_name, "rt");
+    const size_t properties_size =
+	fread(properties, 1, sizeof(properties) - 1, file);
+    properties[properties_size] = '\0';
+    fclose(file);
+    for(int idx = 0; idx < 7; ++idx)
+	fail_unless(strstr(properties, expected_keys[idx]) != NULL,
+		    "Key \"%s\" not found in the properties", expected_keys[idx]);
+
+    remove_hips_tiles(root_dir, 1);
+    hpix_free_map_pyramid(pyramid);
+
+    /* Tiles of 512x512 elements (the usual size) have much more than
+     * 64 KB of data each */
+    pyramid = hpix_create_map_pyramid(map, HPIX_PYRAMID_MEAN);
+    fail_unless(hpix_write_hips_tiles(pyramid, lut, 0.0, 15.0, 512, 0,
+				      "ivo://hpixlib/test", "Test map",
+				      root_dir));
+
+    uint32_t * large_image = malloc(512 * 512 * sizeof(uint32_t));
+    hpix_render_hips_tile(map, 0, 5, 512, lut, 0.0, 15.0,
+			  large_image, 512 * sizeof(uint32_t));
+
+    snprintf(file_name, sizeof(file_name), "%s/Norder0/Dir0/Npix5.png",
+	     root_dir);
+    file = fopen(file_name, "rb");
+    fail_unless(file != NULL, "File %s not found", file_name);
+    unsigned char * scanlines = decode_png(file, 512, 512);
+    fail_unless(scanlines != NULL, "Unable to decode %s", file_name);
+    fclose(file);
+
+    for(unsigned int row = 0; row < 512; ++row)
+    {
+	for(unsigned int column = 0; column < 512; ++column)
+	{
+	    const uint32_t color = large_image[row * 512 + column];
+	    const unsigned char * rgba =
+		scanlines + row * (1 + 4 * 512) + 1 + 4 * column;
+	    fail_unless(rgba[0] == ((color >> 16) & 0xFF)
+			&& rgba[1] == ((color >> 8) & 0xFF)
+			&& rgba[2] == (color & 0xFF)
+			&& rgba[3] == (color >> 24),
+			"Wrong color for element (%u, %u)", column, row);
+	}
+    }
+
+    free(scanlines);
+    free(large_image);
+    remove_hips_tiles(root_dir, 0);
+
+    hpix_free_map_pyramid(pyramid);
+    hpix_free_palette_lut(lut);
+    hpix_free_color_palette(palette);
+    hpix_free_map(map);
+}
+END_TEST
+
+/**********************************************************************/
+
+START_TEST(frame_sequences)
+{
+    const size_t num_of_frames = 5;
+    hpix_map_t * maps[5];
+
+    for(size_t frame = 0; frame < num_of_frames; ++frame)
+    {
+	maps[frame] = hpix_create_map(16, HPIX_ORDER_SCHEME_RING);
+	double *restrict array_of_pixels = hpix_map_pixels(maps[frame]);
+	for(hpix_pixel_num_t index = 0;
+	    index < hpix_map_num_of_pixels(maps[frame]);
+	    ++index)
+	{
+	    array_of_pixels[index] = (index % 11 == 0)
+		? -1.6375e+30 : (frame + 1) * sin(0.01 * index + frame);
+	}
+    }
+
+    hpix_color_palette_t * palette = hpix_create_healpix_color_palette();
+    hpix_palette_lut_t * lut =
+	hpix_create_palette_lut(palette, HPIX_PALETTE_LUT_DEFAULT_SIZE);
+
+    const unsigned int width = 90;
+    const unsigned int height = 45;
+    const size_t stride = width * sizeof(uint32_t);
+    hpix_bmp_projection_t * proj = hpix_create_bmp_projection(width, height);
+    hpix_set_mollweide_projection(proj);
+    hpix_bmp_projection_plan_t * plan =
+	hpix_create_bmp_projection_plan(proj, 16, HPIX_ORDER_SCHEME_RING);
+
+    /* The range of the sequence encloses the range of every frame */
+    double min, max;
+    double expected_min = INFINITY, expected_max = -INFINITY;
+    for(size_t frame = 0; frame < num_of_frames; ++frame)
+    {
+	double frame_min, frame_max;
+	hpix_bmp_projection_plan_range(plan, maps[frame],
+				       &frame_min, &frame_max);
+	expected_min = fmin(expected_min, frame_min);
+	expected_max = fmax(expected_max, frame_max);
+    }
+
+    hpix_frame_sequence_range(plan, (const hpix_map_t * const *) maps,
+			      num_of_frames, &min, &max);
+    fail_unless(min == expected_min && max == expected_max,
+		"Wrong range for the sequence: [%f, %f] instead of [%f, %f]",
+		min, max, expected_min, expected_max);
+
+    /* Frames must appear in the stream in the same order as the maps */
+    uint32_t * image = malloc(stride * height);
+    uint32_t * reference = malloc(stride * height);
+    FILE * raw_file = tmpfile();
+    fail_unless(hpix_write_frame_stream(plan, lut, min, max,
+					(const hpix_map_t * const *) maps,
+					num_of_frames, raw_file));
+    rewind(raw_file);
+    for(size_t frame = 0; frame < num_of_frames; ++frame)
+    {
+	hpix_bmp_projection_plan_render(plan, maps[frame], lut, min, max,
+					reference, stride);
+	ck_assert_int_eq(fread(image, stride, height, raw_file), height);
+	fail_unless(memcmp(image, reference, stride * height) == 0,
+		    "Frame %u differs from the reference", (unsigned) frame);
+    }
+    fail_unless(fgetc(raw_file) == EOF);
+    fclose(raw_file);
+
+    /* Numbered PNG files */
+    fail_unless(hpix_write_frame_files(plan, lut, min, max,
+				       (const hpix_map_t * const *) maps,
+				       num_of_frames, "test_frame%03u.png", 10));
+    for(unsigned int number = 10; number < 10 + num_of_frames; ++number)
+    {
+	char file_name[32];
+	unsigned char signature[8];
+	const unsigned char png_signature[] = {
+	    0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'
+	};
+
+	snprintf(file_name, sizeof(file_name), "test_frame%03u.png", number);
+	FILE * file = fopen(file_name, "rb");
+	fail_unless(file != NULL, "File %s not found", file_name);
+	ck_assert_int_eq(fread(signature, 1, sizeof(signature), file),
+			 sizeof(signature));
+	fail_unless(memcmp(signature, png_signature, sizeof(signature)) == 0);
+	fclose(file);
+	remove(file_name);
+    }
+
+    /* The template is a format string: anything but one conversion
+     * for an unsigned int must be rejected */
+    const char * wrong_templates[] = {
+	"test_frame.png",
+	"test_frame%s.png",
+	"test_frame%u_%u.png",
+	"test_frame%lu.png",
+	"test_frame%*u.png",
+	"test_frame%"
+    };
+    for(int idx = 0; idx < 6; ++idx)
+	fail_unless(! hpix_write_frame_files(plan, lut, min, max,
+					     (const hpix_map_t * const *) maps,
+					     1, wrong_templates[idx], 0),
+		    "Template \"%s\" was accepted", wrong_templates[idx]);
+
+    fail_unless(hpix_write_frame_files(plan, lut, min, max,
+				       (const hpix_map_t * const *) maps,
+				       1, "test_frame%%%02x.png", 10));
+    FILE * percent_file = fopen("test_frame%0a.png", "rb");
+    fail_unless(percent_file != NULL, "File test_frame%%0a.png not found");
+    fclose(percent_file);
+    remove("test_frame%0a.png");
+
+    free(image);
+    free(reference);
+    hpix_free_bmp_projection_plan(plan);
+    hpix_free_bmp_projection(proj);
+
+    /* Frames of 200x100 elements have more than 64 KB of data each:
+     * decode them and compare them with the rendered images */
+    const unsigned int large_width = 200;
+    const unsigned int large_height = 100;
+    const size_t large_stride = large_width * sizeof(uint32_t);
+    proj = hpix_create_bmp_projection(large_width, large_height);
+    hpix_set_mollweide_projection(proj);
+    plan = hpix_create_bmp_projection_plan(proj, 16, HPIX_ORDER_SCHEME_RING);
+    reference = malloc(large_stride * large_height);
+
+    fail_unless(hpix_write_frame_files(plan, lut, min, max,
+				       (const hpix_map_t * const *) maps,
+				       2, "test_frame%03u.png", 0));
+    for(unsigned int number = 0; number < 2; ++number)
+    {
+	char file_name[32];
+
+	hpix_bmp_projection_plan_render(plan, maps[number], lut, min, max,
+					reference, large_stride);
+
+	snprintf(file_name, sizeof(file_name), "test_frame%03u.png", number);
+	FILE * file = fopen(file_name, "rb");
+	fail_unless(file != NULL, "File %s not found", file_name);
+	unsigned char * scanlines = decode_png(file, large_width, large_height);
+	fail_unless(scanlines != NULL, "Unable to decode %s", file_name);
+	fclose(file);
+	remove(file_name);
+
+	for(unsigned int row = 0; row < large_height; ++row)
+	{
+	    for(unsigned int column = 0; column < large_width; ++column)
+	    {
+		const uint32_t color = reference[row * large_width + column];
+		const unsigned char * rgba =
+		    scanlines + row * (1 + large_stride) + 1 + 4 * column;
+		fail_unless(rgba[0] == ((color >> 16) & 0xFF)
+			    && rgba[1] == ((color >> 8) & 0xFF)
+			    && rgba[2] == (color & 0xFF)
+			    && rgba[3] == (color >> 24),
+			    "Wrong color for element (%u, %u) of frame %u",
+			    column, row, number);
+	    }
+	}
+	free(scanlines);
+    }
+
+    free(reference);
+    hpix_free_bmp_projection_plan(plan);
+    hpix_free_bmp_projection(proj);
+    hpix_free_palette_lut(lut);
+    hpix_free_color_palette(palette);
+    for(size_t frame = 0; frame < num_of_frames; ++frame)
+	hpix_free_map(maps[frame]);
+}
+END_TEST
+
+/**********************************************************************/
+
 void
 add_projection_tests_to_testcase(TCase * testcase)
 {
     tcase_add_test(testcase, projection_size);
+    tcase_add_test(testcase, projection_plan);
+    tcase_add_test(testcase, sampling_plans);
+    tcase_add_test(testcase, sampling_plans_alignment);
+    tcase_add_test(testcase, fused_rendering);
+    tcase_add_test(testcase, png_writer);
+    tcase_add_test(testcase, tile_rendering);
+    tcase_add_test(testcase, hips_tiles);
+    tcase_add_test(testcase, frame_sequences);
 }
 
 /**********************************************************************/
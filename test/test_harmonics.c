@@ -0,0 +1,940 @@
+/* test_harmonics.c -- check the spherical harmonic transforms
+ *
+ * Copyright 2011-2013 Maurizio Tomasi.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.  */
+
+#include <hpixlib/hpix.h>
+#include <math.h>
+#include <stdlib.h>
+#include <check.h>
+#include "check_helpers.h"
+#include "constants.h"
+#include "psht.h"
+#include "psht_almhelpers.h"
+#include "psht_geomhelpers.h"
+#include "ls_fft.h"
+
+/* Tolerance used when comparing the result of a map2alm with the
+ * original coefficients (map2alm is not exact on Healpix grids) */
+#define ALM_TOLERANCE 1e-3
+
+/**********************************************************************/
+
+START_TEST(alm_layout)
+{
+    hpix_alm_t * alm = hpix_create_alm(10, 4);
+
+    ck_assert_int_eq(hpix_alm_lmax(alm), 10);
+    ck_assert_int_eq(hpix_alm_mmax(alm), 4);
+    ck_assert_int_eq(hpix_alm_num_of_coefficients(alm), 11 + 10 + 9 + 8 + 7);
+
+    ck_assert_int_eq(hpix_alm_index(alm, 0, 0), 0);
+    ck_assert_int_eq(hpix_alm_index(alm, 10, 0), 10);
+    ck_assert_int_eq(hpix_alm_index(alm, 1, 1), 11);
+    ck_assert_int_eq(hpix_alm_index(alm, 10, 4),
+		     hpix_alm_num_of_coefficients(alm) - 1);
+
+    hpix_free_alm(alm);
+}
+END_TEST
+
+/**********************************************************************/
+
+START_TEST(alm2map_dipole)
+{
+    /* Y_10 = sqrt(3 / 4pi) cos(theta) */
+    hpix_alm_t * alm = hpix_create_alm(4, 4);
+    hpix_alm_coefficients(alm)[hpix_alm_index(alm, 1, 0)].re = 1.0;
+
+    const hpix_ordering_scheme_t schemes[] = {
+	HPIX_ORDER_SCHEME_RING, HPIX_ORDER_SCHEME_NEST
+    };
+
+    for(size_t scheme_idx = 0; scheme_idx < 2; ++scheme_idx)
+    {
+	hpix_map_t * map = hpix_create_map(16, schemes[scheme_idx]);
+	hpix_alm2map(alm, map);
+	ck_assert_int_eq(hpix_map_ordering_scheme(map), schemes[scheme_idx]);
+
+	const hpix_resolution_t * resolution = hpix_map_resolution(map);
+	for(hpix_pixel_num_t idx = 0; idx < hpix_map_num_of_pixels(map); ++idx)
+	{
+	    hpix_vector_t vector;
+	    if(schemes[scheme_idx] == HPIX_ORDER_SCHEME_RING)
+		hpix_ring_pixel_to_vector(resolution, idx, &vector);
+	    else
+		hpix_nest_pixel_to_vector(resolution, idx, &vector);
+
+	    TEST_FOR_CLOSENESS(hpix_map_pixels(map)[idx],
+			       (sqrt(3.0 / (4.0 * M_PI)) * vector.z));
+	}
+
+	hpix_free_map(map);
+    }
+
+    hpix_free_alm(alm);
+}
+END_TEST
+
+/**********************************************************************/
+
+START_TEST(map2alm_round_trip)
+{
+    const unsigned int lmax = 8;
+    hpix_alm_t * input = hpix_create_alm(lmax, lmax);
+    hpix_alm_t * output = hpix_create_alm(lmax, lmax);
+    hpix_complex_t * coeffs = hpix_alm_coefficients(input);
+
+    for(unsigned int m = 0; m <= lmax; ++m)
+    {
+	for(unsigned int l = m; l <= lmax; ++l)
+	{
+	    hpix_complex_t * coeff = &coeffs[hpix_alm_index(input, l, m)];
+	    coeff->re = 1.0 / (1.0 + l + m);
+	    /* The imaginary part of a_l0 is zero for real maps */
+	    coeff->im = (m > 0) ? 0.5 / (1.0 + l) : 0.0;
+	}
+    }
+
+    hpix_map_t * map = hpix_create_map(32, HPIX_ORDER_SCHEME_NEST);
+    hpix_alm2map(input, map);
+
+    /* Run map2alm twice, to check that cached setups work */
+    for(int run = 0; run < 2; ++run)
+    {
+	hpix_map2alm(map, output);
+	ck_assert_int_eq(hpix_map_ordering_scheme(map), HPIX_ORDER_SCHEME_NEST);
+
+	for(size_t idx = 0; idx < hpix_alm_num_of_coefficients(input); ++idx)
+	{
+	    fail_unless(fabs(hpix_alm_coefficients(output)[idx].re
+			     - coeffs[idx].re) < ALM_TOLERANCE);
+	    fail_unless(fabs(hpix_alm_coefficients(output)[idx].im
+			     - coeffs[idx].im) < ALM_TOLERANCE);
+	}
+    }
+
+    hpix_free_map(map);
+    hpix_free_alm(input);
+    hpix_free_alm(output);
+    hpix_free_sht_cache();
+}
+END_TEST
+
+/**********************************************************************/
+
+START_TEST(map2alm_pol_round_trip)
+{
+    const unsigned int lmax = 6;
+    hpix_alm_t * input[3], * output[3];
+    hpix_map_t * maps[3];
+
+    for(int comp = 0; comp < 3; ++comp)
+    {
+	input[comp] = hpix_create_alm(lmax, lmax);
+	output[comp] = hpix_create_alm(lmax, lmax);
+	maps[comp] = hpix_create_map(32, HPIX_ORDER_SCHEME_RING);
+
+	/* Polarized components start from l = 2. We use m = 1 only, so
+	 * the intensity starts from l = 1 */
+	for(unsigned int l = (comp == 0) ? 1 : 2; l <= lmax; ++l)
+	    hpix_alm_coefficients(input[comp])[hpix_alm_index(input[comp],
+							      l, 1)].re
+		= (comp + 1.0) / (l + 1.0);
+    }
+
+    hpix_alm2map_pol(input[0], input[1], input[2], maps[0], maps[1], maps[2]);
+    hpix_map2alm_pol(maps[0], maps[1], maps[2],
+		     output[0], output[1], output[2]);
+
+    for(int comp = 0; comp < 3; ++comp)
+    {
+	for(size_t idx = 0; idx < hpix_alm_num_of_coefficients(input[comp]); ++idx)
+	    fail_unless(fabs(hpix_alm_coefficients(output[comp])[idx].re
+			     - hpix_alm_coefficients(input[comp])[idx].re)
+			< ALM_TOLERANCE);
+
+	hpix_free_alm(input[comp]);
+	hpix_free_alm(output[comp]);
+	hpix_free_map(maps[comp]);
+    }
+}
+END_TEST
+
+/**********************************************************************/
+
+START_TEST(plan_reuse)
+{
+    const unsigned int lmax = 6;
+    hpix_alm_t * alm[3];
+    hpix_map_t * maps[3];
+
+    for(int comp = 0; comp < 3; ++comp)
+    {
+	alm[comp] = hpix_create_alm(lmax, lmax);
+	maps[comp] = hpix_create_map(16, HPIX_ORDER_SCHEME_RING);
+	for(unsigned int l = 2; l <= lmax; ++l)
+	    hpix_alm_coefficients(alm[comp])[hpix_alm_index(alm[comp],
+							    l, 2)].re
+		= (comp + 1.0) / l;
+    }
+
+    hpix_map_t * first = hpix_create_map(16, HPIX_ORDER_SCHEME_RING);
+    hpix_map_t * second = hpix_create_map(16, HPIX_ORDER_SCHEME_RING);
+
+    /* A polarized transform between the two scalar ones makes the plan
+     * switch the recursion used by its Y_lm generators */
+    hpix_alm2map(alm[0], first);
+    hpix_alm2map_pol(alm[0], alm[1], alm[2], maps[0], maps[1], maps[2]);
+    hpix_alm2map(alm[0], second);
+
+    for(size_t idx = 0; idx < hpix_map_num_of_pixels(first); ++idx)
+    {
+	TEST_FOR_CLOSENESS(hpix_map_pixels(first)[idx],
+			   hpix_map_pixels(second)[idx]);
+	TEST_FOR_CLOSENESS(hpix_map_pixels(first)[idx],
+			   hpix_map_pixels(maps[0])[idx]);
+    }
+
+    hpix_free_map(first);
+    hpix_free_map(second);
+    for(int comp = 0; comp < 3; ++comp)
+    {
+	hpix_free_alm(alm[comp]);
+	hpix_free_map(maps[comp]);
+    }
+    hpix_free_sht_cache();
+}
+END_TEST
+
+/**********************************************************************/
+
+START_TEST(anafast_temperature)
+{
+    const unsigned int lmax = 8;
+    hpix_alm_t * alm = hpix_create_alm(lmax, lmax);
+    hpix_complex_t * coeffs = hpix_alm_coefficients(alm);
+    coeffs[hpix_alm_index(alm, 2, 0)].re = 1.0;
+    coeffs[hpix_alm_index(alm, 3, 1)].re = 0.5;
+    coeffs[hpix_alm_index(alm, 3, 1)].im = 0.5;
+
+    hpix_map_t * maps[2];
+    maps[0] = hpix_create_map(32, HPIX_ORDER_SCHEME_RING);
+    maps[1] = hpix_create_map(32, HPIX_ORDER_SCHEME_NEST);
+    hpix_alm2map(alm, maps[0]);
+    hpix_alm2map(alm, maps[1]);
+    hpix_scale_pixels_by_constant_inplace(maps[1], 2.0);
+
+    hpix_power_spectrum_t * spectrum =
+	hpix_anafast((const hpix_map_t * const *) maps, NULL, NULL,
+		     2, NULL, lmax);
+    ck_assert_int_eq(hpix_power_spectrum_lmax(spectrum), lmax);
+    ck_assert_int_eq(hpix_power_spectrum_num_of_fields(spectrum), 2);
+    fail_unless(! hpix_power_spectrum_has_polarization(spectrum));
+    fail_unless(hpix_power_spectrum_cl(spectrum, 0, 0,
+				       HPIX_SPECTRUM_EE) == NULL);
+
+    const double expected[] = { 0.0, 0.0, 1.0 / 5.0, 1.0 / 7.0, 0.0 };
+    const double * auto_cl =
+	hpix_power_spectrum_cl(spectrum, 0, 0, HPIX_SPECTRUM_TT);
+    const double * cross_cl =
+	hpix_power_spectrum_cl(spectrum, 0, 1, HPIX_SPECTRUM_TT);
+    const double * scaled_cl =
+	hpix_power_spectrum_cl(spectrum, 1, 1, HPIX_SPECTRUM_TT);
+    for(unsigned int l = 0; l < 5; ++l)
+    {
+	fail_unless(fabs(auto_cl[l] - expected[l]) < ALM_TOLERANCE);
+	fail_unless(fabs(cross_cl[l] - 2.0 * expected[l]) < ALM_TOLERANCE);
+	fail_unless(fabs(scaled_cl[l] - 4.0 * expected[l]) < ALM_TOLERANCE);
+    }
+    TEST_FOR_CLOSENESS(hpix_power_spectrum_fsky(spectrum), 1.0);
+    hpix_free_power_spectrum(spectrum);
+
+    /* Masking half of the sky roughly halves the pseudo-C_l */
+    hpix_map_t * mask = hpix_create_map(32, HPIX_ORDER_SCHEME_RING);
+    for(size_t idx = 0; idx < hpix_map_num_of_pixels(mask); ++idx)
+	hpix_map_pixels(mask)[idx] = (idx < hpix_map_num_of_pixels(mask) / 2)
+	    ? 1.0 : 0.0;
+    spectrum = hpix_anafast((const hpix_map_t * const *) maps, NULL, NULL,
+			    1, mask, lmax);
+    TEST_FOR_CLOSENESS(hpix_power_spectrum_fsky(spectrum), 0.5);
+    auto_cl = hpix_power_spectrum_cl(spectrum, 0, 0, HPIX_SPECTRUM_TT);
+    fail_unless(auto_cl[2] > 0.05 && auto_cl[2] < 0.15);
+
+    hpix_free_power_spectrum(spectrum);
+    hpix_free_map(mask);
+    hpix_free_map(maps[0]);
+    hpix_free_map(maps[1]);
+    hpix_free_alm(alm);
+}
+END_TEST
+
+/**********************************************************************/
+
+START_TEST(anafast_polarization)
+{
+    const unsigned int lmax = 6;
+    hpix_alm_t * alm[3];
+    hpix_map_t * maps[3];
+
+    for(int comp = 0; comp < 3; ++comp)
+    {
+	alm[comp] = hpix_create_alm(lmax, lmax);
+	maps[comp] = hpix_create_map(32, HPIX_ORDER_SCHEME_RING);
+	hpix_alm_coefficients(alm[comp])[hpix_alm_index(alm[comp],
+							2, 0)].re
+	    = comp + 1.0;
+    }
+
+    hpix_alm2map_pol(alm[0], alm[1], alm[2], maps[0], maps[1], maps[2]);
+    hpix_power_spectrum_t * spectrum =
+	hpix_anafast((const hpix_map_t * const *) &maps[0],
+		     (const hpix_map_t * const *) &maps[1],
+		     (const hpix_map_t * const *) &maps[2],
+		     1, NULL, lmax);
+    fail_unless(hpix_power_spectrum_has_polarization(spectrum));
+
+    /* a_20 is (1, 2, 3) for T, E and B */
+    const double expected[HPIX_NUM_OF_SPECTRUM_COMPONENTS] = {
+	1.0, 4.0, 9.0, 2.0, 3.0, 6.0
+    };
+    for(int comp = 0; comp < HPIX_NUM_OF_SPECTRUM_COMPONENTS; ++comp)
+    {
+	const double * cl = hpix_power_spectrum_cl(spectrum, 0, 0, comp);
+	fail_unless(fabs(cl[2] - expected[comp] / 5.0) < ALM_TOLERANCE);
+	fail_unless(fabs(cl[3]) < ALM_TOLERANCE);
+    }
+
+    hpix_free_power_spectrum(spectrum);
+    for(int comp = 0; comp < 3; ++comp)
+    {
+	hpix_free_alm(alm[comp]);
+	hpix_free_map(maps[comp]);
+    }
+}
+END_TEST
+
+/**********************************************************************/
+
+START_TEST(anafast_many_polarized_fields)
+{
+    /* Each polarized field takes two libpsht jobs, so these fields do
+     * not fit in one joblist */
+    const unsigned int lmax = 6;
+    const size_t num_of_fields = 7;
+    hpix_alm_t * alm[3];
+    hpix_map_t * maps[3][7];
+
+    for(int comp = 0; comp < 3; ++comp)
+    {
+	alm[comp] = hpix_create_alm(lmax, lmax);
+	hpix_alm_coefficients(alm[comp])[hpix_alm_index(alm[comp],
+							2, 0)].re
+	    = comp + 1.0;
+    }
+
+    for(size_t field = 0; field < num_of_fields; ++field)
+    {
+	for(int comp = 0; comp < 3; ++comp)
+	    maps[comp][field] = hpix_create_map(16, HPIX_ORDER_SCHEME_RING);
+
+	hpix_alm2map_pol(alm[0], alm[1], alm[2],
+			 maps[0][field], maps[1][field], maps[2][field]);
+	for(int comp = 0; comp < 3; ++comp)
+	    hpix_scale_pixels_by_constant_inplace(maps[comp][field],
+						  field + 1.0);
+    }
+
+    hpix_power_spectrum_t * spectrum =
+	hpix_anafast((const hpix_map_t * const *) maps[0],
+		     (const hpix_map_t * const *) maps[1],
+		     (const hpix_map_t * const *) maps[2],
+		     num_of_fields, NULL, lmax);
+    ck_assert_int_eq(hpix_power_spectrum_num_of_fields(spectrum),
+		     num_of_fields);
+
+    const double expected[HPIX_NUM_OF_SPECTRUM_COMPONENTS] = {
+	1.0, 4.0, 9.0, 2.0, 3.0, 6.0
+    };
+    for(size_t field = 0; field < num_of_fields; ++field)
+    {
+	const double scale = (field + 1.0) * (field + 1.0);
+	for(int comp = 0; comp < HPIX_NUM_OF_SPECTRUM_COMPONENTS; ++comp)
+	{
+	    const double * cl =
+		hpix_power_spectrum_cl(spectrum, field, field, comp);
+	    fail_unless(fabs(cl[2] - scale * expected[comp] / 5.0)
+			< ALM_TOLERANCE * scale,
+			"Field %u, component %d: C_2 = %f",
+			(unsigned) field, comp, cl[2]);
+	}
+    }
+
+    /* Cross spectrum between the first and the last field */
+    const double * cross_cl =
+	hpix_power_spectrum_cl(spectrum, 0, num_of_fields - 1,
+			       HPIX_SPECTRUM_EE);
+    fail_unless(fabs(cross_cl[2] - num_of_fields * 4.0 / 5.0)
+		< ALM_TOLERANCE * num_of_fields);
+
+    hpix_free_power_spectrum(spectrum);
+    for(int comp = 0; comp < 3; ++comp)
+    {
+	hpix_free_alm(alm[comp]);
+	for(size_t field = 0; field < num_of_fields; ++field)
+	    hpix_free_map(maps[comp][field]);
+    }
+}
+END_TEST
+
+/**********************************************************************/
+
+START_TEST(gaussian_smoothing)
+{
+    const unsigned int lmax = 10;
+    const double fwhm = 20.0 * M_PI / 180.0;
+    const double sigma = fwhm / sqrt(8.0 * log(2.0));
+    hpix_smoothing_t * smoothing = hpix_create_gaussian_smoothing(fwhm, lmax);
+
+    ck_assert_int_eq(hpix_smoothing_lmax(smoothing), lmax);
+    const double * window = hpix_smoothing_window(smoothing, 0);
+    TEST_FOR_CLOSENESS(window[0], 1.0);
+    TEST_FOR_CLOSENESS(window[4], exp(-10.0 * sigma * sigma));
+    TEST_FOR_CLOSENESS(hpix_smoothing_window(smoothing, 1)[2],
+		       exp(-1.0 * sigma * sigma));
+
+    hpix_alm_t * alm = hpix_create_alm(lmax, lmax);
+    hpix_alm_t * smoothed_alm = hpix_create_alm(lmax, lmax);
+    const unsigned int ls[] = { 2, 5 };
+    const unsigned int ms[] = { 1, 3 };
+    for(int idx = 0; idx < 2; ++idx)
+    {
+	const size_t alm_idx = hpix_alm_index(alm, ls[idx], ms[idx]);
+	hpix_alm_coefficients(alm)[alm_idx].re = 1.0;
+	hpix_alm_coefficients(smoothed_alm)[alm_idx].re = window[ls[idx]];
+    }
+
+    /* Smooth two maps at once, with different orderings */
+    hpix_map_t * maps[2];
+    maps[0] = hpix_create_map(32, HPIX_ORDER_SCHEME_RING);
+    maps[1] = hpix_create_map(32, HPIX_ORDER_SCHEME_NEST);
+    hpix_alm2map(alm, maps[0]);
+    hpix_alm2map(alm, maps[1]);
+    hpix_smooth_maps(smoothing, maps, NULL, NULL, 2);
+
+    hpix_map_t * expected = hpix_create_map(32, HPIX_ORDER_SCHEME_RING);
+    hpix_alm2map(smoothed_alm, expected);
+    hpix_switch_order(maps[1]);
+    for(size_t idx = 0; idx < hpix_map_num_of_pixels(expected); ++idx)
+    {
+	const double value = hpix_map_pixels(expected)[idx];
+	fail_unless(fabs(hpix_map_pixels(maps[0])[idx] - value) < ALM_TOLERANCE);
+	fail_unless(fabs(hpix_map_pixels(maps[1])[idx] - value) < ALM_TOLERANCE);
+    }
+
+    hpix_free_map(expected);
+    hpix_free_map(maps[0]);
+    hpix_free_map(maps[1]);
+    hpix_free_alm(alm);
+    hpix_free_alm(smoothed_alm);
+    hpix_free_smoothing(smoothing);
+}
+END_TEST
+
+/**********************************************************************/
+
+START_TEST(tabulated_smoothing)
+{
+    const unsigned int lmax = 6;
+    double window_t[lmax + 1], window_pol[lmax + 1], pixwin[lmax + 1];
+    for(unsigned int l = 0; l <= lmax; ++l)
+    {
+	window_t[l] = 1.0;
+	window_pol[l] = 0.0;
+	pixwin[l] = (l < 4) ? 1.0 : 0.0;
+    }
+
+    hpix_smoothing_t * smoothing =
+	hpix_create_tabulated_smoothing(window_t, window_pol, lmax);
+    hpix_smoothing_apply_pixel_window(smoothing, pixwin, NULL);
+    TEST_FOR_CLOSENESS(hpix_smoothing_window(smoothing, 0)[3], 1.0);
+    TEST_FOR_CLOSENESS(hpix_smoothing_window(smoothing, 0)[4], 0.0);
+
+    hpix_alm_t * alm[3];
+    hpix_map_t * maps[3];
+    for(int comp = 0; comp < 3; ++comp)
+    {
+	alm[comp] = hpix_create_alm(lmax, lmax);
+	maps[comp] = hpix_create_map(16, HPIX_ORDER_SCHEME_RING);
+	hpix_alm_coefficients(alm[comp])[hpix_alm_index(alm[comp],
+							2, 1)].re = 1.0;
+	hpix_alm_coefficients(alm[comp])[hpix_alm_index(alm[comp],
+							5, 2)].im = 1.0;
+    }
+    hpix_alm2map_pol(alm[0], alm[1], alm[2], maps[0], maps[1], maps[2]);
+
+    /* The window keeps only l <= 3 in the intensity map and removes
+     * polarization altogether */
+    hpix_alm_coefficients(alm[0])[hpix_alm_index(alm[0], 5, 2)].im = 0.0;
+    hpix_map_t * expected = hpix_create_map(16, HPIX_ORDER_SCHEME_RING);
+    hpix_alm2map(alm[0], expected);
+
+    hpix_smooth_map_pol(smoothing, maps[0], maps[1], maps[2]);
+    for(size_t idx = 0; idx < hpix_map_num_of_pixels(expected); ++idx)
+    {
+	fail_unless(fabs(hpix_map_pixels(maps[0])[idx]
+			 - hpix_map_pixels(expected)[idx]) < ALM_TOLERANCE);
+	fail_unless(fabs(hpix_map_pixels(maps[1])[idx]) < ALM_TOLERANCE);
+	fail_unless(fabs(hpix_map_pixels(maps[2])[idx]) < ALM_TOLERANCE);
+    }
+
+    hpix_free_map(expected);
+    for(int comp = 0; comp < 3; ++comp)
+    {
+	hpix_free_alm(alm[comp]);
+	hpix_free_map(maps[comp]);
+    }
+    hpix_free_smoothing(smoothing);
+}
+END_TEST
+
+/**********************************************************************/
+
+START_TEST(smoothing_many_polarized_fields)
+{
+    /* More I, Q, U triplets than fit in one libpsht joblist */
+    const unsigned int lmax = 6;
+    const size_t num_of_fields = 7;
+    double window_t[lmax + 1], window_pol[lmax + 1];
+    for(unsigned int l = 0; l <= lmax; ++l)
+    {
+	window_t[l] = (l < 4) ? 1.0 : 0.0;
+	window_pol[l] = 0.0;
+    }
+
+    hpix_smoothing_t * smoothing =
+	hpix_create_tabulated_smoothing(window_t, window_pol, lmax);
+
+    hpix_alm_t * alm[3];
+    for(int comp = 0; comp < 3; ++comp)
+    {
+	alm[comp] = hpix_create_alm(lmax, lmax);
+	hpix_alm_coefficients(alm[comp])[hpix_alm_index(alm[comp],
+							2, 1)].re = 1.0;
+	hpix_alm_coefficients(alm[comp])[hpix_alm_index(alm[comp],
+							5, 2)].im = 1.0;
+    }
+
+    hpix_map_t * maps[3][7];
+    for(size_t field = 0; field < num_of_fields; ++field)
+    {
+	for(int comp = 0; comp < 3; ++comp)
+	    maps[comp][field] = hpix_create_map(16, HPIX_ORDER_SCHEME_RING);
+
+	hpix_alm2map_pol(alm[0], alm[1], alm[2],
+			 maps[0][field], maps[1][field], maps[2][field]);
+	for(int comp = 0; comp < 3; ++comp)
+	    hpix_scale_pixels_by_constant_inplace(maps[comp][field],
+						  field + 1.0);
+    }
+
+    hpix_alm_coefficients(alm[0])[hpix_alm_index(alm[0], 5, 2)].im = 0.0;
+    hpix_map_t * expected = hpix_create_map(16, HPIX_ORDER_SCHEME_RING);
+    hpix_alm2map(alm[0], expected);
+
+    hpix_smooth_maps(smoothing, maps[0], maps[1], maps[2], num_of_fields);
+    for(size_t field = 0; field < num_of_fields; ++field)
+    {
+	for(size_t idx = 0; idx < hpix_map_num_of_pixels(expected); ++idx)
+	{
+	    const double value = (field + 1.0) * hpix_map_pixels(expected)[idx];
+	    fail_unless(fabs(hpix_map_pixels(maps[0][field])[idx] - value)
+			< ALM_TOLERANCE * (field + 1.0));
+	    fail_unless(fabs(hpix_map_pixels(maps[1][field])[idx])
+			< ALM_TOLERANCE * (field + 1.0));
+	    fail_unless(fabs(hpix_map_pixels(maps[2][field])[idx])
+			< ALM_TOLERANCE * (field + 1.0));
+	}
+    }
+
+    hpix_free_map(expected);
+    for(int comp = 0; comp < 3; ++comp)
+    {
+	hpix_free_alm(alm[comp]);
+	for(size_t field = 0; field < num_of_fields; ++field)
+	    hpix_free_map(maps[comp][field]);
+    }
+    hpix_free_smoothing(smoothing);
+}
+END_TEST
+
+/**********************************************************************/
+
+/* Return the largest difference between the coefficients of two sets
+ * of a_lm */
+static double
+max_alm_difference(const hpix_alm_t * alm1, const hpix_alm_t * alm2)
+{
+    double result = 0.0;
+    for(size_t idx = 0; idx < hpix_alm_num_of_coefficients(alm1); ++idx)
+    {
+	const hpix_complex_t * c1 = &hpix_alm_coefficients(alm1)[idx];
+	const hpix_complex_t * c2 = &hpix_alm_coefficients(alm2)[idx];
+	if(fabs(c1->re - c2->re) > result)
+	    result = fabs(c1->re - c2->re);
+	if(fabs(c1->im - c2->im) > result)
+	    result = fabs(c1->im - c2->im);
+    }
+
+    return result;
+}
+
+/**********************************************************************/
+
+START_TEST(map2alm_iterations)
+{
+    const unsigned int lmax = 24;
+    hpix_alm_t * input = hpix_create_alm(lmax, lmax);
+    hpix_alm_t * output = hpix_create_alm(lmax, lmax);
+
+    for(unsigned int l = 0; l <= lmax; ++l)
+	hpix_alm_coefficients(input)[hpix_alm_index(input, l, 0)].re =
+	    1.0 / (1.0 + l);
+
+    hpix_map_t * map = hpix_create_map(16, HPIX_ORDER_SCHEME_NEST);
+    hpix_alm2map(input, map);
+
+    hpix_map2alm(map, output);
+    const double plain_error = max_alm_difference(input, output);
+
+    ck_assert_int_eq(hpix_map2alm_iterative(map, output, 3, 0.0, NULL), 3);
+    const double iterative_error = max_alm_difference(input, output);
+    fail_unless(iterative_error < 0.1 * plain_error);
+
+    /* Unit weights must not change the result */
+    double weights[32];
+    for(size_t idx = 0; idx < 32; ++idx)
+	weights[idx] = 1.0;
+    hpix_map2alm_iterative(map, output, 3, 0.0, weights);
+    TEST_FOR_CLOSENESS(max_alm_difference(input, output), iterative_error);
+
+    /* A loose tolerance stops the iterations early */
+    fail_unless(hpix_map2alm_iterative(map, output, 100, 1e-2, NULL) < 100);
+
+    hpix_free_map(map);
+    hpix_free_alm(input);
+    hpix_free_alm(output);
+}
+END_TEST
+
+/**********************************************************************/
+
+START_TEST(map2alm_pol_iterations)
+{
+    const unsigned int lmax = 16;
+    hpix_alm_t * input[3], * output[3];
+    hpix_map_t * maps[3];
+
+    for(int comp = 0; comp < 3; ++comp)
+    {
+	input[comp] = hpix_create_alm(lmax, lmax);
+	output[comp] = hpix_create_alm(lmax, lmax);
+	maps[comp] = hpix_create_map(16, HPIX_ORDER_SCHEME_RING);
+	for(unsigned int l = 2; l <= lmax; ++l)
+	    hpix_alm_coefficients(input[comp])[hpix_alm_index(input[comp],
+							      l, 0)].re
+		= (comp + 1.0) / l;
+    }
+
+    hpix_alm2map_pol(input[0], input[1], input[2], maps[0], maps[1], maps[2]);
+    hpix_map2alm_pol(maps[0], maps[1], maps[2],
+		     output[0], output[1], output[2]);
+    double plain_error[3];
+    for(int comp = 0; comp < 3; ++comp)
+	plain_error[comp] = max_alm_difference(input[comp], output[comp]);
+
+    hpix_map2alm_pol_iterative(maps[0], maps[1], maps[2],
+			       output[0], output[1], output[2],
+			       3, 0.0, NULL);
+    for(int comp = 0; comp < 3; ++comp)
+    {
+	fail_unless(max_alm_difference(input[comp], output[comp])
+		    < 0.1 * plain_error[comp]);
+
+	hpix_free_alm(input[comp]);
+	hpix_free_alm(output[comp]);
+	hpix_free_map(maps[comp]);
+    }
+}
+END_TEST
+
+/**********************************************************************/
+
+START_TEST(wide_kernels)
+{
+    /* With lmax = 3 nside - 1, high-m Y_lm are negligible near the
+     * poles: this exercises rings joining the recursion at different
+     * values of l within the same group */
+    const unsigned int lmax = 95;
+    hpix_alm_t * input = hpix_create_alm(lmax, lmax);
+    hpix_alm_t * reference_alm = hpix_create_alm(lmax, lmax);
+    hpix_alm_t * output = hpix_create_alm(lmax, lmax);
+    hpix_complex_t * coeffs = hpix_alm_coefficients(input);
+
+    for(unsigned int m = 0; m <= lmax; ++m)
+    {
+	for(unsigned int l = m; l <= lmax; ++l)
+	{
+	    hpix_complex_t * coeff = &coeffs[hpix_alm_index(input, l, m)];
+	    coeff->re = cos(l + 0.3 * m) / (1.0 + l);
+	    coeff->im = (m > 0) ? sin(0.7 * l + m) / (1.0 + l) : 0.0;
+	}
+    }
+
+    hpix_map_t * reference_map = hpix_create_map(32, HPIX_ORDER_SCHEME_RING);
+    hpix_map_t * map = hpix_create_map(32, HPIX_ORDER_SCHEME_RING);
+
+    psht_limit_simd_lanes(0);
+    ck_assert_int_eq(psht_simd_lanes(), 0);
+    hpix_alm2map(input, reference_map);
+    hpix_map2alm(reference_map, reference_alm);
+
+    for(int lanes = 4; lanes <= 8; lanes += 4)
+    {
+	psht_limit_simd_lanes(lanes);
+	hpix_alm2map(input, map);
+	hpix_map2alm(map, output);
+
+	for(size_t idx = 0; idx < hpix_map_num_of_pixels(map); ++idx)
+	    fail_unless(fabs(hpix_map_pixels(map)[idx]
+			     - hpix_map_pixels(reference_map)[idx]) < 1e-12);
+	fail_unless(max_alm_difference(output, reference_alm) < 1e-12);
+    }
+
+    psht_limit_simd_lanes(8);
+    hpix_free_map(map);
+    hpix_free_map(reference_map);
+    hpix_free_alm(input);
+    hpix_free_alm(reference_alm);
+    hpix_free_alm(output);
+    hpix_free_sht_cache();
+}
+END_TEST
+
+/**********************************************************************/
+
+/* Run a single precision alm2map and map2alm on "map" and "output",
+ * optionally using the single precision Y_lm recursion */
+static void
+run_float_transforms(psht_geom_info * geom, psht_alm_info * alm_info,
+		     const pshts_cmplx * input, float * map,
+		     pshts_cmplx * output, int float_recursion)
+{
+    pshts_joblist * joblist;
+    pshts_make_joblist(&joblist);
+    pshts_set_float_recursion(joblist, float_recursion);
+
+    pshts_add_job_alm2map(joblist, input, map, 0);
+    pshts_execute_jobs(joblist, geom, alm_info);
+    pshts_clear_joblist(joblist);
+
+    pshts_add_job_map2alm(joblist, map, output, 0);
+    pshts_execute_jobs(joblist, geom, alm_info);
+    pshts_destroy_joblist(joblist);
+}
+
+/**********************************************************************/
+
+START_TEST(float_recursion)
+{
+    const int nside = 64;
+    const int lmax = 3 * nside - 1;
+    const size_t num_of_pixels = 12 * nside * nside;
+    const size_t num_of_coeffs = (lmax + 1) * (lmax + 2) / 2;
+    psht_geom_info * geom;
+    psht_alm_info * alm_info;
+
+    psht_make_healpix_geom_info(nside, 1, &geom);
+    psht_make_triangular_alm_info(lmax, lmax, 1, &alm_info);
+
+    pshts_cmplx * input = malloc(num_of_coeffs * sizeof(pshts_cmplx));
+    pshts_cmplx * reference_alm = malloc(num_of_coeffs * sizeof(pshts_cmplx));
+    pshts_cmplx * output = malloc(num_of_coeffs * sizeof(pshts_cmplx));
+    float * reference_map = malloc(num_of_pixels * sizeof(float));
+    float * map = malloc(num_of_pixels * sizeof(float));
+
+    for(int m = 0; m <= lmax; ++m)
+    {
+	for(int l = m; l <= lmax; ++l)
+	{
+	    pshts_cmplx * coeff = &input[psht_alm_index(alm_info, l, m)];
+	    coeff->re = cos(l + 0.3 * m) / (1.0 + l);
+	    coeff->im = (m > 0) ? sin(0.7 * l + m) / (1.0 + l) : 0.0;
+	}
+    }
+
+    run_float_transforms(geom, alm_info, input, reference_map,
+			 reference_alm, 0);
+    run_float_transforms(geom, alm_info, input, map, output, 1);
+
+    double max_value = 0.0, max_difference = 0.0;
+    for(size_t idx = 0; idx < num_of_pixels; ++idx)
+    {
+	max_value = fmax(max_value, fabs(reference_map[idx]));
+	max_difference = fmax(max_difference,
+			      fabs(map[idx] - reference_map[idx]));
+    }
+    fail_unless(max_difference < 1e-5 * max_value);
+
+    max_value = max_difference = 0.0;
+    for(size_t idx = 0; idx < num_of_coeffs; ++idx)
+    {
+	max_value = fmax(max_value, fabs(reference_alm[idx].re));
+	max_difference = fmax(max_difference,
+			      fabs(output[idx].re - reference_alm[idx].re));
+	max_difference = fmax(max_difference,
+			      fabs(output[idx].im - reference_alm[idx].im));
+    }
+    fail_unless(max_difference < 1e-5 * max_value);
+
+    free(input);
+    free(reference_alm);
+    free(output);
+    free(reference_map);
+    free(map);
+    psht_destroy_geom_info(geom);
+    psht_destroy_alm_info(alm_info);
+}
+END_TEST
+
+/**********************************************************************/
+
+START_TEST(fft_multi)
+{
+    /* Lengths with factors 2, 3, 4, 5, a generic factor (7), and a length
+     * using Bluestein's algorithm (4 * 1021) */
+    const size_t lengths[] = { 1, 2, 7, 28, 60, 120, 4084 };
+    const size_t num_of_arrays = 5;
+
+    for(size_t i = 0; i < sizeof(lengths) / sizeof(lengths[0]); ++i)
+    {
+	const size_t n = lengths[i];
+	real_plan plan = make_real_plan(n);
+	real_plan cached_plan = make_real_plan(n);
+	double * single = malloc(n * sizeof(double));
+	double * multi = malloc(n * num_of_arrays * sizeof(double));
+
+	/* The second plan comes from the cache */
+	fail_unless(cached_plan->bluestein == plan->bluestein);
+
+	for(size_t idx = 0; idx < n * num_of_arrays; ++idx)
+	    multi[idx] = sin(0.37 * idx) + (double) (idx % 5);
+
+	real_plan_forward_fftpack_multi(cached_plan, multi, num_of_arrays);
+	for(size_t arr = 0; arr < num_of_arrays; ++arr)
+	{
+	    for(size_t idx = 0; idx < n; ++idx)
+	    {
+		const size_t pos = idx * num_of_arrays + arr;
+		single[idx] = sin(0.37 * pos) + (double) (pos % 5);
+	    }
+
+	    real_plan_forward_fftpack(plan, single);
+	    for(size_t idx = 0; idx < n; ++idx)
+	    {
+		fail_unless(fabs(multi[idx * num_of_arrays + arr] - single[idx])
+			    < 1e-12 * n);
+	    }
+	}
+
+	real_plan_backward_fftpack_multi(cached_plan, multi, num_of_arrays);
+	for(size_t idx = 0; idx < n * num_of_arrays; ++idx)
+	{
+	    fail_unless(fabs(multi[idx] / n
+			     - (sin(0.37 * idx) + (double) (idx % 5)))
+			< 1e-12);
+	}
+
+	free(single);
+	free(multi);
+	kill_real_plan(plan);
+	kill_real_plan(cached_plan);
+    }
+
+    /* Plans still work with the cache disabled */
+    ls_fft_set_plan_cache_limit(0);
+    real_plan plan = make_real_plan(28);
+    double data[28] = { 1.0 };
+    real_plan_forward_fftpack(plan, data);
+    for(size_t idx = 0; idx < 28; ++idx)
+	TEST_FOR_CLOSENESS(data[idx], ((idx == 0 || idx % 2 == 1) ? 1.0 : 0.0));
+    kill_real_plan(plan);
+    ls_fft_set_plan_cache_limit(((size_t) 1) << 23);
+}
+END_TEST
+
+/**********************************************************************/
+
+Suite *
+create_hpix_test_suite(void)
+{
+    Suite * suite = suite_create("Spherical harmonics");
+    TCase * tc_core;
+
+    tc_core = tcase_create("a_lm coefficients");
+    tcase_add_test(tc_core, alm_layout);
+    suite_add_tcase(suite, tc_core);
+
+    tc_core = tcase_create("Transforms");
+    tcase_add_test(tc_core, alm2map_dipole);
+    tcase_add_test(tc_core, map2alm_round_trip);
+    tcase_add_test(tc_core, map2alm_pol_round_trip);
+    tcase_add_test(tc_core, plan_reuse);
+    tcase_add_test(tc_core, map2alm_iterations);
+    tcase_add_test(tc_core, map2alm_pol_iterations);
+    tcase_add_test(tc_core, wide_kernels);
+    tcase_add_test(tc_core, float_recursion);
+    tcase_add_test(tc_core, fft_multi);
+    suite_add_tcase(suite, tc_core);
+
+    tc_core = tcase_create("Power spectra");
+    tcase_add_test(tc_core, anafast_temperature);
+    tcase_add_test(tc_core, anafast_polarization);
+    tcase_add_test(tc_core, anafast_many_polarized_fields);
+    suite_add_tcase(suite, tc_core);
+
+    tc_core = tcase_create("Smoothing");
+    tcase_add_test(tc_core, gaussian_smoothing);
+    tcase_add_test(tc_core, tabulated_smoothing);
+    tcase_add_test(tc_core, smoothing_many_polarized_fields);
+    suite_add_tcase(suite, tc_core);
+
+    return suite;
+}
+
+/**********************************************************************/
+
+int
+main(void)
+{
+    int number_failed;
+    Suite * suite = create_hpix_test_suite();
+    SRunner * runner = srunner_create(suite);
+    srunner_run_all(runner, CK_VERBOSE);
+    number_failed = srunner_ntests_failed(runner);
+    srunner_free(runner);
+
+    return (number_failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,203 @@
+/* test_map_pyramid.c -- check the implementation of hpix_map_pyramid_t
+ *
+ * Copyright 2011-2013 Maurizio Tomasi.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.  */
+
+#include <hpixlib/hpix.h>
+#include <math.h>
+#include <stdlib.h>
+#include <check.h>
+#include "check_helpers.h"
+
+/**********************************************************************/
+
+hpix_map_t * base_map = NULL;
+
+void
+setup_base_map(void)
+{
+    base_map = hpix_create_map(8, HPIX_ORDER_SCHEME_NEST);
+    double * pixels = hpix_map_pixels(base_map);
+
+    /* Pixel values are equal to their NEST index */
+    for(size_t idx = 0; idx < hpix_map_num_of_pixels(base_map); ++idx)
+	pixels[idx] = idx;
+}
+
+/**********************************************************************/
+
+void
+teardown_base_map(void)
+{
+    hpix_free_map(base_map);
+}
+
+/**********************************************************************/
+
+START_TEST(pyramid_levels)
+{
+    hpix_map_pyramid_t * pyramid =
+	hpix_create_map_pyramid(base_map, HPIX_PYRAMID_SUM);
+
+    ck_assert_int_eq(hpix_map_pyramid_num_of_levels(pyramid), 4);
+    fail_unless(hpix_map_pyramid_level(pyramid, 0) == base_map);
+
+    for(unsigned int level = 1; level < 4; ++level)
+    {
+	const hpix_map_t * map = hpix_map_pyramid_level(pyramid, level);
+	ck_assert_int_eq(hpix_map_nside(map), 8 >> level);
+	ck_assert_int_eq(hpix_map_ordering_scheme(map),
+			 HPIX_ORDER_SCHEME_NEST);
+    }
+
+    hpix_free_map_pyramid(pyramid);
+}
+END_TEST
+
+/**********************************************************************/
+
+START_TEST(pyramid_statistics)
+{
+    hpix_map_pyramid_t * sum_pyramid =
+	hpix_create_map_pyramid(base_map, HPIX_PYRAMID_SUM);
+    hpix_map_pyramid_t * mean_pyramid =
+	hpix_create_map_pyramid(base_map, HPIX_PYRAMID_MEAN);
+    hpix_map_pyramid_t * count_pyramid =
+	hpix_create_map_pyramid(base_map, HPIX_PYRAMID_VALID_COUNT);
+
+    /* At level 2, pixel p covers base pixels 16p, ..., 16p + 15 */
+    const double * sums =
+	hpix_map_pixels(hpix_map_pyramid_level(sum_pyramid, 2));
+    const double * means =
+	hpix_map_pixels(hpix_map_pyramid_level(mean_pyramid, 2));
+    const double * counts =
+	hpix_map_pixels(hpix_map_pyramid_level(count_pyramid, 2));
+    for(size_t idx = 0; idx < 48; ++idx)
+    {
+	TEST_FOR_CLOSENESS(sums[idx], (256.0 * idx + 120.0));
+	TEST_FOR_CLOSENESS(means[idx], (16.0 * idx + 7.5));
+	TEST_FOR_CLOSENESS(counts[idx], 16.0);
+    }
+
+    /* The top level contains one pixel per face */
+    const double * top =
+	hpix_map_pixels(hpix_map_pyramid_level(mean_pyramid, 3));
+    TEST_FOR_CLOSENESS(top[0], 31.5);
+    TEST_FOR_CLOSENESS(top[11], 735.5);
+
+    hpix_free_map_pyramid(sum_pyramid);
+    hpix_free_map_pyramid(mean_pyramid);
+    hpix_free_map_pyramid(count_pyramid);
+}
+END_TEST
+
+/**********************************************************************/
+
+START_TEST(pyramid_masked_pixels)
+{
+    double * pixels = hpix_map_pixels(base_map);
+    pixels[0] = NAN;
+    pixels[1] = -1.6375e+30;
+
+    hpix_map_pyramid_t * pyramid =
+	hpix_create_map_pyramid(base_map, HPIX_PYRAMID_MEAN);
+    const double * level1 =
+	hpix_map_pixels(hpix_map_pyramid_level(pyramid, 1));
+    TEST_FOR_CLOSENESS(level1[0], 2.5);
+    hpix_free_map_pyramid(pyramid);
+
+    pixels[2] = pixels[3] = NAN;
+    pyramid = hpix_create_map_pyramid(base_map, HPIX_PYRAMID_MEAN);
+    level1 = hpix_map_pixels(hpix_map_pyramid_level(pyramid, 1));
+    fail_unless(isnan(level1[0]));
+    hpix_free_map_pyramid(pyramid);
+}
+END_TEST
+
+/**********************************************************************/
+
+START_TEST(pyramid_incremental_update)
+{
+    hpix_map_pyramid_t * pyramid =
+	hpix_create_map_pyramid(base_map, HPIX_PYRAMID_SUM);
+
+    /* Force the computation of every level */
+    hpix_map_pyramid_level(pyramid, 3);
+
+    /* Pixel 100 falls in pixel 25 at level 1, 6 at level 2 and 1 at
+     * level 3 */
+    hpix_map_pyramid_set_pixel(pyramid, 100, 1100.0);
+
+    const double * level1 =
+	hpix_map_pixels(hpix_map_pyramid_level(pyramid, 1));
+    TEST_FOR_CLOSENESS(level1[25], (16.0 * 25 + 6.0 + 1000.0));
+    TEST_FOR_CLOSENESS(level1[24], (16.0 * 24 + 6.0));
+
+    const double * level3 =
+	hpix_map_pixels(hpix_map_pyramid_level(pyramid, 3));
+    TEST_FOR_CLOSENESS(level3[1], (4096.0 + 2016.0 + 1000.0));
+    TEST_FOR_CLOSENESS(level3[2], (2.0 * 4096.0 + 2016.0));
+
+    /* Now modify the base map directly, and tell the pyramid */
+    hpix_map_pixels(base_map)[767] = 0.0;
+    hpix_map_pyramid_invalidate_pixel(pyramid, 767);
+    level3 = hpix_map_pixels(hpix_map_pyramid_level(pyramid, 3));
+    TEST_FOR_CLOSENESS(level3[11], (11.0 * 4096.0 + 2016.0 - 767.0));
+
+    hpix_free_map_pyramid(pyramid);
+}
+END_TEST
+
+/**********************************************************************/
+
+Suite *
+create_hpix_test_suite(void)
+{
+    Suite * suite = suite_create("Map pyramids");
+    TCase * tc_core;
+
+    tc_core = tcase_create("Building pyramids");
+    tcase_add_checked_fixture(tc_core,
+			      setup_base_map,
+			      teardown_base_map);
+    tcase_add_test(tc_core, pyramid_levels);
+    tcase_add_test(tc_core, pyramid_statistics);
+    tcase_add_test(tc_core, pyramid_masked_pixels);
+    suite_add_tcase(suite, tc_core);
+
+    tc_core = tcase_create("Updating pyramids");
+    tcase_add_checked_fixture(tc_core,
+			      setup_base_map,
+			      teardown_base_map);
+    tcase_add_test(tc_core, pyramid_incremental_update);
+    suite_add_tcase(suite, tc_core);
+
+    return suite;
+}
+
+/**********************************************************************/
+
+int
+main(void)
+{
+    int number_failed;
+    Suite * suite = create_hpix_test_suite();
+    SRunner * runner = srunner_create(suite);
+    srunner_run_all(runner, CK_VERBOSE);
+    number_failed = srunner_ntests_failed(runner);
+    srunner_free(runner);
+
+    return (number_failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
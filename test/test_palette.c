@@ -169,6 +169,68 @@ END_TEST
 
 /**********************************************************************/
 
+START_TEST(palette_lut)
+{
+    hpix_color_palette_t * palette = hpix_create_healpix_color_palette();
+    hpix_set_color_for_unseen_pixels_in_palette(palette,
+						hpix_create_color(0.5, 0.5, 0.5));
+
+    ck_assert_int_eq(hpix_pack_color(hpix_create_color(1.0, 0.0, 0.5)),
+		     0xFFFF0080);
+
+    hpix_palette_lut_t * lut =
+	hpix_create_palette_lut(palette, HPIX_PALETTE_LUT_DEFAULT_SIZE);
+    ck_assert_int_eq(hpix_palette_lut_size(lut), HPIX_PALETTE_LUT_DEFAULT_SIZE);
+    ck_assert_int_eq(hpix_palette_lut_unseen_color(lut), 0xFF808080);
+
+    /* The LUT must agree with the palette within one level for each
+     * color component */
+    for(int idx = 0; idx <= 1000; ++idx)
+    {
+	const double level = idx / 1000.0;
+	hpix_color_t color;
+	hpix_palette_color(palette, level, &color);
+
+	const uint32_t exact = hpix_pack_color(color);
+	const uint32_t approx = hpix_palette_lut_color(lut, level);
+	for(int shift = 0; shift < 32; shift += 8)
+	{
+	    const int difference = (int) ((exact >> shift) & 0xFF)
+		- (int) ((approx >> shift) & 0xFF);
+	    fail_unless(abs(difference) <= 1,
+			"LUT color for level %f differs: %08x vs %08x",
+			level, exact, approx);
+	}
+    }
+
+    /* Values out of range are clipped */
+    ck_assert_int_eq(hpix_palette_lut_color(lut, -3.0),
+		     hpix_palette_lut_entries(lut)[0]);
+    ck_assert_int_eq(hpix_palette_lut_color(lut, 5.0),
+		     hpix_palette_lut_entries(lut)[HPIX_PALETTE_LUT_DEFAULT_SIZE - 1]);
+
+    /* Colorize a 3x2 bitmap with special values. The first row of the
+     * bitmap must become the last row of the image */
+    const double bitmap[] = { 0.0, 10.0, INFINITY,
+			      NAN, -1.6375e+30, 5.0 };
+    uint32_t image[2 * 4];
+    hpix_palette_lut_colorize(lut, bitmap, 3, 2, 0.0, 10.0,
+			      image, 4 * sizeof(uint32_t));
+
+    ck_assert_int_eq(image[4 + 0], hpix_palette_lut_color(lut, 0.0));
+    ck_assert_int_eq(image[4 + 1], hpix_palette_lut_color(lut, 1.0));
+    ck_assert_int_eq(image[4 + 2], 0x00FFFFFF);
+    ck_assert_int_eq(image[0], 0xFF808080);
+    ck_assert_int_eq(image[1], 0xFF808080);
+    ck_assert_int_eq(image[2], hpix_palette_lut_color(lut, 0.5));
+
+    hpix_free_palette_lut(lut);
+    hpix_free_color_palette(palette);
+}
+END_TEST
+
+/**********************************************************************/
+
 void
 add_color_and_palette_tests_to_testcase(TCase * testcase)
 {
@@ -178,6 +240,7 @@ add_color_and_palette_tests_to_testcase(TCase * testcase)
     tcase_add_test(testcase, access_to_palettes);
     tcase_add_test(testcase, modify_colors_in_palette);
     tcase_add_test(testcase, check_interpolation);
+    tcase_add_test(testcase, palette_lut);
 }
 
 /**********************************************************************/
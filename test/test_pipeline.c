@@ -0,0 +1,196 @@
+/* test_pipeline.c -- check the implementation of hpix_pointing_pipeline_t
+ *
+ * Copyright 2011-2013 Maurizio Tomasi.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.  */
+
+#include <hpixlib/hpix.h>
+#include <math.h>
+#include <stdlib.h>
+#include <check.h>
+#include "check_helpers.h"
+#include "constants.h"
+
+/**********************************************************************/
+
+#define NUM_OF_SAMPLES 100003
+
+static double
+sample_theta(size_t index)
+{
+    return M_PI * (index % 1009) / 1009.0;
+}
+
+static double
+sample_phi(size_t index)
+{
+    return 2.0 * M_PI * (index % 997) / 997.0;
+}
+
+/**********************************************************************/
+
+typedef struct {
+    size_t next_sample;
+    size_t chunk_size;
+} reader_state_t;
+
+/* Return chunks of variable size, to check that partially filled
+ * buffers are handled correctly */
+static size_t
+read_pointings(void * user_data, double * theta, double * phi,
+	       size_t max_num_of_samples)
+{
+    reader_state_t * state = user_data;
+    size_t num_of_samples = state->chunk_size % max_num_of_samples + 1;
+    if(num_of_samples > NUM_OF_SAMPLES - state->next_sample)
+	num_of_samples = NUM_OF_SAMPLES - state->next_sample;
+
+    for(size_t idx = 0; idx < num_of_samples; ++idx)
+    {
+	theta[idx] = sample_theta(state->next_sample + idx);
+	phi[idx] = sample_phi(state->next_sample + idx);
+    }
+
+    state->next_sample += num_of_samples;
+    state->chunk_size += 137;
+    return num_of_samples;
+}
+
+/**********************************************************************/
+
+typedef struct {
+    const hpix_resolution_t * resolution;
+    size_t next_sample;
+    int errors;
+} consumer_state_t;
+
+static void
+consume_pixels(void * user_data,
+	       const hpix_pixel_num_t * pixels,
+	       const double * theta,
+	       const double * phi,
+	       size_t first_sample,
+	       size_t num_of_samples)
+{
+    consumer_state_t * state = user_data;
+
+    /* Chunks must arrive in order */
+    if(first_sample != state->next_sample)
+	state->errors++;
+
+    for(size_t idx = 0; idx < num_of_samples; ++idx)
+    {
+	const size_t index = first_sample + idx;
+	if(theta[idx] != sample_theta(index)
+	   || phi[idx] != sample_phi(index)
+	   || pixels[idx] != hpix_angles_to_nest_pixel(state->resolution,
+						       theta[idx], phi[idx]))
+	    state->errors++;
+    }
+
+    state->next_sample += num_of_samples;
+}
+
+/**********************************************************************/
+
+START_TEST(pipeline_conversion)
+{
+    hpix_resolution_t * resolution = hpix_create_resolution(64);
+    hpix_pointing_pipeline_t * pipeline =
+	hpix_create_pointing_pipeline(64, HPIX_ORDER_SCHEME_NEST, 4, 4096);
+
+    /* Run the pipeline twice, to check that it can be reused */
+    for(int run = 0; run < 2; ++run)
+    {
+	reader_state_t reader_state = { 0, 1000 };
+	consumer_state_t consumer_state = { resolution, 0, 0 };
+
+	size_t num_of_samples =
+	    hpix_run_pointing_pipeline(pipeline,
+				       read_pointings, &reader_state,
+				       consume_pixels, &consumer_state);
+
+	ck_assert_int_eq(num_of_samples, NUM_OF_SAMPLES);
+	ck_assert_int_eq(consumer_state.next_sample, NUM_OF_SAMPLES);
+	ck_assert_int_eq(consumer_state.errors, 0);
+
+	const hpix_pipeline_stats_t * stats =
+	    hpix_pointing_pipeline_stats(pipeline);
+	ck_assert_int_eq(stats->num_of_samples, NUM_OF_SAMPLES);
+	fail_unless(stats->num_of_chunks > 0);
+	fail_unless(stats->wall_time >= 0.0);
+    }
+
+    hpix_free_pointing_pipeline(pipeline);
+    hpix_free_resolution(resolution);
+}
+END_TEST
+
+/**********************************************************************/
+
+static size_t
+read_nothing(void * user_data, double * theta, double * phi,
+	     size_t max_num_of_samples)
+{
+    return 0;
+}
+
+START_TEST(pipeline_empty_stream)
+{
+    hpix_resolution_t * resolution = hpix_create_resolution(64);
+    hpix_pointing_pipeline_t * pipeline =
+	hpix_create_pointing_pipeline(64, HPIX_ORDER_SCHEME_NEST, 2, 16);
+    consumer_state_t consumer_state = { resolution, 0, 0 };
+
+    ck_assert_int_eq(hpix_run_pointing_pipeline(pipeline,
+						read_nothing, NULL,
+						consume_pixels,
+						&consumer_state), 0);
+    ck_assert_int_eq(consumer_state.next_sample, 0);
+    ck_assert_int_eq(hpix_pointing_pipeline_stats(pipeline)->num_of_chunks, 0);
+
+    hpix_free_pointing_pipeline(pipeline);
+    hpix_free_resolution(resolution);
+}
+END_TEST
+
+/**********************************************************************/
+
+Suite *
+create_hpix_test_suite(void)
+{
+    Suite * suite = suite_create("Pointing pipelines");
+    TCase * tc_core = tcase_create("Pipeline");
+
+    tcase_add_test(tc_core, pipeline_conversion);
+    tcase_add_test(tc_core, pipeline_empty_stream);
+    suite_add_tcase(suite, tc_core);
+
+    return suite;
+}
+
+/**********************************************************************/
+
+int
+main(void)
+{
+    int number_failed;
+    Suite * suite = create_hpix_test_suite();
+    SRunner * runner = srunner_create(suite);
+    srunner_run_all(runner, CK_VERBOSE);
+    number_failed = srunner_ntests_failed(runner);
+    srunner_free(runner);
+
+    return (number_failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
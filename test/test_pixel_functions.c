@@ -354,6 +354,127 @@ END_TEST
 
 /**********************************************************************/
 
+START_TEST(ring_table)
+{
+    const hpix_nside_t nsides[] = { 1, 2, 16, 128 };
+
+    for(size_t nside_idx = 0; nside_idx < 4; ++nside_idx)
+    {
+	hpix_resolution_t * plain = hpix_create_resolution(nsides[nside_idx]);
+	hpix_resolution_t * cached = hpix_create_resolution(nsides[nside_idx]);
+	hpix_build_ring_table(cached);
+	fail_unless(cached->ring_table != NULL);
+
+	/* The table must agree with the functions that compute
+	 * everything on the fly */
+	for(hpix_pixel_num_t pixel = 0;
+	    pixel < hpix_num_of_pixels(plain);
+	    ++pixel)
+	{
+	    double theta1, phi1, theta2, phi2;
+	    hpix_ring_pixel_to_angles(plain, pixel, &theta1, &phi1);
+	    hpix_ring_pixel_to_angles(cached, pixel, &theta2, &phi2);
+	    TEST_FOR_CLOSENESS(theta1, theta2);
+	    TEST_FOR_CLOSENESS(phi1, phi2);
+
+	    hpix_vector_t vec1, vec2;
+	    hpix_ring_pixel_to_vector(plain, pixel, &vec1);
+	    hpix_ring_pixel_to_vector(cached, pixel, &vec2);
+	    TEST_FOR_CLOSENESS(vec1.x, vec2.x);
+	    TEST_FOR_CLOSENESS(vec1.y, vec2.y);
+	    TEST_FOR_CLOSENESS(vec1.z, vec2.z);
+
+	    ck_assert_int_eq(hpix_nest_to_ring_idx(plain, pixel),
+			     hpix_nest_to_ring_idx(cached, pixel));
+	}
+
+	/* Check that each ring starts where the previous one ends */
+	hpix_pixel_num_t next_pixel = 0;
+	for(unsigned int ring = 1; ring <= hpix_num_of_rings(plain); ++ring)
+	{
+	    hpix_ring_info_t info;
+	    hpix_ring_info(plain, ring, &info);
+	    ck_assert_int_eq(info.first_pixel, next_pixel);
+	    ck_assert_int_eq(hpix_ring_pixel_to_ring(plain, info.first_pixel),
+			     ring);
+	    next_pixel += info.num_of_pixels;
+	    ck_assert_int_eq(hpix_ring_pixel_to_ring(plain, next_pixel - 1),
+			     ring);
+	}
+	ck_assert_int_eq(next_pixel, hpix_num_of_pixels(plain));
+
+	hpix_free_resolution(plain);
+	hpix_free_resolution(cached);
+    }
+}
+END_TEST
+
+/**********************************************************************/
+
+START_TEST(pixel_ranges)
+{
+    hpix_resolution_t * resol = hpix_create_resolution(32);
+    const size_t num_of_pixels = hpix_num_of_pixels(resol);
+    double * x = malloc(num_of_pixels * sizeof(double));
+    double * y = malloc(num_of_pixels * sizeof(double));
+    double * z = malloc(num_of_pixels * sizeof(double));
+
+    const hpix_ordering_scheme_t schemes[] = {
+	HPIX_ORDER_SCHEME_RING, HPIX_ORDER_SCHEME_NEST
+    };
+    hpix_pixel_to_vector * pixel_to_vector_fns[] = {
+	hpix_ring_pixel_to_vector, hpix_nest_pixel_to_vector
+    };
+    hpix_pixel_to_angles * pixel_to_angles_fns[] = {
+	hpix_ring_pixel_to_angles, hpix_nest_pixel_to_angles
+    };
+
+    /* The second range starts in the middle of a polar ring and ends
+     * in the middle of an equatorial ring */
+    const hpix_pixel_num_t first_pixels[] = { 0, 1000 };
+    const size_t counts[] = { num_of_pixels, 3000 };
+
+    for(size_t scheme_idx = 0; scheme_idx < 2; ++scheme_idx)
+    {
+	for(size_t range_idx = 0; range_idx < 2; ++range_idx)
+	{
+	    const hpix_pixel_num_t first = first_pixels[range_idx];
+	    const size_t count = counts[range_idx];
+
+	    hpix_pixel_range_to_vectors(resol, schemes[scheme_idx],
+					first, count, x, y, z);
+	    for(size_t idx = 0; idx < count; ++idx)
+	    {
+		hpix_vector_t vector;
+		pixel_to_vector_fns[scheme_idx](resol, first + idx, &vector);
+		TEST_FOR_CLOSENESS(x[idx], vector.x);
+		TEST_FOR_CLOSENESS(y[idx], vector.y);
+		TEST_FOR_CLOSENESS(z[idx], vector.z);
+	    }
+
+	    /* Reuse x and y for theta and phi */
+	    hpix_pixel_range_to_angles(resol, schemes[scheme_idx],
+				       first, count, x, y);
+	    for(size_t idx = 0; idx < count; ++idx)
+	    {
+		double theta, phi;
+		pixel_to_angles_fns[scheme_idx](resol, first + idx,
+						&theta, &phi);
+		TEST_FOR_CLOSENESS(x[idx], theta);
+		TEST_FOR_CLOSENESS(y[idx], phi);
+	    }
+	}
+    }
+
+    free(x);
+    free(y);
+    free(z);
+    hpix_free_resolution(resol);
+}
+END_TEST
+
+/**********************************************************************/
+
 hpix_map_t * map64 = NULL;
 hpix_map_t * map256 = NULL;
 hpix_map_t * map512 = NULL;
@@ -406,6 +527,30 @@ END_TEST
 
 /**********************************************************************/
 
+START_TEST(xyf_coordinates)
+{
+    unsigned int x, y, face_num;
+
+    /* The last pixel of each face is its northern corner */
+    hpix_nest_to_xyf(resol64, 64 * 64 * 5 - 1, &x, &y, &face_num);
+    ck_assert_int_eq(x, 63);
+    ck_assert_int_eq(y, 63);
+    ck_assert_int_eq(face_num, 4);
+    ck_assert_int_eq(hpix_xyf_to_nest(resol64, 0, 0, 11), 64 * 64 * 11);
+
+    for(hpix_pixel_num_t index = 0;
+	index < hpix_num_of_pixels(resol64);
+	++index)
+    {
+	hpix_nest_to_xyf(resol64, index, &x, &y, &face_num);
+	fail_unless(x < 64 && y < 64 && face_num < 12);
+	ck_assert_int_eq(hpix_xyf_to_nest(resol64, x, y, face_num), index);
+    }
+}
+END_TEST
+
+/**********************************************************************/
+
 START_TEST(switch_order)
 {
     /* A sample map with NSIDE = 2, assumed to be in RING ordering.
@@ -419,12 +564,12 @@ START_TEST(switch_order)
 			  40, 41, 42, 43, 44, 45, 46, 47 };
 
     /* The same map, but with NEST ordering */
-    double nest_idx[] = {  3,  7, 11, 15,  2,  1,  6,  5,
-			  10,  9, 14, 13, 19,  0, 23,  4,
-			  27,  8, 31, 12, 17, 22, 21, 26, 
-			  25, 30, 29, 18, 16, 35, 20, 39, 
-			  24, 43, 28, 47, 34, 33, 38, 37, 
-			  42, 41, 46, 45, 32, 36, 40, 44 };
+    double nest_idx[] = { 13,  5,  4,  0, 15,  7,  6,  1,
+			  17,  9,  8,  2, 19, 11, 10,  3,
+			  28, 20, 27, 12, 30, 22, 21, 14,
+			  32, 24, 23, 16, 34, 26, 25, 18,
+			  44, 37, 36, 29, 45, 39, 38, 31,
+			  46, 41, 40, 33, 47, 43, 42, 35 };
 
     const size_t num_of_pixels = 48;
     hpix_map_t * map =
@@ -472,6 +617,9 @@ add_pixel_tests_to_testcase(TCase * testcase)
 
     tcase_add_test(testcase, vectors_to_pixels);
     tcase_add_test(testcase, pixels_to_vectors);
+
+    tcase_add_test(testcase, ring_table);
+    tcase_add_test(testcase, pixel_ranges);
 }
 
 /**********************************************************************/
@@ -485,6 +633,7 @@ add_pixel_order_tests_to_testcase(TCase * testcase)
 
     tcase_add_test(testcase, nest_to_ring);
     tcase_add_test(testcase, ring_to_nest);
+    tcase_add_test(testcase, xyf_coordinates);
 }
 
 /**********************************************************************/
@@ -20,11 +20,13 @@
 #include <stdlib.h>
 #include <check.h>
 #include "check_helpers.h"
+#include "constants.h"
 
 #define PROJ_WIDTH 1000
 #define PROJ_HEIGHT 500
 hpix_bmp_projection_t * mollweide_proj = NULL;
 hpix_bmp_projection_t * equirectangular_proj = NULL;
+hpix_bmp_projection_t * zoom_proj = NULL;
 
 /**********************************************************************/
 
@@ -90,6 +92,70 @@ END_TEST
 
 START_TEST(mollweide_angles_to_xy)
 {
+    double x, y;
+
+    /* Middle point and poles */
+    fail_unless(hpix_mollweide_angles_to_xy(mollweide_proj,
+					    M_PI_2, 0.0, &x, &y));
+    TEST_FOR_CLOSENESS(x, (PROJ_WIDTH / 2.0));
+    TEST_FOR_CLOSENESS(y, (PROJ_HEIGHT / 2.0));
+
+    hpix_mollweide_angles_to_xy(mollweide_proj, 0.0, 1.0, &x, &y);
+    TEST_FOR_CLOSENESS(x, (PROJ_WIDTH / 2.0));
+    TEST_FOR_CLOSENESS(y, PROJ_HEIGHT);
+
+    hpix_mollweide_angles_to_xy(mollweide_proj, M_PI, 1.0, &x, &y);
+    TEST_FOR_CLOSENESS(x, (PROJ_WIDTH / 2.0));
+    TEST_FOR_CLOSENESS(y, 0.0);
+
+    /* Check that the forward projection inverts
+     * hpix_mollweide_xy_to_angles everywhere within the ellipse,
+     * using both the single-point and the batch functions */
+    const size_t max_points = PROJ_WIDTH * PROJ_HEIGHT / 49 + 1;
+    double * theta = malloc(max_points * sizeof(double));
+    double * phi = malloc(max_points * sizeof(double));
+    double * batch_x = malloc(max_points * sizeof(double));
+    double * batch_y = malloc(max_points * sizeof(double));
+    unsigned int * ref_x = malloc(max_points * sizeof(unsigned int));
+    unsigned int * ref_y = malloc(max_points * sizeof(unsigned int));
+    size_t num_of_points = 0;
+
+    for(unsigned int cur_y = 1; cur_y < PROJ_HEIGHT; cur_y += 7)
+    {
+	for(unsigned int cur_x = 3; cur_x < PROJ_WIDTH; cur_x += 7)
+	{
+	    if(! hpix_mollweide_xy_to_angles(mollweide_proj, cur_x, cur_y,
+					     &theta[num_of_points],
+					     &phi[num_of_points]))
+		continue;
+
+	    ref_x[num_of_points] = cur_x;
+	    ref_y[num_of_points] = cur_y;
+	    ++num_of_points;
+	}
+    }
+
+    ck_assert_int_eq(hpix_mollweide_angles_to_xy_batch(mollweide_proj,
+						       theta, phi,
+						       num_of_points,
+						       batch_x, batch_y),
+		     num_of_points);
+    for(size_t idx = 0; idx < num_of_points; ++idx)
+    {
+	hpix_mollweide_angles_to_xy(mollweide_proj, theta[idx], phi[idx],
+				    &x, &y);
+	fail_unless(fabs(x - ref_x[idx]) < 1e-6 && fabs(y - ref_y[idx]) < 1e-6,
+		    "Wrong projection for (%u, %u): (%f, %f)",
+		    ref_x[idx], ref_y[idx], x, y);
+	fail_unless(x == batch_x[idx] && y == batch_y[idx]);
+    }
+
+    free(theta);
+    free(phi);
+    free(batch_x);
+    free(batch_y);
+    free(ref_x);
+    free(ref_y);
 }
 END_TEST
 
@@ -154,6 +220,205 @@ END_TEST
 
 START_TEST(equirectangular_angles_to_xy)
 {
+    double x, y;
+
+    fail_unless(hpix_equirectangular_angles_to_xy(equirectangular_proj,
+						  1.5707963267948966,
+						  3.14159265358979323848,
+						  &x, &y));
+    TEST_FOR_CLOSENESS(x, (PROJ_WIDTH / 2.0));
+    TEST_FOR_CLOSENESS(y, (PROJ_HEIGHT / 2.0));
+
+    hpix_equirectangular_angles_to_xy(equirectangular_proj,
+				      0.78539816339744830962,
+				      1.57079632679489661924,
+				      &x, &y);
+    TEST_FOR_CLOSENESS(x, (PROJ_WIDTH / 4.0));
+    TEST_FOR_CLOSENESS(y, (PROJ_HEIGHT / 4.0));
+
+    /* Negative longitudes must be wrapped */
+    hpix_equirectangular_angles_to_xy(equirectangular_proj,
+				      0.78539816339744830962,
+				      -1.57079632679489661924,
+				      &x, &y);
+    TEST_FOR_CLOSENESS(x, (PROJ_WIDTH * 3.0 / 4.0));
+
+    /* The batch function falls back to the single-point one */
+    const double theta[] = { 0.78539816339744830962, 1.8849555922 };
+    const double phi[] = { 1.57079632679489661924, 4.1846014146 };
+    double batch_x[2], batch_y[2];
+    ck_assert_int_eq(hpix_bmp_projection_angles_to_xy_batch(equirectangular_proj,
+							     theta, phi, 2,
+							     batch_x, batch_y),
+		     2);
+    TEST_FOR_CLOSENESS(batch_x[0], (PROJ_WIDTH / 4.0));
+    fail_unless(fabs(batch_x[1] - PROJ_WIDTH / 3 * 2) < 1e-6);
+    fail_unless(fabs(batch_y[1] - PROJ_HEIGHT / 5 * 3) < 1e-6);
+}
+END_TEST
+
+/**********************************************************************/
+
+
+void
+setup_zoom(void)
+{
+    zoom_proj = hpix_create_bmp_projection(PROJ_WIDTH, PROJ_HEIGHT);
+}
+
+/**********************************************************************/
+
+
+void
+teardown_zoom(void)
+{
+    hpix_free_bmp_projection(zoom_proj);
+}
+
+/**********************************************************************/
+
+static double
+angular_distance(double theta1, double phi1, double theta2, double phi2)
+{
+    hpix_vector_t vector1, vector2;
+
+    hpix_angles_to_vector(theta1, phi1, &vector1);
+    hpix_angles_to_vector(theta2, phi2, &vector2);
+    return acos(hpix_dot_product(&vector1, &vector2));
+}
+
+/**********************************************************************/
+
+/* Check that the center of a bitmap points towards (theta, phi), and
+ * that a few points survive a round trip through the inverse and the
+ * forward projection */
+static void
+check_round_trip(hpix_bmp_projection_t * proj, double theta0, double phi0)
+{
+    const unsigned int points[][2] = {
+	{ PROJ_WIDTH / 2, PROJ_HEIGHT / 2 },
+	{ PROJ_WIDTH / 2 + 100, PROJ_HEIGHT / 2 },
+	{ PROJ_WIDTH / 2 - 30, PROJ_HEIGHT / 2 + 170 },
+	{ PROJ_WIDTH / 2 + 200, PROJ_HEIGHT / 2 - 100 }
+    };
+    double theta, phi, x, y;
+
+    fail_unless(hpix_bmp_projection_xy_to_angles(proj,
+						 PROJ_WIDTH / 2,
+						 PROJ_HEIGHT / 2,
+						 &theta, &phi));
+    TEST_FOR_CLOSENESS(theta, theta0);
+    TEST_FOR_CLOSENESS(phi, phi0);
+
+    for(size_t idx = 0; idx < sizeof(points) / sizeof(points[0]); ++idx)
+    {
+	fail_unless(hpix_bmp_projection_xy_to_angles(proj,
+						     points[idx][0],
+						     points[idx][1],
+						     &theta, &phi));
+	fail_unless(hpix_bmp_projection_angles_to_xy(proj, theta, phi,
+						     &x, &y));
+	fail_unless(fabs(x - points[idx][0]) < 1e-6
+		    && fabs(y - points[idx][1]) < 1e-6,
+		    "Round trip failed for point (%u, %u): (%f, %f)",
+		    points[idx][0], points[idx][1], x, y);
+    }
+}
+
+/**********************************************************************/
+
+START_TEST(gnomonic_projection)
+{
+    double theta, phi, x, y;
+
+    hpix_set_gnomonic_projection(zoom_proj, 1.0, 4.0, M_PI / 18);
+    fail_unless(hpix_bmp_projection_type(zoom_proj) == HPIX_PROJ_GNOMONIC);
+    check_round_trip(zoom_proj, 1.0, 4.0);
+
+    /* The width of the bitmap covers the field of view */
+    hpix_gnomonic_xy_to_angles(zoom_proj, 0, PROJ_HEIGHT / 2, &theta, &phi);
+    TEST_FOR_CLOSENESS(angular_distance(theta, phi,
+							      1.0, 4.0),
+		       M_PI / 36);
+    /* Longitudes increase towards the left, latitudes towards the top */
+    fail_unless(phi > 4.0);
+    hpix_gnomonic_xy_to_angles(zoom_proj, PROJ_WIDTH / 2, PROJ_HEIGHT - 1,
+			       &theta, &phi);
+    fail_unless(theta < 1.0);
+
+    /* The antipode and points far from the center are not visible */
+    fail_unless(! hpix_gnomonic_angles_to_xy(zoom_proj,
+					     M_PI - 1.0, 4.0 - M_PI,
+					     &x, &y));
+    fail_unless(! hpix_gnomonic_angles_to_xy(zoom_proj, 1.5, 4.0, &x, &y));
+
+    /* Centering the projection on a pole must work too */
+    hpix_set_gnomonic_projection(zoom_proj, 0.0, 0.0, M_PI / 18);
+    hpix_gnomonic_xy_to_angles(zoom_proj, PROJ_WIDTH / 2, PROJ_HEIGHT / 2,
+			       &theta, &phi);
+    TEST_FOR_CLOSENESS(theta, 0.0);
+}
+END_TEST
+
+/**********************************************************************/
+
+START_TEST(orthographic_projection)
+{
+    double theta, phi, x, y;
+
+    hpix_set_orthographic_projection(zoom_proj, 2.0, 0.5);
+    fail_unless(hpix_bmp_projection_type(zoom_proj) == HPIX_PROJ_ORTHOGRAPHIC);
+    check_round_trip(zoom_proj, 2.0, 0.5);
+
+    /* The hemisphere is a disc inscribed in the bitmap */
+    fail_unless(! hpix_orthographic_is_xy_inside(zoom_proj, 0, 0));
+    fail_unless(! hpix_orthographic_xy_to_angles(zoom_proj,
+						 PROJ_WIDTH / 2 - PROJ_HEIGHT / 2 - 1,
+						 PROJ_HEIGHT / 2,
+						 &theta, &phi));
+    fail_unless(hpix_orthographic_xy_to_angles(zoom_proj,
+					       PROJ_WIDTH / 2 - PROJ_HEIGHT / 2 + 1,
+					       PROJ_HEIGHT / 2,
+					       &theta, &phi));
+    fail_unless(angular_distance(theta, phi, 2.0, 0.5)
+		> 0.45 * M_PI);
+
+    fail_unless(! hpix_orthographic_angles_to_xy(zoom_proj,
+						 M_PI - 2.0, 0.5 + M_PI,
+						 &x, &y));
+}
+END_TEST
+
+/**********************************************************************/
+
+START_TEST(cartesian_projection)
+{
+    double theta, phi, x, y;
+
+    /* This box crosses the meridian phi = 0 */
+    hpix_set_cartesian_projection(zoom_proj, -0.2, 0.3, -0.1, 0.15);
+    fail_unless(hpix_bmp_projection_type(zoom_proj) == HPIX_PROJ_CARTESIAN);
+
+    hpix_cartesian_xy_to_angles(zoom_proj, 0, 0, &theta, &phi);
+    TEST_FOR_CLOSENESS(theta, (M_PI_2 + 0.1));
+    TEST_FOR_CLOSENESS(phi, 0.3);
+
+    hpix_cartesian_xy_to_angles(zoom_proj, PROJ_WIDTH / 2, PROJ_HEIGHT / 2,
+				&theta, &phi);
+    TEST_FOR_CLOSENESS(theta, (M_PI_2 - 0.025));
+    TEST_FOR_CLOSENESS(phi, 0.05);
+
+    hpix_cartesian_xy_to_angles(zoom_proj, PROJ_WIDTH * 4 / 5, 0,
+				&theta, &phi);
+    TEST_FOR_CLOSENESS(phi, (2.0 * M_PI - 0.1));
+
+    fail_unless(hpix_cartesian_angles_to_xy(zoom_proj, M_PI_2, 2.0 * M_PI - 0.1,
+					    &x, &y));
+    TEST_FOR_CLOSENESS(x, PROJ_WIDTH * 4 / 5);
+    TEST_FOR_CLOSENESS(y, (PROJ_HEIGHT * 0.4));
+
+    fail_unless(! hpix_cartesian_angles_to_xy(zoom_proj, M_PI_2, 1.0, &x, &y));
+    fail_unless(! hpix_cartesian_angles_to_xy(zoom_proj, 0.5, 0.0, &x, &y));
 }
 END_TEST
 
@@ -181,6 +446,15 @@ create_hpix_test_suite(void)
     tcase_add_test(tc_core, equirectangular_angles_to_xy);
     suite_add_tcase(suite, tc_core);
 
+    tc_core = tcase_create("Zoomed projections");
+    tcase_add_checked_fixture(tc_core,
+			      setup_zoom,
+			      teardown_zoom);
+    tcase_add_test(tc_core, gnomonic_projection);
+    tcase_add_test(tc_core, orthographic_projection);
+    tcase_add_test(tc_core, cartesian_projection);
+    suite_add_tcase(suite, tc_core);
+
     return suite;
 }
 
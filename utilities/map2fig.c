@@ -48,6 +48,11 @@
 #include <cairo-svg.h>
 
 #include "gopt.h"
+#include "walltime_c.h"
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
 /* Used to print information/error/warning messages */
 #define MSG_HEADER   "map2fig: "
@@ -128,6 +133,10 @@ const char * number_format = "%g";
 
 const char * input_file_name = NULL;
 
+/* Name of the file listing the maps to draw in batch mode, set by
+ * `--batch` */
+const char * batch_file_name = NULL;
+
 /* Number of the column to display, set by `-c`, `--column` */
 unsigned short column_number = 1;
 
@@ -163,6 +172,29 @@ typedef struct {
     double width, height;
 } rect_t;
 
+/* Everything needed to draw a map which does not depend on the map
+ * itself. In batch mode (see `--batch`) this is computed once and
+ * reused for all the maps, as they share the same layout. The
+ * projection plan is rebuilt only when NSIDE or the ordering scheme
+ * change. */
+typedef struct {
+    rect_t title_rect;
+    rect_t map_rect;
+    rect_t colorbar_rect;
+    hpix_color_palette_t * palette;
+    hpix_palette_lut_t * lut;
+    hpix_bmp_projection_t * projection;
+    hpix_bmp_projection_plan_t * plan;
+} figure_layout_t;
+
+/* Time (in seconds) spent in each stage of the drawing of one map */
+typedef struct {
+    double load_time;
+    double plan_time;
+    double render_time;
+    double write_time;
+} stage_timing_t;
+
 typedef enum { PAL_NULL, PAL_HEALPIX, PAL_GRAYSCALE, PAL_PLANCK }
     palette_type_code_t;
 
@@ -214,7 +246,8 @@ hpix_projection_type_t projection_type_code = HPIX_PROJ_MOLLWEIDE;
 void
 print_usage(const char * program_name)
 {
-    printf("Usage: %s [OPTIONS] INPUT_MAP\n\n", program_name);
+    printf("Usage: %s [OPTIONS] INPUT_MAP\n", program_name);
+    printf("       %s [OPTIONS] --batch=FILE\n\n", program_name);
     puts("OPTIONS can be one or more of the following:");
     puts("");
     puts("Input/output");
@@ -224,6 +257,9 @@ print_usage(const char * program_name)
     puts("  -f, --format=STRING       Format of the output image file");
     puts("  --list-formats            Print a list of the file formats that");
     puts("                            can be specified with --format");
+    puts("  --batch=FILE              Draw all the maps listed in FILE, each");
+    puts("                            line containing the name of the input");
+    puts("                            map and of the output file");
     puts("");
     puts("Range of values");
     puts("  -s, --scale=NUM           Multiply the pixel values by NUM");
@@ -492,7 +528,8 @@ parse_command_line(int argc, const char ** argv)
 		      gopt_option('2', GOPT_ARG, gopt_shorts(0), gopt_longs("title-font-size")),
 		      gopt_option('f', GOPT_ARG, gopt_shorts('f'), gopt_longs("format")),
 		      gopt_option('p', GOPT_ARG, gopt_shorts('p'), gopt_longs("palette")),
-		      gopt_option('j', GOPT_ARG, gopt_shorts('j'), gopt_longs("projection"))));
+		      gopt_option('j', GOPT_ARG, gopt_shorts('j'), gopt_longs("projection")),
+		      gopt_option('T', GOPT_ARG, gopt_shorts(0), gopt_longs("batch"))));
 
     /* --help */
     if(gopt(options, 'h'))
@@ -610,20 +647,32 @@ parse_command_line(int argc, const char ** argv)
     gopt_arg(options, 't', &title_str);
     /* --output FILE */
     gopt_arg(options, 'o', &output_file_name);
+    /* --batch FILE */
+    gopt_arg(options, 'T', &batch_file_name);
 
     gopt_free(options);
 
     /* NOTE: in this version, there must be only input parameter! This
-     * is the name of the FITS file containing the map to draw. */
+     * is the name of the FITS file containing the map to draw. In
+     * batch mode, input and output files are read from the list. */
 
-    if(argc > 2)
+    if(batch_file_name != NULL)
+    {
+	if(argc > 1 || output_file_name != NULL)
+	{
+	    fputs(MSG_HEADER "input and output files cannot be specified "
+		  "together with --batch\n", stderr);
+	    exit(EXIT_FAILURE);
+	}
+    }
+    else if(argc > 2)
     {
 	fputs(MSG_HEADER "too many command-line arguments (hint: use --help)\n",
 	      stderr);
 	exit(EXIT_FAILURE);
     }
 
-    if(argc < 2)
+    else if(argc < 2)
     {
 	fprintf(stderr,
 		MSG_HEADER "reading maps from stdin is not supported yet\n"
@@ -686,25 +735,28 @@ parse_command_line(int argc, const char ** argv)
 	exit(EXIT_FAILURE);
     }
 
-    input_file_name = argv[1];
+    if(batch_file_name == NULL)
+	input_file_name = argv[1];
 }
 
 /******************************************************************************/
 
 
+/* Load the map from `file_name' and apply --remove-monopole, --log10
+ * and --scale to it. Return NULL if the file cannot be read. */
 hpix_map_t *
-load_map_and_rescale_if_needed(void)
+load_map_and_rescale_if_needed(const char * file_name)
 {
     hpix_map_t * result;
     int status = 0;
 
-    if(! hpix_load_fits_component_from_file(input_file_name,
+    if(! hpix_load_fits_component_from_file(file_name,
 					    column_number,
 					    &result, &status))
     {
 	fprintf(stderr, MSG_HEADER "unable to load file '%s'\n",
-		input_file_name);
-	exit(EXIT_FAILURE);
+		file_name);
+	return NULL;
     }
 
     /* Remove the monopole */
@@ -914,26 +966,22 @@ nice_number(double num, int round_flag)
  * values of `min' and `max' specify the minimum and maximum values to
  * be used in plotting the map, and are used to set the color scale.
  * This function is a nice wrapper around
- * `plot_bitmap_to_cairo_surface', which is more low-level because (1)
- * it fills the whole Cairo surface, and (2) it fills the whole
- * rectangular surface, instead of just an ellipse. (The latter seems
- * to be due to a bug in Cairo.) */
+ * `hpix_bmp_projection_plan_to_cairo_surface', which is more
+ * low-level because (1) it fills the whole Cairo surface, and (2) it
+ * fills the whole rectangular surface, instead of just an ellipse.
+ * (The latter seems to be due to a bug in Cairo.) The projection plan
+ * in `layout' must match the resolution of `map'. */
 void
 paint_map(cairo_t * context, const rect_t * map_rect,
-	  const hpix_color_palette_t * palette,
+	  const figure_layout_t * layout,
 	  const hpix_map_t * map, double min, double max)
 {
-    hpix_bmp_projection_t * projection;
     cairo_surface_t * map_surface;
 
     /* First produce a cairo image surface with the map in it */
-    projection = hpix_create_bmp_projection((int) (bitmap_columns + .5),
-					    (int) (bitmap_rows + .5));
-    configure_projection(projection);
-
     map_surface =
-	hpix_bmp_projection_to_cairo_surface(projection, palette,
-					     map, min, max);
+	hpix_bmp_projection_plan_to_cairo_surface(layout->plan, layout->lut,
+						  map, min, max);
 
     /* Now copy the cairo surface into the surface we're currently
      * using to draw the figure */
@@ -957,7 +1005,7 @@ paint_map(cairo_t * context, const rect_t * map_rect,
 		cairo_image_surface_get_width(map_surface) / 2.0,
 		cairo_image_surface_get_height(map_surface) / 2.0);
     
-    if(hpix_bmp_projection_type(projection) == HPIX_PROJ_MOLLWEIDE)
+    if(hpix_bmp_projection_type(layout->projection) == HPIX_PROJ_MOLLWEIDE)
     {
 	/* Fill an ellipse with the content of `map_surface'. */
 	cairo_arc(context, 0.0, 0.0, 1.0, 0.0, 2 * M_PI);
@@ -974,7 +1022,6 @@ paint_map(cairo_t * context, const rect_t * map_rect,
     
     /* Cleanup */
     cairo_surface_destroy(map_surface);
-    hpix_free_bmp_projection(projection);
 }
 
 /******************************************************************************/
@@ -1164,7 +1211,7 @@ paint_colorbar(cairo_t * context,
 /* Wrapper to one of the cairo_*_surface_create function, depending on
  * the output format chosen by the user (--format). */
 cairo_surface_t *
-create_surface(double width, double height)
+create_surface(const char * file_name, double width, double height)
 {
     cairo_surface_t * surface;
 
@@ -1175,13 +1222,12 @@ create_surface(double width, double height)
 					     ? CAIRO_FORMAT_ARGB32
 					     : CAIRO_FORMAT_RGB24,
 					     width, height);
-	bitmap_columns = width;
 	break;
 
 #if CAIRO_HAS_PS_SURFACE
     case FMT_PS:
     case FMT_EPS:
-	surface = cairo_ps_surface_create(output_file_name,
+	surface = cairo_ps_surface_create(file_name,
 					     width, height);
 	if(output_format == FMT_EPS)
 	    cairo_ps_surface_set_eps(surface, TRUE);
@@ -1190,14 +1236,14 @@ create_surface(double width, double height)
 
 #if CAIRO_HAS_PDF_SURFACE
     case FMT_PDF:
-	surface = cairo_pdf_surface_create(output_file_name,
+	surface = cairo_pdf_surface_create(file_name,
 					     width, height);
 	break;
 #endif
 
 #if CAIRO_HAS_SVG_SURFACE
     case FMT_SVG:
-	surface = cairo_svg_surface_create(output_file_name,
+	surface = cairo_svg_surface_create(file_name,
 					     width, height);
 	break;
 #endif
@@ -1262,11 +1308,98 @@ lay_out_page(rect_t * title_rect, rect_t * map_rect, rect_t * colorbar_rect)
 /******************************************************************************/
 
 
+/* Compute everything in `layout' that does not depend on the map to
+ * be drawn. The projection plan is left empty, as it is computed by
+ * `update_projection_plan' once the resolution of the map is known. */
+void
+init_figure_layout(figure_layout_t * layout)
+{
+    assert(layout != NULL);
+
+    if(output_format == FMT_PNG)
+	bitmap_columns = image_width;
+
+    lay_out_page(&layout->title_rect,
+		 &layout->map_rect,
+		 &layout->colorbar_rect);
+
+    if(output_format == FMT_PNG)
+	bitmap_rows = layout->map_rect.height;
+
+    layout->palette = create_palette();
+    layout->lut = hpix_create_palette_lut(layout->palette,
+					  HPIX_PALETTE_LUT_DEFAULT_SIZE);
+
+    layout->projection =
+	hpix_create_bmp_projection((int) (bitmap_columns + .5),
+				   (int) (bitmap_rows + .5));
+    configure_projection(layout->projection);
+
+    layout->plan = NULL;
+}
+
+/******************************************************************************/
+
+
+void
+free_figure_layout(figure_layout_t * layout)
+{
+    assert(layout != NULL);
+
+    hpix_free_bmp_projection_plan(layout->plan);
+    hpix_free_bmp_projection(layout->projection);
+    hpix_free_palette_lut(layout->lut);
+    hpix_free_color_palette(layout->palette);
+}
+
+/******************************************************************************/
+
+
+/* Make sure that the projection plan in `layout' can be used with
+ * `map'. The plan is recomputed only if this is the first map or if
+ * NSIDE or the ordering scheme of `map' differ from the previous one. */
 void
-paint_and_save_figure(const hpix_map_t * map)
+update_projection_plan(figure_layout_t * layout, const hpix_map_t * map)
+{
+    const hpix_nside_t nside = hpix_map_nside(map);
+    const hpix_ordering_scheme_t scheme = hpix_map_ordering_scheme(map);
+
+    if(layout->plan != NULL
+       && hpix_bmp_projection_plan_nside(layout->plan) == nside
+       && hpix_bmp_projection_plan_scheme(layout->plan) == scheme)
+	return;
+
+    if(verbose_flag)
+	fprintf(stderr, MSG_HEADER "computing the projection plan "
+		"for NSIDE = %u\n", (unsigned) nside);
+
+    hpix_free_bmp_projection_plan(layout->plan);
+    layout->plan = hpix_create_bmp_projection_plan(layout->projection,
+						   nside, scheme);
+}
+
+/******************************************************************************/
+
+
+/* Draw `map' and save it into `file_name', using the layout computed
+ * by `init_figure_layout'. The time spent in each stage is saved in
+ * `timing' (except for the load time). Return 1 if the figure has
+ * been saved successfully, 0 otherwise. */
+int
+paint_and_save_figure(figure_layout_t * layout,
+		      const hpix_map_t * map,
+		      const char * file_name,
+		      stage_timing_t * timing)
 {
     double min, max;
+    double start;
+    int result = 1;
 
+    start = wallTime();
+    update_projection_plan(layout, map);
+    timing->plan_time = wallTime() - start;
+
+    start = wallTime();
     find_map_extrema(map, &min, &max);
     if(! isnan(min_value))
 	min = min_value;
@@ -1283,25 +1416,25 @@ paint_and_save_figure(const hpix_map_t * map)
      * 1. Create a surface of the appropriate type (e.g. PS, PDF...)
      * 2. Fill the background (unless --no-background was used)
      * 3. Draw the title
-     * 4. Use `plot_bitmap_to_cairo_surface` to create another
-     *    (bitmapped) surface containing the Mollview projection of
-     *    the map
+     * 4. Use `hpix_bmp_projection_plan_to_cairo_surface` to create
+     *    another (bitmapped) surface containing the Mollview
+     *    projection of the map
      * 5. Copy the surface with the Mollview projection into the "big"
      *    surface created in 1.
      * 6. Draw the color bar 
      * 7. Save the result
      */
-    cairo_surface_t * surface = create_surface(image_width, image_height);
-    cairo_t * context = cairo_create(surface);
-
-    rect_t title_rect;
-    rect_t map_rect;
-    rect_t colorbar_rect;
-
-    lay_out_page(&title_rect, &map_rect, &colorbar_rect);
+    cairo_surface_t * surface = create_surface(file_name,
+					       image_width, image_height);
+    if(cairo_surface_status(surface) != CAIRO_STATUS_SUCCESS)
+    {
+	fprintf(stderr, MSG_HEADER "unable to create file '%s'\n",
+		file_name);
+	cairo_surface_destroy(surface);
+	return 0;
+    }
 
-    if(output_format == FMT_PNG)
-	bitmap_rows = map_rect.height;
+    cairo_t * context = cairo_create(surface);
 
     /* Draw the background */
     if(no_background_flag)
@@ -1315,34 +1448,258 @@ paint_and_save_figure(const hpix_map_t * map)
 	cairo_paint(context);
     }
 
-    if(title_rect.height > 0.0)
-	paint_title(context, &title_rect);
+    if(layout->title_rect.height > 0.0)
+	paint_title(context, &layout->title_rect);
 
-    hpix_color_palette_t * palette = create_palette();
-    paint_map(context, &map_rect, palette, map, min, max);
+    paint_map(context, &layout->map_rect, layout, map, min, max);
 
-    if(colorbar_rect.height > 0.0)
-	paint_colorbar(context, &colorbar_rect, palette, min, max);
-    hpix_free_color_palette(palette);
+    if(layout->colorbar_rect.height > 0.0)
+	paint_colorbar(context, &layout->colorbar_rect, layout->palette,
+		       min, max);
+    timing->render_time = wallTime() - start;
 
+    start = wallTime();
     if(output_format == FMT_PNG)
     {
 	fprintf(stderr, MSG_HEADER "writing the file to `%s'\n",
-		output_file_name);
-	if(cairo_surface_write_to_png(surface, output_file_name)
+		file_name);
+	if(cairo_surface_write_to_png(surface, file_name)
 	   != CAIRO_STATUS_SUCCESS)
 	{
 	    fprintf(stderr, MSG_HEADER "unable to write to file '%s'\n",
-		    output_file_name);
-	    exit(EXIT_FAILURE);
+		    file_name);
+	    result = 0;
 	}
-	fputs(MSG_HEADER "file has been written successfully\n", stderr);
+	else
+	    fputs(MSG_HEADER "file has been written successfully\n", stderr);
     } else {
 	cairo_show_page(context);
     }
 
     cairo_destroy(context);
+    /* Vector formats are written to disk at this point */
+    cairo_surface_finish(surface);
+    if(cairo_surface_status(surface) != CAIRO_STATUS_SUCCESS)
+    {
+	fprintf(stderr, MSG_HEADER "unable to write to file '%s'\n",
+		file_name);
+	result = 0;
+    }
     cairo_surface_destroy(surface);
+    timing->write_time = wallTime() - start;
+
+    return result;
+}
+
+/******************************************************************************/
+
+
+void
+print_stage_timing(const char * file_name, const stage_timing_t * timing)
+{
+    fprintf(stderr,
+	    MSG_HEADER "`%s': load %.3f s, plan %.3f s, "
+	    "render %.3f s, write %.3f s\n",
+	    file_name,
+	    timing->load_time, timing->plan_time,
+	    timing->render_time, timing->write_time);
+}
+
+/******************************************************************************/
+
+
+/* One line of the file passed to `--batch` */
+typedef struct {
+    char * input_file_name;
+    char * output_file_name;
+} batch_entry_t;
+
+/******************************************************************************/
+
+
+char *
+copy_string(const char * str)
+{
+    char * result = malloc(strlen(str) + 1);
+    if(result == NULL)
+	abort();
+
+    strcpy(result, str);
+    return result;
+}
+
+/******************************************************************************/
+
+
+/* Read the list of maps to draw from `file_name' ("-" means standard
+ * input). Each line contains the name of the FITS file and the name
+ * of the output file, separated by spaces. Empty lines and lines
+ * starting with `#' are skipped. Exit with an error message if the
+ * file cannot be read or is malformed. */
+batch_entry_t *
+read_batch_file(const char * file_name, size_t * num_of_entries)
+{
+    FILE * in = (strcmp(file_name, "-") == 0) ? stdin : fopen(file_name, "rt");
+    batch_entry_t * entries = NULL;
+    size_t capacity = 0;
+    char line[2 * FILENAME_MAX + 2];
+    char input[FILENAME_MAX + 1];
+    char output[FILENAME_MAX + 1];
+    char format[32];
+    unsigned int line_number = 0;
+
+    if(in == NULL)
+    {
+	fprintf(stderr, MSG_HEADER "unable to open file '%s'\n", file_name);
+	exit(EXIT_FAILURE);
+    }
+
+    /* Build something like "%4096s %4096s" */
+    snprintf(format, sizeof(format), "%%%ds %%%ds",
+	     FILENAME_MAX, FILENAME_MAX);
+
+    *num_of_entries = 0;
+    while(fgets(line, sizeof(line), in) != NULL)
+    {
+	char dummy;
+	int num_of_fields;
+
+	++line_number;
+	if(sscanf(line, " %c", &dummy) != 1 || dummy == '#')
+	    continue;
+
+	num_of_fields = sscanf(line, format, input, output);
+	if(num_of_fields != 2)
+	{
+	    fprintf(stderr,
+		    MSG_HEADER "%s:%u: expected the name of the input map "
+		    "and of the output file\n",
+		    file_name, line_number);
+	    exit(EXIT_FAILURE);
+	}
+
+	if(*num_of_entries == capacity)
+	{
+	    capacity = (capacity == 0) ? 16 : 2 * capacity;
+	    entries = realloc(entries, capacity * sizeof(entries[0]));
+	    if(entries == NULL)
+		abort();
+	}
+
+	entries[*num_of_entries].input_file_name = copy_string(input);
+	entries[*num_of_entries].output_file_name = copy_string(output);
+	++(*num_of_entries);
+    }
+
+    if(in != stdin)
+	fclose(in);
+
+    return entries;
+}
+
+/******************************************************************************/
+
+
+/* Draw all the maps listed in the file passed to `--batch`. The
+ * layout, the palette and the projection plan are computed only once.
+ * While one map is being drawn, the next one is read from disk by
+ * another thread. Return the number of maps that could not be
+ * drawn. */
+unsigned int
+run_batch(const char * file_name)
+{
+    size_t num_of_entries;
+    batch_entry_t * entries = read_batch_file(file_name, &num_of_entries);
+    stage_timing_t * timings;
+    stage_timing_t total = { 0.0, 0.0, 0.0, 0.0 };
+    figure_layout_t layout;
+    hpix_map_t * next_map = NULL;
+    unsigned int num_of_failures = 0;
+    double start = wallTime();
+    size_t idx;
+
+    if(num_of_entries == 0)
+    {
+	fprintf(stderr, MSG_HEADER "no maps listed in '%s'\n", file_name);
+	return 0;
+    }
+
+    timings = calloc(num_of_entries, sizeof(timings[0]));
+    if(timings == NULL)
+	abort();
+
+    init_figure_layout(&layout);
+
+#ifdef _OPENMP
+    /* Loading runs in one of the two sections below, so the other
+     * section needs nested parallelism to render with all the
+     * threads. Reading a FITS file is mostly I/O, so the extra thread
+     * does not compete much for the CPU. */
+    omp_set_max_active_levels(2);
+#endif
+
+    timings[0].load_time = wallTime();
+    next_map = load_map_and_rescale_if_needed(entries[0].input_file_name);
+    timings[0].load_time = wallTime() - timings[0].load_time;
+
+    for(idx = 0; idx < num_of_entries; ++idx)
+    {
+	hpix_map_t * map = next_map;
+	next_map = NULL;
+
+#pragma omp parallel sections default(shared) num_threads(2)
+	{
+#pragma omp section
+	    {
+		if(idx + 1 < num_of_entries)
+		{
+		    double load_start = wallTime();
+		    next_map = load_map_and_rescale_if_needed(entries[idx + 1].input_file_name);
+		    timings[idx + 1].load_time = wallTime() - load_start;
+		}
+	    }
+
+#pragma omp section
+	    {
+		if(map == NULL
+		   || ! paint_and_save_figure(&layout, map,
+					      entries[idx].output_file_name,
+					      &timings[idx]))
+		    ++num_of_failures;
+	    }
+	}
+
+	if(verbose_flag)
+	    print_stage_timing(entries[idx].input_file_name, &timings[idx]);
+
+	total.load_time += timings[idx].load_time;
+	total.plan_time += timings[idx].plan_time;
+	total.render_time += timings[idx].render_time;
+	total.write_time += timings[idx].write_time;
+
+	hpix_free_map(map);
+    }
+
+    fprintf(stderr,
+	    MSG_HEADER "%u maps processed (%u failed) in %.3f s\n",
+	    (unsigned int) num_of_entries, num_of_failures,
+	    wallTime() - start);
+    fprintf(stderr,
+	    MSG_HEADER "total time per stage: load %.3f s (overlapped "
+	    "with drawing), plan %.3f s, render %.3f s, write %.3f s\n",
+	    total.load_time, total.plan_time,
+	    total.render_time, total.write_time);
+
+    free_figure_layout(&layout);
+    for(idx = 0; idx < num_of_entries; ++idx)
+    {
+	free(entries[idx].input_file_name);
+	free(entries[idx].output_file_name);
+    }
+    free(entries);
+    free(timings);
+
+    return num_of_failures;
 }
 
 /******************************************************************************/
@@ -1352,20 +1709,34 @@ int
 main(int argc, const char ** argv)
 {
     hpix_map_t * map;
+    figure_layout_t layout;
+    stage_timing_t timing;
+    int success;
 
     parse_command_line(argc, argv);
 
+    if(batch_file_name != NULL)
+	return run_batch(batch_file_name) == 0 ? 0 : EXIT_FAILURE;
+
     if(verbose_flag)
 	fprintf(stderr, MSG_HEADER "loading map `%s'\n", input_file_name);
-    map = load_map_and_rescale_if_needed();
+    timing.load_time = wallTime();
+    map = load_map_and_rescale_if_needed(input_file_name);
+    timing.load_time = wallTime() - timing.load_time;
+    if(map == NULL)
+	exit(EXIT_FAILURE);
     if(verbose_flag)
 	fprintf(stderr, MSG_HEADER "map loaded\n");
 
     if(verbose_flag)
 	fprintf(stderr, MSG_HEADER "painting map\n");
-    paint_and_save_figure(map);
+    init_figure_layout(&layout);
+    success = paint_and_save_figure(&layout, map, output_file_name, &timing);
+    if(verbose_flag)
+	print_stage_timing(input_file_name, &timing);
 
+    free_figure_layout(&layout);
     hpix_free_map(map);
 
-    return 0;
+    return success ? 0 : EXIT_FAILURE;
 }